@@ -1,28 +1,14 @@
 /* Dependencies */
-#include <avr/io.h>     // For I/O and other AVR registers
-#include <util/delay.h> // For timing
 #include <avr/pgmspace.h>
+#include "../Trahagean/YM2612.h" // Chip driver and board profiles
 #include "tables.h"
 
-/* Pinmap (Arduino UNO compatible) */
-#define YM_IC (5) // PC5 (= pin A5 for Arduino UNO)
-#define YM_CS (4) // PC4 (= pin A4 for Arduino UNO)
-#define YM_WR (3) // PC3 (= pin A3 for Arduino UNO)
-#define YM_RD (2) // PC2 (= pin A2 for Arduino UNO)
-#define YM_A0 (1) // PC1 (= pin A1 for Arduino UNO)
-#define YM_A1 (0) // PC0 (= pin A0 for Arduino UNO)
-#define YM_CTRL_DDR DDRC
-#define YM_CTRL_PORT PORTC
-#define YM_DATA_DDR DDRD
-#define YM_DATA_PORT PORTD // Whole PORT D for data bus (= pins D0 to D7 for Arduino UNO)
-#define YM_MCLOCK (1) // PB1 = OC1A (= pin D9 for Arduino UNO)
-#define YM_MCLOCK_DDR DDRB
-
-//PD0 & PD1 for serial i/o, using PD2-PD7 as YM 0-5
-#define DDATA(d) ((d << 2) & B11111100)
-// PB2 PB3 as YM 6-7
-#define BDATA(d) ((d >> 4) & B00001100)
-
+/* Pinmap (Arduino UNO compatible), see ShiftedYmBoard in Board.h:
+ * IC on PC5 (A5), CS on PC4 (A4), WR on PC3 (A3), RD on PC2 (A2),
+ * A0 on PC1 (A1), A1 on PC0 (A0), the master clock on PB1 = OC1A (D9).
+ * PD0 & PD1 for serial i/o, using PD2-PD7 as YM 0-5 and PB2 PB3 as YM 6-7 */
+typedef ShiftedYmBoard Board;
+YM2612Chip<Board> ym;
 
 
 // MIDI input variables
@@ -41,6 +27,8 @@ word pitchFrequency;
 byte pitchMSB;
 byte pitchLSB;
 
+void doMidiIn(byte data);
+
 void blinkTest(int numBlinks = 1, int LEDHighTime = 50, int LEDLowTime = 50) {
   for (int i = 0; i < numBlinks; i++) {
     digitalWrite(13,HIGH);
@@ -50,25 +38,8 @@ void blinkTest(int numBlinks = 1, int LEDHighTime = 50, int LEDLowTime = 50) {
   }
 }
 
-static void write_ym(uint8_t data) {
-
-	YM_CTRL_PORT &= ~_BV(YM_CS); // CS LOW
-	//YM_DATA_PORT = data;
-        YM_DATA_PORT = DDATA(data) | (YM_DATA_PORT & B00000011);
-        PORTB = BDATA(data) | (PORTB & B11110011);
-	_delay_us(1);
-	YM_CTRL_PORT &= ~_BV(YM_WR); // Write data
-	_delay_us(5);
-	YM_CTRL_PORT |= _BV(YM_WR);
-	_delay_us(5);
-	YM_CTRL_PORT |= _BV(YM_CS); // CS HIGH
-}
-
 static void setreg(uint8_t reg, uint8_t data) {
-	YM_CTRL_PORT &= ~_BV(YM_A0); // A0 low (select register)
-	write_ym(reg);
-	YM_CTRL_PORT |= _BV(YM_A0);  // A0 high (write register)
-	write_ym(data);
+	ym.writeReg(YM2612Map::PART1, reg, data);
 }
 
 void setup() {
@@ -76,26 +47,12 @@ void setup() {
   pinMode(13,OUTPUT);
   digitalWrite(13,LOW);
   
-/* Pins setup */
-	YM_CTRL_DDR |= _BV(YM_IC) | _BV(YM_CS) | _BV(YM_WR) | _BV(YM_RD) | _BV(YM_A0) | _BV(YM_A1);
-	//YM_DATA_DDR = 0xFF;
-        YM_DATA_DDR = B11111100;
-	YM_MCLOCK_DDR |= _BV(YM_MCLOCK) | B00001100;
-	YM_CTRL_PORT |= _BV(YM_IC) | _BV(YM_CS) | _BV(YM_WR) | _BV(YM_RD); /* IC, CS, WR and RD HIGH by default */
-	YM_CTRL_PORT &= ~(_BV(YM_A0) | _BV(YM_A1)); /* A0 and A1 LOW by default */
-
-/* F_CPU / 2 clock generation */
-	TCCR1A = _BV(COM1A0);            /* Toggle OCA1 on compare match */
-	TCCR1B = _BV(WGM12) | _BV(CS10); /* CTC mode with prescaler /1 */
-	TCCR1C = 0;                      /* Flag reset */
-	TCNT1 = 0;                       /* Counter reset */
-	OCR1A = 0;                       /* Divide base clock by two */
+/* Pins setup and F_CPU / 2 clock generation */
+	Board::begin();
 
 /* Reset YM2612 */
-	YM_CTRL_PORT &= ~_BV(YM_IC);
-	_delay_ms(10);
-	YM_CTRL_PORT |= _BV(YM_IC);
-	_delay_ms(10);
+	YM2612Chip<Board>::resetChips();
+	ym.begin();
 
 /* YM2612 Test code */ 
 	setreg(0x22, 0x00); // LFO off
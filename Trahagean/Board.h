@@ -0,0 +1,539 @@
+#ifndef BOARD_H__
+#define BOARD_H__
+
+/*
+Board profiles
+
+A profile is a struct with everything about how the sound chips are
+wired: pins as AVR_PIN types, the data bus and the chip clocks.
+
+    YM_IC, YM_A0, YM_A1, YM_WR  YM2612 lines, YM_WR2 for a second chip
+    SN_WE                       SN76489 write enable, SN_WE2 for a second
+    HAS_YM, HAS_SN              which chips the board carries
+    begin()                     data bus and control pins, chip clocks
+    dataBusWrite(data)          put a byte on the data bus
+    dataBusRead()               the byte on the bus, from the output latches
+    Clock                       the timer MegaSynth, VgmStream and Trace
+                                keep time on, on boards that run them
+    snClock(), ymClock()        the chip clocks as they come out, for
+                                MegaSynth's note tables (Tuning.h)
+    YM_IRQ, irqBegin()          the YM2612's IRQ, an AVR_INPUT_PIN, and
+                                its pull-up and pin change interrupt,
+                                SYNTH_YM_IRQ_vect (YmTimer.h)
+
+The drivers take the profile as their first template parameter, e.g.
+YM2612Chip<ShiftedYmBoard>, so every wiring compiles to its own sbi/cbi
+and port writes and gets the same driver code. Chip select and read
+lines the drivers do not strobe (YM2612 CS and RD, SN76489 CE) are set
+once by begin(): CS and CE low, RD high.
+
+The default typedefs (YM2612, SN76489, ...) and MegaSynth use
+SYNTH_BOARD: Mighty1284Board in a build for the ATmega1284(P),
+Mighty644Board for the ATmega644(P), TrahageanBoard otherwise, unless it
+is defined before the includes. The two Mighty boards share a pinout,
+which the Uno's does not fit: on their 40 pin parts OC0B and OC2B are
+PB4 and PD6.
+MegaSynth drives both chips of both pairs and the Clock, so its board
+needs all the pins and its chip clocks on other timers. ISR() takes the
+Clock's vectors by name, so a SYNTH_BOARD whose Clock is Timer3 also
+needs SYNTH_CLOCK defined to 3, and one with YM_IRQ on another port
+SYNTH_YM_IRQ_vect defined to its PCINTn_vect. SYNTH_LINK_USART is the
+USART of the host link (HostLink.h): 0 shares it with MIDI, 1 gives it
+Serial1.
+
+Buffer sizes follow the RAM of the part, BY_RAM(2KB, 4KB, 16KB):
+
+                        ATmega328P  ATmega644P  ATmega1284P
+    serial RX buffer            64         128          256
+    YM2612_QUEUE_LENGTH         16          32           64
+    STREAM_BUFFER_SIZE         512        1024         8192
+    EVENT_QUEUE_LENGTH          16          32           64
+    SEQ_ENGINES                  2           4            8
+    MORPH_ENGINES                1           2            6
+
+The serial buffers are the Arduino core's, built before the sketch, so
+the top level Makefile passes SERIAL_RX_BUFFER_SIZE for each part; the
+others are defaults in YM2612.h, VgmStream.h, EventQueue.h,
+Sequencer.h and Morph.h. host/streambench shows what each step buys.
+
+The synth boards make their chip clocks with toggle.h, asking for
+SYNTH_SN_CLOCK and SYNTH_YM_CLOCK (4MHz and 8MHz). A request the timer
+cannot make exactly is rounded, e.g. an NTSC 3579545Hz PSG clock comes
+out at 4MHz; the note tables follow what comes out, so notes stay in
+tune. On a board whose Clock is not Timer1, SYNTH_SN_DITHER makes the
+SN76489 clock with Timer1Dither instead, on OC1B, stepped from the
+Clock's compare B every SYNTH_SN_DITHER_TICKS. host/tuning prints the
+cent error of every key.
+
+host/boardbench runs the drivers on every profile.
+*/
+
+#include "Arduino.h"
+#include "Pin.h"
+#include "toggle.h"
+
+#ifndef SYNTH_SN_CLOCK
+#define SYNTH_SN_CLOCK 4000000.0
+#endif
+#ifndef SYNTH_YM_CLOCK
+#define SYNTH_YM_CLOCK 8000000.0
+#endif
+#ifndef SYNTH_SN_DITHER_TICKS
+#define SYNTH_SN_DITHER_TICKS 64 // Clock ticks, 32us (31.25kHz)
+#endif
+
+// small, medium or large by the RAM of the part built for
+#define BY_RAM(kb2, kb4, kb16) \
+    (RAMEND - RAMSTART + 1 >= 16384 ? (kb16) \
+    : RAMEND - RAMSTART + 1 >= 4096 ? (kb4) : (kb2))
+
+
+/* The clock MegaSynth, VgmStream and Trace share: a 16 bit timer running
+ * free at F_CPU / 8 (0.5us at 16MHz) in normal mode, with compare A to
+ * wake an idle sleep and the overflow interrupt for Trace. */
+struct Timer1Clock {
+    enum clock_e {
+        TIMER = 1
+    };
+
+    static void begin() {
+        TCCR1A = 0; // normal mode
+        TCCR1B = bit(CS11); // F_CPU / 8
+    }
+
+
+    static inline word now() {
+        return TCNT1;
+    }
+
+
+    static inline void restart() {
+        TCNT1 = 0;
+    }
+
+
+    static inline bool overflowed() {
+        return TIFR1 & bit(TOV1);
+    }
+
+
+    static inline void overflowInterrupt() {
+        TIMSK1 |= bit(TOIE1);
+    }
+
+
+    // compare A interrupt at ticks, clearing a stale match
+    static inline void wakeAt(word ticks) {
+        OCR1A = ticks;
+        TIFR1 = bit(OCF1A);
+        TIMSK1 |= bit(OCIE1A);
+    }
+
+
+    static inline void wakeOff() {
+        TIMSK1 &= ~bit(OCIE1A);
+    }
+};
+
+
+#ifdef TCCR3A
+/* The same on Timer3, which the 1284P has and the 328P and 644P
+ * do not */
+struct Timer3Clock {
+    enum clock_e {
+        TIMER = 3
+    };
+
+    static void begin() {
+        TCCR3A = 0; // normal mode
+        TCCR3B = bit(CS31); // F_CPU / 8
+    }
+
+
+    static inline word now() {
+        return TCNT3;
+    }
+
+
+    static inline void restart() {
+        TCNT3 = 0;
+    }
+
+
+    static inline bool overflowed() {
+        return TIFR3 & bit(TOV3);
+    }
+
+
+    static inline void overflowInterrupt() {
+        TIMSK3 |= bit(TOIE3);
+    }
+
+
+    static inline void wakeAt(word ticks) {
+        OCR3A = ticks;
+        TIFR3 = bit(OCF3A);
+        TIMSK3 |= bit(OCIE3A);
+    }
+
+
+    static inline void wakeOff() {
+        TIMSK3 &= ~bit(OCIE3A);
+    }
+
+
+    // compare B interrupt every ticks, from the first call on
+    static void stepEvery(word ticks) {
+        OCR3B = TCNT3 + ticks;
+        TIFR3 = bit(OCF3B);
+        TIMSK3 |= bit(OCIE3B);
+    }
+
+
+    // from the compare B interrupt
+    static inline void nextStep(word ticks) {
+        OCR3B += ticks;
+    }
+};
+#endif
+
+/* D0-D1 on PD6-7, Uno digital pins 6-7, and D2-D7 on PB0-5, digital
+ * pins 8-13. The bus shares both ports with other pins, so the
+ * read-modify-writes are the one place the drivers mask interrupts: a few
+ * cycles, in case an ISR ever drives one of those pins. */
+struct TrahageanBus {
+    enum bus_e {
+        PORTD_MASK = B11000000,
+        PORTB_MASK = B00111111
+    };
+
+    static void dataBusBegin() {
+        DDRB |= PORTB_MASK;
+        DDRD |= PORTD_MASK;
+    }
+
+
+    static inline void dataBusWrite(byte data) {
+        const byte sreg = SREG;
+        cli();
+        PORTB = (PORTB & ~PORTB_MASK) | ((data >> 2) & PORTB_MASK);
+        PORTD = (PORTD & ~PORTD_MASK) | ((data << 6) & PORTD_MASK);
+        SREG = sreg;
+    }
+
+
+    static inline byte dataBusRead() {
+        return (PORTB & PORTB_MASK) << 2 | (PORTD & PORTD_MASK) >> 6;
+    }
+};
+
+
+/* D0-D7 on the whole of PORTD, Uno digital pins 0-7, as in the SkyWodd
+ * test programs. It takes the USART pins, so there is no serial port.
+ * The bus is the whole port, so a write is a single OUT. */
+struct PortDBus {
+    static void dataBusBegin() {
+        DDRD = 0xFF;
+    }
+
+
+    static inline void dataBusWrite(byte data) {
+        PORTD = data;
+    }
+
+
+    static inline byte dataBusRead() {
+        return PORTD;
+    }
+};
+
+
+/* D0-D5 on PD2-7, Uno digital pins 2-7, and D6-D7 on PB2-3, digital pins
+ * 10-11, shifted to leave RX and TX free for MIDI */
+struct ShiftedBus {
+    enum bus_e {
+        PORTD_MASK = B11111100,
+        PORTB_MASK = B00001100
+    };
+
+    static void dataBusBegin() {
+        DDRB |= PORTB_MASK;
+        DDRD |= PORTD_MASK;
+    }
+
+
+    static inline void dataBusWrite(byte data) {
+        const byte sreg = SREG;
+        cli();
+        PORTD = (PORTD & ~PORTD_MASK) | ((data << 2) & PORTD_MASK);
+        PORTB = (PORTB & ~PORTB_MASK) | ((data >> 4) & PORTB_MASK);
+        SREG = sreg;
+    }
+
+
+    static inline byte dataBusRead() {
+        return (PORTD & PORTD_MASK) >> 2 | (PORTB & PORTB_MASK) << 4;
+    }
+};
+
+
+/* The Trahagean board: a YM2612 and an SN76489, or two of each with
+ * DUAL_CHIPS, on the analog pins. YM2612 CS is tied to WR and SN76489 CE
+ * to WE; YM2612 RD needs a pullup. A second chip shares everything but
+ * its WR/WE. The SN76489 clock is on OC0B (digital pin 5), the YM2612's
+ * on OC2B (digital pin 3). The first YM2612's IRQ is on digital pin 4:
+ * INT0 and INT1 are SN_WE2 and the YM2612 clock, so it takes a pin
+ * change interrupt. */
+struct TrahageanBoard : TrahageanBus {
+    enum board_e {
+        HAS_YM = true,
+        HAS_SN = true
+    };
+    typedef Timer1Clock Clock;
+    AVR_PIN(YM_IC, PORTC, DDRC, PORTC5);
+    AVR_PIN(YM_WR, PORTC, DDRC, PORTC4);
+    AVR_PIN(YM_WR2, PORTC, DDRC, PORTC2);
+    AVR_PIN(YM_A0, PORTC, DDRC, PORTC1);
+    AVR_PIN(YM_A1, PORTC, DDRC, PORTC0);
+    AVR_PIN(SN_WE, PORTC, DDRC, PORTC3);
+    AVR_PIN(SN_WE2, PORTD, DDRD, PORTD2);
+    AVR_INPUT_PIN(YM_IRQ, PIND, PORTD, PIND4);
+
+    static constexpr double snClock() {
+        return toggleClock(SYNTH_SN_CLOCK);
+    }
+
+
+    static constexpr double ymClock() {
+        return toggleClock(SYNTH_YM_CLOCK);
+    }
+
+
+    static void begin() {
+        toggle_OC0B(SYNTH_SN_CLOCK);
+        DDRD |= bit(PORTD5);
+        toggle_OC2B(SYNTH_YM_CLOCK);
+        DDRD |= bit(PORTD3);
+        dataBusBegin();
+    }
+
+
+    // IRQ is open drain; the interrupt comes on both edges
+    static void irqBegin() {
+        YM_IRQ::pullUp();
+#ifdef PCMSK3 // PORTD is pin change group 3 on the parts with a PORTA
+        PCMSK3 |= bit(PCINT28);
+        PCIFR = bit(PCIF3);
+        PCICR |= bit(PCIE3);
+#else
+        PCMSK2 |= bit(PCINT20);
+        PCIFR = bit(PCIF2);
+        PCICR |= bit(PCIE2);
+#endif
+    }
+};
+
+
+/* An ATmega644P or 1284P in MightyCore's standard pinout. The data bus
+ * is the whole of PORTA (A0-A7), so a write is a single OUT with no
+ * masking; the strobes and address lines are on PORTC (digital pins
+ * 16-22, JTAG fuse off). The SN76489 clock is on OC0B (PB4, digital pin
+ * 4), or on OC1B (PD4, digital pin 12) with SYNTH_SN_DITHER, the
+ * YM2612's on OC2B (PD6, digital pin 14). MIDI stays on USART0 and the
+ * host link gets USART1 (Serial1, digital pins 10-11) to itself. The
+ * YM2612's IRQ is on PD7 (digital pin 15, PCINT31). */
+template<class C> struct MightyBoard {
+    enum board_e {
+        HAS_YM = true,
+        HAS_SN = true
+    };
+    typedef C Clock;
+    AVR_PIN(YM_WR, PORTC, DDRC, PORTC0);
+    AVR_PIN(YM_A0, PORTC, DDRC, PORTC1);
+    AVR_PIN(YM_A1, PORTC, DDRC, PORTC2);
+    AVR_PIN(YM_IC, PORTC, DDRC, PORTC3);
+    AVR_PIN(SN_WE, PORTC, DDRC, PORTC4);
+    AVR_PIN(YM_WR2, PORTC, DDRC, PORTC5);
+    AVR_PIN(SN_WE2, PORTC, DDRC, PORTC6);
+    AVR_INPUT_PIN(YM_IRQ, PIND, PORTD, PIND7);
+
+    static void dataBusBegin() {
+        DDRA = 0xFF;
+    }
+
+
+    static inline void dataBusWrite(byte data) {
+        PORTA = data;
+    }
+
+
+    static inline byte dataBusRead() {
+        return PORTA;
+    }
+
+
+#ifdef SYNTH_SN_DITHER
+    static constexpr double snClock() {
+        return ditherClock(SYNTH_SN_CLOCK);
+    }
+#else
+    static constexpr double snClock() {
+        return toggleClock(SYNTH_SN_CLOCK);
+    }
+#endif
+
+
+    static constexpr double ymClock() {
+        return toggleClock(SYNTH_YM_CLOCK);
+    }
+
+
+    static void begin() {
+#ifdef SYNTH_SN_DITHER
+        Timer1Dither::begin(SYNTH_SN_CLOCK);
+        DDRD |= bit(PORTD4);
+        Clock::begin(); // the steps need it running
+        Clock::stepEvery(SYNTH_SN_DITHER_TICKS);
+#else
+        toggle_OC0B(SYNTH_SN_CLOCK);
+        DDRB |= bit(PORTB4);
+#endif
+        toggle_OC2B(SYNTH_YM_CLOCK);
+        DDRD |= bit(PORTD6);
+        dataBusBegin();
+    }
+
+
+    static void irqBegin() {
+        YM_IRQ::pullUp();
+        PCMSK3 |= bit(PCINT31);
+        PCIFR = bit(PCIF3);
+        PCICR |= bit(PCIE3);
+    }
+};
+
+#ifdef TCCR3A
+// Timer3 is the Clock, leaving Timer1 free
+typedef MightyBoard<Timer3Clock> Mighty1284Board;
+#endif
+// the 644P has no Timer3, so the Clock is Timer1 and SYNTH_SN_DITHER is out
+typedef MightyBoard<Timer1Clock> Mighty644Board;
+
+
+/* YM2612 pins of the SkyWodd test program and the boards derived from
+ * it, on the analog pins, with the 8MHz clock on OC1A (digital pin 9).
+ * Timer1 is the clock, so Trace.h, VgmStream.h and MegaSynth cannot run
+ * on these boards. */
+template<class Bus> struct AnalogYmBoard : Bus {
+    enum board_e {
+        HAS_YM = true,
+        HAS_SN = false
+    };
+    AVR_PIN(YM_IC, PORTC, DDRC, PORTC5);
+    AVR_PIN(YM_CS, PORTC, DDRC, PORTC4);
+    AVR_PIN(YM_WR, PORTC, DDRC, PORTC3);
+    AVR_PIN(YM_RD, PORTC, DDRC, PORTC2);
+    AVR_PIN(YM_A0, PORTC, DDRC, PORTC1);
+    AVR_PIN(YM_A1, PORTC, DDRC, PORTC0);
+
+    static void begin() {
+        YM_CS::output();
+        YM_CS::low(); // the only chip on the bus
+        YM_RD::output();
+        YM_RD::high();
+        toggle_OC1A(8000000.0); // F_CPU / 2
+        DDRB |= bit(PORTB1);
+        Bus::dataBusBegin();
+    }
+};
+
+
+/* SN76489 pins of the SkyWodd test program and the boards derived from
+ * it: WE and CE on the analog pins, READY (unused) pulled up, and the
+ * 4MHz clock on OC1A (digital pin 9), taking Timer1 as above. */
+template<class Bus, byte WE, byte CE, byte READY>
+struct AnalogSnBoard : Bus {
+    enum board_e {
+        HAS_YM = false,
+        HAS_SN = true
+    };
+    AVR_PIN(SN_WE, PORTC, DDRC, WE);
+    AVR_PIN(SN_CE, PORTC, DDRC, CE);
+    AVR_PIN(SN_READY, PORTC, DDRC, READY);
+
+    static void begin() {
+        SN_CE::output();
+        SN_CE::low(); // the only chip on the bus
+        SN_READY::high(); // an input, pulled up
+        toggle_OC1A(4000000.0); // F_CPU / 4
+        DDRB |= bit(PORTB1);
+        Bus::dataBusBegin();
+    }
+};
+
+
+// ym2612_synth: the bus on PORTD
+typedef AnalogYmBoard<PortDBus> PortDYmBoard;
+// ym2612_new, MIDIScaledYM2612: the bus shifted clear of RX and TX
+typedef AnalogYmBoard<ShiftedBus> ShiftedYmBoard;
+// sn76489_test: the bus on PORTD, WE on A4, CE on A3, READY on A5
+typedef AnalogSnBoard<PortDBus, PORTC4, PORTC3, PORTC5> PortDSnBoard;
+// sn76489_new: shifted bus, WE on A4, CE on A3, READY on A5
+typedef AnalogSnBoard<ShiftedBus, PORTC4, PORTC3, PORTC5> ShiftedSnBoard;
+// sn76489_rewired: shifted bus, WE on A3, CE on A4, READY on A1
+typedef AnalogSnBoard<ShiftedBus, PORTC3, PORTC4, PORTC1> RewiredSnBoard;
+
+
+#ifndef SYNTH_BOARD
+#if defined(__AVR_ATmega1284P__) || defined(__AVR_ATmega1284__)
+#define SYNTH_BOARD Mighty1284Board
+#define SYNTH_CLOCK 3
+#define SYNTH_LINK_USART 1
+#elif defined(__AVR_ATmega644P__) || defined(__AVR_ATmega644PA__)
+#define SYNTH_BOARD Mighty644Board
+#define SYNTH_LINK_USART 1
+#elif defined(__AVR_ATmega644__) || defined(__AVR_ATmega644A__)
+#define SYNTH_BOARD Mighty644Board // USART0 alone, shared with MIDI
+#else
+#define SYNTH_BOARD TrahageanBoard
+#endif
+#endif
+typedef SYNTH_BOARD SynthBoard;
+
+// the timer of SynthBoard::Clock, for the names of its vectors
+#ifndef SYNTH_CLOCK
+#define SYNTH_CLOCK 1
+#endif
+#if SYNTH_CLOCK == 3
+#define SYNTH_CLOCK_OVF_vect TIMER3_OVF_vect
+#define SYNTH_CLOCK_COMPA_vect TIMER3_COMPA_vect
+#define SYNTH_CLOCK_COMPB_vect TIMER3_COMPB_vect
+#else
+#define SYNTH_CLOCK_OVF_vect TIMER1_OVF_vect
+#define SYNTH_CLOCK_COMPA_vect TIMER1_COMPA_vect
+#define SYNTH_CLOCK_COMPB_vect TIMER1_COMPB_vect
+#endif
+#ifndef SYNTH_LINK_USART
+#define SYNTH_LINK_USART 0
+#endif
+// the pin change vector of SynthBoard::YM_IRQ's port, PORTD on both
+#ifndef SYNTH_YM_IRQ_vect
+#ifdef PCMSK3
+#define SYNTH_YM_IRQ_vect PCINT3_vect
+#else
+#define SYNTH_YM_IRQ_vect PCINT2_vect
+#endif
+#endif
+
+#ifdef SYNTH_SN_DITHER
+static_assert(SYNTH_CLOCK != 1, "SYNTH_SN_DITHER needs Timer1 to itself");
+
+ISR(SYNTH_CLOCK_COMPB_vect) {
+    SynthBoard::Clock::nextStep(SYNTH_SN_DITHER_TICKS);
+    Timer1Dither::step();
+}
+#endif
+
+
+//include guard
+#endif
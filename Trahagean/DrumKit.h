@@ -0,0 +1,181 @@
+#ifndef DRUM_KIT_H__
+#define DRUM_KIT_H__
+
+/*
+Drum kits for the SN76489 noise channel
+
+A kit maps each key of the General MIDI percussion range, KEY_FIRST up,
+to a Note: the noise feedback and shift rate, a level and decay, and a
+tone 3 period. Keys outside the range fold into it by octaves. A note
+resolves with one lookup, in PROGMEM for the built in kit (kit 0) or in
+the EEPROM for custom kits 1 to DRUM_EEPROM_KITS.
+
+With SHIFT_CHAN3 the noise shifts at tone 3's rate, so the drum is
+pitched: MegaSynth borrows tone 3 (MIDI channel 8), silences it and sets
+its period, or the key's pitch when the period is 0. Periodic noise then
+sounds 4 octaves below tone 3. The level is added to the note's
+attenuation (SN76489 2dB steps) and the decay is the time in ms per
+further 2dB step, 0 to hold the note until its note off.
+
+EEPROM kits are written with avrdude from an image made by host/drumkit,
+kit n at DRUM_EEPROM_BASE + (n - 1) * KIT_SIZE:
+
+    KIT_MAGIC, KEY_COUNT x { noise, decay, period (lo, hi) }
+
+where noise is level << 4 | feedback << 2 | rate. A kit without the magic
+byte, such as erased EEPROM, cannot be selected.
+*/
+
+#include "Arduino.h"
+#include "SN76489.h"
+#include <avr/eeprom.h>
+
+#ifndef DRUM_EEPROM_BASE
+#define DRUM_EEPROM_BASE 0
+#endif
+#ifndef DRUM_EEPROM_KITS
+#define DRUM_EEPROM_KITS 2
+#endif
+
+class DrumKit {
+    public:
+    enum drum_e {
+        KEY_FIRST = 35, // Acoustic Bass Drum
+        KEY_COUNT = 48, // to 82, Shaker
+        KIT_MAGIC = 0xD7,
+        NOTE_SIZE = 4,
+        KIT_SIZE = 1 + KEY_COUNT * NOTE_SIZE,
+        BUILT_IN = 0
+    };
+    static_assert(DRUM_EEPROM_BASE + DRUM_EEPROM_KITS * KIT_SIZE <= E2END + 1,
+        "the drum kits do not fit the EEPROM");
+
+    struct Note {
+        byte noise; // level << 4 | feedback << 2 | rate
+        byte decay; // ms per 2dB step, 0 holds
+        word period; // tone 3 with SHIFT_CHAN3, 0 for the key's pitch
+
+        SN76489Map::feedback_e feedback() const {
+            return static_cast<SN76489Map::feedback_e>(noise >> 2 & 0x01);
+        }
+        SN76489Map::rate_e rate() const {
+            return static_cast<SN76489Map::rate_e>(noise & 0x03);
+        }
+        byte level() const {
+            return noise >> 4;
+        }
+    };
+
+    private:
+    static const PROGMEM Note builtIn[KEY_COUNT];
+    byte kit;
+
+    static inline byte fold(byte key) {
+        key &= 0x7F;
+        while (key < KEY_FIRST)
+            key += 12;
+        while (key >= KEY_FIRST + KEY_COUNT)
+            key -= 12;
+        return key - KEY_FIRST;
+    }
+
+
+    static inline const byte *kitAddress(byte n) {
+        return (const byte *)(size_t)(DRUM_EEPROM_BASE + (n - 1) * KIT_SIZE);
+    }
+
+    public:
+    void begin() {
+        kit = BUILT_IN;
+    }
+
+
+    // kit 0 is built in, false if an EEPROM kit is not there
+    bool select(byte n) {
+        if (n != BUILT_IN && (n > DRUM_EEPROM_KITS
+                || eeprom_read_byte(kitAddress(n)) != KIT_MAGIC))
+            return false;
+        kit = n;
+        return true;
+    }
+
+
+    void lookup(byte key, Note &note) const {
+        const byte i = fold(key);
+        if (kit == BUILT_IN) {
+            note.noise = pgm_read_byte(&builtIn[i].noise);
+            note.decay = pgm_read_byte(&builtIn[i].decay);
+            note.period = pgm_read_word(&builtIn[i].period);
+        }
+        else {
+            byte raw[NOTE_SIZE];
+            eeprom_read_block(raw, kitAddress(kit) + 1 + i * NOTE_SIZE,
+                NOTE_SIZE);
+            note.noise = raw[0];
+            note.decay = raw[1];
+            note.period = word(raw[3], raw[2]);
+        }
+    }
+};
+
+
+#define DRUM(fb, rate, level, decay, period) \
+    { (level) << 4 | SN76489Map::fb << 2 | SN76489Map::rate, decay, period }
+
+// General MIDI percussion. Tone 3 periods are 7812 / Hz of the noise.
+const PROGMEM DrumKit::Note DrumKit::builtIn[DrumKit::KEY_COUNT] = {
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 0,  8, 156), // 35 Acoustic Bass Drum
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 0,  8, 130), // 36 Bass Drum 1
+    DRUM(WHITE_NOISE,    SHIFT_512,   1,  2,   0), // 37 Side Stick
+    DRUM(WHITE_NOISE,    SHIFT_1024,  0, 12,   0), // 38 Acoustic Snare
+    DRUM(WHITE_NOISE,    SHIFT_1024,  1,  6,   0), // 39 Hand Clap
+    DRUM(WHITE_NOISE,    SHIFT_512,   0, 10,   0), // 40 Electric Snare
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 0, 15,  98), // 41 Low Floor Tom
+    DRUM(WHITE_NOISE,    SHIFT_512,   2,  3,   0), // 42 Closed Hi-Hat
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 0, 15,  82), // 43 High Floor Tom
+    DRUM(WHITE_NOISE,    SHIFT_512,   3,  4,   0), // 44 Pedal Hi-Hat
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 0, 14,  71), // 45 Low Tom
+    DRUM(WHITE_NOISE,    SHIFT_512,   2, 20,   0), // 46 Open Hi-Hat
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 0, 13,  60), // 47 Low-Mid Tom
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 0, 12,  50), // 48 Hi-Mid Tom
+    DRUM(WHITE_NOISE,    SHIFT_512,   0, 40,   0), // 49 Crash Cymbal 1
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 0, 12,  43), // 50 High Tom
+    DRUM(WHITE_NOISE,    SHIFT_512,   3, 30,   0), // 51 Ride Cymbal 1
+    DRUM(WHITE_NOISE,    SHIFT_1024,  0, 35,   0), // 52 Chinese Cymbal
+    DRUM(PERIODIC_NOISE, SHIFT_512,   2, 25,   0), // 53 Ride Bell
+    DRUM(WHITE_NOISE,    SHIFT_512,   2,  8,   0), // 54 Tambourine
+    DRUM(WHITE_NOISE,    SHIFT_512,   0, 20,   0), // 55 Splash Cymbal
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 1, 10,  14), // 56 Cowbell
+    DRUM(WHITE_NOISE,    SHIFT_1024,  0, 40,   0), // 57 Crash Cymbal 2
+    DRUM(PERIODIC_NOISE, SHIFT_2048,  1, 25,   0), // 58 Vibraslap
+    DRUM(WHITE_NOISE,    SHIFT_512,   3, 30,   0), // 59 Ride Cymbal 2
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 0,  6,  20), // 60 Hi Bongo
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 0,  7,  26), // 61 Low Bongo
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 0,  4,  24), // 62 Mute Hi Conga
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 0, 10,  24), // 63 Open Hi Conga
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 0, 10,  31), // 64 Low Conga
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 0,  8,  18), // 65 High Timbale
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 0,  9,  24), // 66 Low Timbale
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 1, 10,   9), // 67 High Agogo
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 1, 10,  12), // 68 Low Agogo
+    DRUM(WHITE_NOISE,    SHIFT_512,   3,  6,   0), // 69 Cabasa
+    DRUM(WHITE_NOISE,    SHIFT_512,   4,  4,   0), // 70 Maracas
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 2,  6,   4), // 71 Short Whistle
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 2, 20,   4), // 72 Long Whistle
+    DRUM(WHITE_NOISE,    SHIFT_2048,  1,  5,   0), // 73 Short Guiro
+    DRUM(WHITE_NOISE,    SHIFT_2048,  1, 15,   0), // 74 Long Guiro
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 1,  3,   3), // 75 Claves
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 1,  3,   5), // 76 Hi Wood Block
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 1,  3,   7), // 77 Low Wood Block
+    DRUM(PERIODIC_NOISE, SHIFT_1024,  1,  5,   0), // 78 Mute Cuica
+    DRUM(PERIODIC_NOISE, SHIFT_1024,  1, 12,   0), // 79 Open Cuica
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 2,  3,   2), // 80 Mute Triangle
+    DRUM(PERIODIC_NOISE, SHIFT_CHAN3, 2, 25,   2), // 81 Open Triangle
+    DRUM(WHITE_NOISE,    SHIFT_512,   4,  5,   0)  // 82 Shaker
+};
+
+#undef DRUM
+
+
+//include guard
+#endif
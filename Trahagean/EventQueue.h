@@ -0,0 +1,236 @@
+#ifndef EVENT_QUEUE_H__
+#define EVENT_QUEUE_H__
+
+/*
+Timed events
+
+One queue for everything that has to happen at a given Clock tick:
+VgmStream's register writes, the drum envelopes' steps, the sequencer's
+tempo, the patch morphs and any other timed source added later. A producer posts an event
+with the tick it is due at and MegaSynth::service() plays the due ones,
+earliest first and those due at the same tick in the order they were
+posted, so sources share the bus in time order and none waits on
+another's backlog. Live MIDI is due the moment it arrives and is still
+played straight from serialEvent(), without a trip through the queue.
+
+    EVENT_YM0-EVENT_YM3  part data    MegaSynth::writeYm(), 2 and 3 are
+                                      the second chip's with DUAL_CHIPS
+    EVENT_SN             data         MegaSynth::writeSn()
+    EVENT_WAKE                        nothing, only ends an idle sleep
+    EVENT_DRUM                        a ms of the drum envelopes
+    EVENT_SEQ                         a pulse of Sequencer.h's tempo
+    EVENT_MORPH                       a step of Morph.h's blends
+
+Each event also names its source, so a source can drop what it still
+has queued (cancel()). The last EVENT_RESERVE slots are kept for sources
+other than the stream, so a long VGM burst does not lock out the drums.
+
+The queue is a binary min-heap of EVENT_QUEUE_LENGTH events, see BY_RAM()
+in Board.h. A post costs a compare per level it rises, and the stream
+posts in time order, so most stop after one; taking the earliest costs
+two compares per level. A timing wheel fine enough for the Clock's 0.5us
+would need far more slots than there is RAM for.
+
+Times are Clock ticks (F_CPU / 8) extended to 32 bits by now(), which
+has to run at least every 65536 ticks (32ms at 16MHz) while events are
+queued. service() does, and so does canSleep(), which points the
+Clock's compare A at the next event so a sketch that sleeps wakes in
+time for it.
+*/
+
+#include "Arduino.h"
+#include "Board.h"
+#include "Trace.h"
+
+#ifndef EVENT_QUEUE_LENGTH
+#define EVENT_QUEUE_LENGTH BY_RAM(16, 32, 64) // events, 10 bytes of RAM each
+#endif
+#ifndef EVENT_RESERVE
+#define EVENT_RESERVE 4 // slots the stream leaves to other sources
+#endif
+// Clock ticks the compare A wake must still be ahead to sleep on it
+#define EVENT_WAKE_MARGIN 4
+
+enum event_e {
+    EVENT_YM0,
+    EVENT_YM1,
+    EVENT_YM2,
+    EVENT_YM3,
+    EVENT_SN,
+    EVENT_WAKE,
+    EVENT_DRUM,
+    EVENT_SEQ,
+    EVENT_MORPH
+};
+
+enum event_source_e {
+    EVENT_SOURCE_DRUMS,
+    EVENT_SOURCE_STREAM,
+    EVENT_SOURCE_SEQUENCER,
+    EVENT_SOURCE_MORPH
+};
+
+class EventQueue {
+    typedef SynthBoard::Clock Clock;
+    static_assert(EVENT_QUEUE_LENGTH > EVENT_RESERVE
+        && EVENT_QUEUE_LENGTH <= 128,
+        "EVENT_QUEUE_LENGTH must be over EVENT_RESERVE and <= 128");
+
+    public:
+    struct Event {
+        unsigned long due;
+        word order; // posts so far, breaks ties in due
+        byte source;
+        byte kind;
+        byte reg;
+        byte data;
+    };
+
+    private:
+    Event heap[EVENT_QUEUE_LENGTH]; // heap[0] is the earliest
+    byte length;
+    word posted;
+    unsigned long time; // at lastTicks
+    word lastTicks;
+
+    static inline bool before(const Event &a, const Event &b) {
+        const long d = a.due - b.due;
+        return d < 0 || (d == 0 && (int)(a.order - b.order) < 0);
+    }
+
+
+    void rise(byte i) {
+        const Event e = heap[i];
+        while (i > 0) {
+            const byte parent = (i - 1) / 2;
+            if (!before(e, heap[parent]))
+                break;
+            heap[i] = heap[parent];
+            i = parent;
+        }
+        heap[i] = e;
+    }
+
+
+    void sink(byte i) {
+        const Event e = heap[i];
+        for (;;) {
+            byte child = 2 * i + 1;
+            if (child >= length)
+                break;
+            if (child + 1 < length && before(heap[child + 1], heap[child]))
+                child++;
+            if (!before(heap[child], e))
+                break;
+            heap[i] = heap[child];
+            i = child;
+        }
+        heap[i] = e;
+    }
+
+
+    void pop() {
+        heap[0] = heap[--length];
+        if (length)
+            sink(0);
+    }
+
+
+    public:
+    void begin() {
+        length = 0;
+        posted = 0;
+        time = 0;
+        lastTicks = Clock::now();
+        Clock::wakeOff();
+    }
+
+
+    // the Clock extended to 32 bits
+    unsigned long now() {
+        const word ticks = Clock::now();
+        time += (word)(ticks - lastTicks);
+        lastTicks = ticks;
+        return time;
+    }
+
+
+    // free slots, EVENT_RESERVE of them for sources other than the stream
+    byte room() const {
+        return EVENT_QUEUE_LENGTH - length;
+    }
+
+
+    // False when the queue is full. An event due already plays from the
+    // next service().
+    bool post(unsigned long due, byte source, byte kind,
+              byte reg = 0, byte data = 0) {
+        if (length == EVENT_QUEUE_LENGTH)
+            return false;
+        Event &e = heap[length];
+        e.due = due;
+        e.order = posted++;
+        e.source = source;
+        e.kind = kind;
+        e.reg = reg;
+        e.data = data;
+        rise(length++);
+        return true;
+    }
+
+
+    // drops every event of the source still queued
+    void cancel(byte source) {
+        byte kept = 0;
+        for (byte i = 0; i < length; i++) {
+            if (heap[i].source != source)
+                heap[kept++] = heap[i];
+        }
+        length = kept;
+        for (byte i = length / 2; i-- > 0;)
+            sink(i);
+    }
+
+
+    // Plays the events due with player.play(event), which may post more.
+    // Call it as often as possible.
+    template<class P> void service(P &player) {
+        const unsigned long t = now();
+        while (length && (long)(heap[0].due - t) <= 0) {
+            const Event e = heap[0];
+            pop();
+            player.play(e);
+        }
+    }
+
+
+    // True unless an event is due within EVENT_WAKE_MARGIN ticks; the
+    // Clock's compare A is then set to wake the CPU for the earliest, at
+    // most half a Clock cycle ahead. Call it with interrupts masked, just
+    // before sleeping.
+    bool canSleep() {
+        if (!length) {
+            Clock::wakeOff();
+            return true;
+        }
+        long ahead = heap[0].due - now();
+        if (ahead <= EVENT_WAKE_MARGIN)
+            return false;
+        if (ahead > 0x8000)
+            ahead = 0x8000;
+        Clock::wakeAt(lastTicks + ahead);
+        return true;
+    }
+};
+
+// only there to end an idle sleep, see canSleep()
+#ifdef TRACE_ENABLE
+ISR(SYNTH_CLOCK_COMPA_vect) {
+    TRACE(TRACE_ISR_ENTER, TRACE_ISR_CLOCK_COMPA);
+    TRACE(TRACE_ISR_EXIT, TRACE_ISR_CLOCK_COMPA);
+}
+#else
+EMPTY_INTERRUPT(SYNTH_CLOCK_COMPA_vect);
+#endif
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef HOST_LINK_H__
+#define HOST_LINK_H__
+
+/*
+Framed host link protocol
+
+For a computer connected straight to the USART at LINK_BAUDRATE instead of
+a MIDI wire, or to a USART of its own (LINK_SERIAL) beside MIDI on boards
+with two, see SYNTH_LINK_USART in Board.h. The Arduino core switches the
+USART to double speed (U2X) itself for these rates; 500k and 1M baud are
+exact at 16MHz.
+
+Every frame, in both directions:
+
+    LINK_SYNC type length payload[length] checksum
+
+where the checksum makes the 8 bit sum of type, length, payload and
+checksum zero. Frames that fail the checksum or are too long are dropped
+and reported with LINK_NAK; the parser then hunts for the next LINK_SYNC.
+
+Host to device:
+    LINK_HELLO   (empty) resets the parser, answered with LINK_HELLO
+    LINK_YM      (part, register, data) triples, parts 2 and 3 are the
+                 second YM2612 with DUAL_CHIPS
+    LINK_SN      raw SN76489 latch/data bytes
+    LINK_MIDI    MIDI bytes, fed through the MIDI packetizer
+    LINK_STREAM  timestamped chip writes for the jitter buffer (VgmStream.h)
+    LINK_STATE_QUERY  chip, hashes: what of the YM2612's shadow registers
+                 differs from the host's copy (StateSync.h)
+
+Device to host:
+    LINK_HELLO   version, window: bytes the host may have in flight
+    LINK_CREDIT  n: n more bytes have left the receive buffer
+    LINK_NAK     reason: a frame was dropped
+    LINK_MIDI    MIDI bytes, the SysEx answers of Patch.h when MIDI comes
+                 through the link
+    LINK_STREAM_FILL  jitter buffer state (VgmStream.h)
+    LINK_STATE, LINK_STATE_END  the answer to LINK_STATE_QUERY
+
+Flow control is by credit: after the LINK_HELLO answer the host may send
+window bytes, and each LINK_CREDIT returns some. The device counts every
+byte it takes out of the serial receive buffer, so the host can never
+overrun it, even with garbage or dropped frames on the line. Credit goes
+back in batches, and whenever the receive buffer runs empty so a host
+waiting on the last few bytes of its window is never stuck.
+*/
+
+#include "Arduino.h"
+#include "Board.h"
+
+#if SYNTH_LINK_USART == 1
+#define LINK_SERIAL Serial1
+#else
+#define LINK_SERIAL Serial
+#endif
+
+// Needs nothing to mask interrupts for more than the two byte times the
+// USART receive FIFO can hold (20us); latencybench -i checks that bound
+#define LINK_BAUDRATE 1000000
+#define LINK_VERSION 1
+
+#define LINK_SYNC 0xA5
+#define LINK_PAYLOAD_MAX 48
+
+#define LINK_HELLO 0x00
+#define LINK_YM 0x01
+#define LINK_SN 0x02
+#define LINK_MIDI 0x03
+#define LINK_STREAM 0x04
+#define LINK_STATE_QUERY 0x05
+#define LINK_CREDIT 0x80
+#define LINK_NAK 0x81
+#define LINK_STREAM_FILL 0x82
+#define LINK_STATE 0x83
+#define LINK_STATE_END 0x84
+
+#define LINK_NAK_CHECKSUM 1
+#define LINK_NAK_LENGTH 2
+
+// LINK_STREAM commands and LINK_STREAM_FILL, see VgmStream.h
+#define STREAM_RATE 44100 // VGM's sample clock
+
+enum stream_e {
+    STREAM_YM0,
+    STREAM_YM1,
+    STREAM_SN,
+    STREAM_WAIT,
+    STREAM_END,
+    STREAM_COMMAND_COUNT
+};
+
+#define STREAM_FILL_LENGTH 7
+
+#define LINK_TYPE_INDEX 0
+#define LINK_LENGTH_INDEX 1
+#define LINK_PAYLOAD_INDEX 2
+
+#ifndef SERIAL_RX_BUFFER_SIZE
+#define SERIAL_RX_BUFFER_SIZE 64 // Arduino core default
+#endif
+// the core's ring buffer holds one byte less than its size
+#define LINK_WINDOW (SERIAL_RX_BUFFER_SIZE - 1)
+// return credit in batches so credit frames stay a small part of the traffic
+#define LINK_CREDIT_BATCH (LINK_WINDOW / 4)
+
+class HostLink {
+    enum state_e {
+        STATE_SYNC,
+        STATE_TYPE,
+        STATE_LENGTH,
+        STATE_PAYLOAD,
+        STATE_CHECKSUM
+    };
+    byte frame[LINK_PAYLOAD_INDEX + LINK_PAYLOAD_MAX];
+    byte have; // payload bytes stored
+    byte sum;
+    byte state;
+    byte consumed; // bytes read since the last credit
+
+    void nak(byte reason) {
+        send(LINK_NAK, 1, &reason);
+    }
+
+    public:
+    HostLink() {
+        state = STATE_SYNC;
+        consumed = 0;
+    }
+
+
+    // a frame to the host
+    void send(byte type, byte length, const byte *payload) {
+        byte sum = type + length;
+        LINK_SERIAL.write(LINK_SYNC);
+        LINK_SERIAL.write(type);
+        LINK_SERIAL.write(length);
+        for (byte i = 0; i < length; i++) {
+            LINK_SERIAL.write(payload[i]);
+            sum += payload[i];
+        }
+        LINK_SERIAL.write((byte)-sum);
+    }
+
+
+    // answer a LINK_HELLO: the window starts over from here
+    void hello() {
+        const byte payload[2] = { LINK_VERSION, LINK_WINDOW };
+        consumed = 0;
+        send(LINK_HELLO, sizeof(payload), payload);
+    }
+
+
+    // inByte is an int so a failed read (-1) can be passed straight in.
+    // Returns the frame (type, length, payload) once complete and valid.
+    const byte *receive(int inByte) {
+        if (inByte < 0)
+            return NULL;
+        if (++consumed >= LINK_CREDIT_BATCH || !LINK_SERIAL.available()) {
+            send(LINK_CREDIT, 1, &consumed);
+            consumed = 0;
+        }
+        switch (state) {
+            case STATE_SYNC:
+            if (inByte == LINK_SYNC)
+                state = STATE_TYPE;
+            return NULL;
+
+            case STATE_TYPE:
+            frame[LINK_TYPE_INDEX] = inByte;
+            sum = inByte;
+            state = STATE_LENGTH;
+            return NULL;
+
+            case STATE_LENGTH:
+            if (inByte > LINK_PAYLOAD_MAX) {
+                nak(LINK_NAK_LENGTH);
+                state = STATE_SYNC;
+                return NULL;
+            }
+            frame[LINK_LENGTH_INDEX] = inByte;
+            sum += inByte;
+            have = 0;
+            state = inByte ? STATE_PAYLOAD : STATE_CHECKSUM;
+            return NULL;
+
+            case STATE_PAYLOAD:
+            frame[LINK_PAYLOAD_INDEX + have++] = inByte;
+            sum += inByte;
+            if (have == frame[LINK_LENGTH_INDEX])
+                state = STATE_CHECKSUM;
+            return NULL;
+
+            default: // STATE_CHECKSUM
+            state = STATE_SYNC;
+            if ((byte)(sum + inByte) != 0) {
+                nak(LINK_NAK_CHECKSUM);
+                return NULL;
+            }
+            return frame;
+        }
+    }
+};
+
+#endif
@@ -6,28 +6,28 @@
 YM2612 pin-out
             ________
 GND --- GND|o       |0M ---- D3
-D4  ---- D0|        |Vcc --- 5V
-D5  ---- D1|        |A.Vcc - 5V
-D6  ---- D2|        |OUT L - To Mixer Circuit
-D7  ---- D3|        |Out R - To Mixer Circuit
+D6  ---- D0|        |Vcc --- 5V
+D7  ---- D1|        |A.Vcc - 5V
+D8  ---- D2|        |OUT L - To Mixer Circuit
+D9  ---- D3|        |Out R - To Mixer Circuit
 D10 ---- D4|        |A.GND - GND
 D11 ---- D5|        |A1 ---- A0
 D12 ---- D6|        |A0 ---- A1
 D13 ---- D7|        |RD ---- PULLUP (1K?)
-NC  ---- NC|        |WR ---- A2
+NC  ---- NC|        |WR ---- A4
 A5  ---- IC|        |CS ---- A4
-GND --- GND|________|IRQ --- NC
+GND --- GND|________|IRQ --- D4 (PULLUP)
 
 
 SN76489AN pin-out
             ____
 D11 ---- D5|o   |Vcc --- 5V
 D12 ---- D6|    |D4 ---- D10
-D13 ---- D7|    |CLK --- D9
-PLDWN READY|    |D3 ---- D7
- A2 ---- WE|    |D2 ---- D6
- A3 ---- CE|    |D1 ---- D5
-  AUDIO OUT|    |D0 ---- D4
+D13 ---- D7|    |CLK --- D5
+PLDWN READY|    |D3 ---- D9
+ A3 ---- WE|    |D2 ---- D8
+ A3 ---- CE|    |D1 ---- D7
+  AUDIO OUT|    |D0 ---- D6
  GND -- GND|____|NC (INPUT)
 
 */
@@ -40,22 +40,22 @@ Arduino pins:
 ### PORT C ###
 C0/A0:    YM_A1
 C1/A1:    YM_A0
-C2/A2:    YM_WR | SN_WE
-C3/A3:  * SN_CE
-C4/A4:  * YM_CS
+C2/A2:  * YM2_WR | YM2_CS (DUAL_CHIPS)
+C3/A3:  * SN_WE | SN_CE
+C4/A4:  * YM_WR | YM_CS
 C5/A5:    YM_IC
 ### PORT D ###
 D0/D00: * MIDI_IN
 D1/D01: * SERIAL_OUT
-D2/D02:
+D2/D02: * SN2_WE | SN2_CE (DUAL_CHIPS)
 D3/D03: * YM_[phi]M
-D4/D04:   YM_D0 | SN_D0
-D5/D05:   YM_D1 | SN_D1
-D6/D06:   YM_D2 | SN_D2
-D7/D07:   YM_D3 | SN_D3
+D4/D04: * YM_IRQ (the first YM2612's, pulled up)
+D5/D05: * SN_CLK
+D6/D06:   YM_D0 | SN_D0
+D7/D07:   YM_D1 | SN_D1
 ### PORT B ###
-B0/D08:
-B1/D09: * SN_CLK
+B0/D08:   YM_D2 | SN_D2
+B1/D09:   YM_D3 | SN_D3
 B2/D10:   YM_D4 | SN_D4
 B3/D11:   YM_D5 | SN_D5
 B4/D12:   YM_D6 | SN_D6
@@ -63,13 +63,75 @@ B5/D13:   YM_D7 | SN_D7 | LED_PIN
 
 NOTE: YM_RD needs a pull-up.
 
+This is TrahageanBoard in Board.h, the default SYNTH_BOARD on all but
+the ATmega644P and 1284P, which have their own (Mighty644Board and
+Mighty1284Board).
+
+With DUAL_CHIPS defined a second YM2612 and SN76489 share the data bus,
+clocks, A0, A1 and IC, each with its own write strobe above. Every MIDI
+channel of the chips then has two voices, one per chip, so a channel can
+hold two notes. Patch CCs go to both YM2612s, interleaved on the bus by
+YM2612Scheduler. The SN76489s feed the left and right outputs, as in
+Documents/dual_sn76489an_schematic.png.
+
+Global CC 82 switches the SN76489 channels 6-9 to stereo: each note plays
+on both chips, panned by CC 10 of its channel (0-42 left, 43-84 both,
+85-127 right) and with the right chip's period offset by CC 12 - 64 for a
+chorus. Both take effect from the next note. Writes both chips share go
+out once to both (SN76489Pair), so a centred, undetuned note costs what a
+single chip does.
+
+Levels go through Mixer.h: velocity, CC 7 (volume) and CC 11
+(expression) of the channel and global CC 87 (master volume) attenuate
+the YM2612 carriers and the SN76489 channels on a dB scale. They apply to
+the notes playing too, but only carriers whose TL changes are written.
+CC 10 pans the YM2612 channels (0-42 left, 43-84 both, 85-127 right).
+
+Channel 9 plays drums on the SN76489 noise channel from a DrumKit.h kit,
+selected by CC 0 on channel 9. A pitched drum borrows tone 3 and silences
+the note of channel 8. Drums that decay ignore their note off; their
+steps are EventQueue.h events, played from loop() through service().
+
+Global CC 80 (64-127 on) puts the first YM2612's channel 3 in special
+mode: MIDI channels 10-13 each play one of its operators as a voice of
+its own. Their notes queue up and flushNotes() sends them from loop()
+once the MIDI input has drained, so a chord costs one burst on the bus.
+Out of special mode channels 10-13 are silent. In it, MIDI channel 2
+loses the first YM2612's channel 3: its notes play on the second chip
+with DUAL_CHIPS and are dropped without, and its CC 14 is kept for
+later. Turning the mode off gives channel 3 back its algorithm.
+
+Sequencer.h arpeggiates the keys held on a channel, or plays an EEPROM
+pattern from them, to an internal tempo or MIDI clock: CC 102-105 on the
+channel and global CC 106 and 107. The internal tempo can also come from
+the YM2612's Timer B, ticking on its IRQ (YmTimer.h).
+
+Morph.h blends two patches on a YM2612 channel, CC 108 taking them and
+CC 109 moving between them, at a bounded cost on the bus.
+
+A SysEx message loads a whole YM2612 patch, registers or a .tfi or .dmp,
+into a channel at once, or asks for one back; see Patch.h. The answer
+goes out on Serial, or where setSysexSender() says.
+
 */
 
 #include "YM2612.h"
 #include "SN76489.h"
 #include "midiPacketizer.h"
+#include "Mixer.h"
+#include "DrumKit.h"
+#include "Trace.h"
+#include "Tuning.h"
+#include "EventQueue.h"
+#include "Sequencer.h"
+#include "Patch.h"
+#include "Morph.h"
+#include "YmTimer.h"
 
 class MegaSynth {
+    static_assert(SynthBoard::Clock::TIMER == SYNTH_CLOCK,
+        "SYNTH_CLOCK must name the timer of SynthBoard::Clock");
+
     public:
     enum note_e {
         NOTE_C,
@@ -91,43 +153,93 @@ class MegaSynth {
         NOTE_B,
         NOTE_COUNT
     };
+    enum special_e { // channel 3 special mode voices, one per operator
+        SPECIAL_CHAN1 = 10, // MIDI channel (0-based) of operator 1
+        SPECIAL_CHAN_COUNT = YM2612::SLOT_COUNT,
+        SPECIAL_NO_KEY = 0xFF
+    };
+    enum voice_e { // MIDI channels with a voice on each chip
+        VOICE_CHAN_COUNT = 10,
+#ifdef DUAL_CHIPS
+        CHIP_COUNT = 2,
+#else
+        CHIP_COUNT = 1,
+#endif
+        NO_VOICE = 0xFF
+    };
+    enum sn_e {
+        SN_CHAN1 = 6,
+        SN_CHAN_COUNT = 4,
+        SN_TONE3_CHAN = 8, // lends tone 3 to pitched drums
+        SN_DRUM_CHAN = 9,
+        SN_PAN_LEFT = bit(0),
+        SN_PAN_RIGHT = bit(1),
+        SN_PAN_BOTH = SN_PAN_LEFT | SN_PAN_RIGHT,
+        SN_DETUNE_NONE = 64
+    };
     private:
     YM2612 ym;
     SN76489 sn;
-    static const PROGMEM word noteFreq72[NOTE_COUNT];
+#ifdef DUAL_CHIPS
+    YM2612B ym2;
+    SN76489B sn2;
+    byte voiceKey[2][VOICE_CHAN_COUNT]; // key each chip's voice holds
+    word stealSecond; // per channel: the next note with both busy takes chip 2
+    bool snStereo; // channels 6-9 play on both SN76489s, see CC 82
+    byte snPan[SN_CHAN_COUNT]; // chips that play: bit 0 left, bit 1 right
+    byte snDetune[SN_CHAN_COUNT]; // right chip's period offset + 64
+#endif
+    byte specialKey[YM2612::SLOT_COUNT]; // key held by each operator voice
+    byte specialQueued; // voices flushNotes() keys on, keyBit() values
+    byte specialRetrigger; // of those, the ones to key off first
+    bool specialMode; // CC 80, channel 3 of the first YM2612 is theirs
+    byte specialAlgorithm; // channel 3's, to restore when the mode ends
+    Mixer mixer;
+    // velocity of each voice's last note, to mix it again on CC 7, 11, 87;
+    // 0 once an SN76489 voice is off
+    byte noteVelocity[CHIP_COUNT][VOICE_CHAN_COUNT];
+    byte specialVelocity[YM2612::SLOT_COUNT];
+    byte snAttn[CHIP_COUNT][SN_CHAN_COUNT]; // as last written
+    DrumKit drums;
+    struct DrumVoice {
+        byte offset; // added attenuation, grows as the drum decays
+        byte decay; // ms per step, 0 once the drum holds or has faded
+        byte countdown; // ms to the next step
+    } drum[CHIP_COUNT];
+    EventQueue queue;
+    Sequencer seq;
+    Morph morph;
+    YmTimer ymTicks;
+    PatchSysex patchSysex;
+    PatchSysex::Sender sysexSender;
+    static const word DRUM_MS_TICKS = F_CPU / 8 / 1000;
 
     static inline int8_t keyToBlock(byte key) {
         // obtain octave by applying / NOTE_COUNT to key
         // then apply the offset (-1)
         return key / NOTE_COUNT - 1;
     }
-    
-    
-    static inline word keyToFrequency72(byte key) {
-        //look up the freq72 for the key, disregarding octave by
-        // applying % NOTE_COUNT
-        return pgm_read_word(&noteFreq72[key % NOTE_COUNT]);
-    }
-    
-    
-    static inline word keyToPeriod125k(byte key) {
-        //look up the freq72 for the key, disregarding octave by
-        // applying % NOTE_COUNT
-        word freq72 = pgm_read_word(&noteFreq72[key % NOTE_COUNT]);
-        int8_t octave = key / NOTE_COUNT - 5;
-        // noteFreq72 starts at key 60 or octave 5, corrections follow:
-        // multiply by 2 for each octave above 5
-        // divide by 2 for each octave below 5
-        // finally, add half of freq72 to numerator to reduce roundoff errors
-        // 125000 is based on 4MHz clock
-        long period = ((
-                (octave < 0) ? ((125000 * 72) << -octave)
-                : (octave > 0) ? ((125000 * 72) >> octave)
-                : (125000 * 72)
-            ) + (freq72 >> 1)) / freq72;
-        while (period > 1023) // period does not fit in 10bits
-            period >>= 1; // halve period until it does
-        return period;
+
+
+    // global CCs of the YM2612 registers, for each chip
+    template<class Y> static inline byte doYmGlobalCc(Y &chip, byte num, byte val) {
+        switch (num) {
+            // DO NOT FORGET: break
+            case  1: chip.template setGlobal<YM2612::Field::  LFOFREQ>(val); break;
+            case 74: chip.template setGlobal<YM2612::Field::    LFOEN>(val); break;
+            // Timer A's bits alone: Timer B is the tempo's, see YmTimer.h
+            case 92: chip.setTimerABits(val); break;
+            case 93: chip.template setGlobal<YM2612::Field::     T27H>(val); break;
+            case 94: chip.template setGlobal<YM2612::Field::     T20L>(val); break;
+            case 95: chip.template setGlobal<YM2612::Field::     T20H>(val); break;
+            case 96: chip.template setGlobal<YM2612::Field::     T2CL>(val); break;
+            case 97: chip.template setGlobal<YM2612::Field::     T2CH>(val); break;
+
+            default:
+            return 0; //did not handle CC
+            break;
+        }
+        return 1; //handled CC
     }
 
 
@@ -135,15 +247,14 @@ class MegaSynth {
         switch (num) {
             // global CCs
             // DO NOT FORGET: break
-            case  1: ym.setGlobal22(YM2612::Field::  LFOFREQ, val); break;
-            case 74: ym.setGlobal22(YM2612::Field::    LFOEN, val); break;
-            case 80: ym.setGlobal27(YM2612::Field::SPECIALEN, val); break;
-            case 92: ym.setGlobal27(YM2612::Field::     T27L, val); break;
-            case 93: ym.setGlobal27(YM2612::Field::     T27H, val); break;
-            case 94: ym.setGlobal20(YM2612::Field::     T20L, val); break;
-            case 95: ym.setGlobal20(YM2612::Field::     T20H, val); break;
-            case 96: ym.setGlobal2C(YM2612::Field::     T2CL, val); break;
-            case 97: ym.setGlobal2C(YM2612::Field::     T2CH, val); break;
+            case 80: setSpecialMode(val); break;
+            case 87: setMasterVolume(val); break;
+#ifdef DUAL_CHIPS
+            case 82: setSnStereo(val); break;
+#endif
+#ifdef TRACE_ENABLE
+            case 86: Trace::dump(); break;
+#endif
 
             // valid but unimplemented global CCs:
             case 85: //pitch transposition (YM & SN)
@@ -157,8 +268,9 @@ class MegaSynth {
         }
         return 1; //handled CC
     }
-    inline byte doYmCc(byte channel, byte num, byte val) {
-        if (channel > YM2612::CHAN_COUNT) //sanity check 
+    template<class Y>
+    static inline byte doYmCc(Y &chip, byte channel, byte num, byte val) {
+        if (channel >= YM2612::CHAN_COUNT) //sanity check
             return 0; //did not handle CC
         //now that channel is sane, cast it to the channel enum:
         YM2612::channel_e c = static_cast<YM2612::channel_e>(channel);
@@ -167,16 +279,20 @@ class MegaSynth {
 // SHORTCUT:            
 #define YM_CHANNEL_CC(cc, field) \
             case cc: \
-            ym.setChannel(c, YM2612::Field:: field, val); \
+            chip.template setChannel<YM2612::Field:: field>(c, val); \
             break
 
-            YM_CHANNEL_CC(14, ALGO);
             YM_CHANNEL_CC(15, FB);
             YM_CHANNEL_CC(77, LR);
             YM_CHANNEL_CC(76, AMS);
             YM_CHANNEL_CC(75, PMS);
 #undef YM_CHANNEL_CC
 
+            case 14: chip.setAlgorithm(c, val); break;
+            // LR: bit 1 is left, bit 0 right
+            case 10: chip.template setChannel<YM2612::Field::LR>(c,
+                val < 43 ? B10 : val < 85 ? B11 : B1); break;
+
             // valid but unimplemented channel CCs
             case  6: //instrument store
             case  9: //instrument recall
@@ -187,7 +303,7 @@ class MegaSynth {
 // SHORTCUT:            
 #define YM_SLOT_CC(cc, slot, field) \
             case cc: \
-            ym.setSlot(c, YM2612:: slot, YM2612::Field:: field, val); \
+            chip.template setSlot<YM2612:: slot, YM2612::Field:: field>(c, val); \
             break
             
             YM_SLOT_CC(90, SLOT1, SSEG);
@@ -195,10 +311,11 @@ class MegaSynth {
             YM_SLOT_CC(92, SLOT3, SSEG);
             YM_SLOT_CC(93, SLOT4, SSEG);
 
-            YM_SLOT_CC(16, SLOT1, TL);
-            YM_SLOT_CC(17, SLOT2, TL);
-            YM_SLOT_CC(18, SLOT3, TL);
-            YM_SLOT_CC(19, SLOT4, TL);
+            // TL is the patch's level, the mixer adds to it on carriers
+            case 16: chip.setLevel(c, YM2612::SLOT1, val); break;
+            case 17: chip.setLevel(c, YM2612::SLOT2, val); break;
+            case 18: chip.setLevel(c, YM2612::SLOT3, val); break;
+            case 19: chip.setLevel(c, YM2612::SLOT4, val); break;
 
             YM_SLOT_CC(20, SLOT1, MULTI);
             YM_SLOT_CC(21, SLOT2, MULTI);
@@ -254,97 +371,767 @@ class MegaSynth {
         return 1; //handled CC        
     }
 
+    static inline YM2612::slot_e toSpecialSlot(byte channel) {
+        // voices are in operator order, slot_e is in register order
+        return channel == SPECIAL_CHAN1 ? YM2612::SLOT1
+            : channel == SPECIAL_CHAN1 + 1 ? YM2612::SLOT2
+            : channel == SPECIAL_CHAN1 + 2 ? YM2612::SLOT3
+            : YM2612::SLOT4;
+    }
+
+
+    void setSpecialMode(byte val) {
+        const bool on = val >= 64;
+        // cuts the voices of either mode, MIDI channel 2's included
+        ym.specialKeyOff(B1111);
+        for (byte s = YM2612::SLOT1; s < YM2612::SLOT_COUNT; s++) {
+            specialKey[s] = SPECIAL_NO_KEY;
+        }
+        specialQueued = specialRetrigger = 0;
+        noteVelocity[0][YM2612::CHAN3] = 0;
+#ifdef DUAL_CHIPS
+        voiceKey[0][YM2612::CHAN3] = NO_VOICE;
+#endif
+        ym.setGlobal<YM2612::Field::SPECIALEN>(on);
+        if (on && !specialMode) {
+            // every operator a carrier, so each one is a voice
+            specialAlgorithm = ym.getChannel<YM2612::Field::ALGO>(
+                YM2612::CHAN3);
+            ym.setAlgorithm(YM2612::CHAN3, 7);
+        } else if (!on && specialMode) {
+            ym.setAlgorithm(YM2612::CHAN3, specialAlgorithm);
+        }
+        specialMode = on;
+    }
+
+
+    static inline bool isSpecialChannel(byte channel) {
+        return SPECIAL_CHAN1 <= channel
+            && channel < SPECIAL_CHAN1 + SPECIAL_CHAN_COUNT;
+    }
+
+
+    // queues the voice for flushNotes(), which keys it on with the others
+    void specialNoteOn(YM2612::slot_e slot, byte key) {
+        const byte k = YM2612::keyBit(slot);
+        if (specialKey[slot] != SPECIAL_NO_KEY && !(specialQueued & k))
+            specialRetrigger |= k; // held voice, keyed off first
+        specialQueued |= k;
+        specialKey[slot] = key;
+    }
+
+
+    void specialNoteOff(YM2612::slot_e slot, byte key) {
+        if (specialKey[slot] != key) // voice was taken by a newer note
+            return;
+        if (specialQueued & YM2612::keyBit(slot))
+            flushNotes(); // the note sounds before it ends
+        ym.specialKeyOff(YM2612::keyBit(slot));
+        specialKey[slot] = SPECIAL_NO_KEY;
+    }
+
+
+    template<class Y>
+    static void ymNoteOn(Y &chip, byte channel, byte key, byte atten) {
+        chip.frequency(channel, keyToBlock(key), SynthTuning::ymFnumber(key));
+        chip.setAttenuation(channel, atten);
+        //kill existing notes -- is this what we want?
+        chip.setOperators(channel, 0);
+        chip.setOperators(channel, bit(YM2612::SLOT1) | bit(YM2612::SLOT2) | bit(YM2612::SLOT3) | bit(YM2612::SLOT4)); //enable ALL the operators
+    }
+
+
+    template<class S> void snNoteOn(byte chip, byte channel, byte key) {
+        if (channel == SN_DRUM_CHAN) {
+            DrumKit::Note note;
+            drums.lookup(key, note);
+            if (note.rate() == SN76489::SHIFT_CHAN3) {
+                noteVelocity[chip][SN_TONE3_CHAN] = 0;
+                snLevel<S>(chip, SN_TONE3_CHAN);
+                S::setPeriod(SN76489::CHAN3, drumPeriod(note, key));
+            }
+            S::setNoise(note.feedback(), note.rate());
+            startDrum(chip, note);
+        } else {
+            S::setPeriod(static_cast<SN76489::channel_e>(channel - 6), SynthTuning::snPeriod(key));
+        }
+        snLevel<S>(chip, channel);
+    }
+
+
+    // tone 3 period of a pitched drum
+    static inline word drumPeriod(const DrumKit::Note &note, byte key) {
+        const word period = SynthTuning::snPeriod(key) >> 4;
+        return note.period ? note.period : period ? period : 1;
+    }
+
+
+    void startDrum(byte chip, const DrumKit::Note &note) {
+        if (!drumDecaying()) { // steps from now, even if one is queued
+            queue.cancel(EVENT_SOURCE_DRUMS);
+            queue.post(queue.now() + DRUM_MS_TICKS, EVENT_SOURCE_DRUMS,
+                EVENT_DRUM);
+        }
+        drum[chip].offset = note.level();
+        drum[chip].decay = drum[chip].countdown = note.decay;
+    }
+
+
+    bool drumDecaying() const {
+        for (byte chip = 0; chip < CHIP_COUNT; chip++) {
+            if (drum[chip].decay)
+                return true;
+        }
+        return false;
+    }
+
+
+    // one ms of a drum's envelope
+    void stepDrum(byte chip) {
+        DrumVoice &d = drum[chip];
+        if (!d.decay || --d.countdown)
+            return;
+        d.countdown = d.decay;
+        d.offset++;
+        if (snVoiceAttn(chip, SN_DRUM_CHAN) == Mixer::SN_ATTN_MAX)
+            d.decay = 0; // faded out
+#ifdef DUAL_CHIPS
+        if (snStereo) {
+            snStereoLevel(SN_DRUM_CHAN);
+            return;
+        }
+        if (chip) {
+            snLevel<SN76489B>(1, SN_DRUM_CHAN);
+            return;
+        }
+#endif
+        snLevel<SN76489>(0, SN_DRUM_CHAN);
+    }
+
+
+    // a drum that decays plays out whatever its note off says
+    inline bool drumRinging(byte chip, byte channel) const {
+        return channel == SN_DRUM_CHAN && drum[chip].decay;
+    }
+
+
+    // attenuation of an SN76489 voice: its note through the mixer, and on
+    // channel 9 the drum's level and decay
+    byte snVoiceAttn(byte chip, byte channel) const {
+        byte attn = Mixer::toSnAttn(
+            mixer.noteAtten(channel, noteVelocity[chip][channel]));
+        if (channel == SN_DRUM_CHAN)
+            attn += drum[chip].offset;
+        return attn > Mixer::SN_ATTN_MAX ? Mixer::SN_ATTN_MAX : attn;
+    }
+
+
+    // mix an SN76489 voice at its note's velocity, skipped if unchanged
+    template<class S> void snLevel(byte chip, byte channel) {
+        const byte v = channel - SN_CHAN1;
+        const byte attn = snVoiceAttn(chip, channel);
+        if (attn == snAttn[chip][v])
+            return;
+        snAttn[chip][v] = attn;
+        S::attenuation(static_cast<SN76489::channel_e>(v), attn);
+    }
+
+
+    // mix again the voices of a channel after its attenuation changed
+    void mixChannel(byte channel) {
+        if (channel < YM2612::CHAN_COUNT) {
+            if (channel != YM2612::CHAN3 || !specialMode)
+                ym.setAttenuation(channel,
+                    mixer.noteAtten(channel, noteVelocity[0][channel]));
+#ifdef DUAL_CHIPS
+            ym2.setAttenuation(channel,
+                mixer.noteAtten(channel, noteVelocity[1][channel]));
+#endif
+        } else if (isSpecialChannel(channel)) {
+            if (!specialMode)
+                return;
+            const YM2612::slot_e slot = toSpecialSlot(channel);
+            ym.setAttenuation(YM2612::CHAN3, slot,
+                mixer.noteAtten(channel, specialVelocity[slot]));
+        } else if (SN_CHAN1 <= channel && channel < SN_CHAN1 + SN_CHAN_COUNT) {
+#ifdef DUAL_CHIPS
+            if (snStereo) {
+                snStereoLevel(channel);
+                return;
+            }
+            snLevel<SN76489B>(1, channel);
+#endif
+            snLevel<SN76489>(0, channel);
+        }
+    }
+
+
+    inline byte doDrumCc(byte channel, byte num, byte val) {
+        if (channel != SN_DRUM_CHAN || num != 0)
+            return 0; //did not handle CC
+        drums.select(val); // CC 0, bank select: the kit
+        return 1; //handled CC
+    }
+
+
+    // channel CCs of the mixer, for every chip
+    inline byte doMixerCc(byte channel, byte num, byte val) {
+        bool changed;
+        switch (num) {
+            // DO NOT FORGET: break
+            case  7: changed = mixer.setVolume(channel, val); break;
+            case 11: changed = mixer.setExpression(channel, val); break;
+
+            default:
+            return 0; //did not handle CC
+            break;
+        }
+        if (changed)
+            mixChannel(channel);
+        return 1; //handled CC
+    }
+
+
+    void setMasterVolume(byte val) {
+        mixer.setMaster(val);
+        for (byte c = 0; c < Mixer::CHAN_COUNT; c++) {
+            mixChannel(c);
+        }
+    }
+
+
+#ifdef DUAL_CHIPS
+    // chip (0 or 1) to play a new note on: a free voice, or else the
+    // chips take turns losing their note
+    byte takeVoice(byte channel, byte key) {
+        byte chip;
+        if (voiceKey[0][channel] == NO_VOICE) {
+            chip = 0;
+        }
+        else if (voiceKey[1][channel] == NO_VOICE) {
+            chip = 1;
+        }
+        else {
+            chip = bitRead(stealSecond, channel);
+            stealSecond ^= bit(channel);
+        }
+        voiceKey[chip][channel] = key;
+        return chip;
+    }
+
+
+    // SN76489 channel CCs for stereo mode
+    inline byte doSnCc(byte channel, byte num, byte val) {
+        if (channel < SN_CHAN1 || channel >= SN_CHAN1 + SN_CHAN_COUNT)
+            return 0; //did not handle CC
+        const byte v = channel - SN_CHAN1;
+        switch (num) {
+            // DO NOT FORGET: break
+            case 10:
+            snPan[v] = val < 43 ? SN_PAN_LEFT
+                : val < 85 ? SN_PAN_BOTH
+                : SN_PAN_RIGHT;
+            break;
+            case 12: snDetune[v] = val; break;
+
+            default:
+            return 0; //did not handle CC
+            break;
+        }
+        return 1; //handled CC
+    }
+
+
+    void setSnStereo(byte enable) {
+        for (byte v = 0; v < SN_CHAN_COUNT; v++) {
+            noteVelocity[0][SN_CHAN1 + v] = noteVelocity[1][SN_CHAN1 + v] = 0;
+            snStereoLevel(SN_CHAN1 + v);
+            voiceKey[0][SN_CHAN1 + v] = voiceKey[1][SN_CHAN1 + v] = NO_VOICE;
+        }
+        snStereo = enable;
+    }
+
+
+    // mix a stereo voice, panned; a chip whose level stays is not written
+    void snStereoLevel(byte channel) {
+        const byte v = channel - SN_CHAN1;
+        const SN76489::channel_e c = static_cast<SN76489::channel_e>(v);
+        const byte attn = snVoiceAttn(0, channel);
+        const byte left = snPan[v] & SN_PAN_LEFT ? attn : Mixer::SN_ATTN_MAX;
+        const byte right = snPan[v] & SN_PAN_RIGHT ? attn : Mixer::SN_ATTN_MAX;
+        const bool toLeft = left != snAttn[0][v];
+        const bool toRight = right != snAttn[1][v];
+        snAttn[0][v] = left;
+        snAttn[1][v] = right;
+        if (toLeft && toRight)
+            SN76489Stereo::attenuation(c, left, right);
+        else if (toLeft)
+            SN76489::attenuation(c, left);
+        else if (toRight)
+            SN76489B::attenuation(c, right);
+    }
+
+
+    static inline word detune(word period, byte offset) {
+        const int p = (int)period + offset - SN_DETUNE_NONE;
+        return p < 1 ? 1 : p > 0x3FF ? 0x3FF : p;
+    }
+
+
+    // one note on both SN76489s
+    void snStereoNoteOn(byte channel, byte key) {
+        const byte v = channel - SN_CHAN1;
+        const SN76489::channel_e c = static_cast<SN76489::channel_e>(v);
+        if (channel == SN_DRUM_CHAN) {
+            DrumKit::Note note;
+            drums.lookup(key, note);
+            if (note.rate() == SN76489::SHIFT_CHAN3) {
+                const word period = drumPeriod(note, key);
+                noteVelocity[0][SN_TONE3_CHAN] = 0;
+                snStereoLevel(SN_TONE3_CHAN);
+                SN76489Stereo::setPeriod(SN76489::CHAN3, period, period);
+            }
+            SN76489Stereo::setNoise(note.feedback(), note.rate());
+            startDrum(0, note);
+        } else {
+            const word period = SynthTuning::snPeriod(key);
+            SN76489Stereo::setPeriod(c, period,
+                detune(period, snDetune[v]));
+        }
+        snStereoLevel(channel);
+    }
+
+
+    // chip playing the key, NO_VOICE if neither does any more
+    byte releaseVoice(byte channel, byte key) {
+        for (byte chip = 0; chip < 2; chip++) {
+            if (voiceKey[chip][channel] == key) {
+                voiceKey[chip][channel] = NO_VOICE;
+                return chip;
+            }
+        }
+        return NO_VOICE;
+    }
+#endif
+
+    // the default sysexSender: raw MIDI out of the serial port
+    static void writeSerial(const byte *bytes, byte length) {
+        Serial.write(bytes, length);
+    }
+
+
+    // a SysEx message has ended, complete or cut short by another status
+    void finishSysex(bool complete) {
+        const Patch::channel_e channel = patchSysex.target();
+        switch (patchSysex.finish(complete)) {
+            case PatchSysex::DONE_LOAD:
+#ifdef DUAL_CHIPS
+            // both chips keep the same patch, their writes interleave a
+            // queue's worth at a time
+            memcpy(ym2.slice(channel), ym.slice(channel),
+                YM2612::CHAN_STATE_LENGTH);
+            ym.loadLevels(channel);
+            ym2.loadLevels(channel);
+            for (byte i = 0; i < YM2612::CHAN_STATE_LENGTH;
+                    i += YM2612_QUEUE_LENGTH) {
+                const byte end = i + YM2612_QUEUE_LENGTH
+                    < YM2612::CHAN_STATE_LENGTH ? i + YM2612_QUEUE_LENGTH
+                    : YM2612::CHAN_STATE_LENGTH;
+                ym.defer();
+                ym2.defer();
+                ym.loadRegs(channel, i, end);
+                ym2.loadRegs(channel, i, end);
+                YM2612Scheduler::flush(ym, ym2);
+            }
+#else
+            ym.load(channel);
+#endif
+            break;
+
+            case PatchSysex::DONE_REQUEST:
+            PatchSysex::send(ym, channel, patchSysex.requested(),
+                sysexSender);
+            break;
+
+            default:
+            break;
+        }
+    }
+
     public:
     void begin() {
         pinMode(LED_BUILTIN, OUTPUT);
         digitalWrite(LED_BUILTIN, LOW);
         
+        YM2612::resetChips();
         ym.begin();
         sn.begin();
+#ifdef DUAL_CHIPS
+        ym2.begin();
+        sn2.begin();
+        for (byte c = 0; c < VOICE_CHAN_COUNT; c++) {
+            voiceKey[0][c] = voiceKey[1][c] = NO_VOICE;
+        }
+        stealSecond = 0;
+        snStereo = false;
+        for (byte v = 0; v < SN_CHAN_COUNT; v++) {
+            snPan[v] = SN_PAN_BOTH;
+            snDetune[v] = SN_DETUNE_NONE;
+        }
+#endif
+        for (byte s = YM2612::SLOT1; s < YM2612::SLOT_COUNT; s++) {
+            specialKey[s] = SPECIAL_NO_KEY;
+            specialVelocity[s] = 0;
+        }
+        specialQueued = specialRetrigger = 0;
+        specialMode = false;
+        mixer.begin();
+        drums.begin();
+        // shared with Trace.h and VgmStream.h
+        SynthBoard::Clock::begin();
+        queue.begin();
+        seq.begin();
+        morph.begin();
+        ymTicks.begin();
+        sysexSender = writeSerial;
+        for (byte chip = 0; chip < CHIP_COUNT; chip++) {
+            drum[chip].offset = drum[chip].decay = 0;
+            for (byte c = 0; c < VOICE_CHAN_COUNT; c++) {
+                noteVelocity[chip][c] = 0;
+            }
+            for (byte v = 0; v < SN_CHAN_COUNT; v++) {
+                snAttn[chip][v] = Mixer::SN_ATTN_MAX; // begin() silenced them
+            }
+        }
+    }
+
+    // register streams bypass the voice logic; parts 2 and 3 are the
+    // second chip's with DUAL_CHIPS
+    void writeYm(byte part, byte reg, byte data) {
+        if (part < YM2612::PART_COUNT)
+            ym.writeReg(static_cast<YM2612::part_e>(part), reg, data);
+#ifdef DUAL_CHIPS
+        else if (part < 2 * YM2612::PART_COUNT)
+            ym2.writeReg(
+                static_cast<YM2612::part_e>(part - YM2612::PART_COUNT),
+                reg, data);
+#endif
+    }
+
+
+    void writeSn(byte data) {
+        if ((data & 0x90) == 0x90) // attenuation latch, keep snAttn true
+            snAttn[0][(data >> 5) & 0x03] = data & 0x0F;
+        sn.writeByte(data);
+    }
+
+
+    // where the answer to a patch request goes, see Patch.h
+    void setSysexSender(PatchSysex::Sender sender) {
+        sysexSender = sender;
+    }
+
+
+    // a YM2612 channel's patch, see YM2612Chip::readPatch()
+    void readPatch(byte channel, byte *patch) const {
+        ym.readPatch(static_cast<YM2612::channel_e>(channel), patch);
+    }
+
+
+    // writes what a patch changes on the channel, on both chips with
+    // DUAL_CHIPS
+    void writePatch(byte channel, const byte *patch) {
+        const YM2612::channel_e c = static_cast<YM2612::channel_e>(channel);
+#ifdef DUAL_CHIPS
+        ym.defer();
+        ym2.defer();
+        ym.writePatch(c, patch);
+        ym2.writePatch(c, patch);
+        YM2612Scheduler::flush(ym, ym2);
+#else
+        ym.writePatch(c, patch);
+#endif
+    }
+
+
+    // a YM2612's shadow registers, YM2612::STATE_LENGTH bytes; chip 1 is
+    // the second with DUAL_CHIPS. NULL for a chip there is not.
+    const byte *ymState(byte chip) const {
+        if (chip == 0)
+            return ym.shadow();
+#ifdef DUAL_CHIPS
+        if (chip == 1)
+            return ym2.shadow();
+#endif
+        return NULL;
+    }
+
+
+    // timed events for other sources, see VgmStream.h
+    EventQueue &events() {
+        return queue;
+    }
+
+
+    // Timer B of the first YM2612 ticking every units / per of its steps,
+    // see YmTimer.h
+    void startYmTicks(unsigned long units, word per) {
+        ymTicks.start(ym, units, per);
+    }
+
+
+    void setYmTickRate(unsigned long units, word per) {
+        ymTicks.rate(units, per);
+    }
+
+
+    void stopYmTicks() {
+        ymTicks.stop(ym);
+    }
+
+
+    // plays the events due and the YM2612's ticks, call it from loop()
+    void service() {
+        if (ymTicks.service(ym))
+            seq.ymTick(*this);
+        queue.service(*this);
     }
 
+
+    /* Keys on the channel 3 special mode voices queued since the last
+     * call, in one burst: their frequencies and levels, then a single
+     * 0x28 write for all of them (one more before it for the voices
+     * retriggered). Call it from loop() once the MIDI input has drained,
+     * so the notes of a chord go out together. */
+    void flushNotes() {
+        if (!specialQueued)
+            return;
+        ym.defer();
+        for (byte channel = SPECIAL_CHAN1;
+                channel < SPECIAL_CHAN1 + SPECIAL_CHAN_COUNT; channel++) {
+            const YM2612::slot_e slot = toSpecialSlot(channel);
+            if (!(specialQueued & YM2612::keyBit(slot)))
+                continue;
+            const byte key = specialKey[slot];
+            ym.specialFrequency(slot, keyToBlock(key),
+                SynthTuning::ymFnumber(key));
+            ym.setAttenuation(YM2612::CHAN3, slot,
+                mixer.noteAtten(channel, specialVelocity[slot]));
+        }
+        if (specialRetrigger)
+            ym.specialKeyOff(specialRetrigger);
+        ym.specialKeyOn(specialQueued);
+        YM2612Scheduler::flush(ym);
+        specialQueued = specialRetrigger = 0;
+    }
+
+
+    // false while service() or flushNotes() has work to do, see
+    // EventQueue::canSleep()
+    bool canSleep() {
+        return !specialQueued && !ymTicks.pending() && queue.canSleep();
+    }
+
+
+    // an event from the queue, see EventQueue.h
+    void play(const EventQueue::Event &e) {
+        switch (e.kind) {
+            case EVENT_SN:
+            writeSn(e.data);
+            break;
+
+            case EVENT_WAKE:
+            break;
+
+            case EVENT_SEQ:
+            seq.tick(*this);
+            break;
+
+            case EVENT_MORPH:
+            morph.tick(*this);
+            break;
+
+            case EVENT_DRUM:
+            for (byte chip = 0; chip < CHIP_COUNT; chip++) {
+                stepDrum(chip);
+            }
+            if (drumDecaying())
+                queue.post(e.due + DRUM_MS_TICKS, EVENT_SOURCE_DRUMS,
+                    EVENT_DRUM);
+            break;
+
+            default: // EVENT_YM0-EVENT_YM3 are the part
+            writeYm(e.kind, e.reg, e.data);
+            break;
+        }
+    }
+
+
     void noteOn(byte channel, byte key, byte velocity) {
-        if (channel <= 5 || (10 <= channel && channel <= 12 )) {
-            ym.frequency72(channel, keyToBlock(key), keyToFrequency72(key));
-            if (channel <= 5) {
-                ym.level(channel, 127 - velocity);
-                //kill existing notes -- is this what we want?
-                ym.setOperators(channel, 0);
-                ym.setOperators(channel, bit(YM2612::SLOT1) | bit(YM2612::SLOT2) | bit(YM2612::SLOT3) | bit(YM2612::SLOT4)); //enable ALL the operators
-            }            
+        if (channel <= 5) {
+            const byte atten = mixer.noteAtten(channel, velocity);
+            const bool second = channel == YM2612::CHAN3 && specialMode;
+#ifdef DUAL_CHIPS
+            if (second) // the first chip's channel 3 is the operators'
+                voiceKey[1][channel] = key;
+            if (second || takeVoice(channel, key)) {
+                noteVelocity[1][channel] = velocity;
+                ymNoteOn(ym2, channel, key, atten);
+                return;
+            }
+#endif
+            if (second)
+                return;
+            noteVelocity[0][channel] = velocity;
+            ymNoteOn(ym, channel, key, atten);
+        } else if (isSpecialChannel(channel)) {
+            if (!specialMode)
+                return;
+            const YM2612::slot_e slot = toSpecialSlot(channel);
+            specialVelocity[slot] = velocity;
+            specialNoteOn(slot, key);
         } else if (6 <= channel && channel <= 9) {
-            if (channel == 9) {
-                key %= NOTE_COUNT;
-                enum SN76489::feedback_e fb;
-                enum SN76489::rate_e shift;
-                if (key == NOTE_C
-                    || key == NOTE_Cs
-                    || key == NOTE_D
-                    || key == NOTE_Ds
-                    || key == NOTE_E
-                    || key == NOTE_A
-                    || key == NOTE_As) {
-                    fb = SN76489::PERIODIC_NOISE;
-                }
-                else {
-                    fb = SN76489::WHITE_NOISE;
-                }
-                if (key == NOTE_C
-                    || key == NOTE_Cs
-                    || key == NOTE_F) {
-                    shift = SN76489::SHIFT_512;
-                }
-                else if (key == NOTE_D
-                    || key == NOTE_Ds
-                    || key == NOTE_Fs) {
-                    shift = SN76489::SHIFT_1024;
-                }
-                else if (key == NOTE_E
-                    || key == NOTE_G
-                    || key == NOTE_Gs) {
-                    shift = SN76489::SHIFT_2048;
-                }
-                else {
-                    shift = SN76489::SHIFT_CHAN3;
-                }
-                sn.setNoise(fb, shift);
-            } else {                
-                sn.setPeriod125k(static_cast<SN76489::channel_e>(channel - 6), keyToPeriod125k(key));
-            }                
-            sn.level(static_cast<SN76489::channel_e>(channel - 6), velocity);
+#ifdef DUAL_CHIPS
+            if (snStereo) {
+                noteVelocity[0][channel] = velocity;
+                snStereoNoteOn(channel, key);
+                return;
+            }
+            if (takeVoice(channel, key)) {
+                noteVelocity[1][channel] = velocity;
+                snNoteOn<SN76489B>(1, channel, key);
+                return;
+            }
+#endif
+            noteVelocity[0][channel] = velocity;
+            snNoteOn<SN76489>(0, channel, key);
         }
     }
 
 
-    void noteOff(byte channel) {
+    void noteOff(byte channel, byte key) {
+#ifdef DUAL_CHIPS
+        if (snStereo && 6 <= channel && channel <= 9) {
+            if (drumRinging(0, channel))
+                return;
+            noteVelocity[0][channel] = 0;
+            snStereoLevel(channel);
+            return;
+        }
+        if (channel < VOICE_CHAN_COUNT) {
+            switch (releaseVoice(channel, key)) {
+                case 0:
+                break;
+
+                case 1:
+                if (channel <= 5) {
+                    ym2.setOperators(channel, 0);
+                } else if (!drumRinging(1, channel)) {
+                    noteVelocity[1][channel] = 0;
+                    snLevel<SN76489B>(1, channel);
+                }
+                return;
+
+                default: // the note was stolen
+                return;
+            }
+        }
+#endif
         if (channel <= 5) {
+            if (channel == YM2612::CHAN3 && specialMode)
+                return; // played elsewhere or not at all
             ym.setOperators(channel, 0); //disable ALL the operators
+        } else if (isSpecialChannel(channel)) {
+            if (specialMode)
+                specialNoteOff(toSpecialSlot(channel), key);
         } else if (6 <= channel && channel <= 9) {
-            sn.level(static_cast<SN76489::channel_e>(channel - 6), 0);
+            if (drumRinging(0, channel))
+                return;
+            noteVelocity[0][channel] = 0;
+            snLevel<SN76489>(0, channel);
         }
     }
     
     
     void continuousController(byte channel, byte ccnum, byte ccval) {
         byte done = 0;
+#ifdef DUAL_CHIPS
+        // both chips keep the same patch, their writes interleave
+        ym.defer();
+        ym2.defer();
+#endif
         if (!done) {
             done = doGlobalCc(ccnum, ccval);
         }
         if (!done) {
-            done = doYmCc(channel, ccnum, ccval);
+            done = seq.doCc(*this, channel, ccnum, ccval);
+        }
+        if (!done) {
+            done = morph.doCc(*this, channel, ccnum, ccval);
         }
+        if (!done) {
+            done = doMixerCc(channel, ccnum, ccval);
+        }
+        if (!done) {
+            done = doDrumCc(channel, ccnum, ccval);
+        }
+        if (!done && ccnum == 14 && channel == YM2612::CHAN3 && specialMode) {
+            // the special voices keep algorithm 7, this is for afterwards
+            specialAlgorithm = ccval;
+#ifdef DUAL_CHIPS
+            ym2.setAlgorithm(YM2612::CHAN3, ccval);
+#endif
+            done = 1;
+        }
+#ifdef DUAL_CHIPS
+        if (!done) {
+            done = doSnCc(channel, ccnum, ccval);
+        }
+        if (!done) {
+            done = doYmGlobalCc(ym, ccnum, ccval);
+            doYmGlobalCc(ym2, ccnum, ccval);
+        }
+        if (!done) {
+            done = doYmCc(ym, channel, ccnum, ccval);
+            doYmCc(ym2, channel, ccnum, ccval);
+        }
+        YM2612Scheduler::flush(ym, ym2);
+#else
+        if (!done) {
+            done = doYmGlobalCc(ym, ccnum, ccval);
+        }
+        if (!done) {
+            done = doYmCc(ym, channel, ccnum, ccval);
+        }
+#endif
     }
 
 
     void parseMidiPacket(const byte *packet) {
         if (packet == NULL) // does the packet exist?
             return; // abort!
+        TRACE(TRACE_DISPATCH_BEGIN, packet[MIDI_STATUS_INDEX]);
+        if (patchSysex.active() && packet[MIDI_STATUS_INDEX] < MIDI_REALTIME
+                && (packet[MIDI_STATUS_INDEX] != MIDI_SYSEX
+                    || packet[MIDI_SYSEX_INDEX] == MIDI_SYSEX))
+            finishSysex(packet[MIDI_STATUS_INDEX] == MIDI_SYSEX_END);
         switch (toMidiCommand(packet[MIDI_STATUS_INDEX])) {
             case MIDI_NOTEOFF:
-            noteOff(toMidiTarget(packet[MIDI_STATUS_INDEX]));
+            if (seq.noteOff(*this,
+                    toMidiTarget(packet[MIDI_STATUS_INDEX]),
+                    packet[MIDI_KEY_INDEX]))
+                break; // the channel's arpeggio lets go of it
+            noteOff(
+                toMidiTarget(packet[MIDI_STATUS_INDEX]),
+                packet[MIDI_KEY_INDEX]);
             break;
 
             case MIDI_NOTEON:
+            if (seq.noteOn(*this,
+                    toMidiTarget(packet[MIDI_STATUS_INDEX]),
+                    packet[MIDI_KEY_INDEX],
+                    packet[MIDI_VELOCITY_INDEX]))
+                break; // the channel's arpeggio plays it
             noteOn(
                 toMidiTarget(packet[MIDI_STATUS_INDEX]),
                 packet[MIDI_KEY_INDEX],
@@ -357,77 +1144,25 @@ class MegaSynth {
                 packet[MIDI_CCNUM_INDEX],
                 packet[MIDI_CCVAL_INDEX]);
             break;
+
+            case MIDI_SYSTEM:
+            if (packet[MIDI_STATUS_INDEX] >= MIDI_REALTIME)
+                seq.realTime(*this, packet[MIDI_STATUS_INDEX]);
+            else if (packet[MIDI_STATUS_INDEX] != MIDI_SYSEX)
+                break; // the F7 finished it above
+            else if (packet[MIDI_SYSEX_INDEX] == MIDI_SYSEX)
+                patchSysex.start();
+            else
+                patchSysex.receive(ym, packet[MIDI_SYSEX_INDEX]);
+            break;
             
             default:
             break;
-        }        
+        }
+        TRACE(TRACE_DISPATCH_END, packet[MIDI_STATUS_INDEX]);
     }
 };
 
 
-#ifndef EQUAL_TEMPERAMENT_A4
-#define EQUAL_TEMPERAMENT_A4 440.0
-#endif
-// A precise calculation for the 12th root of two:
-#define ROOT12_2 1.0594630943592952645618252949463
-// Equal temperament uses the 12th root of two as the half-step scaler.
-// There's no pow() in the preprocessor, so multiply or divide N times.
-// For example, to get from A4 to G4 scale down A4 twice with division,
-// as G4 is two half-steps (one whole-step) below A4:
-// G4 = A4 / ROOT12_2 / ROOT12_2
-// To scale up, multiply repeatedly the scalar by the desired number of 
-// half steps.
-#define EQUAL_TEMPERAMENT_C4 \
-    (EQUAL_TEMPERAMENT_A4 / ROOT12_2 / ROOT12_2 / ROOT12_2 / ROOT12_2 \
-        / ROOT12_2 / ROOT12_2 / ROOT12_2 / ROOT12_2 / ROOT12_2)
-
-#define EQUAL_TEMPERAMENT_Cs4 \
-    (EQUAL_TEMPERAMENT_A4 / ROOT12_2 / ROOT12_2 / ROOT12_2 / ROOT12_2 \
-        / ROOT12_2 / ROOT12_2 / ROOT12_2 / ROOT12_2)
-
-#define EQUAL_TEMPERAMENT_D4  \
-    (EQUAL_TEMPERAMENT_A4 / ROOT12_2 / ROOT12_2 / ROOT12_2 / ROOT12_2 \
-        / ROOT12_2 / ROOT12_2 / ROOT12_2)
-
-#define EQUAL_TEMPERAMENT_Ds4 \
-    (EQUAL_TEMPERAMENT_A4 / ROOT12_2 / ROOT12_2 / ROOT12_2 / ROOT12_2 \
-        / ROOT12_2 / ROOT12_2)
-
-#define EQUAL_TEMPERAMENT_E4  \
-    (EQUAL_TEMPERAMENT_A4 / ROOT12_2 / ROOT12_2 / ROOT12_2 / ROOT12_2 \
-        / ROOT12_2)
-
-#define EQUAL_TEMPERAMENT_F4  \
-    (EQUAL_TEMPERAMENT_A4 / ROOT12_2 / ROOT12_2 / ROOT12_2 / ROOT12_2)
-
-#define EQUAL_TEMPERAMENT_Fs4 \
-    (EQUAL_TEMPERAMENT_A4 / ROOT12_2 / ROOT12_2 / ROOT12_2)
-
-#define EQUAL_TEMPERAMENT_G4  (EQUAL_TEMPERAMENT_A4 / ROOT12_2 / ROOT12_2)
-
-#define EQUAL_TEMPERAMENT_Gs4 (EQUAL_TEMPERAMENT_A4 / ROOT12_2)
-
-#define EQUAL_TEMPERAMENT_As4 (EQUAL_TEMPERAMENT_A4 * ROOT12_2)
-
-#define EQUAL_TEMPERAMENT_B4  (EQUAL_TEMPERAMENT_A4 * ROOT12_2 * ROOT12_2)
-
-//scale by 72 and round to get higher integer precision
-const PROGMEM word MegaSynth::noteFreq72[MegaSynth::NOTE_COUNT] = 
-{
-    (word)(0.5 + 72.0 * EQUAL_TEMPERAMENT_C4),
-    (word)(0.5 + 72.0 * EQUAL_TEMPERAMENT_Cs4),
-    (word)(0.5 + 72.0 * EQUAL_TEMPERAMENT_D4),
-    (word)(0.5 + 72.0 * EQUAL_TEMPERAMENT_Ds4),
-    (word)(0.5 + 72.0 * EQUAL_TEMPERAMENT_E4),
-    (word)(0.5 + 72.0 * EQUAL_TEMPERAMENT_F4),
-    (word)(0.5 + 72.0 * EQUAL_TEMPERAMENT_Fs4),
-    (word)(0.5 + 72.0 * EQUAL_TEMPERAMENT_G4),
-    (word)(0.5 + 72.0 * EQUAL_TEMPERAMENT_Gs4),
-    (word)(0.5 + 72.0 * EQUAL_TEMPERAMENT_A4),
-    (word)(0.5 + 72.0 * EQUAL_TEMPERAMENT_As4),
-    (word)(0.5 + 72.0 * EQUAL_TEMPERAMENT_B4)
-};
-
-
 //include guard
 #endif
@@ -0,0 +1,126 @@
+#ifndef MIXER_H__
+#define MIXER_H__
+
+/*
+Channel mixer
+
+Every note's level is the sum of four attenuations: its velocity, CC 7
+(volume) and CC 11 (expression) of its MIDI channel and global CC 87
+(master volume). Each 7 bit value maps to an attenuation through
+gainTable, the General MIDI curve of 40 log10(value / 127) dB, in steps
+of 0.75dB, the step of the YM2612 TL field. The sums saturate at
+ATTEN_MAX, which is silence.
+
+The volume, expression and master part of a channel is kept summed, so a
+note only adds its velocity. The YM2612 adds the attenuation to the TL of
+the carriers (YM2612Chip::setAttenuation); the SN76489 takes it in its
+own 2dB steps (toSnAttn()).
+*/
+
+#include "Arduino.h"
+
+class Mixer {
+    public:
+    enum mixer_e {
+        CHAN_COUNT = 16, // MIDI channels
+        ATTEN_MAX = 127, // in TL steps, silence
+        SN_ATTN_MAX = 15, // SN76489 attenuation that is off
+        VOLUME_DEFAULT = 100, // as in General MIDI
+        EXPRESSION_DEFAULT = 127,
+        MASTER_DEFAULT = 127
+    };
+
+    private:
+    static const PROGMEM byte gainTable[128];
+    byte volume[CHAN_COUNT];
+    byte expression[CHAN_COUNT];
+    byte master;
+    byte channelAtten[CHAN_COUNT]; // volume, expression and master summed
+
+    static inline byte add(byte a, byte b) {
+        const word sum = a + b;
+        return sum > ATTEN_MAX ? ATTEN_MAX : sum;
+    }
+
+
+    void update(byte channel) {
+        channelAtten[channel] = add(add(gain(volume[channel]),
+            gain(expression[channel])), gain(master));
+    }
+
+    public:
+    // attenuation of a 7 bit gain, in TL steps
+    static inline byte gain(byte val) {
+        return pgm_read_byte(&gainTable[val & 0x7F]);
+    }
+
+
+    // TL steps of 0.75dB to SN76489 steps of 2dB, rounded
+    static inline byte toSnAttn(byte atten) {
+        const byte attn = ((word)atten * 3 + 4) >> 3;
+        return attn > SN_ATTN_MAX ? SN_ATTN_MAX : attn;
+    }
+
+
+    void begin() {
+        master = MASTER_DEFAULT;
+        for (byte c = 0; c < CHAN_COUNT; c++) {
+            volume[c] = VOLUME_DEFAULT;
+            expression[c] = EXPRESSION_DEFAULT;
+            update(c);
+        }
+    }
+
+
+    // attenuation of a note on the channel, in TL steps
+    inline byte noteAtten(byte channel, byte velocity) const {
+        return add(channelAtten[channel], gain(velocity));
+    }
+
+
+    // The setters return whether the channel's attenuation changed, so
+    // the caller knows if the notes playing need new levels.
+    bool setVolume(byte channel, byte val) {
+        volume[channel] = val;
+        return refresh(channel);
+    }
+
+
+    bool setExpression(byte channel, byte val) {
+        expression[channel] = val;
+        return refresh(channel);
+    }
+
+
+    // every channel may change, the caller updates them all
+    void setMaster(byte val) {
+        master = val;
+        for (byte c = 0; c < CHAN_COUNT; c++) {
+            update(c);
+        }
+    }
+
+    private:
+    bool refresh(byte channel) {
+        const byte before = channelAtten[channel];
+        update(channel);
+        return channelAtten[channel] != before;
+    }
+};
+
+
+// round(-40 log10(v / 127) / 0.75), v = 0 is silence
+const PROGMEM byte Mixer::gainTable[128] = {
+    127, 112,  96,  87,  80,  75,  71,  67,  64,  61,  59,  57,  55,  53,  51,  49,
+     48,  47,  45,  44,  43,  42,  41,  40,  39,  38,  37,  36,  35,  34,  33,  33,
+     32,  31,  31,  30,  29,  29,  28,  27,  27,  26,  26,  25,  25,  24,  24,  23,
+     23,  22,  22,  21,  21,  20,  20,  19,  19,  19,  18,  18,  17,  17,  17,  16,
+     16,  16,  15,  15,  14,  14,  14,  13,  13,  13,  13,  12,  12,  12,  11,  11,
+     11,  10,  10,  10,  10,   9,   9,   9,   8,   8,   8,   8,   7,   7,   7,   7,
+      6,   6,   6,   6,   6,   5,   5,   5,   5,   4,   4,   4,   4,   4,   3,   3,
+      3,   3,   3,   2,   2,   2,   2,   2,   1,   1,   1,   1,   1,   0,   0,   0
+};
+
+
+//include guard
+#endif
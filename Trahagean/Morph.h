@@ -0,0 +1,243 @@
+#ifndef MORPH_H__
+#define MORPH_H__
+
+/*
+Patch morphing
+
+A YM2612 channel given two patches by CC 108 plays a blend of them, set
+by CC 109, so a knob crossfades between two sounds:
+
+    CC 108  0 stops morphing (frees the engine), 1-63 takes the channel's
+            patch as it is now for A, 64-127 for B
+    CC 109  position, 0 all A, 127 all B
+    CC 110  glide: 0 jumps to a new position, 1-127 moves there a step
+            of 127 at a time, (135 - val) / 8 steps a tick, so 127 takes
+            half a second from end to end
+
+CC 108 takes what the channel plays, patch CCs and SysEx loads included,
+so setting A and B is: make a patch, CC 108 = 1, make another, CC 108 =
+127. The operator levels, envelope rates and sustain level, multiplier,
+key scale, feedback and LFO depths go in a straight line from A to B;
+detune, AM, SSG-EG, the algorithm and pan have no in between and switch
+halfway.
+
+CC 109 does not go to the chip as it comes. An EVENT_MORPH tick, at most
+one every MORPH_TICK_MS, blends the latest position into a buffer and
+writes only the registers that differ from the chip's shadow State
+(YM2612Chip::writePatch()). A sweep that sends hundreds of CCs a second
+costs at most a channel's 30 registers a tick, and usually the few the
+step moved. CCs and ticks both run from the main loop, never from an
+interrupt, so nothing can see the buffer half written: the State is the
+front buffer, the flush is the swap, and no lock is needed.
+
+There are MORPH_ENGINES engines, see BY_RAM() in Board.h. With
+DUAL_CHIPS both chips play the blend.
+*/
+
+#include "Arduino.h"
+#include "Board.h"
+#include "EventQueue.h"
+#include "YM2612.h"
+
+#ifndef MORPH_ENGINES
+#define MORPH_ENGINES BY_RAM(1, 2, 6) // channels that morph, 64 bytes each
+#endif
+#ifndef MORPH_TICK_MS
+#define MORPH_TICK_MS 4
+#endif
+
+class Morph : public YM2612Map {
+    public:
+    enum morph_e {
+        NO_CHANNEL = 0xFF,
+        POSITION_MAX = 127,
+        POSITION_HALF = 64
+    };
+
+    // a field that moves in a straight line, where it is in a patch
+    struct Item {
+        byte state;
+        byte mask;
+        byte shift;
+    };
+
+    template<class F> static constexpr Item slotItem(byte slot) {
+        return Item { slotState(0, slot, F::index), F::mask, F::shift };
+    }
+
+
+    template<class F> static constexpr Item channelItem() {
+        return Item { channelState(0, F::index), F::mask, F::shift };
+    }
+
+    private:
+    typedef SynthBoard::Clock Clock;
+    static const word TICK_TICKS = F_CPU / 8 / 1000 * MORPH_TICK_MS;
+    enum {
+        ITEM_COUNT = 8 * SLOT_COUNT + 3
+    };
+    static const PROGMEM Item items[ITEM_COUNT];
+
+    struct Engine {
+        byte channel; // NO_CHANNEL while free
+        byte a[CHAN_STATE_LENGTH]; // YM2612Chip::readPatch()
+        byte b[CHAN_STATE_LENGTH];
+        byte position; // as last blended
+        byte target; // CC 109
+        byte glide; // steps a tick, POSITION_MAX jumps
+        bool stale; // A or B changed since the last blend
+    } engine[MORPH_ENGINES];
+    bool ticking; // an EVENT_MORPH is queued
+    unsigned long due; // the soonest the next one may be
+
+    Engine *find(byte channel) {
+        for (byte i = 0; i < MORPH_ENGINES; i++) {
+            if (engine[i].channel == channel)
+                return &engine[i];
+        }
+        return NULL;
+    }
+
+
+    // the patch at e's position: A's or B's bytes, the fields that can be
+    // in between worked out from both
+    static void blend(const Engine &e, byte *patch) {
+        memcpy(patch, e.position < POSITION_HALF ? e.a : e.b,
+            CHAN_STATE_LENGTH);
+        for (byte i = 0; i < ITEM_COUNT; i++) {
+            Item item;
+            memcpy_P(&item, items + i, sizeof(item));
+            const int a = (e.a[item.state] & item.mask) >> item.shift;
+            const int d = ((e.b[item.state] & item.mask) >> item.shift) - a;
+            const byte value = a + (d * e.position
+                + (d < 0 ? -POSITION_MAX / 2 : POSITION_MAX / 2))
+                / POSITION_MAX;
+            patch[item.state] = (patch[item.state] & ~item.mask)
+                | ((value << item.shift) & item.mask);
+        }
+    }
+
+
+    // the next tick, no sooner than TICK_TICKS after the last
+    template<class P> void schedule(P &synth) {
+        if (ticking)
+            return;
+        EventQueue &queue = synth.events();
+        const unsigned long now = queue.now();
+        if ((long)(due - now) < 0)
+            due = now;
+        ticking = queue.post(due, EVENT_SOURCE_MORPH, EVENT_MORPH);
+    }
+
+
+    template<class P> void take(P &synth, byte channel, byte val) {
+        Engine *e = find(channel);
+        if (!val) {
+            if (e)
+                e->channel = NO_CHANNEL;
+            return;
+        }
+        if (!e) {
+            if ((e = find(NO_CHANNEL)) == NULL)
+                return;
+            e->channel = channel;
+            e->position = e->target = 0;
+            e->glide = POSITION_MAX;
+            synth.readPatch(channel, e->a);
+            memcpy(e->b, e->a, CHAN_STATE_LENGTH);
+        }
+        synth.readPatch(channel, val < POSITION_HALF ? e->a : e->b);
+        e->stale = true;
+    }
+
+    public:
+    void begin() {
+        for (byte i = 0; i < MORPH_ENGINES; i++) {
+            engine[i].channel = NO_CHANNEL;
+        }
+        ticking = false;
+        due = 0;
+    }
+
+
+    // CC 108-110, see above; 1 if handled
+    template<class P> byte doCc(P &synth, byte channel, byte num, byte val) {
+        if (num < 108 || num > 110)
+            return 0; //did not handle CC
+        if (channel >= CHAN_COUNT)
+            return 1; // only the YM2612 channels morph
+        Engine *e;
+        switch (num) {
+            // DO NOT FORGET: break
+            case 108: take(synth, channel, val); break;
+
+            case 109:
+            if ((e = find(channel)) != NULL) {
+                e->target = val;
+                schedule(synth);
+            }
+            break;
+
+            case 110:
+            if ((e = find(channel)) != NULL)
+                e->glide = val ? (POSITION_MAX + 8 - val) / 8 : POSITION_MAX;
+            break;
+        }
+        return 1; //handled CC
+    }
+
+
+    // an EVENT_MORPH from the queue: each engine steps to its target and
+    // writes what changed, the next tick queued while one still moves
+    template<class P> void tick(P &synth) {
+        ticking = false;
+        due = synth.events().now() + TICK_TICKS;
+        bool moving = false;
+        for (byte i = 0; i < MORPH_ENGINES; i++) {
+            Engine &e = engine[i];
+            if (e.channel == NO_CHANNEL
+                    || (e.position == e.target && !e.stale))
+                continue;
+            if (e.target > e.position)
+                e.position = e.target - e.position > e.glide
+                    ? e.position + e.glide : e.target;
+            else if (e.target < e.position)
+                e.position = e.position - e.target > e.glide
+                    ? e.position - e.glide : e.target;
+            e.stale = false;
+            byte patch[CHAN_STATE_LENGTH];
+            blend(e, patch);
+            synth.writePatch(e.channel, patch);
+            moving = moving || e.position != e.target;
+        }
+        if (moving)
+            schedule(synth);
+    }
+};
+
+
+#define MORPH_OPERATOR(slot) \
+    Morph::slotItem<YM2612Map::Field::MULTI>(slot), \
+    Morph::slotItem<YM2612Map::Field::TL>(slot), \
+    Morph::slotItem<YM2612Map::Field::KS>(slot), \
+    Morph::slotItem<YM2612Map::Field::AR>(slot), \
+    Morph::slotItem<YM2612Map::Field::DR>(slot), \
+    Morph::slotItem<YM2612Map::Field::SR>(slot), \
+    Morph::slotItem<YM2612Map::Field::SL>(slot), \
+    Morph::slotItem<YM2612Map::Field::RR>(slot)
+
+const PROGMEM Morph::Item Morph::items[Morph::ITEM_COUNT] = {
+    MORPH_OPERATOR(YM2612Map::SLOT1),
+    MORPH_OPERATOR(YM2612Map::SLOT3),
+    MORPH_OPERATOR(YM2612Map::SLOT2),
+    MORPH_OPERATOR(YM2612Map::SLOT4),
+    Morph::channelItem<YM2612Map::Field::FB>(),
+    Morph::channelItem<YM2612Map::Field::AMS>(),
+    Morph::channelItem<YM2612Map::Field::PMS>()
+};
+
+#undef MORPH_OPERATOR
+
+
+// include guard
+#endif
@@ -0,0 +1,383 @@
+#ifndef PATCH_H__
+#define PATCH_H__
+
+/*
+YM2612 patches over SysEx
+
+A channel's whole patch in one message instead of a CC per field:
+
+    F0 7D command channel format data... F7
+
+    command  PATCH_DATA: data is a patch for the channel, and the answer
+             to a PATCH_REQUEST
+             PATCH_REQUEST: no data, asks for the channel's PATCH_DATA
+    channel  YM2612 channel 0-5, on both chips with DUAL_CHIPS
+    format   FORMAT_REGISTERS: the channel's CHAN_STATE_LENGTH shadow
+             registers in State order, TLs without the mixer's
+             attenuation
+             FORMAT_TFI: a TFM Music Maker .tfi, TFI_LENGTH bytes
+             FORMAT_DMP: a DefleMask .dmp FM preset, version 11 for the
+             Genesis, DMP_LENGTH bytes
+
+7D is the ID for non-commercial use. The data is 8 bit bytes 7 bits at a
+time: each group of up to 7 goes after a byte of their top bits, bit 0
+for the first. PatchSysex decodes them as they arrive, field by field
+through the format's PROGMEM table, straight into the channel's slice of
+the chip's State (YM2612Chip::slice()); nothing is buffered. The F7 then
+writes the channel in one burst (YM2612Chip::load()), so loading a patch
+costs its bytes on the wire and 30 register writes, where the same patch
+as CCs is a message and a write per field.
+
+Both files list the operators in register order (1, 3, 2, 4, as slot_e)
+with detune 0-7 centred on 3. DMP's LFO and LFO2 are PMS and AMS, which
+a TFI leaves as they are, and neither touches LR (pan). A DMP of another
+version, system or mode changes nothing. A message cut short changes the
+fields it got to, and those are written as if it had ended.
+*/
+
+#include "Arduino.h"
+#include "YM2612.h"
+#include "midiPacketizer.h"
+
+class Patch : public YM2612Map {
+    public:
+    enum patch_e {
+        SYSEX_ID = 0x7D,
+        PATCH_DATA = 0x01,
+        PATCH_REQUEST = 0x02,
+        FORMAT_REGISTERS = 0,
+        FORMAT_TFI,
+        FORMAT_DMP,
+        FORMAT_COUNT,
+        TFI_LENGTH = 2 + SLOT_COUNT * 10,
+        DMP_LENGTH = 7 + SLOT_COUNT * 11,
+        DMP_VERSION = 11,
+        DMP_GENESIS = 2,
+        DMP_FM = 1,
+        GROUP = 7 // bytes after each byte of top bits
+    };
+
+    // what a byte of a layout is in the channel's slice
+    struct Item {
+        byte state; // offset in the slice, or the byte for ITEM_CONST
+        byte mask;
+        byte shift;
+        byte kind;
+    };
+    enum item_e {
+        ITEM_FIELD,
+        ITEM_LEVEL, // TL: YM2612Chip::level() in a dump
+        ITEM_DETUNE, // 3 for none, 0 for -3, as the files have it
+        ITEM_CONST // a header byte the patch must have
+    };
+
+    private:
+    static const PROGMEM Item tfi[TFI_LENGTH];
+    static const PROGMEM Item dmp[DMP_LENGTH];
+
+    static const Item *table(byte format) {
+        return format == FORMAT_TFI ? tfi : dmp;
+    }
+
+
+    static void readItem(byte format, byte index, Item &item) {
+        memcpy_P(&item, table(format) + index, sizeof(item));
+    }
+
+
+    // register detune from the files' 3 centred one, and back
+    static inline byte toDetune(byte dt) {
+        return dt >= 3 ? dt - 3 : 7 - dt;
+    }
+
+
+    static inline byte fromDetune(byte dt) {
+        return dt >= 4 ? 7 - dt : dt + 3; // 4, -0, is the centre too
+    }
+
+    public:
+    template<class F>
+    static constexpr Item slotItem(byte slot, byte kind = ITEM_FIELD) {
+        return Item { slotState(0, slot, F::index), F::mask, F::shift, kind };
+    }
+
+
+    template<class F> static constexpr Item channelItem() {
+        return Item { channelState(0, F::index), F::mask, F::shift,
+            ITEM_FIELD };
+    }
+
+
+    static constexpr Item constItem(byte value) {
+        return Item { value, 0, 0, ITEM_CONST };
+    }
+
+
+    static inline byte length(byte format) {
+        return format == FORMAT_TFI ? TFI_LENGTH
+            : format == FORMAT_DMP ? DMP_LENGTH : (byte)CHAN_STATE_LENGTH;
+    }
+
+
+    // Byte index of a layout into a channel's slice; false if it is a
+    // header byte the patch does not have.
+    static bool decode(byte format, byte index, byte value, byte *slice) {
+        if (format == FORMAT_REGISTERS) {
+            slice[index] = value;
+            return true;
+        }
+        Item item;
+        readItem(format, index, item);
+        switch (item.kind) {
+            case ITEM_CONST:
+            return value == item.state;
+
+            case ITEM_DETUNE:
+            value = toDetune(value);
+            break;
+
+            default:
+            break;
+        }
+        slice[item.state] = (slice[item.state] & ~item.mask)
+            | ((value << item.shift) & item.mask);
+        return true;
+    }
+
+
+    // byte index of a layout, from the chip's channel
+    template<class Y>
+    static byte encode(Y &chip, channel_e channel, byte format, byte index) {
+        const byte *slice = chip.slice(channel);
+        if (format == FORMAT_REGISTERS) {
+            return index < SLOT_STATE_LENGTH
+                && index % SLOT_REG_LENGTH == Field::TL::index
+                ? chip.level(channel,
+                    static_cast<slot_e>(index / SLOT_REG_LENGTH))
+                : slice[index];
+        }
+        Item item;
+        readItem(format, index, item);
+        const byte value = (slice[item.state] & item.mask) >> item.shift;
+        switch (item.kind) {
+            case ITEM_CONST: return item.state;
+            case ITEM_DETUNE: return fromDetune(value);
+            case ITEM_LEVEL: return chip.level(channel,
+                static_cast<slot_e>(item.state / SLOT_REG_LENGTH));
+            default: return value;
+        }
+    }
+};
+
+
+/* The SysEx side: a message's bytes after the F0 through receive(), which
+ * decodes PATCH_DATA as it comes, then finish() at the F7. */
+class PatchSysex {
+    enum state_e {
+        STATE_IDLE,
+        STATE_HEADER,
+        STATE_DATA,
+        STATE_REQUEST,
+        STATE_IGNORE // not ours, or a patch that does not fit
+    };
+    enum header_e {
+        HEADER_ID,
+        HEADER_COMMAND,
+        HEADER_CHANNEL,
+        HEADER_FORMAT
+    };
+    byte state;
+    byte have; // header bytes, then patch bytes decoded
+    byte command;
+    byte channel;
+    byte format;
+    byte msbs; // top bits of the group being read
+    byte group; // bytes left in it
+
+    public:
+    enum done_e {
+        DONE_NOTHING,
+        DONE_LOAD, // target()'s slice changed, load() it
+        DONE_REQUEST // send() target() in requested()
+    };
+    // where send() puts a message, a part at a time
+    typedef void (*Sender)(const byte *bytes, byte length);
+
+    PatchSysex() : state(STATE_IDLE) { }
+
+
+    // an F0
+    void start() {
+        state = STATE_HEADER;
+        have = 0;
+        group = 0;
+    }
+
+
+    bool active() const {
+        return state != STATE_IDLE;
+    }
+
+
+    // a data byte of the message, patch bytes go into chip's slice
+    template<class Y> void receive(Y &chip, byte data) {
+        switch (state) {
+            case STATE_HEADER:
+            switch (have++) {
+                case HEADER_ID:
+                if (data != Patch::SYSEX_ID)
+                    state = STATE_IGNORE;
+                break;
+
+                case HEADER_COMMAND:
+                command = data;
+                if (command != Patch::PATCH_DATA
+                        && command != Patch::PATCH_REQUEST)
+                    state = STATE_IGNORE;
+                break;
+
+                case HEADER_CHANNEL:
+                channel = data;
+                if (channel >= Patch::CHAN_COUNT)
+                    state = STATE_IGNORE;
+                break;
+
+                default: // HEADER_FORMAT
+                format = data;
+                state = format >= Patch::FORMAT_COUNT ? STATE_IGNORE
+                    : command == Patch::PATCH_DATA ? STATE_DATA
+                    : STATE_REQUEST;
+                have = 0;
+                break;
+            }
+            break;
+
+            case STATE_DATA:
+            if (!group) {
+                msbs = data;
+                group = Patch::GROUP;
+                break;
+            }
+            group--;
+            if (have == Patch::length(format))
+                break; // extra bytes
+            if (!Patch::decode(format, have++, data | (msbs & 1) << 7,
+                    chip.slice(static_cast<Patch::channel_e>(channel)))) {
+                state = STATE_IGNORE; // a header byte, nothing written yet
+                break;
+            }
+            msbs >>= 1;
+            break;
+
+            default:
+            break;
+        }
+    }
+
+
+    // The message is over: the F7, or complete = false when another status
+    // byte cut it short. What is left to do with it.
+    byte finish(bool complete) {
+        byte done = DONE_NOTHING;
+        if (state == STATE_DATA && have)
+            done = DONE_LOAD;
+        else if (complete && state == STATE_REQUEST)
+            done = DONE_REQUEST;
+        state = STATE_IDLE;
+        return done;
+    }
+
+
+    Patch::channel_e target() const {
+        return static_cast<Patch::channel_e>(channel);
+    }
+
+
+    byte requested() const {
+        return format;
+    }
+
+
+    // a PATCH_DATA message of chip's channel
+    template<class Y>
+    static void send(Y &chip, Patch::channel_e channel, byte format,
+                     Sender sender) {
+        const byte header[] = { MIDI_SYSEX, Patch::SYSEX_ID,
+            Patch::PATCH_DATA, (byte)channel, format };
+        sender(header, sizeof(header));
+        const byte length = Patch::length(format);
+        for (byte i = 0; i < length; i += Patch::GROUP) {
+            byte packed[1 + Patch::GROUP];
+            byte n = 0;
+            packed[0] = 0;
+            for (; n < Patch::GROUP && i + n < length; n++) {
+                const byte b = Patch::encode(chip, channel, format, i + n);
+                packed[0] |= (b >> 7) << n;
+                packed[1 + n] = b & 0x7F;
+            }
+            sender(packed, 1 + n);
+        }
+        const byte end = MIDI_SYSEX_END;
+        sender(&end, 1);
+    }
+};
+
+
+#define TFI_OPERATOR(slot) \
+    Patch::slotItem<YM2612Map::Field::MULTI>(slot), \
+    Patch::slotItem<YM2612Map::Field::DT>(slot, Patch::ITEM_DETUNE), \
+    Patch::slotItem<YM2612Map::Field::TL>(slot, Patch::ITEM_LEVEL), \
+    Patch::slotItem<YM2612Map::Field::KS>(slot), \
+    Patch::slotItem<YM2612Map::Field::AR>(slot), \
+    Patch::slotItem<YM2612Map::Field::DR>(slot), \
+    Patch::slotItem<YM2612Map::Field::SR>(slot), \
+    Patch::slotItem<YM2612Map::Field::RR>(slot), \
+    Patch::slotItem<YM2612Map::Field::SL>(slot), \
+    Patch::slotItem<YM2612Map::Field::SSEG>(slot)
+
+// algorithm, feedback, then MUL DT TL RS AR DR SR RR SL SSG-EG an operator
+const PROGMEM Patch::Item Patch::tfi[Patch::TFI_LENGTH] = {
+    Patch::channelItem<YM2612Map::Field::ALGO>(),
+    Patch::channelItem<YM2612Map::Field::FB>(),
+    TFI_OPERATOR(YM2612Map::SLOT1),
+    TFI_OPERATOR(YM2612Map::SLOT3),
+    TFI_OPERATOR(YM2612Map::SLOT2),
+    TFI_OPERATOR(YM2612Map::SLOT4)
+};
+
+#undef TFI_OPERATOR
+
+#define DMP_OPERATOR(slot) \
+    Patch::slotItem<YM2612Map::Field::MULTI>(slot), \
+    Patch::slotItem<YM2612Map::Field::TL>(slot, Patch::ITEM_LEVEL), \
+    Patch::slotItem<YM2612Map::Field::AR>(slot), \
+    Patch::slotItem<YM2612Map::Field::DR>(slot), \
+    Patch::slotItem<YM2612Map::Field::SL>(slot), \
+    Patch::slotItem<YM2612Map::Field::RR>(slot), \
+    Patch::slotItem<YM2612Map::Field::AM>(slot), \
+    Patch::slotItem<YM2612Map::Field::KS>(slot), \
+    Patch::slotItem<YM2612Map::Field::DT>(slot, Patch::ITEM_DETUNE), \
+    Patch::slotItem<YM2612Map::Field::SR>(slot), \
+    Patch::slotItem<YM2612Map::Field::SSEG>(slot)
+
+// version, system, mode, PMS, feedback, algorithm, AMS, then MULT TL AR
+// DR SL RR AM RS DT D2R SSG-EG an operator
+const PROGMEM Patch::Item Patch::dmp[Patch::DMP_LENGTH] = {
+    Patch::constItem(Patch::DMP_VERSION),
+    Patch::constItem(Patch::DMP_GENESIS),
+    Patch::constItem(Patch::DMP_FM),
+    Patch::channelItem<YM2612Map::Field::PMS>(),
+    Patch::channelItem<YM2612Map::Field::FB>(),
+    Patch::channelItem<YM2612Map::Field::ALGO>(),
+    Patch::channelItem<YM2612Map::Field::AMS>(),
+    DMP_OPERATOR(YM2612Map::SLOT1),
+    DMP_OPERATOR(YM2612Map::SLOT3),
+    DMP_OPERATOR(YM2612Map::SLOT2),
+    DMP_OPERATOR(YM2612Map::SLOT4)
+};
+
+#undef DMP_OPERATOR
+
+
+//include guard
+#endif
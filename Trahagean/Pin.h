@@ -0,0 +1,40 @@
+#ifndef PIN_H__
+#define PIN_H__
+
+#include "Arduino.h"
+
+/* A GPIO pin as a type, so drivers can take their chip select pins as
+ * template arguments and one driver can run several chips. Everything is
+ * inline on constant registers, so high() and low() still compile to
+ * single sbi/cbi instructions.
+ *
+ *     AVR_PIN(YM_WR, PORTC, DDRC, PORTC4);
+ *     YM_WR::low();
+ */
+#define AVR_PIN(name, port, ddr, b) \
+    struct name { \
+        enum { BIT = b }; \
+        static inline decltype((port)) out() { return port; } \
+        static inline decltype((ddr)) dir() { return ddr; } \
+        static inline void output() { ddr |= bit(b); } \
+        static inline void high() { port |= bit(b); } \
+        static inline void low() { port &= ~bit(b); } \
+        static inline bool isHigh() { return (port & bit(b)) != 0; } \
+    }
+
+/* An input pin, read from its PINx register, e.g. an open drain line with
+ * the pull-up on:
+ *
+ *     AVR_INPUT_PIN(YM_IRQ, PIND, PORTD, PIND4);
+ *     YM_IRQ::pullUp();
+ *     if (YM_IRQ::isLow()) ...
+ */
+#define AVR_INPUT_PIN(name, pins, port, b) \
+    struct name { \
+        enum { BIT = b }; \
+        static inline decltype((pins)) in() { return pins; } \
+        static inline void pullUp() { port |= bit(b); } \
+        static inline bool isLow() { return !(pins & bit(b)); } \
+    }
+
+#endif
@@ -2,17 +2,16 @@
 #define SN76489_H__
 
 #include "Arduino.h"
+#include "Board.h"
+#include "Trace.h"
 #include <util/delay.h>
 
-extern void dataBusWrite(byte data);
+template<class B, class WE = typename B::SN_WE> class SN76489Chip;
+template<class B, class WE1 = typename B::SN_WE,
+    class WE2 = typename B::SN_WE2> class SN76489Pair;
 
-/*PORTC corresponds to analog pins on the Uno */
-#define SN76489_WE_PORT PORTC
-#define SN76489_WE_DDR  DDRC
-#define SN76489_WE_BIT  PORTC3
-// Tie CE to WE
-
-class SN76489 {
+/* What every SN76489 has in common, so both chips take the same enums */
+class SN76489Map {
     public:
     enum channel_e {
         CHAN1,
@@ -30,25 +29,32 @@ class SN76489 {
         SHIFT_2048,
         SHIFT_CHAN3
     };
+};
+
+
+/* One SN76489 on the data bus of board B (see Board.h), selected by its
+ * own WE pin (a type made with AVR_PIN), the board's SN_WE unless given.
+ * The chip holds no state, so everything is static.
+ *
+ * Writes run with interrupts enabled. An interrupt during one only
+ * stretches the WE pulse, which the chip does not mind, so the 150us
+ * strobes never hold up the serial port. Chips must not be written from
+ * an ISR. */
+template<class B, class WE> class SN76489Chip : public SN76489Map {
+    template<class, class, class> friend class SN76489Pair;
 
     private:
     inline static void write(byte data) {
-        dataBusWrite(data);
-	    SN76489_WE_PORT &= ~bit(SN76489_WE_BIT); // WE LOW (latch)
+        B::dataBusWrite(data);
+	    WE::low(); // WE LOW (latch)
 	    _delay_us(150);
-	    SN76489_WE_PORT |= bit(SN76489_WE_BIT); // WE HIGH
+	    WE::high(); // WE HIGH
+	    TRACE(TRACE_SN_WRITE, data);
     }
 
 
-    inline static void setRegDirect(byte reg, byte data) {
-        write(0x80 | ((reg & 0x07) << 4) | (data & 0x0F));
-    }
-    
-    
     inline static void setReg(byte reg, byte data) {
-        noInterrupts();
-        setRegDirect(reg, data);
-        interrupts();
+        write(0x80 | ((reg & 0x07) << 4) | (data & 0x0F));
     }
 
     
@@ -69,8 +75,8 @@ class SN76489 {
     public:
     static void begin() {
 	    /* Pins setup */
-	    SN76489_WE_DDR |= bit(SN76489_WE_BIT);
-	    SN76489_WE_PORT |= bit(SN76489_WE_BIT); // HIGH by default
+	    WE::output();
+	    WE::high(); // HIGH by default
 
         /* shut up all the channels */
 	    level(CHAN1, 0);
@@ -79,13 +85,23 @@ class SN76489 {
 	    level(CHAN4, 0);
     }
 
-    //send 10 LSBs of period (measured in 125kHz clock cycles) to channel
-    //first send 4 LSBs then send 6 MSBs
-    static inline void setPeriod125k(channel_e channel, word period) {
-        noInterrupts();
-        setRegDirect(toRegFreqCtrl(channel), period & 0x0F); // 4 LSB
+    //send 10 LSBs of period (in cycles of the chip clock / 32, see
+    //Tuning.h) to channel, first send 4 LSBs then send 6 MSBs
+    static inline void setPeriod(channel_e channel, word period) {
+        setReg(toRegFreqCtrl(channel), period & 0x0F); // 4 LSB
         write((period >> 4) & 0x3F); // 6 MSB
-        interrupts();
+    }
+
+
+    // the period in 125kHz cycles, right for a 4MHz clock
+    static inline void setPeriod125k(channel_e channel, word period) {
+        setPeriod(channel, period);
+    }
+
+
+    // raw latch/data byte for register streams
+    static inline void writeByte(byte data) {
+        write(data);
     }
 
 
@@ -94,11 +110,83 @@ class SN76489 {
     }
 
     static inline void level(channel_e channel, byte val) {
-        setReg(toRegAttn(channel), toAttn(val));
+        attenuation(channel, toAttn(val));
+    }
+
+
+    // raw attenuation, 2dB steps from 0 (loudest) to 15 (off)
+    static inline void attenuation(channel_e channel, byte attn) {
+        setReg(toRegAttn(channel), attn);
     }
 };
 
 
+typedef SN76489Chip<SynthBoard> SN76489;
+// second chip of a dual setup
+typedef SN76489Chip<SynthBoard, SynthBoard::SN_WE2> SN76489B;
+
+
+/* Two SN76489s played as one, e.g. the left and right chips of a stereo
+ * pair. Each call takes a value per chip; where they match, the byte goes
+ * to both chips in one write: the data bus is set once and both WE pins
+ * strobe together, so a paired write costs no more than a single one.
+ * The chips are board B's SN_WE and SN_WE2 unless given. */
+template<class B, class WE1, class WE2>
+class SN76489Pair : public SN76489Map {
+    typedef SN76489Chip<B, WE1> First;
+    typedef SN76489Chip<B, WE2> Second;
+
+    inline static void write(byte data) {
+        B::dataBusWrite(data);
+        WE1::low(); // WE LOW (latch), both chips
+        WE2::low();
+        _delay_us(150);
+        WE1::high(); // WE HIGH
+        WE2::high();
+        TRACE(TRACE_SN_WRITE, data);
+    }
+
+
+    inline static void write(byte first, byte second) {
+        if (first == second) {
+            write(first);
+        }
+        else {
+            First::write(first);
+            Second::write(second);
+        }
+    }
+
+    public:
+    // as SN76489Chip::setPeriod, one period per chip
+    static inline void setPeriod(channel_e channel, word first,
+                                     word second) {
+        const byte reg = 0x80 | (First::toRegFreqCtrl(channel) << 4);
+        write(reg | (first & 0x0F), reg | (second & 0x0F)); // 4 LSB
+        write((first >> 4) & 0x3F, (second >> 4) & 0x3F); // 6 MSB
+    }
+
+
+    static inline void setNoise(feedback_e fb, rate_e shift) {
+        const byte data = 0x80 | (First::toRegFreqCtrl(CHAN4) << 4)
+            | (fb << 2) | shift;
+        write(data);
+    }
+
+
+    static inline void level(channel_e channel, byte first, byte second) {
+        attenuation(channel, First::toAttn(first), First::toAttn(second));
+    }
+
+
+    static inline void attenuation(channel_e channel, byte first,
+                                   byte second) {
+        const byte reg = 0x80 | (First::toRegAttn(channel) << 4);
+        write(reg | (first & 0x0F), reg | (second & 0x0F));
+    }
+};
+
+typedef SN76489Pair<SynthBoard> SN76489Stereo;
 
 
 //include guard
@@ -0,0 +1,525 @@
+#ifndef SEQUENCER_H__
+#define SEQUENCER_H__
+
+/*
+Arpeggiator and pattern sequencer
+
+A MIDI channel given an engine by CC 102 no longer plays the keys held on
+it: the engine plays notes made from them, a step every few pulses of a
+24 per quarter note clock, until the last key is let go. The notes go to
+MegaSynth::noteOn() and noteOff() as if they had come over MIDI, so a
+chord held on one channel plays hundreds of notes a second with nothing
+else on the wire.
+
+    CC 102  mode: 0 off (frees the engine), 1 up, 2 down, 3 up and down,
+            4 in the order played, 5 random, MODE_PATTERN1 + n - 1
+            pattern n from the EEPROM
+    CC 103  pulses per step, 1-96 (6 sixteenths, 24 quarter notes)
+    CC 104  gate, the part of a step the note sounds in 128ths; 127
+            holds it to the next step
+    CC 105  octaves the arpeggio spans, 1-4
+
+CC 103-105 set the channel's engine, so they follow its CC 102. There
+are SEQ_ENGINES engines, see BY_RAM() in Board.h. Two global CCs set the
+clock every engine follows:
+
+    CC 106  tempo, 2 bpm a step, TEMPO_MIN at least
+    CC 107  0-31 the internal tempo, 32-63 the same from the YM2612's
+            Timer B, 64-127 MIDI clock (0xF8)
+
+The internal tempo is EVENT_SEQ events on the EventQueue, one a pulse
+while a key is held on any engine, so it starts with the first key. From
+Timer B only the first pulse is an event: the rest are YmTimer.h ticks,
+counted by the chip on its own clock and raised on its IRQ, so the
+pulses take no queue slots and no AVR timer. With MIDI clock a pulse is
+a 0xF8, counted between start (0xFA) or continue (0xFB) and stop (0xFC);
+start plays every engine from its first step.
+
+A pattern is up to PATTERN_STEPS steps of 2 bytes, transposed to the
+last key held and played at that key's velocity. Pattern n sits at
+SEQ_EEPROM_BASE + (n - 1) * PATTERN_SIZE, after the drum kits:
+
+    PATTERN_MAGIC, length, length x { note, level }
+
+where note is the half steps from the key + STEP_ROOT, and level is the
+velocity of the step (0 rests, scaled by the key's), | STEP_TIE to hold
+the note to the next step. host/seqpattern makes the image. A pattern
+without the magic byte cannot be selected.
+*/
+
+#include "Arduino.h"
+#include "Board.h"
+#include "DrumKit.h"
+#include "EventQueue.h"
+#include "midiPacketizer.h"
+#include "YM2612.h"
+#include <avr/eeprom.h>
+
+#ifndef SEQ_ENGINES
+#define SEQ_ENGINES BY_RAM(2, 4, 8) // channels that arpeggiate, 27 bytes each
+#endif
+#ifndef SEQ_EEPROM_BASE
+#define SEQ_EEPROM_BASE \
+    (DRUM_EEPROM_BASE + DRUM_EEPROM_KITS * DrumKit::KIT_SIZE)
+#endif
+#ifndef SEQ_EEPROM_PATTERNS
+#define SEQ_EEPROM_PATTERNS 4
+#endif
+
+class Sequencer {
+    public:
+    enum seq_e {
+        PPQN = 24, // pulses per quarter note, as MIDI clock
+        HELD_MAX = 8, // keys an engine holds, the oldest makes way
+        NO_CHANNEL = 0xFF,
+        NO_KEY = 0xFF,
+        OCTAVES_MAX = 4,
+        RATE_MAX = 4 * PPQN,
+        GATE_HOLD = 127,
+        TEMPO_DEFAULT = 120,
+        TEMPO_MIN = 20,
+        PATTERN_MAGIC = 0x5E,
+        PATTERN_STEPS = 32,
+        STEP_SIZE = 2,
+        PATTERN_SIZE = 2 + PATTERN_STEPS * STEP_SIZE,
+        STEP_ROOT = 64,
+        STEP_TIE = bit(7)
+    };
+    enum mode_e {
+        MODE_OFF,
+        MODE_UP,
+        MODE_DOWN,
+        MODE_UP_DOWN,
+        MODE_PLAYED,
+        MODE_RANDOM,
+        MODE_PATTERN1 = 16
+    };
+    enum clock_e { // where pulses come from, CC 107
+        CLOCK_INTERNAL,
+        CLOCK_YM,
+        CLOCK_MIDI
+    };
+    static_assert(SEQ_EEPROM_BASE + SEQ_EEPROM_PATTERNS * PATTERN_SIZE
+        <= E2END + 1, "the patterns do not fit the EEPROM");
+
+    private:
+    typedef SynthBoard::Clock Clock;
+    // Clock ticks (F_CPU / 8) a minute, a pulse at 1 bpm
+    static const unsigned long PULSE_TICKS_BPM = F_CPU / 8 * 60 / PPQN;
+    // and YM2612 samples (Timer A counts), 16 to a Timer B step
+    static const unsigned long PULSE_SAMPLES_BPM = SynthBoard::ymClock()
+        * 60 / (YM2612::TIMER_A_CLOCKS * PPQN) + 0.5;
+    static const byte SAMPLES_STEP =
+        YM2612::TIMER_B_CLOCKS / YM2612::TIMER_A_CLOCKS;
+
+    struct Engine {
+        byte channel; // NO_CHANNEL while free
+        byte mode;
+        byte rate; // pulses per step
+        byte gate; // 128ths of a step
+        byte octaves;
+        byte held[HELD_MAX]; // in the order played
+        byte sorted[HELD_MAX]; // lowest first
+        byte count; // keys held
+        byte velocity; // of the last key
+        byte step; // next in the arpeggio or pattern
+        byte pulse; // pulses into the step
+        byte sounding; // key playing, NO_KEY
+        bool tie; // the note holds to the next step
+    } engine[SEQ_ENGINES];
+    byte tempo; // bpm
+    byte clock; // clock_e
+    bool running; // between MIDI start or continue and stop
+    bool ticking; // an EVENT_SEQ is queued
+    unsigned long due; // of the next EVENT_SEQ
+    word remainder; // of the pulse length, in 1/tempo ticks
+    word lfsr; // for MODE_RANDOM
+
+    Engine *find(byte channel) {
+        for (byte i = 0; i < SEQ_ENGINES; i++) {
+            if (engine[i].channel == channel)
+                return &engine[i];
+        }
+        return NULL;
+    }
+
+
+    static bool patternValid(byte mode) {
+        const byte n = mode - MODE_PATTERN1;
+        if (mode < MODE_PATTERN1 || n >= SEQ_EEPROM_PATTERNS)
+            return false;
+        const byte *p = patternAddress(n);
+        const byte length = eeprom_read_byte(p + 1);
+        return eeprom_read_byte(p) == PATTERN_MAGIC
+            && length && length <= PATTERN_STEPS;
+    }
+
+
+    static inline const byte *patternAddress(byte n) {
+        return (const byte *)(size_t)(SEQ_EEPROM_BASE + n * PATTERN_SIZE);
+    }
+
+
+    // false when the key is not in the list
+    static bool remove(byte *keys, byte count, byte key) {
+        byte i = 0;
+        while (i < count && keys[i] != key)
+            i++;
+        if (i == count)
+            return false;
+        for (; i + 1 < count; i++) {
+            keys[i] = keys[i + 1];
+        }
+        return true;
+    }
+
+
+    static void hold(Engine &e, byte key) {
+        for (byte i = 0; i < e.count; i++) {
+            if (e.held[i] == key)
+                return;
+        }
+        if (e.count == HELD_MAX)
+            release(e, e.held[0]);
+        e.held[e.count] = key;
+        byte i = e.count++;
+        for (; i > 0 && e.sorted[i - 1] > key; i--) {
+            e.sorted[i] = e.sorted[i - 1];
+        }
+        e.sorted[i] = key;
+    }
+
+
+    static void release(Engine &e, byte key) {
+        if (remove(e.held, e.count, key)) {
+            remove(e.sorted, e.count, key);
+            e.count--;
+        }
+    }
+
+
+    byte nextRandom() {
+        lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xB400);
+        return lfsr;
+    }
+
+
+    template<class P> static void silence(P &synth, Engine &e) {
+        if (e.sounding == NO_KEY)
+            return;
+        synth.noteOff(e.channel, e.sounding);
+        e.sounding = NO_KEY;
+    }
+
+
+    // key and velocity of the engine's next step, false for a rest
+    bool nextStep(Engine &e, byte &key, byte &velocity) {
+        velocity = e.velocity;
+        e.tie = e.gate == GATE_HOLD;
+        if (e.mode >= MODE_PATTERN1) {
+            const byte *p = patternAddress(e.mode - MODE_PATTERN1);
+            if (e.step >= eeprom_read_byte(p + 1))
+                e.step = 0;
+            p += 2 + e.step++ * STEP_SIZE;
+            const int k = e.held[e.count - 1] + eeprom_read_byte(p)
+                - STEP_ROOT;
+            const byte level = eeprom_read_byte(p + 1);
+            if (!(level & ~STEP_TIE) || k < 0 || k > 127)
+                return false;
+            key = k;
+            velocity = (word)(level & ~STEP_TIE) * velocity / 127;
+            if (!velocity)
+                velocity = 1;
+            if (level & STEP_TIE)
+                e.tie = true;
+            return true;
+        }
+        const byte span = e.count * e.octaves;
+        const byte length = e.mode == MODE_UP_DOWN && span > 1
+            ? 2 * span - 2 : span;
+        if (e.step >= length)
+            e.step = 0;
+        byte i = e.step++;
+        switch (e.mode) {
+            case MODE_DOWN: i = span - 1 - i; break;
+            case MODE_UP_DOWN: if (i >= span) i = length - i; break;
+            case MODE_RANDOM: i = nextRandom() % span; break;
+            default: break;
+        }
+        const byte *keys = e.mode == MODE_PLAYED ? e.held : e.sorted;
+        const byte k = keys[i % e.count] + i / e.count * 12;
+        if (k > 127)
+            return false;
+        key = k;
+        return true;
+    }
+
+
+    // one pulse of an engine: the gate closes or the next step plays
+    template<class P> void pulse(P &synth, Engine &e) {
+        if (++e.pulse < e.rate) {
+            if (!e.tie && e.pulse == gatePulses(e))
+                silence(synth, e);
+            return;
+        }
+        e.pulse = 0;
+        byte key, velocity;
+        const bool play = e.count && nextStep(e, key, velocity);
+        silence(synth, e);
+        if (!play)
+            return;
+        synth.noteOn(e.channel, key, velocity);
+        e.sounding = key;
+    }
+
+
+    static inline byte gatePulses(const Engine &e) {
+        const byte pulses = (word)e.rate * e.gate >> 7;
+        return pulses ? pulses : 1;
+    }
+
+
+    // restarts an engine, its first step plays on the next pulse
+    static inline void rewind(Engine &e) {
+        e.step = 0;
+        e.pulse = e.rate - 1;
+    }
+
+
+    bool active() const {
+        for (byte i = 0; i < SEQ_ENGINES; i++) {
+            if (engine[i].channel != NO_CHANNEL
+                    && (engine[i].count || engine[i].sounding != NO_KEY))
+                return true;
+        }
+        return false;
+    }
+
+
+    // the internal tempo from now, if it has stopped
+    template<class P> void startTicking(P &synth) {
+        if (ticking || clock == CLOCK_MIDI)
+            return;
+        EventQueue &queue = synth.events();
+        due = queue.now();
+        remainder = 0;
+        ticking = queue.post(due, EVENT_SOURCE_SEQUENCER, EVENT_SEQ);
+    }
+
+
+    template<class P> void pulseAll(P &synth) {
+        for (byte i = 0; i < SEQ_ENGINES; i++) {
+            if (engine[i].channel != NO_CHANNEL)
+                pulse(synth, engine[i]);
+        }
+    }
+
+
+    template<class P> void silenceAll(P &synth) {
+        for (byte i = 0; i < SEQ_ENGINES; i++) {
+            if (engine[i].channel != NO_CHANNEL)
+                silence(synth, engine[i]);
+        }
+    }
+
+
+    template<class P> void setMode(P &synth, byte channel, byte mode) {
+        Engine *e = find(channel);
+        if (mode == MODE_OFF) {
+            if (e) {
+                silence(synth, *e);
+                e->channel = NO_CHANNEL;
+            }
+            return;
+        }
+        if ((mode > MODE_RANDOM && !patternValid(mode))
+                || (!e && !(e = find(NO_CHANNEL))))
+            return;
+        if (e->channel != channel) {
+            e->channel = channel;
+            e->rate = PPQN / 4;
+            e->gate = 64;
+            e->octaves = 1;
+            e->count = 0;
+            e->sounding = NO_KEY;
+            e->tie = false;
+        }
+        e->mode = mode;
+        rewind(*e);
+    }
+
+
+    // Timer B ticks are PULSE_SAMPLES_BPM / ymPer() of its steps
+    word ymPer() const {
+        return (word)tempo * SAMPLES_STEP;
+    }
+
+
+    template<class P> void setTempo(P &synth, byte val) {
+        tempo = val < TEMPO_MIN / 2 ? TEMPO_MIN : 2 * val;
+        if (clock == CLOCK_YM && ticking)
+            synth.setYmTickRate(PULSE_SAMPLES_BPM, ymPer());
+    }
+
+
+    template<class P> void setClock(P &synth, byte c) {
+        if (c == clock)
+            return;
+        silenceAll(synth);
+        synth.events().cancel(EVENT_SOURCE_SEQUENCER);
+        if (clock == CLOCK_YM)
+            synth.stopYmTicks();
+        ticking = false;
+        clock = c;
+        running = false;
+        if (active())
+            startTicking(synth);
+    }
+
+    public:
+    void begin() {
+        for (byte i = 0; i < SEQ_ENGINES; i++) {
+            engine[i].channel = NO_CHANNEL;
+        }
+        tempo = TEMPO_DEFAULT;
+        clock = CLOCK_INTERNAL;
+        running = ticking = false;
+        lfsr = 0xACE1;
+    }
+
+
+    // True when the key is the channel's engine's; the note is not played.
+    // Velocity 0 lets go of the key.
+    template<class P> bool noteOn(P &synth, byte channel, byte key,
+                                  byte velocity) {
+        if (!velocity)
+            return noteOff(synth, channel, key);
+        Engine *e = find(channel);
+        if (!e)
+            return false;
+        if (!e->count)
+            rewind(*e);
+        hold(*e, key);
+        e->velocity = velocity;
+        startTicking(synth);
+        return true;
+    }
+
+
+    template<class P> bool noteOff(P &synth, byte channel, byte key) {
+        Engine *e = find(channel);
+        if (!e)
+            return false;
+        release(*e, key);
+        if (!e->count)
+            silence(synth, *e);
+        return true;
+    }
+
+
+    // CC 102-107, see above; 1 if handled
+    template<class P> byte doCc(P &synth, byte channel, byte num, byte val) {
+        Engine *e;
+        switch (num) {
+            // DO NOT FORGET: break
+            case 102: setMode(synth, channel, val); break;
+            case 106: setTempo(synth, val); break;
+            case 107:
+            setClock(synth, val < 32 ? CLOCK_INTERNAL
+                : val < 64 ? CLOCK_YM : CLOCK_MIDI);
+            break;
+
+            case 103:
+            if ((e = find(channel)) != NULL)
+                e->rate = !val ? 1 : val > RATE_MAX ? (byte)RATE_MAX : val;
+            break;
+            case 104:
+            if ((e = find(channel)) != NULL)
+                e->gate = val;
+            break;
+            case 105:
+            if ((e = find(channel)) != NULL)
+                e->octaves = !val ? 1
+                    : val > OCTAVES_MAX ? (byte)OCTAVES_MAX : val;
+            break;
+
+            default:
+            return 0; //did not handle CC
+            break;
+        }
+        return 1; //handled CC
+    }
+
+
+    // a MIDI real time message, MIDI_REALTIME up
+    template<class P> void realTime(P &synth, byte status) {
+        if (clock != CLOCK_MIDI)
+            return;
+        switch (status) {
+            case MIDI_CLOCK:
+            if (running)
+                pulseAll(synth);
+            break;
+
+            case MIDI_START:
+            for (byte i = 0; i < SEQ_ENGINES; i++) {
+                rewind(engine[i]);
+            }
+            running = true;
+            break;
+
+            case MIDI_CONTINUE:
+            running = true;
+            break;
+
+            case MIDI_STOP:
+            running = false;
+            silenceAll(synth);
+            break;
+
+            default:
+            break;
+        }
+    }
+
+
+    // an EVENT_SEQ from the queue: a pulse of the internal tempo, the next
+    // one queued while a key is held or a note sounds; on Timer B the
+    // first, the ticks starting from it
+    template<class P> void tick(P &synth) {
+        ticking = false;
+        if (clock == CLOCK_MIDI)
+            return;
+        pulseAll(synth);
+        if (!active())
+            return;
+        if (clock == CLOCK_YM) {
+            synth.startYmTicks(PULSE_SAMPLES_BPM, ymPer());
+            ticking = true;
+            return;
+        }
+        due += PULSE_TICKS_BPM / tempo;
+        remainder += PULSE_TICKS_BPM % tempo;
+        if (remainder >= tempo) {
+            remainder -= tempo;
+            due++;
+        }
+        ticking = synth.events().post(due, EVENT_SOURCE_SEQUENCER, EVENT_SEQ);
+    }
+
+
+    // a YmTimer.h tick: a pulse of the tempo on Timer B, which stops
+    // once no key is held and no note sounds
+    template<class P> void ymTick(P &synth) {
+        if (clock != CLOCK_YM || !ticking)
+            return;
+        pulseAll(synth);
+        if (active())
+            return;
+        synth.stopYmTicks();
+        ticking = false;
+    }
+};
+
+// include guard
+#endif
@@ -0,0 +1,130 @@
+#ifndef STATE_SYNC_H__
+#define STATE_SYNC_H__
+
+/*
+YM2612 shadow registers over the host link
+
+An editor that reconnects, or only wants to know it still agrees with the
+device, asks for the chip's State (YM2612.h) with LINK_STATE_QUERY and
+gets back only the parts that differ from its own copy. The query
+carries a hash of each STATE_BLOCK bytes of that copy:
+
+    chip, then crc lo, hi of blocks 0, 1, ... (stateHash())
+
+Blocks the query has no hash for, all of them in a query of just the
+chip, count as changed. The device answers with a LINK_STATE frame for
+each run of changed blocks, then LINK_STATE_END:
+
+    LINK_STATE      chip, offset, the State's bytes from there
+    LINK_STATE_END  chip, State length, crc lo, hi of all of it, blocks
+                    sent
+
+The host patches its copy with the LINK_STATE frames and checks it
+against the crc in LINK_STATE_END; a copy that still differs, from a
+block whose crc matched by chance, is asked for again with the chip
+alone. A chip the firmware does not have answers with a length of 0.
+
+The hashes are CRC-16s (the CCITT polynomial, reflected, as avr-libc's
+_crc_ccitt_update()), a few shifts a byte and good at the single field
+changes between syncs. Nothing is tracked as registers are written: the
+State is hashed when asked, so the hot path does not pay for syncing.
+The answer goes out from serialEvent(), at most STATE_LENGTH bytes and a
+frame's framing per 40, a couple of ms at LINK_BAUDRATE.
+
+host/statesync is the reference client, host/stateloop its loopback
+check against the firmware on the shim.
+*/
+
+#include "Arduino.h"
+#include "HostLink.h"
+
+#define STATE_BLOCK 8 // bytes a hash covers
+#define STATE_CRC_INIT 0xFFFF
+// State bytes in a LINK_STATE frame, whole blocks
+#define STATE_FRAME_BYTES \
+    ((LINK_PAYLOAD_MAX - 2) / STATE_BLOCK * STATE_BLOCK)
+// hashes a query can carry
+#define STATE_QUERY_BLOCKS ((LINK_PAYLOAD_MAX - 1) / 2)
+
+#define STATE_CHIP_INDEX 0
+#define STATE_OFFSET_INDEX 1
+#define STATE_DATA_INDEX 2
+#define STATE_LENGTH_INDEX 1
+#define STATE_CRC_INDEX 2
+#define STATE_SENT_INDEX 4
+#define STATE_END_LENGTH 5
+
+static inline word stateCrc(word crc, byte data) {
+    data ^= crc & 0xFF;
+    data ^= data << 4;
+    return ((word)data << 8 | crc >> 8) ^ (byte)(data >> 4)
+        ^ ((word)data << 3);
+}
+
+
+static inline word stateHash(const byte *data, byte length) {
+    word crc = STATE_CRC_INIT;
+    for (byte i = 0; i < length; i++) {
+        crc = stateCrc(crc, data[i]);
+    }
+    return crc;
+}
+
+
+class StateSync {
+    static bool changed(const byte *state, byte length, byte block,
+                        const byte *hashes, byte hashCount) {
+        if (block >= hashCount)
+            return true;
+        const byte offset = block * STATE_BLOCK;
+        const byte n = length - offset < STATE_BLOCK ? length - offset
+            : STATE_BLOCK;
+        const word crc = stateHash(state + offset, n);
+        return (crc & 0xFF) != hashes[2 * block]
+            || (crc >> 8) != hashes[2 * block + 1];
+    }
+
+    public:
+    // Answers a LINK_STATE_QUERY for chip's state, NULL if there is no
+    // such chip.
+    static void answer(HostLink &link, const byte *query, byte queryLength,
+                       const byte *state, byte length) {
+        byte frame[LINK_PAYLOAD_MAX];
+        frame[STATE_CHIP_INDEX] = query[STATE_CHIP_INDEX];
+        if (state == NULL)
+            length = 0;
+        const byte *hashes = query + 1;
+        const byte hashCount = (queryLength - 1) / 2;
+        const byte blocks = (length + STATE_BLOCK - 1) / STATE_BLOCK;
+        byte sent = 0;
+        for (byte block = 0; block < blocks;) {
+            if (!changed(state, length, block, hashes, hashCount)) {
+                block++;
+                continue;
+            }
+            // the run of changed blocks from here, as much as fits
+            const byte offset = block * STATE_BLOCK;
+            byte end = offset;
+            do {
+                end += STATE_BLOCK;
+                block++;
+                sent++;
+            } while (block < blocks && end - offset < STATE_FRAME_BYTES
+                && changed(state, length, block, hashes, hashCount));
+            if (end > length)
+                end = length;
+            frame[STATE_OFFSET_INDEX] = offset;
+            memcpy(frame + STATE_DATA_INDEX, state + offset, end - offset);
+            link.send(LINK_STATE, STATE_DATA_INDEX + end - offset, frame);
+        }
+        const word crc = stateHash(state, length);
+        frame[STATE_LENGTH_INDEX] = length;
+        frame[STATE_CRC_INDEX] = crc & 0xFF;
+        frame[STATE_CRC_INDEX + 1] = crc >> 8;
+        frame[STATE_SENT_INDEX] = sent;
+        link.send(LINK_STATE_END, STATE_END_LENGTH, frame);
+    }
+};
+
+// include guard
+#endif
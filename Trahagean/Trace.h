@@ -0,0 +1,157 @@
+#ifndef TRACE_H__
+#define TRACE_H__
+
+/*
+Hot path tracing
+
+Define TRACE_ENABLE before the includes to timestamp events into a RAM ring
+buffer; without it TRACE() compiles to nothing. Timestamps are counts of
+the board's Clock (Board.h) at F_CPU / 8 (0.5us at 16MHz) extended to 24
+bits by its overflow interrupt, so the Clock's timer is not available for
+anything else while tracing.
+
+Global CC 86 dumps the buffer over Serial, oldest event first:
+
+    'T' 'R' 'C' version(1)
+    tick rate in Hz (uint32, little endian)
+    event count (uint8)
+    count x { event, arg, time bits 16-23, time bits 0-7, time bits 8-15 }
+
+The sketch's ISRs record TRACE_ISR_ENTER and TRACE_ISR_EXIT with their
+trace_isr_e id, except two on the Clock: the overflow, which is the
+tracing's own time base, and SYNTH_SN_DITHER's compare B step, which
+every 32us would overwrite the whole buffer within 2ms. The Arduino
+core's USART and millis() interrupts are its own; serialEvent's
+TRACE_MIDI_BYTE marks what the RX one received.
+
+host/tracedecode turns dumps into latency histograms and a Chrome trace.
+*/
+
+#include "Arduino.h"
+#include "Board.h"
+
+enum trace_e {
+    TRACE_MIDI_BYTE = 1, // arg: the byte, when serialEvent reads it
+    TRACE_PACKET, // arg: status, packetizer completed a packet
+    TRACE_DISPATCH_BEGIN, // arg: status, parseMidiPacket entry
+    TRACE_DISPATCH_END, // arg: status, parseMidiPacket exit
+    TRACE_YM_WRITE, // arg: register, after the data strobe
+    TRACE_SN_WRITE, // arg: data byte, after the WE strobe
+    TRACE_ISR_ENTER, // arg: vector id
+    TRACE_ISR_EXIT, // arg: vector id
+    TRACE_WAKE // arg: 0, back from an idle sleep (USE_IDLE_SLEEP)
+};
+
+// the vector ids of TRACE_ISR_ENTER and TRACE_ISR_EXIT
+enum trace_isr_e {
+    TRACE_ISR_YM_IRQ = 1, // SYNTH_YM_IRQ_vect, YmTimer.h
+    TRACE_ISR_CLOCK_COMPA // SYNTH_CLOCK_COMPA_vect, EventQueue.h's wake
+};
+
+#define TRACE_VERSION 1
+
+#ifdef TRACE_ENABLE
+
+#ifndef TRACE_LENGTH
+#define TRACE_LENGTH 64 // events, 5 bytes of RAM each
+#endif
+
+#define TRACE(event, arg) Trace::record(event, arg)
+
+class Trace {
+    typedef SynthBoard::Clock Clock;
+    static_assert(TRACE_LENGTH && !(TRACE_LENGTH & (TRACE_LENGTH - 1))
+        && TRACE_LENGTH <= 128, "TRACE_LENGTH must be a power of two <= 128");
+
+    struct Event {
+        byte event;
+        byte arg;
+        byte epoch;
+        word ticks;
+    };
+
+    static Event buffer[TRACE_LENGTH];
+    static byte head; // next slot to write
+    static byte count;
+    static bool paused;
+
+    public:
+    static volatile byte epoch; // Clock overflows, time bits 16-23
+
+    static void begin() {
+        Clock::begin();
+        Clock::restart();
+        Clock::overflowInterrupt();
+        head = count = 0;
+        paused = false;
+    }
+
+
+    static inline void record(byte event, byte arg) {
+        if (paused)
+            return;
+        byte sreg = SREG;
+        cli();
+        word ticks = Clock::now();
+        byte e = epoch;
+        if (Clock::overflowed() && ticks < 0x8000)
+            e++; // overflowed, the ISR has not run yet
+        Event &slot = buffer[head];
+        slot.event = event;
+        slot.arg = arg;
+        slot.epoch = e;
+        slot.ticks = ticks;
+        head = (head + 1) & (TRACE_LENGTH - 1);
+        if (count < TRACE_LENGTH)
+            count++;
+        SREG = sreg;
+    }
+
+
+    // blocks until the whole buffer has gone out, then starts over
+    static void dump() {
+        paused = true;
+        const unsigned long rate = F_CPU / 8;
+        Serial.write('T');
+        Serial.write('R');
+        Serial.write('C');
+        Serial.write(TRACE_VERSION);
+        for (byte i = 0; i < 4; i++)
+            Serial.write((byte)(rate >> (8 * i)));
+        Serial.write(count);
+        for (byte i = 0; i < count; i++) {
+            const Event &e = buffer[(head - count + i) & (TRACE_LENGTH - 1)];
+            Serial.write(e.event);
+            Serial.write(e.arg);
+            Serial.write(e.epoch);
+            Serial.write(lowByte(e.ticks));
+            Serial.write(highByte(e.ticks));
+        }
+        head = count = 0;
+        paused = false;
+    }
+};
+
+Trace::Event Trace::buffer[TRACE_LENGTH];
+byte Trace::head;
+byte Trace::count;
+bool Trace::paused;
+volatile byte Trace::epoch;
+
+ISR(SYNTH_CLOCK_OVF_vect) {
+    Trace::epoch++;
+}
+
+#else
+
+#define TRACE(event, arg) do { } while (0)
+
+class Trace {
+    public:
+    static inline void begin() { }
+    static inline void dump() { }
+};
+
+#endif
+
+#endif
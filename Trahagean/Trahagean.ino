@@ -1,17 +1,41 @@
 /* Dependencies */
 #include "Arduino.h"
-#include "toggle.h"
 #include <avr/delay.h>
 
 // flag for MegaSynth to dump freqs for verification purposes
 //#define DUMP_FREQS
 // initial tuning (default is 440)
 //#define EQUAL_TEMPERAMENT_A4 440.0
+// timestamp hot path events, global CC 86 dumps them (see Trace.h)
+//#define TRACE_ENABLE
+// a second YM2612 and SN76489 on the bus, see Board.h for the pins
+//#define DUAL_CHIPS
+// idle sleep between events instead of spinning in loop(), see idleSleep()
+//#define USE_IDLE_SLEEP
 #include "MegaSynth.h"
+#ifdef USE_IDLE_SLEEP
+#include <avr/sleep.h>
+#endif
 
 //#define USE_QD_PACKETIZER
+// framed register/MIDI protocol from a computer instead of MIDI, or beside
+// it on a board with a second USART (see HostLink.h)
+//#define USE_HOST_LINK
+#ifdef USE_HOST_LINK
+#if defined(USE_QD_PACKETIZER)
+#error "USE_HOST_LINK needs MidiPacketizer, undefine USE_QD_PACKETIZER"
+#endif
+#include "HostLink.h"
+#include "VgmStream.h"
+#include "StateSync.h"
+#if SYNTH_LINK_USART == 0
+#define BAUDRATE LINK_BAUDRATE
+#endif
+#endif
+#ifndef BAUDRATE
 //#define BAUDRATE MIDI_NATIVE_BAUDRATE
 #define BAUDRATE MIDI_SOFTWARE_BAUDRATE
+#endif
 
 
 //rate for MIDI bridge software (for historical reasons this number is a multiple of 300)
@@ -21,44 +45,20 @@
 
 
 MegaSynth synth;
-
-//Pin map for data pins is a bit complicated:
-//DATA_BUS_D0 through DATA_BUS_D1 map to PORTD pins 6-7 -- Uno digital pins 6-7
-//DATA_BUS_D2 through DATA_BUS_D7 map to PORTB pins 0-5 -- Uno digital pins 8-13
-#define DATA_BUS_PORTD_MASK B11000000
-#define DATA_BUS_PORTD_BITBANG(b) ((b) << 6)
-
-#define DATA_BUS_PORTB_MASK B00111111
-#define DATA_BUS_PORTB_BITBANG(b) ((b) >> 2)
-
-
-#if !defined(DATA_BUS_PORTB_MASK) \
-    && !defined(DATA_BUS_PORTC_MASK) \
-    && !defined(DATA_BUS_PORTD_MASK)
-#error "define at least one DATA_BUS_PORT[BCD]_MASK"
-#endif
-#if (defined(DATA_BUS_PORTB_MASK) && !defined(DATA_BUS_PORTB_BITBANG))
-#error "DATA_BUS_PORTB_MASK defined without DATA_BUS_PORTB_BITBANG(b)"
-#endif
-#if (defined(DATA_BUS_PORTC_MASK) && !defined(DATA_BUS_PORTC_BITBANG))
-#error "DATA_BUS_PORTC_MASK defined without DATA_BUS_PORTC_BITBANG(b)"
+#ifdef USE_HOST_LINK
+HostLink hostLink;
+VgmStream stream(synth, hostLink);
+// a LINK_STREAM frame waiting for room in the jitter buffer; serial input
+// stops until it is taken so credit holds the host back
+const byte *heldFrame = NULL;
+#if SYNTH_LINK_USART == 0
+// MIDI only comes through the link, so patch dumps go back through it
+void linkSysex(const byte *bytes, byte length) {
+    hostLink.send(LINK_MIDI, length, bytes);
+}
 #endif
-#if (defined(DATA_BUS_PORTD_MASK) && !defined(DATA_BUS_PORTD_BITBANG))
-#error "DATA_BUS_PORTD_MASK defined without DATA_BUS_PORTD_BITBANG(b)"
 #endif
 
-void dataBusWrite(byte data) {
-#ifdef DATA_BUS_PORTB_MASK
-    PORTB = (PORTB & ~(DATA_BUS_PORTB_MASK)) | (DATA_BUS_PORTB_BITBANG(data) & DATA_BUS_PORTB_MASK);
-#endif
-#ifdef DATA_BUS_PORTC_MASK
-    PORTC = (PORTC & ~(DATA_BUS_PORTC_MASK)) | (DATA_BUS_PORTC_BITBANG(data) & DATA_BUS_PORTC_MASK);
-#endif
-#ifdef DATA_BUS_PORTD_MASK
-    PORTD = (PORTD & ~(DATA_BUS_PORTD_MASK)) | (DATA_BUS_PORTD_BITBANG(data) & DATA_BUS_PORTD_MASK);
-#endif
-    
-}
 
 #ifdef USE_QD_PACKETIZER
 // Quick and dirty packetizer
@@ -95,6 +95,11 @@ void qdMidiPacketizer(void (*midiPacketParser)(const byte *), int inByte){
 #else
 MidiPacketizer packetizer;
 #endif
+#if defined(USE_HOST_LINK) && SYNTH_LINK_USART == 1
+MidiPacketizer linkPacketizer; // LINK_MIDI apart from the MIDI port
+#elif defined(USE_HOST_LINK)
+MidiPacketizer &linkPacketizer = packetizer;
+#endif
 
 void blinkTest(byte numBlinks = 1, word LEDHighTime = 50, word LEDLowTime = 50) {
 	for (int i = 0; i < numBlinks; i++) {
@@ -113,28 +118,23 @@ void blinkTest(byte numBlinks = 1, word LEDHighTime = 50, word LEDLowTime = 50)
 void setup() {
     /* activate MIDI Serial input - Gopal */
     Serial.begin(BAUDRATE);
-        
-    //SN Clock on Uno's D5
-    toggle_OC0B(4000000.0); // 4MHz
-    pinMode(5, OUTPUT);
-
-    //YM Clock on Uno's D3
-    toggle_OC2B(8000000.0); // 8MHz
-    pinMode(3, OUTPUT);
-
-#ifdef DATA_BUS_PORTB_MASK
-    DDRB |= DATA_BUS_PORTB_MASK;
-#endif
-#ifdef DATA_BUS_PORTC_MASK
-    DDRC |= DATA_BUS_PORTC_MASK;
-#endif
-#ifdef DATA_BUS_PORTD_MASK
-    DDRD |= DATA_BUS_PORTD_MASK;
+#if defined(USE_HOST_LINK) && SYNTH_LINK_USART == 1
+    LINK_SERIAL.begin(LINK_BAUDRATE);
 #endif
+        
+    // chip clocks and the data bus, see Board.h for the pins
+    SynthBoard::begin();
 
     pinMode(LED_BUILTIN, OUTPUT);
     
+    Trace::begin();
     synth.begin();
+#ifdef USE_HOST_LINK
+    stream.begin();
+#if SYNTH_LINK_USART == 0
+    synth.setSysexSender(linkSysex);
+#endif
+#endif
     _delay_ms(200);
     blinkTest(3,200,200);
     //blinkTest(3,400,200);
@@ -142,27 +142,158 @@ void setup() {
 }
 
 
+// a byte of MIDI or of a link frame is waiting to be read
+static inline bool inputWaiting() {
+#ifdef USE_HOST_LINK
+    return (heldFrame == NULL && LINK_SERIAL.available())
+#if SYNTH_LINK_USART == 1
+        || Serial.available()
+#endif
+        ;
+#else
+    return Serial.available();
+#endif
+}
+
+
+#ifdef USE_IDLE_SLEEP
+// Idle sleep until an interrupt: a received byte, or the Clock's compare A
+// when the next timed event is due (EventQueue.h): a stream's write or a
+// drum's step. Idle mode keeps the I/O clock, so the chip clocks on
+// Timer0/Timer2 and the USART run on. Waking takes a few cycles, far less
+// than a chip write. Work is checked with interrupts masked and the sleep
+// follows sei() directly: the instruction after sei() always runs before
+// a pending interrupt, so a byte that arrives after the check still ends
+// the sleep.
+void idleSleep() {
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    cli();
+#ifdef USE_HOST_LINK
+    const bool work = inputWaiting() || !stream.canSleep()
+        || !synth.canSleep();
+#else
+    const bool work = inputWaiting() || !synth.canSleep();
+#endif
+    if (work) {
+        sei();
+        return;
+    }
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+    TRACE(TRACE_WAKE, 0);
+}
+#endif
+
+
 void loop() {
-    // nothing! -- see serialEvent() instead
-    // do not sleep here because it adds latency
+    synth.service();
+#ifdef USE_HOST_LINK
+    stream.service();
+    if (heldFrame != NULL && stream.push(heldFrame + LINK_PAYLOAD_INDEX,
+            heldFrame[LINK_LENGTH_INDEX]))
+        heldFrame = NULL;
+#endif
+    if (!inputWaiting()) // the notes that came together go out together
+        synth.flushNotes();
+#ifdef USE_IDLE_SLEEP
+    idleSleep();
+#endif
+    // nothing else! -- see serialEvent() instead
 }
 
 
-#ifdef USE_QD_PACKETIZER
+#if defined(USE_HOST_LINK)
+
+
+void linkHelper(const byte *frame) {
+    const byte *payload = frame + LINK_PAYLOAD_INDEX;
+    const byte length = frame[LINK_LENGTH_INDEX];
+    switch (frame[LINK_TYPE_INDEX]) {
+        case LINK_HELLO:
+        hostLink.hello();
+        break;
+
+        case LINK_YM:
+        for (byte i = 0; i + 2 < length; i += 3) {
+            synth.writeYm(payload[i], payload[i + 1], payload[i + 2]);
+        }
+        break;
+
+        case LINK_SN:
+        for (byte i = 0; i < length; i++) {
+            synth.writeSn(payload[i]);
+        }
+        break;
+
+        case LINK_MIDI:
+        for (byte i = 0; i < length; i++) {
+            const byte *packet = linkPacketizer.receive(payload[i]);
+            if (packet != NULL)
+                TRACE(TRACE_PACKET, packet[MIDI_STATUS_INDEX]);
+            synth.parseMidiPacket(packet);
+        }
+        break;
+
+        case LINK_STREAM:
+        if (!stream.push(payload, length))
+            heldFrame = frame;
+        break;
+
+        case LINK_STATE_QUERY:
+        if (length)
+            StateSync::answer(hostLink, payload, length,
+                synth.ymState(payload[STATE_CHIP_INDEX]),
+                YM2612::STATE_LENGTH);
+        break;
+
+        default:
+        break;
+    }
+}
+
+
+#if SYNTH_LINK_USART == 1
+void serialEvent1() { // the same for the link's own USART
+#else
+void serialEvent() { // Serial port triggers this when there is data waiting
+#endif
+    if (heldFrame != NULL)
+        return; // the frame buffer is still in use, see loop()
+    int inByte = LINK_SERIAL.read();
+    TRACE(TRACE_MIDI_BYTE, inByte);
+    const byte *frame = hostLink.receive(inByte);
+    if (frame != NULL)
+        linkHelper(frame);
+}
+#endif
+
+
+#if defined(USE_HOST_LINK) && SYNTH_LINK_USART == 0
+// MIDI only comes through the link
+#elif defined(USE_QD_PACKETIZER)
 // ideally this would use a base class/interface instead of function pointer
 void qdHelper(const byte *packet) {
+    TRACE(TRACE_PACKET, packet[MIDI_STATUS_INDEX]);
     //put your packet parsers here:
     synth.parseMidiPacket(packet);
 }
 
 
 void serialEvent() { // Serial port triggers this when there is data waiting
-    qdMidiPacketizer(qdHelper, Serial.read());
+    int inByte = Serial.read();
+    TRACE(TRACE_MIDI_BYTE, inByte);
+    qdMidiPacketizer(qdHelper, inByte);
 }
 #else
 void serialEvent() { // Serial port triggers this when there is data waiting
     const byte *packet = NULL;
-    packet = packetizer.receive(Serial.read());
+    int inByte = Serial.read();
+    TRACE(TRACE_MIDI_BYTE, inByte);
+    packet = packetizer.receive(inByte);
+    if (packet != NULL)
+        TRACE(TRACE_PACKET, packet[MIDI_STATUS_INDEX]);
     //put your packet parsers here:
     synth.parseMidiPacket(packet);
 }
@@ -0,0 +1,110 @@
+#ifndef TUNING_H__
+#define TUNING_H__
+
+/*
+Note tables for the chip clocks the board makes
+
+Equal temperament from EQUAL_TEMPERAMENT_A4, worked out by the compiler
+for the clocks SynthBoard's snClock() and ymClock() say come out of the
+timers (see Board.h), not the ones asked for:
+
+    SynthTuning::snPeriod(key)   SN76489 tone period, clock / 32 / Hz,
+                                 an octave up for keys too low for the
+                                 10 bit counter
+    SynthTuning::ymFnumber(key)  YM2612 F-number in block keyToBlock(key)
+                                 of MegaSynth, key / 12 - 1
+
+F-numbers repeat every octave, so the YM2612 table holds the octave of
+key 60 (block 4); Hz = F-number clock / 144 / 2^(21 - block). Every SN76489
+key gets its own period, so low keys are not octaves of rounded high
+ones. host/tuning prints the cents every key is off by.
+*/
+
+#include "Arduino.h"
+#include "Board.h"
+
+#ifndef EQUAL_TEMPERAMENT_A4
+#define EQUAL_TEMPERAMENT_A4 440.0
+#endif
+// A precise calculation for the 12th root of two:
+#define ROOT12_2 1.0594630943592952645618252949463
+
+class Tuning {
+    public:
+    enum tuning_e {
+        KEY_COUNT = 128,
+        OCTAVE = 12,
+        KEY_A4 = 69,
+        YM_TABLE_KEY = 60, // first key of the YM2612 table, block 4
+        SN_PERIOD_MAX = 1023,
+        YM_FNUMBER_MAX = 2047
+    };
+
+    // n half steps up from A4, or down for n < 0
+    static constexpr double halfSteps(int n) {
+        return n > 0 ? halfSteps(n - 1) * ROOT12_2
+            : n < 0 ? halfSteps(n + 1) / ROOT12_2 : 1.0;
+    }
+
+
+    static constexpr double keyHz(int key) {
+        return EQUAL_TEMPERAMENT_A4 * halfSteps(key - KEY_A4);
+    }
+
+
+    static constexpr word snPeriodFor(double clock, double hz) {
+        return clock / 32 / hz + 0.5 > SN_PERIOD_MAX
+            ? snPeriodFor(clock, hz * 2)
+            : clock / 32 / hz + 0.5 < 1 ? 1 : clock / 32 / hz + 0.5;
+    }
+
+
+    // in block 4, the block of YM_TABLE_KEY
+    static constexpr word ymFnumberFor(double clock, double hz) {
+        return hz * 144 * 131072 / clock + 0.5;
+    }
+};
+
+
+template<class B> class ChipTuning : public Tuning {
+    static_assert(ymFnumberFor(B::ymClock(), keyHz(YM_TABLE_KEY + 11))
+        <= YM_FNUMBER_MAX, "YM2612 clock too slow for the F-numbers");
+
+    template<word... I> struct SnTable {
+        static const PROGMEM word table[sizeof...(I)];
+    };
+    template<word... I> struct YmTable {
+        static const PROGMEM word table[sizeof...(I)];
+    };
+    template<template<word...> class T, word N, word... I>
+    struct Generate : Generate<T, N - 1, N - 1, I...> { };
+    template<template<word...> class T, word... I>
+    struct Generate<T, 0, I...> : T<I...> { };
+    typedef Generate<SnTable, KEY_COUNT> snTable;
+    typedef Generate<YmTable, OCTAVE> ymTable;
+
+    public:
+    static inline word snPeriod(byte key) {
+        return pgm_read_word(&snTable::table[key & (KEY_COUNT - 1)]);
+    }
+
+
+    static inline word ymFnumber(byte key) {
+        return pgm_read_word(&ymTable::table[key % OCTAVE]);
+    }
+};
+
+template<class B> template<word... I>
+const PROGMEM word ChipTuning<B>::SnTable<I...>::table[sizeof...(I)] = {
+    snPeriodFor(B::snClock(), keyHz(I))...
+};
+
+template<class B> template<word... I>
+const PROGMEM word ChipTuning<B>::YmTable<I...>::table[sizeof...(I)] = {
+    ymFnumberFor(B::ymClock(), keyHz(YM_TABLE_KEY + I))...
+};
+
+typedef ChipTuning<SynthBoard> SynthTuning;
+
+// include guard
+#endif
@@ -0,0 +1,299 @@
+#ifndef VGM_STREAM_H__
+#define VGM_STREAM_H__
+
+/*
+Live VGM streaming over the host link
+
+host/vgmstream walks a VGM file and sends its chip writes as LINK_STREAM
+frames. An empty frame starts a new stream, dropping anything buffered.
+Otherwise the payload of a frame is a run of whole commands:
+
+    STREAM_YM0 register data    YM2612 part 0 write
+    STREAM_YM1 register data    YM2612 part 1 write
+    STREAM_SN data              SN76489 write
+    STREAM_WAIT lo hi           wait 1-65535 samples at STREAM_RATE
+    STREAM_END                  play what is buffered, then stop
+
+The waits timestamp the writes relative to each other. Commands go into a
+jitter buffer of STREAM_BUFFER_SIZE bytes, so when a frame arrives does
+not matter as long as it arrives before it is due. Playback starts once
+STREAM_PREROLL samples are buffered, the buffer is full or STREAM_END
+arrives. If the buffer runs dry it counts an underrun and prerolls again.
+
+While playing, service() posts the writes due within STREAM_HORIZON
+ticks to the synth's EventQueue (EventQueue.h), stamped with their Clock
+tick to the sample; the queue plays them alongside the synth's own timed
+events. A wait that runs past the horizon leaves an EVENT_WAKE at the
+point the stream has to carry on from.
+
+A frame that does not fit is held and the sketch stops reading the serial
+port until it does, so the link's credit holds the host back and a track
+of any length plays in bounded memory.
+
+After each frame, each underrun and every STREAM_REPORT_INTERVAL samples
+played the device reports LINK_STREAM_FILL:
+
+    free bytes (lo, hi), buffered samples (lo, hi, saturating),
+    underruns, frames accepted (both counting from the start of the
+    stream and wrapping), playing (0 while prerolling)
+
+which lets the host pace itself to keep the buffered time near a target
+without ever filling the buffer. Commands handed to the queue no longer
+count as buffered.
+
+The buffer grows with the part's RAM, see BY_RAM() in Board.h.
+*/
+
+#include "Arduino.h"
+#include "HostLink.h"
+#include "MegaSynth.h"
+
+#ifndef STREAM_BUFFER_SIZE
+#define STREAM_BUFFER_SIZE BY_RAM(512, 1024, 8192) // bytes, a power of two
+#endif
+#ifndef STREAM_PREROLL
+#define STREAM_PREROLL 8820 // samples, 200ms
+#endif
+#ifndef STREAM_REPORT_INTERVAL
+#define STREAM_REPORT_INTERVAL 2205 // samples, 50ms
+#endif
+#ifndef STREAM_HORIZON
+#define STREAM_HORIZON 2048 // Clock ticks, 1ms at 16MHz
+#endif
+
+static constexpr unsigned long streamGcd(unsigned long a, unsigned long b) {
+    return b ? streamGcd(b, a % b) : a;
+}
+
+class VgmStream {
+    static_assert(STREAM_BUFFER_SIZE
+        && !(STREAM_BUFFER_SIZE & (STREAM_BUFFER_SIZE - 1))
+        && STREAM_BUFFER_SIZE <= 0x8000,
+        "STREAM_BUFFER_SIZE must be a power of two <= 32768");
+    static_assert((int)STREAM_YM0 == EVENT_YM0 && (int)STREAM_YM1 == EVENT_YM1,
+        "stream YM2612 commands are queued as their part");
+
+    // Time is kept in 1/STREAM_RATE Clock ticks so neither rate has to
+    // divide the other: a sample costs SAMPLE_COST units, a tick is worth
+    // TICK_VALUE of them (20000 and 441 at 16MHz). The next command is due
+    // at tick cursor plus remainder units.
+    static const unsigned long TICK_RATE = F_CPU / 8;
+    static const unsigned long SAMPLE_COST
+        = TICK_RATE / streamGcd(TICK_RATE, STREAM_RATE);
+    static const unsigned long TICK_VALUE
+        = STREAM_RATE / streamGcd(TICK_RATE, STREAM_RATE);
+    static_assert(0xFFFFUL * SAMPLE_COST <= 0xFFFFFFFFUL - TICK_VALUE,
+        "the longest wait must fit the units");
+
+    static byte commandLength(byte command) {
+        switch (command) {
+            case STREAM_YM0:
+            case STREAM_YM1:
+            case STREAM_WAIT:
+            return 3;
+            case STREAM_SN:
+            return 2;
+            case STREAM_END:
+            return 1;
+            default:
+            return 0;
+        }
+    }
+
+    MegaSynth &synth;
+    HostLink &link;
+    byte buffer[STREAM_BUFFER_SIZE];
+    word head; // next byte to write
+    word used;
+    unsigned long buffered; // samples of waits in the buffer
+    unsigned long cursor; // EventQueue time the next command is due at
+    word remainder;
+    unsigned long wakeDue; // of the last EVENT_WAKE posted
+    word sinceReport; // samples handed on since the last report
+    bool playing;
+    bool ending; // STREAM_END is in the buffer
+    bool waiting; // for the Clock or the queue, see canSleep()
+    byte underruns;
+    byte frames;
+
+    // enough buffered to start playing
+    bool prerolled() const {
+        return buffered >= STREAM_PREROLL || ending
+            || used > STREAM_BUFFER_SIZE - LINK_PAYLOAD_MAX;
+    }
+
+
+    // an EVENT_WAKE at due, unless one comes sooner
+    void wakeAt(EventQueue &events, unsigned long now, unsigned long due) {
+        if ((long)(wakeDue - now) > 0 && (long)(wakeDue - due) <= 0)
+            return;
+        if (events.post(due, EVENT_SOURCE_STREAM, EVENT_WAKE))
+            wakeDue = due;
+    }
+
+
+    byte take() {
+        byte b = buffer[(head - used) & (STREAM_BUFFER_SIZE - 1)];
+        used--;
+        return b;
+    }
+
+
+    void report() {
+        const word free = STREAM_BUFFER_SIZE - used;
+        const word samples = buffered > 0xFFFF ? 0xFFFF : buffered;
+        const byte payload[STREAM_FILL_LENGTH] = {
+            lowByte(free), highByte(free),
+            lowByte(samples), highByte(samples),
+            underruns, frames, playing
+        };
+        link.send(LINK_STREAM_FILL, sizeof(payload), payload);
+    }
+
+    public:
+    VgmStream(MegaSynth &synth, HostLink &link) : synth(synth), link(link) {
+        reset();
+    }
+
+
+    void begin() {
+        wakeDue = synth.events().now();
+    }
+
+
+    // drop whatever is buffered or queued
+    void reset() {
+        head = used = 0;
+        buffered = 0;
+        sinceReport = 0;
+        playing = ending = waiting = false;
+        underruns = frames = 0;
+        synth.events().cancel(EVENT_SOURCE_STREAM);
+    }
+
+
+    // Takes the commands of a LINK_STREAM frame. False if they do not fit
+    // yet; the caller keeps the frame and tries again after service().
+    // Frames with a broken command are dropped.
+    bool push(const byte *payload, byte length) {
+        if (length == 0) {
+            reset();
+            report();
+            return true;
+        }
+        if (length > STREAM_BUFFER_SIZE - used)
+            return false;
+        unsigned long samples = 0;
+        byte i = 0;
+        while (i < length) {
+            const byte n = commandLength(payload[i]);
+            if (n == 0 || i + n > length)
+                return true;
+            if (payload[i] == STREAM_WAIT)
+                samples += word(payload[i + 2], payload[i + 1]);
+            else if (payload[i] == STREAM_END)
+                ending = true;
+            i += n;
+        }
+        for (i = 0; i < length; i++) {
+            buffer[head] = payload[i];
+            head = (head + 1) & (STREAM_BUFFER_SIZE - 1);
+        }
+        used += length;
+        buffered += samples;
+        frames++;
+        waiting = false;
+        report();
+        return true;
+    }
+
+
+    // queues whatever is due within the horizon, call it as often as
+    // possible
+    void service() {
+        EventQueue &events = synth.events();
+        const unsigned long now = events.now();
+        if (!playing) {
+            if (!prerolled())
+                return;
+            playing = true;
+            cursor = now;
+            remainder = 0;
+        }
+        waiting = true;
+        for (;;) {
+            const long ahead = cursor - now;
+            if (used == 0) {
+                if (ahead > 0) { // dry, but not late yet
+                    wakeAt(events, now, cursor);
+                    return;
+                }
+                playing = waiting = false;
+                underruns++;
+                report();
+                return;
+            }
+            if (ahead >= STREAM_HORIZON) {
+                wakeAt(events, now, cursor - STREAM_HORIZON);
+                return;
+            }
+            if (events.room() <= EVENT_RESERVE)
+                return; // the queue's earliest event wakes us
+            const byte command
+                = buffer[(head - used) & (STREAM_BUFFER_SIZE - 1)];
+            if (command == STREAM_END && ahead > 0) {
+                wakeAt(events, now, cursor);
+                return;
+            }
+            take();
+            byte reg, data;
+            word samples;
+            unsigned long units;
+            switch (command) {
+                case STREAM_YM0:
+                case STREAM_YM1:
+                reg = take();
+                data = take();
+                // the command is the part
+                events.post(cursor, EVENT_SOURCE_STREAM, command, reg, data);
+                break;
+
+                case STREAM_SN:
+                events.post(cursor, EVENT_SOURCE_STREAM, EVENT_SN, 0, take());
+                break;
+
+                case STREAM_WAIT:
+                reg = take(); // low byte first
+                samples = word(take(), reg);
+                buffered -= samples;
+                units = remainder + samples * SAMPLE_COST;
+                cursor += units / TICK_VALUE;
+                remainder = units % TICK_VALUE;
+                if (samples < STREAM_REPORT_INTERVAL - sinceReport) {
+                    sinceReport += samples;
+                } else {
+                    sinceReport = 0;
+                    report();
+                }
+                break;
+
+                default: // STREAM_END
+                playing = ending = waiting = false;
+                report();
+                return;
+            }
+        }
+    }
+
+
+    // True unless there is work for service(): time to wait out is left
+    // to the EventQueue's wake. Call it with interrupts masked, just
+    // before sleeping.
+    bool canSleep() const {
+        if (!playing)
+            return !prerolled();
+        return waiting;
+    }
+};
+
+#endif
@@ -3,28 +3,26 @@
 
 #include "Arduino.h"
 #include "YM2612_addr.h"
+#include "Board.h"
+#include "Trace.h"
 #include <util/delay.h>
 
 
-extern void dataBusWrite(byte data);
-
-/*PORTC corresponds to analog pins on the Uno */
-#define YM2612_IC_PORT PORTC
-#define YM2612_IC_DDR  DDRC 
-#define YM2612_IC_BIT  PORTC5
-#define YM2612_WR_PORT PORTC
-#define YM2612_WR_DDR  DDRC
-#define YM2612_WR_BIT  PORTC4
-#define YM2612_A0_PORT PORTC
-#define YM2612_A0_DDR  DDRC
-#define YM2612_A0_BIT  PORTC1
-#define YM2612_A1_PORT PORTC
-#define YM2612_A1_DDR  DDRC
-#define YM2612_A1_BIT  PORTC0
-// RD pin needs pullup. It isn't used.
-// Tie CS to WR
-
-class YM2612 {
+// bus timing: data setup before WR falls, WR low time, and the wait after
+// WR rises before the chip takes the next write
+#define YM2612_SETUP_US 1
+#define YM2612_PULSE_US 5
+#define YM2612_BUSY_US 5
+
+#ifndef YM2612_QUEUE_LENGTH
+#define YM2612_QUEUE_LENGTH BY_RAM(16, 32, 64) // deferred writes per chip
+#endif
+
+template<class B, class WR = typename B::YM_WR> class YM2612Chip;
+
+/* Register map, shadow state layout and fields: everything about the
+ * YM2612 that does not depend on which pins a chip is wired to */
+class YM2612Map {
     public:
     enum part_e {
         PART1,
@@ -65,11 +63,27 @@ class YM2612 {
     enum reg_e {
         REG_COUNT = 256
     };
+    enum timer_e { // bits of the timers' calls, see startTimers()
+        TIMER_A = bit(0),
+        TIMER_B = bit(1),
+        TIMER_A_MAX = 1024, // longest period, in TIMER_A_CLOCKS
+        TIMER_B_MAX = 256, // in TIMER_B_CLOCKS
+        TIMER_A_CLOCKS = 144, // master clocks a count, a sample
+        TIMER_B_CLOCKS = 16 * TIMER_A_CLOCKS
+    };
+    enum state_e { // offsets into State.flat[]
+        SLOT_STATE_LENGTH = SLOT_COUNT * SLOT_REG_LENGTH,
+        CHAN_STATE_LENGTH = SLOT_STATE_LENGTH + CHAN_REG_LENGTH,
+        PART2_STATE_BASE = YM2612_CHAN_PART_COUNT * CHAN_STATE_LENGTH,
+        GLOBAL_STATE_BASE = CHAN_COUNT * CHAN_STATE_LENGTH,
+        GLOBAL_STATE_LENGTH = 4,
+        STATE_LENGTH = GLOBAL_STATE_BASE + GLOBAL_STATE_LENGTH,
+        NO_STATE = 0xFF // register is not shadowed
+    };
     //stateful YM2612 registers
-    private:
+    protected:
     union State {
         struct Struc {
-            byte dummy;
             struct {
                 struct {
                     byte slotReg[SLOT_REG_LENGTH];
@@ -86,235 +100,499 @@ class YM2612 {
         byte flat[sizeof(Struc)];
         Struc struc;
     };
-    State state;
-    static const PROGMEM State regLookup;
-    static const PROGMEM byte stateLookup[PART_COUNT][REG_COUNT];
-    
-    inline byte toFlat(byte *p) { //assumes pointer is in state.flat
-        return static_cast<byte>(p - state.flat);
+    /* Mapping between State.flat[] and (part, register), derived from the
+     * YM2612_addr.h constants. Everything is constexpr, so a lookup with a
+     * known channel, slot and field folds to a constant. */
+    static constexpr part_e channelPart(byte channel) {
+        return channel < YM2612_CHAN_PART_COUNT ? PART1 : PART2;
+    }
+
+
+    static constexpr byte slotState(byte channel, byte slot, byte index) {
+        return channel * CHAN_STATE_LENGTH + slot * SLOT_REG_LENGTH + index;
     }
+
+
+    static constexpr byte channelState(byte channel, byte index) {
+        return channel * CHAN_STATE_LENGTH + SLOT_STATE_LENGTH + index;
+    }
+
+
+    static constexpr byte slotReg(byte channel, byte slot, byte index) {
+        return YM2612_SLOT_BASE_REG + index * YM2612_SLOT_REG_LENGTH
+            + slot * YM2612_CHAN_PART_LENGTH
+            + channel % YM2612_CHAN_PART_COUNT;
+    }
+
+
+    static constexpr byte channelReg(byte channel, byte index) {
+        return YM2612_CHAN_BASE_REG + index * YM2612_CHAN_REG_LENGTH
+            + channel % YM2612_CHAN_PART_COUNT;
+    }
+
+
+    static constexpr byte globalReg(byte index) {
+        return index == 0 ? YM2612_GLOBAL20_REG
+            : index == 1 ? YM2612_GLOBAL22_REG
+            : index == 2 ? YM2612_GLOBAL27_REG
+            : YM2612_GLOBAL2C_REG;
+    }
+
+
+    static constexpr part_e statePart(byte flat) {
+        return PART2_STATE_BASE <= flat && flat < GLOBAL_STATE_BASE
+            ? PART2 : PART1;
+    }
+
+
+    static constexpr byte stateReg(byte flat) {
+        return flat >= STATE_LENGTH ? 0
+            : flat >= GLOBAL_STATE_BASE ? globalReg(flat - GLOBAL_STATE_BASE)
+            : flat % CHAN_STATE_LENGTH >= SLOT_STATE_LENGTH
+            ? channelReg(flat / CHAN_STATE_LENGTH,
+                flat % CHAN_STATE_LENGTH - SLOT_STATE_LENGTH)
+            : slotReg(flat / CHAN_STATE_LENGTH,
+                flat % CHAN_STATE_LENGTH / SLOT_REG_LENGTH,
+                flat % CHAN_STATE_LENGTH % SLOT_REG_LENGTH);
+    }
+
+
+    static constexpr byte regState(part_e part, byte reg) {
+        // the register offset YM2612_CHAN_PART_COUNT is padding
+        return REG_RANGE(SLOT, reg)
+            && reg % YM2612_CHAN_PART_LENGTH != YM2612_CHAN_PART_COUNT
+            ? slotState(
+                part * YM2612_CHAN_PART_COUNT + reg % YM2612_CHAN_PART_LENGTH,
+                (reg - YM2612_SLOT_BASE_REG) / YM2612_CHAN_PART_LENGTH
+                    % SLOT_COUNT,
+                (reg - YM2612_SLOT_BASE_REG) / YM2612_SLOT_REG_LENGTH)
+            : REG_RANGE(CHAN, reg)
+            && reg % YM2612_CHAN_PART_LENGTH != YM2612_CHAN_PART_COUNT
+            ? channelState(
+                part * YM2612_CHAN_PART_COUNT + reg % YM2612_CHAN_PART_LENGTH,
+                (reg - YM2612_CHAN_BASE_REG) / YM2612_CHAN_REG_LENGTH)
+            : part != PART1 ? NO_STATE
+            : reg == YM2612_GLOBAL20_REG ? GLOBAL_STATE_BASE
+            : reg == YM2612_GLOBAL22_REG ? GLOBAL_STATE_BASE + 1
+            : reg == YM2612_GLOBAL27_REG ? GLOBAL_STATE_BASE + 2
+            : reg == YM2612_GLOBAL2C_REG ? GLOBAL_STATE_BASE + 3
+            : NO_STATE;
+    }
+
+
+    // self-checks, bisected to keep the constexpr recursion shallow
+    static constexpr bool isRegInverse(word first, word last) {
+        return last - first > 1
+            ? isRegInverse(first, (first + last) / 2)
+                && isRegInverse((first + last) / 2, last)
+            : regState(statePart(first), stateReg(first)) == first;
+    }
+
+
+    static constexpr bool isStateInverse(word first, word last) {
+        return last - first > 1
+            ? isStateInverse(first, (first + last) / 2)
+                && isStateInverse((first + last) / 2, last)
+            : regState(static_cast<part_e>(first / REG_COUNT),
+                first % REG_COUNT) == NO_STATE
+            || (stateReg(regState(static_cast<part_e>(first / REG_COUNT),
+                    first % REG_COUNT)) == first % REG_COUNT
+                && statePart(regState(static_cast<part_e>(first / REG_COUNT),
+                    first % REG_COUNT)) == first / REG_COUNT);
+    }
+
+
+    /* PROGMEM copies of the mapping for lookups with runtime arguments,
+     * expanded from an index pack (there is no <utility> in avr-libc) */
+    template<word... I> struct RegLookup {
+        static const PROGMEM byte table[sizeof...(I)];
+    };
+    template<word... I> struct StateLookup {
+        static const PROGMEM byte table[sizeof...(I)];
+    };
+    template<template<word...> class T, word N, word... I>
+    struct Generate : Generate<T, N - 1, N - 1, I...> { };
+    template<template<word...> class T, word... I>
+    struct Generate<T, 0, I...> : T<I...> { };
+    typedef Generate<RegLookup, STATE_LENGTH> regLookup;
+    typedef Generate<StateLookup, PART_COUNT * REG_COUNT> stateLookup;
+
     public:
     class Field {
-        friend class YM2612;
-        struct BasicField {
-            byte width;
-            byte shift;
-            BasicField(byte width, byte shift) 
-                : width(width), shift(shift) { };
-        };
-        
-        struct IndexField : BasicField {
-            byte index;
-            IndexField(byte width, byte shift, byte index)
-                : BasicField(width, shift), index(index) { };
+        template<class, class> friend class YM2612Chip;
+        enum kind_e {
+            SLOT_FIELD,
+            CHANNEL_FIELD,
+            GLOBAL_FIELD
         };
-        
-        struct SlotField : IndexField {
-            SlotField(byte width, byte shift, slotReg_e index)
-                : IndexField(width, shift, index) { };
-        };
-        
-        struct ChannelField : IndexField {
-            ChannelField(byte width, byte shift, channelReg_e index)
-                : IndexField(width, shift, index) { };
-        };
-        
-        struct GlobalField20 : BasicField {
-            GlobalField20 (byte width, byte shift)
-                : BasicField(width, shift) { };
-        };
-        
-        struct GlobalField22 : BasicField {
-            GlobalField22 (byte width, byte shift)
-            : BasicField(width, shift) { };
+        // all properties are compile time constants, so masks and shifts
+        // fold into the instructions instead of running on the AVR
+        template<kind_e K, byte W, byte S, byte I> struct BasicField {
+            static constexpr kind_e kind = K;
+            static constexpr byte index = I;
+            static constexpr byte shift = S;
+            static constexpr byte mask = ((1 << W) - 1) << S;
+            static constexpr byte pack(byte val) {
+                return (val << S) & mask;
+            }
         };
 
-        struct GlobalField27 : BasicField {
-            GlobalField27 (byte width, byte shift)
-            : BasicField(width, shift) { };
+        template<byte W, byte S, slotReg_e I>
+        struct SlotField : BasicField<SLOT_FIELD, W, S, I> { };
+
+        template<byte W, byte S, channelReg_e I>
+        struct ChannelField : BasicField<CHANNEL_FIELD, W, S, I> { };
+
+        // I is the global register: 0 for 0x20, 1 for 0x22, 2 for 0x27, ...
+        template<byte W, byte S, byte I>
+        struct GlobalField : BasicField<GLOBAL_FIELD, W, S, I> { };
+
+        // one value per field of a setter
+        template<class F> struct Value {
+            typedef byte type;
         };
 
-        struct GlobalField2C : BasicField {
-            GlobalField2C (byte width, byte shift)
-            : BasicField(width, shift) { };
+        // fields sharing one register, combined into a single write
+        template<class... F> struct Merge;
+
+        template<class F> struct Merge<F> : F { };
+
+        template<class F, class G, class... R> struct Merge<F, G, R...> {
+            typedef Merge<G, R...> Rest;
+            static_assert(F::kind == Rest::kind && F::index == Rest::index,
+                "merged fields must be in the same register");
+            static_assert(!(F::mask & Rest::mask),
+                "merged fields must not overlap");
+            static constexpr kind_e kind = F::kind;
+            static constexpr byte index = F::index;
+            static constexpr byte mask = F::mask | Rest::mask;
+            static constexpr byte
+            pack(byte val, typename Value<G>::type next,
+                typename Value<R>::type... rest) {
+                return F::pack(val) | Rest::pack(next, rest...);
+            }
         };
         
         public:
-        static const SlotField     DT;
-        static const SlotField     MULTI;
-        static const SlotField     TL;
-        static const SlotField     KS;
-        static const SlotField     AR;
-        static const SlotField     AM;
-        static const SlotField     DR;
-        static const SlotField     SR;
-        static const SlotField     SL;
-        static const SlotField     RR;
-        static const SlotField     SSEG;
-        static const ChannelField  FB;
-        static const ChannelField  ALGO;
-        static const ChannelField  LR;
-        static const ChannelField  AMS;
-        static const ChannelField  PMS;
-        static const GlobalField20 T20H;
-        static const GlobalField20 T20L;
-        static const GlobalField22 LFOEN;
-        static const GlobalField22 LFOFREQ;
-        static const GlobalField27 SPECIALEN;
-        static const GlobalField27 T27H;
-        static const GlobalField27 T27L;
-        static const GlobalField2C T2CH;
-        static const GlobalField2C T2CL;
+        typedef SlotField    <3, 4, SLOT_REG1> DT;
+        typedef SlotField    <4, 0, SLOT_REG1> MULTI;
+        typedef SlotField    <7, 0, SLOT_REG2> TL;
+        typedef SlotField    <2, 6, SLOT_REG3> KS;
+        typedef SlotField    <5, 0, SLOT_REG3> AR;
+        typedef SlotField    <1, 7, SLOT_REG4> AM;
+        typedef SlotField    <5, 0, SLOT_REG4> DR;
+        typedef SlotField    <5, 0, SLOT_REG5> SR;
+        typedef SlotField    <4, 4, SLOT_REG6> SL;
+        typedef SlotField    <4, 0, SLOT_REG6> RR;
+        typedef SlotField    <4, 0, SLOT_REG7> SSEG;
+        typedef ChannelField <3, 3, CHAN_REG1> FB;
+        typedef ChannelField <3, 0, CHAN_REG1> ALGO;
+        typedef ChannelField <2, 6, CHAN_REG2> LR;
+        typedef ChannelField <2, 4, CHAN_REG2> AMS;
+        typedef ChannelField <3, 0, CHAN_REG2> PMS;
+        typedef GlobalField  <4, 4, 0>         T20H;
+        typedef GlobalField  <4, 0, 0>         T20L;
+        typedef GlobalField  <1, 3, 1>         LFOEN;
+        typedef GlobalField  <3, 0, 1>         LFOFREQ;
+        typedef GlobalField  <1, 6, 2>         SPECIALEN;
+        typedef GlobalField  <1, 7, 2>         CSMEN;
+        typedef GlobalField  <1, 6, 2>         T27H;
+        typedef GlobalField  <6, 0, 2>         T27L;
+        typedef GlobalField  <4, 4, 3>         T2CH;
+        typedef GlobalField  <4, 0, 3>         T2CL;
     };
-    
-     
-    inline void
-    updateField(part_e part, byte reg, byte width, byte shift, byte val) {
-        const byte mask = bit(width) - 1;
-        setReg(
-            part, reg, 
-            (getReg(part, reg) & ~(mask << shift)) | ((val & mask) << shift));
+
+
+    // slots that are carriers in an algorithm, a bit(slot_e) per slot
+    static constexpr byte carriers(byte algo) {
+        return algo < 4 ? bit(SLOT4)
+            : algo == 4 ? bit(SLOT2) | bit(SLOT4)
+            : algo < 7 ? bit(SLOT2) | bit(SLOT3) | bit(SLOT4)
+            : bit(SLOT1) | bit(SLOT2) | bit(SLOT3) | bit(SLOT4);
     }
-    
 
-    inline void
-    setSlot(channel_e channel, slot_e slot, Field::SlotField field, byte val) {
-        byte flat =
-            toFlat(&state.struc.channelMem[channel].slotMem[slot]
-                .slotReg[field.index]);
-        updateField(
-            whichPart(flat), whichReg(flat), field.width, field.shift, val);
+
+    // bit of an operator in the 0x28 key on field,
+    // which is in S1, S2, S3, S4 order unlike slot_e
+    static constexpr byte keyBit(slot_e slot) {
+        return slot == SLOT1 ? bit(0)
+            : slot == SLOT2 ? bit(1)
+            : slot == SLOT3 ? bit(2)
+            : bit(3);
+    }
+
+    protected:
+    static inline byte whichState(part_e part, byte reg) {
+        return pgm_read_byte(&stateLookup::table[part * REG_COUNT + reg]);
+    }
+
+
+    static inline part_e whichPart(byte index) {
+        return statePart(index);
+    }
+
+
+    static inline byte whichReg(byte index) {
+        return pgm_read_byte(&regLookup::table[index]);
     }
+};
+
 
+/* One YM2612 on the data, A0, A1 and IC lines of board B (see Board.h),
+ * selected by its own WR pin (a type made with AVR_PIN), the board's YM_WR
+ * unless given. Several chips are several instantiations, e.g.
+ * YM2612Chip<TrahageanBoard, TrahageanBoard::YM_WR2> for a second one. */
+template<class B, class WR> class YM2612Chip : public YM2612Map {
+    State state;
+    byte specialKeys; // channel 3 operators keyed on, in 0x28 bit order
+    // deferred writes, see defer()
+    struct Write {
+        byte part;
+        byte reg;
+        byte data;
+    };
+    Write queue[YM2612_QUEUE_LENGTH];
+    byte queueHead; // oldest write
+    byte queued;
+    bool deferring;
+    // TL is the patch's level plus, on carriers, the mixer's attenuation
+    byte patchLevel[CHAN_COUNT][SLOT_COUNT];
+    byte attenuation[CHAN_COUNT][SLOT_COUNT];
 
+    public:
     inline void
-    setChannel(channel_e channel, Field::ChannelField field, byte val) {
-        byte flat =
-            toFlat(&state.struc.channelMem[channel].channelReg[field.index]);
+    updateField(byte flat, part_e part, byte reg, byte mask, byte bits) {
+        state.flat[flat] = (state.flat[flat] & ~mask) | bits;
+        setRegDirect(part, reg, state.flat[flat]);
+    }
+    
+
+    // set one or more fields of a slot register with a single write, e.g.
+    // setSlot<Field::DT, Field::MULTI>(CHAN1, SLOT1, dt, multi);
+    template<class... F> inline void
+    setSlot(channel_e channel, slot_e slot,
+        typename Field::template Value<F>::type... val) {
+        typedef Field::Merge<F...> M;
+        static_assert(M::kind == Field::SLOT_FIELD, "not a slot field");
         updateField(
-            whichPart(flat), whichReg(flat), field.width, field.shift, val);
+            slotState(channel, slot, M::index), channelPart(channel),
+            slotReg(channel, slot, M::index), M::mask, M::pack(val...));
     }
 
 
-    inline void setGlobal20(Field::GlobalField20 field, byte val) {
-        byte flat = toFlat(&state.struc.globalMem.reg20);
-        updateField(
-            whichPart(flat), whichReg(flat), field.width, field.shift, val);
+    template<slot_e slot, class... F> inline void
+    setSlot(channel_e channel, typename Field::template Value<F>::type... val) {
+        setSlot<F...>(channel, slot, val...);
     }
 
 
-    inline void setGlobal22(Field::GlobalField22 field, byte val) {
-        byte flat = toFlat(&state.struc.globalMem.reg22);
+    template<class... F> inline void
+    setChannel(channel_e channel,
+        typename Field::template Value<F>::type... val) {
+        typedef Field::Merge<F...> M;
+        static_assert(M::kind == Field::CHANNEL_FIELD, "not a channel field");
         updateField(
-            whichPart(flat), whichReg(flat), field.width, field.shift, val);
+            channelState(channel, M::index), channelPart(channel),
+            channelReg(channel, M::index), M::mask, M::pack(val...));
     }
 
 
-    inline void setGlobal27(Field::GlobalField27 field, byte val) {
-        byte flat = toFlat(&state.struc.globalMem.reg27);
-        updateField(
-            whichPart(flat), whichReg(flat), field.width, field.shift, val);
+    // a channel field as the shadow state holds it
+    template<class F> inline byte getChannel(channel_e channel) const {
+        static_assert(F::kind == Field::CHANNEL_FIELD, "not a channel field");
+        return (state.flat[channelState(channel, F::index)] & F::mask)
+            >> F::shift;
     }
 
 
-    inline void setGlobal2C(Field::GlobalField2C field, byte val) {
-        byte flat = toFlat(&state.struc.globalMem.reg2C);
+    template<class... F> inline void
+    setGlobal(typename Field::template Value<F>::type... val) {
+        typedef Field::Merge<F...> M;
+        static_assert(M::kind == Field::GLOBAL_FIELD, "not a global field");
         updateField(
-            whichPart(flat), whichReg(flat), field.width, field.shift, val);
+            GLOBAL_STATE_BASE + M::index, PART1, globalReg(M::index),
+            M::mask, M::pack(val...));
     }
 
 
     private:
-    static inline void write(byte data) {
-        dataBusWrite(data);
-        _delay_us(1);
-        YM2612_WR_PORT &= ~bit(YM2612_WR_BIT);
-        _delay_us(5);
-        YM2612_WR_PORT |= bit(YM2612_WR_BIT);
-        _delay_us(5);
+    // one WR pulse with data on the bus, without the wait after it
+    static inline void strobe(byte data) {
+        B::dataBusWrite(data);
+        _delay_us(YM2612_SETUP_US);
+        WR::low();
+        _delay_us(YM2612_PULSE_US);
+        WR::high();
     }
 
 
-    static inline byte whichState(part_e part, byte reg) {
-        return pgm_read_byte(&stateLookup[part][reg]);
-    }
-    
-    
-    static inline part_e whichPart(byte index) {
-        // range from spreadsheet
-        return 91 <= index && index <= 180 ? YM2612::PART2 : YM2612::PART1;
+    static inline void write(byte data) {
+        strobe(data);
+        _delay_us(YM2612_BUSY_US);
     }
 
 
-    inline byte whichReg(byte index) {
-        return pgm_read_byte(&regLookup.flat[index]);
+    static inline void selectPart(byte part) {
+        if (part == PART1) {
+            B::YM_A1::low();
+        }
+        else {
+            B::YM_A1::high();
+        }
     }
 
 
     void setRegDirect(part_e part, byte reg, byte data) {
-        noInterrupts();
-        if (part == YM2612::PART1) {
-            YM2612_A1_PORT &= ~bit(YM2612_A1_BIT); // A1 LOW
-        }
-        else {
-            YM2612_A1_PORT |= bit(YM2612_A1_BIT); // A1 HIGH
+        if (deferring) {
+            if (queued == YM2612_QUEUE_LENGTH) {
+                flush(); // on this chip alone, then carry on deferring
+                deferring = true;
+            }
+            Write &w = queue[(queueHead + queued++) % YM2612_QUEUE_LENGTH];
+            w.part = part;
+            w.reg = reg;
+            w.data = data;
+            return;
         }
-        YM2612_A0_PORT &= ~bit(YM2612_A0_BIT); // A0 LOW (select register)
+        // No critical section: A0, A1 and WR change with single sbi/cbi
+        // instructions, and an interrupt between the steps only stretches
+        // a pulse or a wait, which the chip does not mind.
+        selectPart(part);
+        B::YM_A0::low(); // select register
         write(reg);
-        YM2612_A0_PORT |= bit(YM2612_A0_BIT);  // A0 HIGH (write register)
+        B::YM_A0::high(); // write register
         write(data);
-        interrupts();
+        TRACE(TRACE_YM_WRITE, reg);
     }
 
 
     void setReg(part_e part, byte reg, byte data) {
-        state.flat[whichState(part, reg)] = data;
+        byte flat = whichState(part, reg);
+        if (flat != NO_STATE)
+            state.flat[flat] = data;
         setRegDirect(part, reg, data);
     }
 
 
     byte getReg(part_e part, byte reg) {
-        return state.flat[pgm_read_byte(&stateLookup[part][reg])];
+        byte flat = whichState(part, reg);
+        return flat != NO_STATE ? state.flat[flat] : 0;
     }
-    
-    
-//TODO set up masks for scaling carrier slot levels on MIDI velocity
-/* algorithm : carrier slots
-    0-3 : 4
-    4   : 2,4
-    5,6 : 2,3,4
-    7   : 1,2,3,4
-*/
-    
+
+
+    // write the TLs of a channel that differ from what they should be
+    void updateLevels(channel_e channel) {
+        const byte mask = Field::TL::mask;
+        const byte on = carriers(Field::ALGO::mask
+            & state.struc.channelMem[channel].channelReg[CHAN_REG1]);
+        for (byte s = SLOT1; s < SLOT_COUNT; s++) {
+            word level = patchLevel[channel][s];
+            if (on & bit(s))
+                level += attenuation[channel][s];
+            if (level > mask)
+                level = mask;
+            // TL is alone in its register, the state is the chip's value
+            if (level != (mask
+                    & state.struc.channelMem[channel].slotMem[s].slotReg[
+                        Field::TL::index]))
+                setSlot<Field::TL>(channel, static_cast<slot_e>(s), level);
+        }
+    }
+
     public:
-    void begin() {
-        /* Pins setup */
-        YM2612_IC_DDR |= bit(YM2612_IC_BIT);
-        YM2612_WR_DDR |= bit(YM2612_WR_BIT);
-        YM2612_A0_DDR |= bit(YM2612_A0_BIT);
-        YM2612_A1_DDR |= bit(YM2612_A1_BIT);
-        /* IC, WR and RD HIGH by default */
-        YM2612_IC_PORT |= bit(YM2612_IC_BIT);
-        YM2612_WR_PORT |= bit(YM2612_WR_BIT);
+    YM2612Chip() : queueHead(0), queued(0), deferring(false) { }
+
+
+    /* Pins shared by every chip, and a reset pulse on IC, which resets
+     * them all: call it once before the chips' begin() */
+    static void resetChips() {
+        B::YM_IC::output();
+        B::YM_A0::output();
+        B::YM_A1::output();
+        /* IC HIGH by default */
+        B::YM_IC::high();
         /* A0 and A1 LOW by default */
-        YM2612_A0_PORT &= bit(YM2612_A0_BIT);
-        YM2612_A1_PORT &= bit(YM2612_A1_BIT);
-        /* Reset YM2612 */
-        YM2612_IC_PORT &= ~bit(YM2612_IC_BIT);
+        B::YM_A0::low();
+        B::YM_A1::low();
+        B::YM_IC::low();
         _delay_ms(10);
-        YM2612_IC_PORT |= bit(YM2612_IC_BIT);
+        B::YM_IC::high();
         _delay_ms(10);
+    }
+
+
+    /* Deferred writes: from defer() on, register writes only update the
+     * shadow state and queue up. YM2612Scheduler::flush() then issues the
+     * queues of several chips interleaved, so each chip's wait after a
+     * write is spent strobing the others. */
+    void defer() {
+        deferring = true;
+    }
+
+
+    bool pending() const {
+        return queued != 0;
+    }
+
+
+    // address strobe of the oldest deferred write, false if there is none
+    bool strobeAddress() {
+        if (!queued)
+            return false;
+        const Write &w = queue[queueHead];
+        selectPart(w.part);
+        B::YM_A0::low();
+        strobe(w.reg);
+        return true;
+    }
+
+
+    // data strobe of the write strobeAddress() started
+    void strobeData() {
+        const Write &w = queue[queueHead];
+        selectPart(w.part);
+        B::YM_A0::high();
+        strobe(w.data);
+        TRACE(TRACE_YM_WRITE, w.reg);
+        queueHead = (queueHead + 1) % YM2612_QUEUE_LENGTH;
+        queued--;
+    }
+
+
+    // issue this chip's deferred writes on their own and stop deferring
+    void flush() {
+        deferring = false;
+        while (queued) {
+            const Write &w = queue[queueHead];
+            setRegDirect(static_cast<part_e>(w.part), w.reg, w.data);
+            queueHead = (queueHead + 1) % YM2612_QUEUE_LENGTH;
+            queued--;
+        }
+    }
+
+
+    void begin() {
+        /* Compile time checks of the register mapping */
+        static_assert(sizeof(State) == STATE_LENGTH,
+            "State layout does not match STATE_LENGTH");
+        static_assert(isRegInverse(0, STATE_LENGTH),
+            "register lookup is not the inverse of the state lookup");
+        static_assert(isStateInverse(0, PART_COUNT * REG_COUNT),
+            "state lookup is not the inverse of the register lookup");
+        /* WR (and RD) HIGH by default */
+        WR::output();
+        WR::high();
         /* YM2612 Test code */
-        setGlobal22(Field::LFOEN, 0);
+        setGlobal<Field::LFOEN>(0);
         /* make sure notes are off */
+        specialKeys = 0;
         setOperators(0, 0);
         setOperators(1, 0);
         setOperators(2, 0);
         setOperators(3, 0);
         setOperators(4, 0);
         setOperators(5, 0);
-        setGlobal27(Field::T27H, 0);
-        setGlobal27(Field::T27L, 0);
+        setGlobal<Field::T27H, Field::T27L>(0, 0);
         setReg(PART1, 0x2B, 0x00); // DAC off
         /* init voices */
         defaultVoice(CHAN1);
@@ -332,213 +610,392 @@ class YM2612 {
         setReg(PART1, 0x94, 0x00); // Proprietary
         setReg(PART1, 0x98, 0x00); // Proprietary
         setReg(PART1, 0x9C, 0x00); // Proprietary
+        for (byte c = CHAN1; c < CHAN_COUNT; c++) {
+            for (byte s = SLOT1; s < SLOT_COUNT; s++) {
+                patchLevel[c][s] = Field::TL::mask
+                    & state.struc.channelMem[c].slotMem[s].slotReg[
+                        Field::TL::index];
+                attenuation[c][s] = 0;
+            }
+        }
     }
 
-    
+
     void setOperators(byte channel, byte bitfield) {
-        if (bitfield)
-            digitalWrite(LED_BUILTIN, HIGH); //debug
-        else
-            digitalWrite(LED_BUILTIN, LOW); //debug
-	    setReg(PART1, 0x28, ((bitfield & B1111) << 4) | (channel < 3 ? channel : channel % 3 + 4)); //skip over 011
+        if (channel == CHAN3) // keep special mode voices in sync
+            specialKeys = bitfield & B1111;
+        setReg(PART1, YM2612_KEY_BASE_REG, ((bitfield & B1111) << YM2612_KEY_SHIFT) | (channel < 3 ? channel : channel % 3 + 4)); //skip over 011
     }
 
 
-    void frequency72(byte channel, int8_t block, word freq) {
-	    byte lsbReg = channel <= 5 ? 0xA0 : 0xAC; //if higher than 5 then use the special mode registers
-        if (10 <= channel && channel <= 12) // if channel is special mode
-            channel -= 10; // set channel to 0,1,2
-	    byte chanOffset = channel % 3; //MIDI channels are in YM sequence, and 0,1,2 overlap 3,4,5
-	    byte part = (3 <= channel && channel <= 5); // part is 0 unless channel is 3,4,5
+    /* Channel 3 special mode: each operator of channel 3 has its own
+     * frequency, so with algorithm 7 they are four independent voices.
+     * Keys are a bitfield of keyBit() values, several operators can be
+     * keyed on or off with a single 0x28 write. */
+    void specialKeyOn(byte keys) {
+        specialKeys |= keys;
+        setReg(PART1, YM2612_KEY_BASE_REG, (specialKeys << YM2612_KEY_SHIFT) | CHAN3);
+    }
+
+
+    void specialKeyOff(byte keys) {
+        specialKeys &= ~keys;
+        setReg(PART1, YM2612_KEY_BASE_REG, (specialKeys << YM2612_KEY_SHIFT) | CHAN3);
+    }
+
+
+    // F-number fnum in block, see Tuning.h; blocks outside 0-7 are
+    // folded into the F-number as far as it goes
+    void frequency(byte channel, int8_t block, word fnum) {
+        if (channel >= CHAN_COUNT) // sanity check
+            return;
+        setFrequency(channelPart(channel),
+            YM2612_FREQ_BASE_REG + channel % YM2612_CHAN_PART_COUNT,
+            toFrequency(block, fnum));
+    }
+
+
+    void specialFrequency(slot_e slot, int8_t block, word fnum) {
+        setFrequency(PART1, specialReg(slot), toFrequency(block, fnum));
+    }
+
+
+    // raw register write for register streams, keeps the shadow state
+    void writeReg(part_e part, byte reg, byte data) {
+        setReg(part, reg, data);
+    }
+
+
+    /* Timers: Timer A overflows every count x TIMER_A_CLOCKS master
+     * clocks (1-TIMER_A_MAX, 18us-18.4ms at 8MHz), Timer B every count x
+     * TIMER_B_CLOCKS (1-TIMER_B_MAX, 288us-73.7ms). A running timer takes
+     * a new period at its next overflow, so the period after the one
+     * running can be set at any time in it. The overflow of a timer
+     * started with its IRQ sets its flag, which holds IRQ low until
+     * ackTimers(). The boards never read the status register, so IRQ is
+     * how the AVR hears of it (YmTimer.h). The State keeps the load and
+     * enable bits of 0x27 with the mode bits; the reset bits are strobes
+     * and stay out of it. */
+    void setTimerA(word count) {
+        const word n = TIMER_A_MAX - count;
+        setRegDirect(PART1, YM2612_TIMERA_MSB_REG,
+            n >> YM2612_TIMERA_LSB_WIDTH);
+        setRegDirect(PART1, YM2612_TIMERA_LSB_REG,
+            n & (bit(YM2612_TIMERA_LSB_WIDTH) - 1));
+    }
+
+
+    void setTimerB(word count) {
+        setRegDirect(PART1, YM2612_TIMERB_REG, TIMER_B_MAX - count);
+    }
+
+
+    // timers (timer_e bits) counting a full period from now, raising IRQ
+    // on overflow for those also in irqs
+    void startTimers(byte timers, byte irqs) {
+        byte &reg = state.struc.globalMem.reg27;
+        if (reg & timers << YM2612_TIMER_LOAD_SHIFT) // reload as load rises
+            setGlobal<Field::T27L>(Field::T27L::mask & reg
+                & ~(timers << YM2612_TIMER_LOAD_SHIFT));
+        reg = (reg & ~(timers << YM2612_TIMER_ENABLE_SHIFT))
+            | timers << YM2612_TIMER_LOAD_SHIFT
+            | (irqs & timers) << YM2612_TIMER_ENABLE_SHIFT;
+        ackTimers(timers);
+    }
+
+
+    void stopTimers(byte timers) {
+        state.struc.globalMem.reg27 &= ~(timers << YM2612_TIMER_LOAD_SHIFT
+            | timers << YM2612_TIMER_ENABLE_SHIFT);
+        ackTimers(timers);
+    }
+
+
+    // clear the timers' flags, letting go of IRQ once none is left set
+    void ackTimers(byte timers) {
+        setRegDirect(PART1, YM2612_GLOBAL27_REG, state.struc.globalMem.reg27
+            | timers << YM2612_TIMER_RESET_SHIFT);
+    }
+
+
+    // Timer A's load, enable and reset bits of 0x27 as given, e.g. by a
+    // CC; Timer B's stay as the calls above left them
+    void setTimerABits(byte bits) {
+        const byte kept = TIMER_A << YM2612_TIMER_LOAD_SHIFT
+            | TIMER_A << YM2612_TIMER_ENABLE_SHIFT;
+        byte &reg = state.struc.globalMem.reg27;
+        reg = (reg & ~kept) | (bits & kept);
+        setRegDirect(PART1, YM2612_GLOBAL27_REG,
+            reg | (bits & TIMER_A << YM2612_TIMER_RESET_SHIFT));
+    }
+
+
+    private:
+    // F-number LSB register of a channel 3 operator in special mode
+    static constexpr byte specialReg(slot_e slot) {
+        return slot == SLOT1 ? YM2612_SPECIAL_FREQ_BASE_REG + 1
+            : slot == SLOT2 ? YM2612_SPECIAL_FREQ_BASE_REG + 2
+            : slot == SLOT3 ? YM2612_SPECIAL_FREQ_BASE_REG
+            : YM2612_FREQ_BASE_REG + CHAN3;
+    }
+
+
+    void setFrequency(part_e part, byte lsbReg, word freq) {
+        //pitch MSB first, it is latched until the LSB is written
+        setReg(part, lsbReg + YM2612_FREQ_MSB_OFFSET, freq >> 8);
+        //pitch LSB
+        setReg(part, lsbReg, freq & 0xFF);
+    }
+
+
+    // the block and F-number register pair
+    static word toFrequency(int8_t block, word fnum) {
         if (block < 0) { // for octaves lower than block 0
-            freq >>= -block; //divide by 2 the number of octaves below 0
+            fnum >>= -block; //divide by 2 the number of octaves below 0
             block = 0; // minimum allowed YM block
         }
-        else if (block > 7) {
-            word f = (((uint32_t)(freq) << 9) / 15625);
-            byte b; //octave where 10th bit overflows
-            // find the octave above 7 which causes f's bit 10 to overflow
-            for (b = 0; !(f & bit(10)); b++) {
-                f <<= 1; // multiply by 2 (octave)
-            }
-            byte t = block - 7; // ideal number of octaves above 7
-            // if the overflow octave (b) is smaller than ideal (t), use it instead
-            freq <<= (t < b ? t : b); // multiply by 2 the number of octaves
+        // for octaves above 7, multiply by 2 while it fits in 11 bits
+        for (; block > 7 && !(fnum & bit(10)); block--)
+            fnum <<= 1;
+        if (block > 7)
             block = 7; // maximum allowed YM block
+        return (block << 11) | fnum;
+    }
+
+
+    public:
+    /* Levels: the TL of a slot is the patch's level, plus the attenuation
+     * (in TL steps, see Mixer.h) when the algorithm makes the slot a
+     * carrier. Only TLs whose value changes are written. */
+    void setLevel(channel_e channel, slot_e slot, byte level) {
+        patchLevel[channel][slot] = level & Field::TL::mask;
+        updateLevels(channel);
+    }
+
+
+    void setAlgorithm(channel_e channel, byte algo) {
+        setChannel<Field::ALGO>(channel, algo);
+        updateLevels(channel);
+    }
+
+
+    // every slot of the channel, carriers take it
+    void setAttenuation(byte channel, byte atten) {
+        if (channel >= CHAN_COUNT) // sanity check
+            return;
+        for (byte s = SLOT1; s < SLOT_COUNT; s++) {
+            attenuation[channel][s] = atten;
         }
-        // insert block field, adjust for factor of 72 and YM scaling:
-        freq = (block << 11) | (((uint32_t)(freq) << 9) / 15625);
-        //pitch MSB first, MSB register is LSB+4
-	    setReg(static_cast<part_e>(part), lsbReg + chanOffset + 4, freq >> 8);
-        //pitch LSB
-	    setReg(static_cast<part_e>(part), lsbReg + chanOffset, freq & 0xFF);
-    }
-
-
-    void level(byte channel, byte val)
-    {
-        if (channel < 6) {
-            byte chanOffset = channel % 3; //channels are in sequence, and 012 overlap 345
-	        byte part = (3 <= channel && channel <= 5); // part is 0 unless channel is 3 4 5
-            setReg(static_cast<part_e>(part), 0x40 + chanOffset, val); // Operator 1
-/* TODO FIXME
-            if (slotOperators[channel] & YM2612_OP1)
-	            setreg(0x40 + chanOffset, val, part); // Operator 1
-            if (slotOperators[channel] & YM2612_OP2)
-	            setreg(0x44 + chanOffset, val, part); // Operator 2
-            if (slotOperators[channel] & YM2612_OP3)
-	            setreg(0x48 + chanOffset, val, part); // Operator 3
-            if (slotOperators[channel] & YM2612_OP4)
-	            setreg(0x4C + chanOffset, val, part); // Operator 4
-*/
-        }
+        updateLevels(static_cast<channel_e>(channel));
     }
 
+
+    // one slot, for the channel 3 special mode voices
+    void setAttenuation(channel_e channel, slot_e slot, byte atten) {
+        attenuation[channel][slot] = atten;
+        updateLevels(channel);
+    }
+
+
     void defaultVoice(channel_e channel) {
-        setSlot(channel, SLOT1, Field::DT,     7);
-        setSlot(channel, SLOT1, Field::MULTI,  1);
-        setSlot(channel, SLOT1, Field::TL,    35);
-        setSlot(channel, SLOT1, Field::KS,     1);
-        setSlot(channel, SLOT1, Field::AR,    31);
-        setSlot(channel, SLOT1, Field::AM,     0);
-        setSlot(channel, SLOT1, Field::DR,     5);
-        setSlot(channel, SLOT1, Field::SR,     2);
-        setSlot(channel, SLOT1, Field::SL,     1);
-        setSlot(channel, SLOT1, Field::RR,     1);
-
-        setSlot(channel, SLOT2, Field::DT,     3);
-        setSlot(channel, SLOT2, Field::MULTI,  3);
-        setSlot(channel, SLOT2, Field::TL,    38);
-        setSlot(channel, SLOT2, Field::KS,     1);
-        setSlot(channel, SLOT2, Field::AR,    31);
-        setSlot(channel, SLOT2, Field::AM,     0);
-        setSlot(channel, SLOT2, Field::DR,     5);
-        setSlot(channel, SLOT2, Field::SR,     2);
-        setSlot(channel, SLOT2, Field::SL,     1);
-        setSlot(channel, SLOT2, Field::RR,     1);
-
-        setSlot(channel, SLOT3, Field::DT,     0);
-        setSlot(channel, SLOT3, Field::MULTI, 13);
-        setSlot(channel, SLOT3, Field::TL,    45);
-        setSlot(channel, SLOT3, Field::KS,     2);
-        setSlot(channel, SLOT3, Field::AR,    25);
-        setSlot(channel, SLOT3, Field::AM,     0);
-        setSlot(channel, SLOT3, Field::DR,     5);
-        setSlot(channel, SLOT3, Field::SR,     2);
-        setSlot(channel, SLOT3, Field::SL,     1);
-        setSlot(channel, SLOT3, Field::RR,     1);
-
-        setSlot(channel, SLOT4, Field::DT,     0);
-        setSlot(channel, SLOT4, Field::MULTI,  1);
-        setSlot(channel, SLOT4, Field::TL,     0);
-        setSlot(channel, SLOT4, Field::KS,     2);
-        setSlot(channel, SLOT4, Field::AR,    20);
-        setSlot(channel, SLOT4, Field::AM,     0);
-        setSlot(channel, SLOT4, Field::DR,     7);
-        setSlot(channel, SLOT4, Field::SR,     2);
-        setSlot(channel, SLOT4, Field::SL,    10);
-        setSlot(channel, SLOT4, Field::RR,     6);
-
-        setChannel(channel, Field::FB,          1);
-        setChannel(channel, Field::ALGO,        0);
-        setChannel(channel, Field::LR,        B11);
-        setChannel(channel, Field::AMS,         0);
-        setChannel(channel, Field::PMS,         0);
+        setSlot<SLOT1, Field::DT, Field::MULTI>(channel,  7,  1);
+        setSlot<SLOT1, Field::TL>              (channel, 35);
+        setSlot<SLOT1, Field::KS, Field::AR>   (channel,  1, 31);
+        setSlot<SLOT1, Field::AM, Field::DR>   (channel,  0,  5);
+        setSlot<SLOT1, Field::SR>              (channel,  2);
+        setSlot<SLOT1, Field::SL, Field::RR>   (channel,  1,  1);
+
+        setSlot<SLOT2, Field::DT, Field::MULTI>(channel,  3,  3);
+        setSlot<SLOT2, Field::TL>              (channel, 38);
+        setSlot<SLOT2, Field::KS, Field::AR>   (channel,  1, 31);
+        setSlot<SLOT2, Field::AM, Field::DR>   (channel,  0,  5);
+        setSlot<SLOT2, Field::SR>              (channel,  2);
+        setSlot<SLOT2, Field::SL, Field::RR>   (channel,  1,  1);
+
+        setSlot<SLOT3, Field::DT, Field::MULTI>(channel,  0, 13);
+        setSlot<SLOT3, Field::TL>              (channel, 45);
+        setSlot<SLOT3, Field::KS, Field::AR>   (channel,  2, 25);
+        setSlot<SLOT3, Field::AM, Field::DR>   (channel,  0,  5);
+        setSlot<SLOT3, Field::SR>              (channel,  2);
+        setSlot<SLOT3, Field::SL, Field::RR>   (channel,  1,  1);
+
+        setSlot<SLOT4, Field::DT, Field::MULTI>(channel,  0,  1);
+        setSlot<SLOT4, Field::TL>              (channel,  0);
+        setSlot<SLOT4, Field::KS, Field::AR>   (channel,  2, 20);
+        setSlot<SLOT4, Field::AM, Field::DR>   (channel,  0,  7);
+        setSlot<SLOT4, Field::SR>              (channel,  2);
+        setSlot<SLOT4, Field::SL, Field::RR>   (channel, 10,  6);
+
+        setChannel<Field::FB, Field::ALGO>(channel, 1, 0);
+        setChannel<Field::LR, Field::AMS, Field::PMS>(channel, B11, 0, 0);
     }
 
 
-    void channelRegCopy(channel_e dest, channel_e src) {
+    /* Bulk patches (Patch.h): a decoder fills a channel's shadow
+     * registers in place through slice(), State order from SLOT1's first,
+     * then load() writes every one of them, taking the TLs for the
+     * patch's levels and adding the carriers' attenuation again. */
+    byte *slice(channel_e channel) {
+        return &state.flat[slotState(channel, SLOT1, SLOT_REG1)];
+    }
+
+
+    // all of State, for a host to compare its copy with (StateSync.h)
+    const byte *shadow() const {
+        return state.flat;
+    }
+
+
+    // the TL of a slot before the mixer's attenuation
+    byte level(channel_e channel, slot_e slot) const {
+        return patchLevel[channel][slot];
+    }
+
+
+    // load() in two steps, so several chips can interleave the writes in
+    // batches that fit their queues
+    void loadLevels(channel_e channel) {
+        byte *tl = slice(channel) + Field::TL::index;
+        const byte on = carriers(Field::ALGO::mask
+            & state.struc.channelMem[channel].channelReg[CHAN_REG1]);
+        for (byte s = SLOT1; s < SLOT_COUNT; s++, tl += SLOT_REG_LENGTH) {
+            patchLevel[channel][s] = *tl & Field::TL::mask;
+            word level = patchLevel[channel][s];
+            if (on & bit(s))
+                level += attenuation[channel][s];
+            *tl = level > Field::TL::mask ? Field::TL::mask : level;
+        }
+    }
+
+
+    // slice() bytes from to end
+    void loadRegs(channel_e channel, byte from, byte end) {
+        const byte first = slotState(channel, SLOT1, SLOT_REG1);
+        for (byte i = first + from; i < first + end; i++) {
+            setRegDirect(whichPart(i), whichReg(i), state.flat[i]);
+        }
+    }
+
+
+    void load(channel_e channel) {
+        loadLevels(channel);
+        loadRegs(channel, 0, CHAN_STATE_LENGTH);
+    }
+
+
+    // the channel's patch in slice() order, its TLs the patch's levels
+    void readPatch(channel_e channel, byte *patch) const {
+        memcpy(patch, &state.flat[slotState(channel, SLOT1, SLOT_REG1)],
+            CHAN_STATE_LENGTH);
         for (byte s = SLOT1; s < SLOT_COUNT; s++) {
-            for (byte r = SLOT_REG1; r < SLOT_REG_LENGTH; r++) {
-                byte *v =
-                    &state.struc.channelMem[dest].slotMem[s].slotReg[r];
-                byte i = toFlat(v);
-                setRegDirect(whichPart(i), whichReg(i), *v);
+            patch[s * SLOT_REG_LENGTH + Field::TL::index]
+                = patchLevel[channel][s];
+        }
+    }
+
+
+    // a patch as readPatch() has it, writing only the registers it changes
+    void writePatch(channel_e channel, const byte *patch) {
+        const byte first = slotState(channel, SLOT1, SLOT_REG1);
+        const byte on = carriers(Field::ALGO::mask
+            & patch[SLOT_STATE_LENGTH + CHAN_REG1]);
+        for (byte i = 0; i < CHAN_STATE_LENGTH; i++) {
+            byte data = patch[i];
+            if (i < SLOT_STATE_LENGTH
+                    && i % SLOT_REG_LENGTH == Field::TL::index) {
+                const byte s = i / SLOT_REG_LENGTH;
+                patchLevel[channel][s] = data & Field::TL::mask;
+                word level = patchLevel[channel][s];
+                if (on & bit(s))
+                    level += attenuation[channel][s];
+                data = level > Field::TL::mask ? Field::TL::mask : level;
             }
-        }            
-        for (byte r = CHAN_REG1; r < CHAN_REG_LENGTH; r++) {
-            byte *v = &state.struc.channelMem[dest].channelReg[r];
-            byte i = toFlat(v);
-            setRegDirect(whichPart(i), whichReg(i), *v);
+            if (data == state.flat[first + i])
+                continue;
+            state.flat[first + i] = data;
+            setRegDirect(whichPart(first + i), whichReg(first + i), data);
         }
     }
-};
 
 
-// The following tables were copied from the spreadsheet:
-const PROGMEM YM2612::State YM2612::regLookup = {
-    { //flat[]
-        0x00,0x30,0x40,0x50,0x60,0x70,0x80,0x90,0x34,0x44,0x54,0x64,0x74,0x84,
-        0x94,0x38,0x48,0x58,0x68,0x78,0x88,0x98,0x3C,0x4C,0x5C,0x6C,0x7C,0x8C,
-        0x9C,0xB0,0xB4,0x31,0x41,0x51,0x61,0x71,0x81,0x91,0x35,0x45,0x55,0x65,
-        0x75,0x85,0x95,0x39,0x49,0x59,0x69,0x79,0x89,0x99,0x3D,0x4D,0x5D,0x6D,
-        0x7D,0x8D,0x9D,0xB1,0xB5,0x32,0x42,0x52,0x62,0x72,0x82,0x92,0x36,0x46,
-        0x56,0x66,0x76,0x86,0x96,0x3A,0x4A,0x5A,0x6A,0x7A,0x8A,0x9A,0x3E,0x4E,
-        0x5E,0x6E,0x7E,0x8E,0x9E,0xB3,0xB6,0x30,0x40,0x50,0x60,0x70,0x80,0x90,
-        0x34,0x44,0x54,0x64,0x74,0x84,0x94,0x38,0x48,0x58,0x68,0x78,0x88,0x98,
-        0x3C,0x4C,0x5C,0x6C,0x7C,0x8C,0x9C,0xB0,0xB4,0x31,0x41,0x51,0x61,0x71,
-        0x81,0x91,0x35,0x45,0x55,0x65,0x75,0x85,0x95,0x39,0x49,0x59,0x69,0x79,
-        0x89,0x99,0x3D,0x4D,0x5D,0x6D,0x7D,0x8D,0x9D,0xB1,0xB5,0x32,0x42,0x52,
-        0x62,0x72,0x82,0x92,0x36,0x46,0x56,0x66,0x76,0x86,0x96,0x3A,0x4A,0x5A,
-        0x6A,0x7A,0x8A,0x9A,0x3E,0x4E,0x5E,0x6E,0x7E,0x8E,0x9E,0xB2,0xB6,0x20,
-        0x22,0x27,0x2C
+    void channelRegCopy(channel_e dest, channel_e src) {
+        const byte first = slotState(dest, SLOT1, SLOT_REG1);
+        for (byte i = first; i < first + CHAN_STATE_LENGTH; i++) {
+            setRegDirect(whichPart(i), whichReg(i), state.flat[i]);
+        }
     }
 };
 
 
-const PROGMEM byte YM2612::stateLookup[YM2612::PART_COUNT][YM2612::REG_COUNT] =
-{
-    { // YM2612_PART1 parallels State.flat[]
-        0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,181,0,
-        182,0,0,0,0,183,0,0,0,0,184,0,0,0,1,31,61,0,8,38,68,0,15,45,75,0,22,
-        52,82,0,2,32,62,0,9,39,69,0,16,46,76,0,23,53,83,0,3,33,63,0,10,40,70,
-        0,17,47,77,0,24,54,84,0,4,34,64,0,11,41,71,0,18,48,78,0,25,55,85,0,5,
-        35,65,0,12,42,72,0,19,49,79,0,26,56,86,0,6,36,66,0,13,43,73,0,20,50,
-        80,0,27,57,87,0,7,37,67,0,14,44,74,0,21,51,81,0,28,58,88,0,0,0,0,0,0,
-        0,0,0,0,0,0,0,0,0,0,0,29,59,0,89,30,60,90,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-        0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-        0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
-    },
-    { // YM2612_PART2 parallels State.flat[]
-        0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-        0,0,0,0,0,0,0,0,0,0,0,0,0,91,121,151,0,98,128,158,0,105,135,165,0,112,
-        142,172,0,92,122,152,0,99,129,159,0,106,136,166,0,113,143,173,0,93,
-        123,153,0,100,130,150,0,107,137,167,0,114,144,174,0,94,124,154,0,101,
-        131,161,0,108,138,168,0,115,145,175,0,95,125,155,0,102,132,162,0,109,
-        139,169,0,116,146,176,0,96,126,156,0,103,133,163,0,110,140,170,0,117,
-        147,177,0,97,127,157,0,104,134,164,0,111,141,171,0,118,148,178,0,0,0,
-        0,0,0,0,0,0,0,0,0,0,0,0,0,0,119,149,179,0,120,150,180,0,0,0,0,0,0,0,0,
-        0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-        0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
-    }
+template<word... I>
+const PROGMEM byte YM2612Map::RegLookup<I...>::table[sizeof...(I)] = {
+    YM2612Map::stateReg(I)...
 };
 
 
-const YM2612::Field::SlotField     YM2612::Field::DT         (3, 4, YM2612::SLOT_REG1);
-const YM2612::Field::SlotField     YM2612::Field::MULTI      (4, 0, YM2612::SLOT_REG1);
-const YM2612::Field::SlotField     YM2612::Field::TL         (7, 0, YM2612::SLOT_REG2);
-const YM2612::Field::SlotField     YM2612::Field::KS         (2, 6, YM2612::SLOT_REG3);
-const YM2612::Field::SlotField     YM2612::Field::AR         (5, 0, YM2612::SLOT_REG3);
-const YM2612::Field::SlotField     YM2612::Field::AM         (1, 7, YM2612::SLOT_REG4);
-const YM2612::Field::SlotField     YM2612::Field::DR         (5, 0, YM2612::SLOT_REG4);
-const YM2612::Field::SlotField     YM2612::Field::SR         (5, 0, YM2612::SLOT_REG5);
-const YM2612::Field::SlotField     YM2612::Field::SL         (4, 4, YM2612::SLOT_REG6);
-const YM2612::Field::SlotField     YM2612::Field::RR         (4, 0, YM2612::SLOT_REG6);
-const YM2612::Field::SlotField     YM2612::Field::SSEG       (4, 0, YM2612::SLOT_REG7);
-const YM2612::Field::ChannelField  YM2612::Field::FB         (3, 3, YM2612::CHAN_REG1);
-const YM2612::Field::ChannelField  YM2612::Field::ALGO       (3, 0, YM2612::CHAN_REG1);
-const YM2612::Field::ChannelField  YM2612::Field::LR         (2, 6, YM2612::CHAN_REG2);
-const YM2612::Field::ChannelField  YM2612::Field::AMS        (2, 4, YM2612::CHAN_REG2);
-const YM2612::Field::ChannelField  YM2612::Field::PMS        (3, 0, YM2612::CHAN_REG2);
-const YM2612::Field::GlobalField20 YM2612::Field::T20H       (4, 4);
-const YM2612::Field::GlobalField20 YM2612::Field::T20L       (4, 0);
-const YM2612::Field::GlobalField22 YM2612::Field::LFOEN      (1, 3);
-const YM2612::Field::GlobalField22 YM2612::Field::LFOFREQ    (3, 0);
-const YM2612::Field::GlobalField27 YM2612::Field::SPECIALEN  (1, 7);
-const YM2612::Field::GlobalField27 YM2612::Field::T27H       (1, 6);
-const YM2612::Field::GlobalField27 YM2612::Field::T27L       (6, 0);
-const YM2612::Field::GlobalField2C YM2612::Field::T2CH       (4, 4);
-const YM2612::Field::GlobalField2C YM2612::Field::T2CL       (4, 0);
+template<word... I>
+const PROGMEM byte YM2612Map::StateLookup<I...>::table[sizeof...(I)] = {
+    YM2612Map::regState(
+        static_cast<YM2612Map::part_e>(I / YM2612Map::REG_COUNT),
+        I % YM2612Map::REG_COUNT)...
+};
+
+
+typedef YM2612Chip<SynthBoard> YM2612;
+// second chip of a dual setup
+typedef YM2612Chip<SynthBoard, SynthBoard::YM_WR2> YM2612B;
+
+
+/* Interleaves the deferred writes of several chips on the shared bus:
+ * each round strobes the next address of every chip with writes queued,
+ * then their data in the same order. A chip's strobes are separated by
+ * the other chips' strobes, which take longer than the chip needs, so
+ * with two or more chips busy the waits drop out and the bus carries
+ * writes back to back. */
+class YM2612Scheduler {
+    static inline byte strobeAddresses() {
+        return 0;
+    }
+
+
+    template<class C, class... R>
+    static inline byte strobeAddresses(C &chip, R &... rest) {
+        const byte issued = chip.strobeAddress();
+        return issued + strobeAddresses(rest...);
+    }
+
+
+    static inline void strobeData() { }
+
+
+    template<class C, class... R>
+    static inline void strobeData(C &chip, R &... rest) {
+        if (chip.pending())
+            chip.strobeData();
+        strobeData(rest...);
+    }
+
+    public:
+    // issue every deferred write of the chips and stop deferring
+    template<class... C> static void flush(C &... chips) {
+        for (;;) {
+            // an interrupt can only make the gaps longer, so the rounds
+            // need no critical section either
+            const byte issued = strobeAddresses(chips...);
+            if (!issued)
+                break;
+            if (issued == 1)
+                _delay_us(YM2612_BUSY_US);
+            strobeData(chips...);
+            if (issued == 1)
+                _delay_us(YM2612_BUSY_US);
+        }
+        // the last chip strobed may still be busy
+        _delay_us(YM2612_BUSY_US);
+        const bool flushed[] = { (chips.flush(), false)... };
+        (void)flushed;
+    }
+};
 
 
 //include guard
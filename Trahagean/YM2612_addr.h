@@ -13,6 +13,10 @@
 #define REG_RANGE(name, reg) \
     (YM2612_##name##_BASE_REG <= (reg) && (reg) <= YM2612_##name##_END_REG)
 
+#define YM2612_PART_COUNT 2
+#define YM2612_CHAN_COUNT 6
+#define YM2612_SLOT_COUNT 4
+
 #define YM2612_CHAN_PART_COUNT (YM2612_CHAN_COUNT / YM2612_PART_COUNT)
 
 #define YM2612_CHAN_PART_PAD 1
@@ -31,8 +35,54 @@
 #define YM2612_DACEN_BASE_REG 0x2B
 #define YM2612_DACEN_WIDTH 1
 #define YM2612_DACEN_SHIFT 7
+// parameters for KEY: key on/off, operator bits are S1, S2, S3, S4
+#define YM2612_KEY_BASE_REG 0x28
+#define YM2612_KEY_WIDTH 4
+#define YM2612_KEY_SHIFT 4
+// parameters for TIMERA: the 10 bit Timer A period, 8 MSBs then 2 LSBs
+#define YM2612_TIMERA_MSB_REG 0x24
+#define YM2612_TIMERA_LSB_REG 0x25
+#define YM2612_TIMERA_LSB_WIDTH 2
+// parameters for TIMERB: the 8 bit Timer B period
+#define YM2612_TIMERB_REG 0x26
+// 0x27 bits 0-5, timers' load, enable (IRQ) and reset bits: Timer A's
+// bit of each pair, Timer B's the one above
+#define YM2612_TIMER_LOAD_SHIFT 0
+#define YM2612_TIMER_ENABLE_SHIFT 2
+#define YM2612_TIMER_RESET_SHIFT 4
+
+/* FREQUENCY REGISTER CONSTANTS */
+// F-number LSB registers, block and F-number MSB are YM2612_FREQ_MSB_OFFSET
+// above and must be written first
+#define YM2612_FREQ_BASE_REG 0xA0
+#define YM2612_FREQ_MSB_OFFSET 4
+// channel 3 special mode: operators 3, 1 and 2 in sequence,
+// operator 4 keeps using the channel 3 registers
+#define YM2612_SPECIAL_FREQ_BASE_REG 0xA8
+
+/*** STATEFUL REGISTER CONSTANTS ***/
+/* GLOBAL REGISTER CONSTANTS */
+// shadowed global registers, all of them live in part 1
+#define YM2612_GLOBAL20_REG 0x20
+#define YM2612_GLOBAL22_REG 0x22
+#define YM2612_GLOBAL27_REG 0x27
+#define YM2612_GLOBAL2C_REG 0x2C
+
+/* SLOT REGISTER CONSTANTS */
+// 7 registers (DT/MULTI through SSG-EG), each block 0x10 apart
+// within a block: slot * YM2612_CHAN_PART_LENGTH + channel in part
+#define YM2612_SLOT_BASE_REG 0x30
+#define YM2612_SLOT_LENGTH 7
+#define YM2612_SLOT_REG_LENGTH 0x10
+#define YM2612_SLOT_END_REG END_REG(SLOT)
 
 /* CHAN REGISTER CONSTANTS */
+// 2 registers (FB/ALGO and LR/AMS/PMS), each block 4 apart
+// within a block: channel in part
+#define YM2612_CHAN_BASE_REG 0xB0
+#define YM2612_CHAN_LENGTH 2
+#define YM2612_CHAN_REG_LENGTH YM2612_CHAN_PART_LENGTH
+#define YM2612_CHAN_END_REG END_REG(CHAN)
 
 
 //include guard
@@ -0,0 +1,159 @@
+#ifndef YM_TIMER_H__
+#define YM_TIMER_H__
+
+/*
+YM2612 Timer B as a tick source
+
+Timer B counts on the YM2612's own clock, a step every
+YM2612::TIMER_B_CLOCKS master clocks (288us at 8MHz), and pulls IRQ low
+when it overflows. YmTimer makes ticks of it, one every units / per
+steps, exact on average however the division falls, with no AVR timer
+and no queued event per tick. Sequencer.h takes its tempo from it with
+CC 107 at 32-63.
+
+A tick longer than a period can be (TIMER_B_MAX steps, 73.7ms) is cut
+into equal periods, each over half of that. The chip takes a new period
+when the one running overflows, so the register always holds the period
+after the running one: at each overflow service() acknowledges it and
+writes the one after next.
+
+IRQ is SynthBoard::YM_IRQ on a pin change interrupt (Board.h). The ISR
+only sets a flag and service(), from the main loop, does the bus writes,
+so an ISR never writes to the bus under the main loop. RD is not wired
+on the boards, so the status register cannot be read: an overflow that
+comes before service() has acknowledged the last raises no new edge and
+is lost. service() has to run more often than the shortest period, a
+tick at the fastest tempo (9.8ms at 254 bpm); loop() waits on nothing
+longer. With USE_IDLE_SLEEP the pin change wakes the CPU.
+
+Only the first YM2612's IRQ is wired. Timer A is left to the CSM mode
+and to global CC 92, which sets its load, enable and reset bits of 0x27
+and no others; CC 93 sets the mode bits. Timer B's bits are YmTimer's.
+*/
+
+#include "Arduino.h"
+#include "Board.h"
+#include "Trace.h"
+#include "YM2612.h"
+
+class YmTimer {
+    enum ends_e { // the periods that end a tick
+        ENDS_RUNNING = bit(0),
+        ENDS_QUEUED = bit(1)
+    };
+    unsigned long units; // a tick is units / per steps
+    word per;
+    word remainder; // of units / per, in 1/per steps
+    word left; // steps of the tick not yet in a period
+    byte ends;
+    bool running;
+
+    // a function's static, so the ISR and the object share it
+    static inline volatile bool &raised() {
+        static volatile bool r;
+        return r;
+    }
+
+
+    word nextTick() {
+        word steps = units / per;
+        remainder += units % per;
+        if (remainder >= per) {
+            remainder -= per;
+            steps++;
+        }
+        return steps ? steps : 1;
+    }
+
+
+    // the period after the running one into the register
+    template<class Y> void queue(Y &chip) {
+        word period = left;
+        if (period > YM2612::TIMER_B_MAX)
+            period = left / ((left + YM2612::TIMER_B_MAX - 1)
+                / YM2612::TIMER_B_MAX);
+        left -= period;
+        if (!left) {
+            ends |= ENDS_QUEUED;
+            left = nextTick();
+        }
+        chip.setTimerB(period);
+    }
+
+    public:
+    // from SYNTH_YM_IRQ_vect when IRQ has gone low
+    static inline void raise() {
+        raised() = true;
+    }
+
+
+    void begin() {
+        running = false;
+    }
+
+
+    // ticks from now, the first a whole tick away
+    template<class Y> void start(Y &chip, unsigned long u, word p) {
+        SynthBoard::irqBegin();
+        units = u;
+        per = p;
+        remainder = 0;
+        ends = 0;
+        left = nextTick();
+        queue(chip);
+        ends >>= 1; // started, it is the running one
+        raised() = false;
+        chip.startTimers(YM2612::TIMER_B, YM2612::TIMER_B);
+        queue(chip);
+        running = true;
+    }
+
+
+    // a new length from the next tick cut into periods on
+    void rate(unsigned long u, word p) {
+        units = u;
+        per = p;
+        if (remainder >= per)
+            remainder = 0;
+    }
+
+
+    template<class Y> void stop(Y &chip) {
+        chip.stopTimers(YM2612::TIMER_B);
+        running = false;
+    }
+
+
+    // From the main loop: acknowledges an overflow and queues the next
+    // period. True when the period that overflowed ended a tick.
+    template<class Y> bool service(Y &chip) {
+        if (!raised())
+            return false;
+        raised() = false;
+        if (!running)
+            return false;
+        chip.ackTimers(YM2612::TIMER_B);
+        const bool tick = ends & ENDS_RUNNING;
+        ends >>= 1;
+        queue(chip);
+        return tick;
+    }
+
+
+    // an overflow waits for service()
+    bool pending() const {
+        return raised();
+    }
+};
+
+
+ISR(SYNTH_YM_IRQ_vect) {
+    TRACE(TRACE_ISR_ENTER, TRACE_ISR_YM_IRQ);
+    if (SynthBoard::YM_IRQ::isLow())
+        YmTimer::raise();
+    TRACE(TRACE_ISR_EXIT, TRACE_ISR_YM_IRQ);
+}
+
+
+// include guard
+#endif
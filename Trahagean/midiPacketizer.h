@@ -11,7 +11,7 @@
 //#define MIDI_PROGRAMCHANGE_ENABLE
 //#define MIDI_CHANNELPRESSURE_ENABLE
 #define MIDI_PITCHBEND_ENABLE
-//#define MIDI_SYSTEM_ENABLE
+#define MIDI_SYSTEM_ENABLE // real time messages: clock, start, stop (Sequencer.h)
 
 
 
@@ -22,6 +22,7 @@
 #define MIDI_PACKET_SIZE 3
 #define MIDI_STATE_STATUS 0
 #define MIDI_STATE_DATA 1
+#define MIDI_STATE_SYSEX 2
 
 #define MIDI_STATUS_INDEX 0
 #define MIDI_KEY_INDEX 1
@@ -33,6 +34,7 @@
 #define MIDI_TOUCH_INDEX 2
 #define MIDI_CCVAL_INDEX 2
 #define MIDI_BENDHIGH_INDEX 2
+#define MIDI_SYSEX_INDEX 1
 
 #define MIDI_NOTEOFF 0x80
 #define MIDI_NOTEON 0x90
@@ -42,6 +44,13 @@
 #define MIDI_CHANNELPRESSURE 0xD0
 #define MIDI_PITCHBEND 0xE0
 #define MIDI_SYSTEM 0xF0
+#define MIDI_SYSEX 0xF0
+#define MIDI_SYSEX_END 0xF7
+#define MIDI_REALTIME 0xF8 // and up, single bytes
+#define MIDI_CLOCK 0xF8 // 24 per quarter note
+#define MIDI_START 0xFA
+#define MIDI_CONTINUE 0xFB
+#define MIDI_STOP 0xFC
 
 
 /* Abstract some MIDI bit banging */
@@ -57,6 +66,9 @@
 
 class MidiPacketizer {
     byte packet[MIDI_PACKET_SIZE];
+#   ifdef MIDI_SYSTEM_ENABLE
+    byte realTime; // a one byte packet, apart from the one being read
+#   endif
     byte have;
     byte need;
     byte mode;
@@ -83,6 +95,29 @@ class MidiPacketizer {
     const byte *receive(int inByte) {
         if (inByte < 0) // did the read fail?
             return NULL; // abort!
+#       ifdef MIDI_SYSTEM_ENABLE
+        // real time bytes may come between any two bytes of a message,
+        // which goes on being read around them
+        if (inByte >= MIDI_REALTIME) {
+            realTime = inByte;
+            return &realTime;
+        }
+        // SysEx goes through a byte at a time, nothing is kept of it:
+        // { F0, F0 } starts it, { F0, data } for each data byte and { F7 }
+        // ends it. Another status byte ends it early, without the { F7 }.
+        if (mode == MIDI_STATE_SYSEX) {
+            if (isMidiData(inByte)) {
+                packet[MIDI_STATUS_INDEX] = MIDI_SYSEX;
+                packet[MIDI_SYSEX_INDEX] = inByte;
+                return packet;
+            }
+            reset();
+            if (inByte == MIDI_SYSEX_END) {
+                packet[MIDI_STATUS_INDEX] = MIDI_SYSEX_END;
+                return packet;
+            }
+        }
+#       endif
         if (mode == MIDI_STATE_STATUS && isMidiStatus(inByte)) {
             store(inByte);
             need = have;
@@ -137,12 +172,14 @@ class MidiPacketizer {
                     need += 2;
                     break;
                     
-                    case B11110000:
-                    reset(); // skip over data, if any
-                    return NULL; //unsupported!
+                    case MIDI_SYSEX:
+                    have = 0;
+                    mode = MIDI_STATE_SYSEX;
+                    packet[MIDI_SYSEX_INDEX] = MIDI_SYSEX;
+                    return packet;
                     break;
 
-                    default: // the rest of system commands
+                    default: // the rest of system common, F6 and F7
                     reset(); // they don't have any data
                     return packet;
                     break;
@@ -169,6 +206,8 @@ class MidiPacketizer {
         }
         //invalid state: unrecognized packet, or stream hiccup. in either event reset
         reset();
+        if (isMidiStatus(inByte)) // cut the last message short, start anew
+            return receive(inByte);
         return NULL; // ignore packet
     }
 };
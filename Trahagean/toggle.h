@@ -65,20 +65,42 @@
      533333.333333,
      500000.000000,
     etc. If you need more accuracy, use an external clock!
+    toggleClock() tells at compile time what a request comes out at, so
+    tunings can be built for the real clock (see Tuning.h).
+
+    Timer1Dither gets closer on Timer1: fast PWM, so the period can be
+    any whole number of cycles, switched between the two either side of
+    F_CPU / f so the average is f. 3579545Hz comes out as 4 and 5 cycle
+    periods (4MHz and 3.2MHz) 47% and 53% of the time. The chip's clock
+    is frequency modulated at the step rate, so steps must come well
+    above the audio band, from a timer interrupt every few tens of
+    microseconds: the pitch is right on average and the modulation is
+    out of earshot. Output on OC1B.
 */
 
+// the OCR value toggle_*() set for f, and the clock that comes out
+constexpr unsigned long toggleOcr(double f) {
+    return F_CPU / (f * 2) - 1;
+}
+
+
+constexpr double toggleClock(double f) {
+    return F_CPU / 2.0 / (toggleOcr(f) + 1);
+}
+
+
 // Timer 0
 inline void toggle_OC0A(double f) {
     TCCR0A = bit(COM0A0) | bit(WGM01);
     TCCR0B = bit(CS00);
-    OCR0A = F_CPU / (f * 2) - 1;
+    OCR0A = toggleOcr(f);
 }
 
 
 inline void toggle_OC0B(double f) {
     TCCR0A = bit(COM0B0) | bit(WGM01);
     TCCR0B = bit(CS00);
-    OCR0A = F_CPU / (f * 2) - 1;
+    OCR0A = toggleOcr(f);
 }
 
 
@@ -86,14 +108,14 @@ inline void toggle_OC0B(double f) {
 inline void toggle_OC1A(double f) {
     TCCR1A = bit(COM1A0);
     TCCR1B = bit(WGM12) | bit(CS10);
-    OCR1A = F_CPU / (f * 2) - 1;
+    OCR1A = toggleOcr(f);
 }
 
 
 inline void toggle_OC1B(double f) {
     TCCR1A = bit(COM1B0);
     TCCR1B = bit(WGM12) | bit(CS10);
-    OCR1A = F_CPU / (f * 2) - 1;
+    OCR1A = toggleOcr(f);
 }
 
 
@@ -101,15 +123,84 @@ inline void toggle_OC1B(double f) {
 inline void toggle_OC2A(double f) {
     TCCR2A = bit(COM2A0) | bit(WGM21);
     TCCR2B = bit(CS20);
-    OCR2A = F_CPU / (f * 2) - 1;
+    OCR2A = toggleOcr(f);
 }
 
 
 inline void toggle_OC2B(double f) {
     TCCR2A = bit(COM2B0) | bit(WGM21);
     TCCR2B = bit(CS20);
-    OCR2A = F_CPU / (f * 2) - 1;
+    OCR2A = toggleOcr(f);
+}
+
+
+// Timer 1, fractional: the shorter period in cycles, n where
+// n < F_CPU / f <= n + 1
+constexpr unsigned long ditherPeriod(double f) {
+    return (unsigned long)(F_CPU / f)
+        - ((unsigned long)(F_CPU / f) == F_CPU / f);
+}
+
+
+constexpr word ditherRound(double x) {
+    return x * 65536 + 0.5 >= 65535 ? 65535 : x * 65536 + 0.5;
+}
+
+
+// the share of the time at n cycles (in 1/65536) that averages out at f:
+// x F_CPU / n + (1 - x) F_CPU / (n + 1) = f
+constexpr word ditherShare(double f) {
+    return ditherRound(
+        ditherPeriod(f) * ((ditherPeriod(f) + 1) * f / F_CPU - 1));
 }
 
+
+// the average that comes out, off f by the rounding of the share
+constexpr double ditherClock(double f) {
+    return F_CPU * (ditherShare(f) / 65536.0 / ditherPeriod(f)
+        + (1 - ditherShare(f) / 65536.0) / (ditherPeriod(f) + 1));
+}
+
+
+class Timer1Dither {
+    struct State {
+        word top; // OCR1A for n cycles
+        word share;
+        word phase;
+    };
+
+    // a function's static, so host tools of several files that include
+    // Board.h still link
+    static inline State &state() {
+        static State s;
+        return s;
+    }
+
+    public:
+    static void begin(double f) {
+        const unsigned long n = ditherPeriod(f);
+        State &s = state();
+        s.top = n - 1;
+        s.share = ditherShare(f);
+        s.phase = 0;
+        // fast PWM with TOP in OCR1A, OC1B set at BOTTOM and cleared on
+        // a match: high for half the cycles, rounded up
+        TCCR1A = bit(COM1B1) | bit(WGM11) | bit(WGM10);
+        TCCR1B = bit(WGM13) | bit(WGM12) | bit(CS10);
+        OCR1B = (n + 1) / 2 - 1;
+        OCR1A = s.top + 1;
+    }
+
+
+    // pick the next period, at a steady rate; OCR1A is double buffered,
+    // so it takes effect at the end of the current period
+    static inline void step() {
+        State &s = state();
+        const word before = s.phase;
+        s.phase += s.share;
+        OCR1A = s.phase < before ? s.top : s.top + 1;
+    }
+};
+
 // include guard
 #endif
@@ -0,0 +1,142 @@
+/**
+ * Decodes the firmware's GPIO writes into sound chip bus cycles and feeds
+ * them to the software cores at the simulated time they happen.
+ *
+ * Header only: include it after the sketch, it finds the strobes and the
+ * data bus through the pins of the sketch's board profile (SynthBoard, see
+ * Board.h). Strobes on the second chips' WR2/WE2 pins go to ym2 and sn2
+ * and switch the mix to dual.
+ *
+ * The first YM2612's IRQ drives SynthBoard::YM_IRQ, low while a timer
+ * flag is set. The timers count rendered samples, so they run while
+ * recording: the shim's line hook renders up to the sample a timer
+ * overflows on and pulls the pin there, raising its pin change interrupt.
+ */
+#ifndef CHIP_BUS_H__
+#define CHIP_BUS_H__
+
+#include "Arduino.h"
+#include "ChipMix.h"
+
+class ChipBus : public ChipMix {
+    public:
+    unsigned long ymWrites;
+    unsigned long snWrites;
+
+    ChipBus(uint32_t ymClock, uint32_t snClock)
+        : ChipMix(ymClock, snClock), ymWrites(0), snWrites(0),
+          origin(0), recording(false) {
+        instance = this;
+    }
+
+    /* hook the strobe ports, call after hostReset() */
+    void attach() {
+        SynthBoard::YM_WR::out().hook = onPortWrite;
+        SynthBoard::YM_WR2::out().hook = onPortWrite;
+        SynthBoard::YM_IC::out().hook = onPortWrite;
+        SynthBoard::SN_WE::out().hook = onPortWrite;
+        SynthBoard::SN_WE2::out().hook = onPortWrite;
+        SynthBoard::YM_IRQ::in().value |= bit(SynthBoard::YM_IRQ::BIT);
+        hostLineHook = onLineDue;
+    }
+
+    /* audio starts now, earlier chip writes only set up state */
+    bool record(const char *path) {
+        origin = hostCycles;
+        recording = true;
+        updateIrq();
+        return open(path);
+    }
+
+    /* render audio up to the current simulated time */
+    void sync() {
+        if (!recording || hostCycles < origin)
+            return;
+        renderTo((hostCycles - origin) * ym.sampleRate() / F_CPU);
+    }
+
+    void finish() {
+        sync();
+        close();
+    }
+
+    private:
+    static ChipBus *instance;
+    uint64_t origin;
+    bool recording;
+
+    template<class P> static bool rose(HostPort &port, uint8_t previous) {
+        return &port == &P::out() && !(previous & bit(P::BIT))
+            && (port & bit(P::BIT));
+    }
+
+    template<class P> static bool fell(HostPort &port, uint8_t previous) {
+        return &port == &P::out() && (previous & bit(P::BIT))
+            && !(port & bit(P::BIT));
+    }
+
+    // IRQ as the YM2612 pulls it, and when a timer will next pull it
+    void updateIrq() {
+        HostPort &pins = SynthBoard::YM_IRQ::in();
+        const uint8_t previous = pins;
+        if (ym.irq())
+            pins.value &= ~bit(SynthBoard::YM_IRQ::BIT);
+        else
+            pins.value |= bit(SynthBoard::YM_IRQ::BIT);
+        const uint64_t samples = ym.samplesToIrq();
+        if (recording && samples != UINT64_MAX)
+            hostLineDue = origin + ((frames() + samples) * F_CPU
+                + ym.sampleRate() - 1) / ym.sampleRate();
+        else
+            hostLineDue = UINT64_MAX;
+        if (pins != previous)
+            hostPinsChanged(pins, previous);
+    }
+
+    static void onLineDue() {
+        instance->sync();
+        instance->updateIrq();
+    }
+
+    // both chips latch on the rising edge of their write strobe
+    static void onPortWrite(HostPort &port, uint8_t previous) {
+        ChipBus &bus = *instance;
+        if (rose<SynthBoard::YM_WR>(port, previous)) {
+            bus.sync();
+            bus.ym.busWrite(
+                SynthBoard::YM_A1::isHigh(), SynthBoard::YM_A0::isHigh(),
+                SynthBoard::dataBusRead());
+            bus.ymWrites++;
+            bus.updateIrq();
+        }
+        if (rose<SynthBoard::YM_WR2>(port, previous)) {
+            bus.sync();
+            bus.dual = true;
+            bus.ym2.busWrite(
+                SynthBoard::YM_A1::isHigh(), SynthBoard::YM_A0::isHigh(),
+                SynthBoard::dataBusRead());
+            bus.ymWrites++;
+        }
+        if (fell<SynthBoard::YM_IC>(port, previous)) {
+            bus.sync();
+            bus.ym.reset();
+            bus.ym2.reset();
+            bus.updateIrq();
+        }
+        if (rose<SynthBoard::SN_WE>(port, previous)) {
+            bus.sync();
+            bus.sn.write(SynthBoard::dataBusRead());
+            bus.snWrites++;
+        }
+        if (rose<SynthBoard::SN_WE2>(port, previous)) {
+            bus.sync();
+            bus.dual = true;
+            bus.sn2.write(SynthBoard::dataBusRead());
+            bus.snWrites++;
+        }
+    }
+};
+
+ChipBus *ChipBus::instance;
+
+#endif
@@ -0,0 +1,71 @@
+/**
+ * The two sound chip cores mixed into one stereo stream at the YM2612
+ * sample rate and written out as 16 bit PCM. A second pair of cores is
+ * mixed in once dual is set, for firmware built with DUAL_CHIPS; the two
+ * SN76489s then feed the left and right outputs, as in
+ * Documents/dual_sn76489an_schematic.png.
+ */
+#ifndef CHIP_MIX_H__
+#define CHIP_MIX_H__
+
+#include "YM2612Core.h"
+#include "SN76489Core.h"
+#include "WavWriter.h"
+
+class ChipMix {
+    public:
+    YM2612Core ym;
+    SN76489Core sn;
+    YM2612Core ym2;
+    SN76489Core sn2;
+    bool dual;
+    WavWriter wav;
+
+    ChipMix(uint32_t ymClock, uint32_t snClock)
+        : ym(ymClock), sn(snClock), ym2(ymClock), sn2(snClock), dual(false),
+          rendered(0) { }
+
+    /* path may be NULL to only fingerprint the audio */
+    bool open(const char *path) {
+        rendered = 0;
+        return wav.open(path, ym.sampleRate());
+    }
+
+    /* render up to, not including, the given output frame */
+    void renderTo(uint64_t frame) {
+        while (rendered < frame) {
+            size_t n = frame - rendered < CHUNK ? frame - rendered : CHUNK;
+            ym.render(mix, n);
+            sn.render(mix, n, ym.sampleRate(),
+                      dual ? SN76489Core::OUT_LEFT : SN76489Core::OUT_BOTH);
+            if (dual) {
+                ym2.render(second, n);
+                sn2.render(second, n, ym.sampleRate(), SN76489Core::OUT_RIGHT);
+                for (size_t i = 0; i < 2 * n; i++)
+                    mix[i] += second[i];
+            }
+            for (size_t i = 0; i < 2 * n; i++) {
+                int32_t v = mix[i];
+                pcm[i] = v > 32767 ? 32767 : v < -32768 ? -32768 : v;
+            }
+            wav.write(pcm, n);
+            rendered += n;
+        }
+    }
+
+    void close() { wav.close(); }
+
+    uint64_t frames() const { return rendered; }
+    double seconds() const { return (double)rendered / ym.sampleRate(); }
+
+    private:
+    enum {
+        CHUNK = 1024
+    };
+    uint64_t rendered;
+    int32_t mix[2 * CHUNK];
+    int32_t second[2 * CHUNK];
+    int16_t pcm[2 * CHUNK];
+};
+
+#endif
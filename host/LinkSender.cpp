@@ -0,0 +1,237 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#undef B0 // termios hangup rate, clashes with binary.h from HostLink.h
+
+#include "LinkSender.h"
+
+static long long nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static speed_t toSpeed(unsigned long baud) {
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 500000: return B500000;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+    case 2000000: return B2000000;
+    default: return 0;
+    }
+}
+
+int LinkSender::openSerial(const char *path, unsigned long baud) {
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0)
+        return -1;
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) { // pipes and files have no termios
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        speed_t speed = toSpeed(baud);
+        if (!speed) {
+            close(fd);
+            errno = EINVAL;
+            return -1;
+        }
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        tio.c_cc[VMIN] = 0;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tio);
+        tcflush(fd, TCIOFLUSH);
+    }
+    return fd;
+}
+
+LinkSender::LinkSender(int fd)
+    : onFrame(NULL), context(NULL), fd(fd), available(0), windowSize(0),
+      greeted(false), hungUp(false), counters(), pendingType(0) { }
+
+bool LinkSender::hello(int timeoutMs) {
+    greeted = false;
+    const uint8_t frame[4] = { LINK_SYNC, LINK_HELLO, 0, 0 };
+    if (write(fd, frame, sizeof(frame)) != sizeof(frame))
+        return false;
+    long long deadline = nowMs() + timeoutMs;
+    while (!greeted && nowMs() < deadline)
+        poll(deadline - nowMs());
+    return greeted;
+}
+
+void LinkSender::poll(int timeoutMs) {
+    struct pollfd p = { fd, POLLIN, 0 };
+    if (hungUp || ::poll(&p, 1, timeoutMs < 0 ? 0 : timeoutMs) <= 0)
+        return;
+    uint8_t buffer[256];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        rx.insert(rx.end(), buffer, buffer + n);
+        if (n < (ssize_t)sizeof(buffer))
+            break;
+    }
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+        hungUp = true;
+    parse();
+}
+
+void LinkSender::parse() {
+    size_t i = 0;
+    while (i < rx.size()) {
+        if (rx[i] != LINK_SYNC) {
+            i++;
+            continue;
+        }
+        if (rx.size() - i < 4)
+            break; // wait for the header and checksum
+        uint8_t length = rx[i + 2];
+        if (length > LINK_PAYLOAD_MAX) {
+            i++;
+            continue;
+        }
+        if (rx.size() - i < 4u + length)
+            break;
+        uint8_t sum = 0;
+        for (size_t k = 1; k < 4u + length; k++)
+            sum += rx[i + k];
+        if (sum) {
+            i++; // not a frame after all, hunt on
+            continue;
+        }
+        handle(rx[i + 1], &rx[i + 3], length);
+        i += 4 + length;
+    }
+    rx.erase(rx.begin(), rx.begin() + i);
+}
+
+void LinkSender::handle(uint8_t type, const uint8_t *payload, uint8_t length) {
+    switch (type) {
+    case LINK_HELLO:
+        if (length >= 2) {
+            windowSize = available = payload[1];
+            greeted = true;
+        }
+        break;
+    case LINK_CREDIT:
+        if (greeted && length >= 1)
+            available += payload[0];
+        if (available > windowSize) // more than we sent, resync
+            available = windowSize;
+        break;
+    case LINK_NAK:
+        counters.naks++;
+        break;
+    default:
+        if (onFrame)
+            onFrame(type, payload, length, context);
+        break;
+    }
+}
+
+bool LinkSender::frame(uint8_t type, const uint8_t *payload, uint8_t length,
+                       int timeoutMs) {
+    if (!flushPending(timeoutMs))
+        return false;
+    const size_t size = 4 + length;
+    if (size > windowSize)
+        return false;
+    long long deadline = nowMs() + timeoutMs;
+    if (available < size)
+        counters.creditWaits++;
+    long long lastCredit = nowMs();
+    size_t before = available;
+    while (available < size) {
+        long long now = nowMs();
+        if (hungUp || now >= deadline)
+            return false;
+        if (available != before) {
+            before = available;
+            lastCredit = now;
+        } else if (now - lastCredit >= RESYNC_MS) {
+            counters.resyncs++;
+            if (!hello(RESYNC_MS))
+                return false;
+            lastCredit = nowMs();
+            continue;
+        }
+        poll(RESYNC_MS);
+    }
+    uint8_t out[4 + LINK_PAYLOAD_MAX];
+    uint8_t sum = type + length;
+    out[0] = LINK_SYNC;
+    out[1] = type;
+    out[2] = length;
+    for (uint8_t i = 0; i < length; i++) {
+        out[3 + i] = payload[i];
+        sum += payload[i];
+    }
+    out[3 + length] = -sum;
+    for (size_t done = 0; done < size; ) {
+        ssize_t n = write(fd, out + done, size - done);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            return false;
+        }
+        done += n;
+    }
+    available -= size;
+    counters.frames++;
+    counters.bytes += size;
+    poll(0); // pick up credit early
+    return true;
+}
+
+void LinkSender::queue(uint8_t type, const uint8_t *data, size_t length,
+                       size_t unit) {
+    if (!pending.empty() && (pendingType != type
+            || pending.size() + length > LINK_PAYLOAD_MAX - LINK_PAYLOAD_MAX % unit))
+        flushPending(1000); // on failure the batch is dropped, see flush()
+    pendingType = type;
+    pending.insert(pending.end(), data, data + length);
+}
+
+bool LinkSender::flushPending(int timeoutMs) {
+    if (pending.empty())
+        return true;
+    std::vector<uint8_t> payload;
+    payload.swap(pending);
+    return frame(pendingType, payload.data(), payload.size(), timeoutMs);
+}
+
+void LinkSender::ym(uint8_t part, uint8_t reg, uint8_t data) {
+    const uint8_t write[3] = { part, reg, data };
+    queue(LINK_YM, write, 3, 3);
+}
+
+void LinkSender::sn(uint8_t data) {
+    queue(LINK_SN, &data, 1, 1);
+}
+
+void LinkSender::midi(const uint8_t *data, size_t length) {
+    // split on message boundaries is not needed, the device's packetizer
+    // carries partial messages across frames
+    while (length) {
+        size_t n = length < LINK_PAYLOAD_MAX ? length : LINK_PAYLOAD_MAX;
+        queue(LINK_MIDI, data, n, 1);
+        data += n;
+        length -= n;
+    }
+}
+
+bool LinkSender::flush(int timeoutMs) {
+    return flushPending(timeoutMs);
+}
@@ -0,0 +1,88 @@
+/**
+ * Host end of the framed link protocol in Trahagean/HostLink.h.
+ *
+ * Works on any file descriptor: a serial port opened with openSerial(), a
+ * pty, or a pipe. Frames are only written when the device has granted
+ * enough credit, so the device's receive buffer can never overrun.
+ */
+#ifndef LINK_SENDER_H__
+#define LINK_SENDER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "HostLink.h"
+
+class LinkSender {
+    public:
+    struct Stats {
+        unsigned long frames; // sent
+        unsigned long bytes; // sent, framing included
+        unsigned long creditWaits; // times a frame had to wait for credit
+        unsigned long naks; // frames the device dropped
+        unsigned long resyncs; // credit recovered with a HELLO
+    };
+
+    explicit LinkSender(int fd);
+
+    /* Open and configure a serial port for raw I/O at baud, -1 on error */
+    static int openSerial(const char *path, unsigned long baud);
+
+    /* Reset the device's parser and learn its window. False if it did not
+     * answer within timeoutMs. */
+    bool hello(int timeoutMs = 1000);
+
+    /* Queue writes, they go out in as few frames as fit LINK_PAYLOAD_MAX */
+    void ym(uint8_t part, uint8_t reg, uint8_t data);
+    void sn(uint8_t data);
+    void midi(const uint8_t *data, size_t length);
+
+    /* Send everything queued, waiting for credit as needed. False if the
+     * device stopped granting credit for timeoutMs. */
+    bool flush(int timeoutMs = 1000);
+
+    /* Read whatever the device sent, waiting up to timeoutMs for it */
+    void poll(int timeoutMs);
+
+    /* Frames from the device other than HELLO, CREDIT and NAK are passed
+     * here, e.g. the streaming fill reports */
+    void (*onFrame)(uint8_t type, const uint8_t *payload, uint8_t length,
+                    void *context);
+    void *context;
+
+    bool connected() const { return !hungUp; }
+    size_t credit() const { return available; }
+    size_t window() const { return windowSize; }
+    const Stats &stats() const { return counters; }
+
+    /* Send one frame now, waiting for credit; queued writes go first.
+     * Bytes lost on the wire never come back as credit, so when none has
+     * arrived for RESYNC_MS the window is reset with a HELLO. */
+    enum {
+        RESYNC_MS = 100
+    };
+    bool frame(uint8_t type, const uint8_t *payload, uint8_t length,
+               int timeoutMs = 1000);
+
+    private:
+    int fd;
+    size_t available; // credit left
+    size_t windowSize;
+    bool greeted;
+    bool hungUp;
+    Stats counters;
+    uint8_t pendingType;
+    std::vector<uint8_t> pending; // payload being batched
+
+    // device to host frame parser
+    std::vector<uint8_t> rx;
+
+    void queue(uint8_t type, const uint8_t *data, size_t length,
+               size_t unit);
+    bool flushPending(int timeoutMs);
+    void parse();
+    void handle(uint8_t type, const uint8_t *payload, uint8_t length);
+};
+
+#endif
@@ -0,0 +1,78 @@
+/**
+ * The host's copy of a YM2612's shadow registers, kept in step with the
+ * device through LINK_STATE_QUERY (Trahagean/StateSync.h). query() builds
+ * the query from the copy, handle() takes the answer's frames; once done
+ * is set, ok says whether the copy now matches the device's crc. A copy
+ * that does not is cleared, so the next query asks for everything.
+ */
+#ifndef STATE_MIRROR_H__
+#define STATE_MIRROR_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+#include "StateSync.h"
+
+class StateMirror {
+    public:
+    uint8_t chip;
+    std::vector<uint8_t> copy;
+    std::vector<uint8_t> before; // the copy as the last query had it
+    bool done;
+    bool ok;
+    unsigned frames; // LINK_STATE frames of the last answer
+    size_t received; // State bytes in them
+    unsigned blocks; // blocks the device said it sent
+
+    explicit StateMirror(uint8_t chip = 0)
+        : chip(chip), done(false), ok(false), frames(0), received(0),
+          blocks(0) { }
+
+    /* The LINK_STATE_QUERY payload for the copy, its length returned */
+    uint8_t query(uint8_t *payload) {
+        before = copy;
+        done = ok = false;
+        frames = 0;
+        received = 0;
+        blocks = 0;
+        payload[STATE_CHIP_INDEX] = chip;
+        uint8_t length = 1;
+        for (size_t offset = 0; offset < copy.size()
+                && length / 2 < STATE_QUERY_BLOCKS; offset += STATE_BLOCK) {
+            const size_t n = copy.size() - offset < STATE_BLOCK
+                ? copy.size() - offset : STATE_BLOCK;
+            const uint16_t crc = stateHash(&copy[offset], n);
+            payload[length++] = crc & 0xFF;
+            payload[length++] = crc >> 8;
+        }
+        return length;
+    }
+
+    /* A frame from the device; others than the answer are ignored */
+    void handle(uint8_t type, const uint8_t *payload, uint8_t length) {
+        if (length < 1 || payload[STATE_CHIP_INDEX] != chip)
+            return;
+        if (type == LINK_STATE && length > STATE_DATA_INDEX) {
+            const size_t offset = payload[STATE_OFFSET_INDEX];
+            const size_t n = length - STATE_DATA_INDEX;
+            if (copy.size() < offset + n)
+                copy.resize(offset + n);
+            memcpy(&copy[offset], payload + STATE_DATA_INDEX, n);
+            frames++;
+            received += n;
+        } else if (type == LINK_STATE_END && length >= STATE_END_LENGTH) {
+            copy.resize(payload[STATE_LENGTH_INDEX]);
+            const uint16_t crc = payload[STATE_CRC_INDEX]
+                | payload[STATE_CRC_INDEX + 1] << 8;
+            blocks = payload[STATE_SENT_INDEX];
+            ok = stateHash(copy.data(), copy.size()) == crc;
+            if (!ok)
+                copy.clear();
+            done = true;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,194 @@
+#include "VgmPlayer.h"
+
+#include <zlib.h>
+
+uint32_t VgmPlayer::read32(uint32_t offset) const {
+    if (offset + 4 > data.size())
+        return 0;
+    return data[offset] | data[offset + 1] << 8 | data[offset + 2] << 16
+        | (uint32_t)data[offset + 3] << 24;
+}
+
+bool VgmPlayer::load(const std::string &path) {
+    // gzread passes uncompressed files through, so this covers .vgm too
+    gzFile in = gzopen(path.c_str(), "rb");
+    if (!in)
+        return fail("cannot open");
+    data.clear();
+    uint8_t buffer[65536];
+    int n;
+    while ((n = gzread(in, buffer, sizeof(buffer))) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+    bool broken = n < 0;
+    gzclose(in);
+    if (broken)
+        return fail("corrupt gzip data");
+    data.shrink_to_fit();
+
+    if (data.size() < 0x40 || read32(0) != 0x206D6756) // "Vgm "
+        return fail("not a VGM file");
+    head.version = read32(0x08);
+    head.snClock = read32(0x0C) & 0x3FFFFFFF;
+    head.ymClock = head.version >= 0x110 ? read32(0x2C) : read32(0x10);
+    head.ymClock &= 0x3FFFFFFF;
+    head.totalSamples = read32(0x18);
+    head.loopOffset = read32(0x1C) ? read32(0x1C) + 0x1C : 0;
+    head.loopSamples = read32(0x20);
+    head.dataOffset = head.version >= 0x150 && read32(0x34)
+        ? read32(0x34) + 0x34 : 0x40;
+    if (head.dataOffset >= data.size())
+        return fail("data offset past the end of the file");
+    if (head.loopOffset >= data.size())
+        head.loopOffset = 0;
+    return true;
+}
+
+namespace {
+
+// renders the writes into the chip cores as they come
+class MixSink : public VgmSink {
+    public:
+    explicit MixSink(ChipMix &mix)
+        : mix(mix), rate(mix.ym.sampleRate()), samples(0) { }
+
+    void ym(uint8_t part, uint8_t reg, uint8_t data) {
+        mix.renderTo(samples * rate / VgmPlayer::VGM_RATE);
+        mix.ym.write(part, reg, data);
+    }
+    void sn(uint8_t data) {
+        mix.renderTo(samples * rate / VgmPlayer::VGM_RATE);
+        mix.sn.write(data);
+    }
+    void wait(uint32_t n) { samples += n; }
+
+    void finish() { mix.renderTo(samples * rate / VgmPlayer::VGM_RATE); }
+
+    private:
+    ChipMix &mix;
+    const uint64_t rate;
+    uint64_t samples; // VGM clock
+};
+
+}
+
+bool VgmPlayer::render(const char *wavPath, unsigned loops) {
+    delete mix;
+    mix = new ChipMix(head.ymClock ? head.ymClock : DEFAULT_YM_CLOCK,
+                      head.snClock);
+    if (!mix->open(wavPath))
+        return fail("cannot write WAV");
+    MixSink sink(*mix);
+    if (!play(sink, loops))
+        return false;
+    sink.finish();
+    mix->close();
+    return true;
+}
+
+bool VgmPlayer::play(VgmSink &sink, unsigned loops) {
+    pcm.clear();
+    uint32_t pcmPos = 0;
+    uint32_t pos = head.dataOffset;
+    const uint32_t size = data.size();
+    bool ended = false;
+
+    while (!ended) {
+        if (pos >= size)
+            break;
+        uint8_t cmd = data[pos];
+        uint32_t wait = 0;
+        uint32_t length;
+        if (cmd >= 0x70 && cmd <= 0x7F) {
+            wait = (cmd & 0x0F) + 1;
+            length = 1;
+        } else if (cmd >= 0x80 && cmd <= 0x8F) {
+            sink.ym(0, 0x2A, pcmPos < pcm.size() ? pcm[pcmPos] : 0x80);
+            pcmPos++;
+            wait = cmd & 0x0F;
+            length = 1;
+        } else if (cmd >= 0x30 && cmd <= 0x3F) {
+            length = 2;
+        } else if (cmd >= 0x40 && cmd <= 0x4E) {
+            length = 3;
+        } else if (cmd >= 0x51 && cmd <= 0x5F && cmd != 0x52 && cmd != 0x53) {
+            length = 3;
+        } else if (cmd >= 0xA0 && cmd <= 0xBF) {
+            length = 3;
+        } else if (cmd >= 0xC0 && cmd <= 0xDF) {
+            length = 4;
+        } else if (cmd >= 0xE1) {
+            length = 5;
+        } else {
+            switch (cmd) {
+            case 0x4F: // Game Gear stereo, not emulated
+            case 0x94:
+                length = 2;
+                break;
+            case 0x50:
+                if (pos + 1 < size)
+                    sink.sn(data[pos + 1]);
+                length = 2;
+                break;
+            case 0x52:
+            case 0x53:
+                if (pos + 2 < size)
+                    sink.ym(cmd & 1, data[pos + 1], data[pos + 2]);
+                length = 3;
+                break;
+            case 0x61:
+                wait = pos + 2 < size ? data[pos + 1] | data[pos + 2] << 8 : 0;
+                length = 3;
+                break;
+            case 0x62:
+                wait = 735;
+                length = 1;
+                break;
+            case 0x63:
+                wait = 882;
+                length = 1;
+                break;
+            case 0x66:
+                if (loops && head.loopOffset) {
+                    loops--;
+                    pos = head.loopOffset;
+                    continue;
+                }
+                ended = true;
+                length = 1;
+                break;
+            case 0x67: { // data block: 0x67 0x66 type size32 data
+                uint32_t blockSize = read32(pos + 3) & 0x7FFFFFFF;
+                uint32_t start = pos + 7;
+                if (start + blockSize > size)
+                    return fail("truncated data block");
+                if (data[pos + 2] == 0x00)
+                    pcm.insert(pcm.end(), data.begin() + start,
+                               data.begin() + start + blockSize);
+                length = 7 + blockSize;
+                break;
+            }
+            case 0x90:
+            case 0x91:
+            case 0x95:
+                length = 5;
+                break;
+            case 0x92:
+                length = 6;
+                break;
+            case 0x93:
+                length = 11;
+                break;
+            case 0xE0:
+                pcmPos = read32(pos + 1);
+                length = 5;
+                break;
+            default:
+                return fail("unknown command");
+            }
+        }
+        if (wait)
+            sink.wait(wait);
+        pos += length;
+    }
+    return true;
+}
@@ -0,0 +1,82 @@
+/**
+ * VGM/VGZ playback into the host chip cores.
+ *
+ * Only the YM2612 and SN76489 are emulated; commands for other chips are
+ * skipped. Time is VGM's 44100 Hz sample clock, mapped onto the YM2612
+ * output rate.
+ */
+#ifndef VGM_PLAYER_H__
+#define VGM_PLAYER_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "ChipMix.h"
+
+/* Receives a file's chip writes in order, wait() in VGM samples */
+class VgmSink {
+    public:
+    virtual ~VgmSink() { }
+    virtual void ym(uint8_t part, uint8_t reg, uint8_t data) = 0;
+    virtual void sn(uint8_t data) = 0;
+    virtual void wait(uint32_t samples) = 0;
+};
+
+class VgmPlayer {
+    public:
+    enum {
+        VGM_RATE = 44100,
+        DEFAULT_YM_CLOCK = 7670453 // NTSC Mega Drive
+    };
+
+    struct Header {
+        uint32_t version;
+        uint32_t snClock;
+        uint32_t ymClock;
+        uint32_t totalSamples;
+        uint32_t loopOffset; // absolute, 0 if none
+        uint32_t loopSamples;
+        uint32_t dataOffset; // absolute
+    };
+
+    VgmPlayer() : mix(NULL) { }
+    ~VgmPlayer() { delete mix; }
+
+    /* Read a .vgm or gzip compressed .vgz file, false with error() set on
+     * failure */
+    bool load(const std::string &path);
+
+    /* Play the file, then the loop section loops more times, into a WAV
+     * file at wavPath (NULL for fingerprint only) */
+    bool render(const char *wavPath, unsigned loops = 0);
+
+    /* Walk the file, then the loop section loops more times, passing the
+     * writes and waits to sink. DAC data blocks are resolved into 0x2A
+     * writes. */
+    bool play(VgmSink &sink, unsigned loops = 0);
+
+    const Header &header() const { return head; }
+    const std::string &error() const { return message; }
+    const ChipMix &output() const { return *mix; }
+
+    /* bytes held for this file: the VGM data, PCM bank and chip state */
+    size_t footprint() const {
+        return data.capacity() + pcm.capacity() + sizeof(ChipMix);
+    }
+
+    private:
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> pcm; // YM2612 DAC data blocks
+    Header head;
+    std::string message;
+    ChipMix *mix;
+
+    bool fail(const std::string &what) {
+        message = what;
+        return false;
+    }
+    uint32_t read32(uint32_t offset) const;
+};
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ * Streaming 16 bit PCM WAV writer with a running FNV-1a fingerprint of the
+ * sample data, so renders can be compared against golden hashes without
+ * keeping the audio in memory.
+ */
+#ifndef WAV_WRITER_H__
+#define WAV_WRITER_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+class WavWriter {
+    public:
+    WavWriter() : file(NULL), frames(0), channels(2), hash(FNV_OFFSET) { }
+    ~WavWriter() { close(); }
+
+    /* path may be NULL to only compute the fingerprint */
+    bool open(const char *path, uint32_t rate, uint16_t channelCount = 2) {
+        channels = channelCount;
+        frames = 0;
+        hash = FNV_OFFSET;
+        if (!path)
+            return true;
+        file = fopen(path, "wb");
+        if (!file)
+            return false;
+        writeHeader(rate);
+        sampleRate = rate;
+        return true;
+    }
+
+    void write(const int16_t *samples, size_t frameCount) {
+        const size_t count = frameCount * channels;
+        for (size_t i = 0; i < count; i++) {
+            uint8_t le[2] = {
+                (uint8_t)(samples[i] & 0xFF), (uint8_t)(samples[i] >> 8)
+            };
+            hash = (hash ^ le[0]) * FNV_PRIME;
+            hash = (hash ^ le[1]) * FNV_PRIME;
+            if (file)
+                fwrite(le, 1, 2, file);
+        }
+        frames += frameCount;
+    }
+
+    void close() {
+        if (!file)
+            return;
+        fseek(file, 0, SEEK_SET);
+        writeHeader(sampleRate);
+        fclose(file);
+        file = NULL;
+    }
+
+    uint64_t fingerprint() const { return hash; }
+    uint64_t frameCount() const { return frames; }
+
+    private:
+    static const uint64_t FNV_OFFSET = 0xCBF29CE484222325ULL;
+    static const uint64_t FNV_PRIME = 0x100000001B3ULL;
+
+    FILE *file;
+    uint64_t frames;
+    uint16_t channels;
+    uint32_t sampleRate;
+    uint64_t hash;
+
+    void put32(uint32_t v) {
+        uint8_t b[4] = {
+            (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)
+        };
+        fwrite(b, 1, 4, file);
+    }
+
+    void put16(uint16_t v) {
+        uint8_t b[2] = { (uint8_t)v, (uint8_t)(v >> 8) };
+        fwrite(b, 1, 2, file);
+    }
+
+    void writeHeader(uint32_t rate) {
+        uint32_t dataBytes = (uint32_t)(frames * channels * 2);
+        fwrite("RIFF", 1, 4, file);
+        put32(36 + dataBytes);
+        fwrite("WAVEfmt ", 1, 8, file);
+        put32(16);
+        put16(1); // PCM
+        put16(channels);
+        put32(rate);
+        put32(rate * channels * 2);
+        put16(channels * 2);
+        put16(16);
+        fwrite("data", 1, 4, file);
+        put32(dataBytes);
+    }
+};
+
+#endif
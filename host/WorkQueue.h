@@ -0,0 +1,79 @@
+/**
+ * Work-stealing job queue: every worker owns a deque and takes jobs from
+ * its back, idle workers steal from the back of the others too. Jobs are
+ * pushed biggest first, so the back holds the biggest one left and a
+ * steal takes over as much of a busy worker's load as it can. Jobs are
+ * never added once run() starts, so a worker is done when every deque is
+ * empty.
+ */
+#ifndef WORK_QUEUE_H__
+#define WORK_QUEUE_H__
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+template <typename Job>
+class WorkQueue {
+    public:
+    explicit WorkQueue(unsigned workers)
+        : queues(workers ? workers : 1) { }
+
+    /* deal jobs round robin; push the biggest first so the long ones
+     * start early and the short ones fill in at the end */
+    void push(const Job &job) {
+        queues[next++ % queues.size()].jobs.push_front(job);
+    }
+
+    /* run every job on the workers, worker numbers are 0..workers-1 */
+    void run(const std::function<void(const Job &, unsigned)> &work) {
+        std::vector<std::thread> threads;
+        for (unsigned w = 1; w < queues.size(); w++)
+            threads.push_back(std::thread(&WorkQueue::worker, this, w, work));
+        worker(0, work);
+        for (size_t i = 0; i < threads.size(); i++)
+            threads[i].join();
+    }
+
+    private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<Job> jobs;
+    };
+    std::vector<Queue> queues;
+    size_t next = 0;
+
+    bool take(unsigned w, Job &job) {
+        Queue &own = queues[w];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (own.jobs.empty())
+            return false;
+        job = own.jobs.back();
+        own.jobs.pop_back();
+        return true;
+    }
+
+    bool steal(unsigned w, Job &job) {
+        for (size_t i = 1; i < queues.size(); i++) {
+            Queue &victim = queues[(w + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.jobs.empty()) {
+                job = victim.jobs.back();
+                victim.jobs.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void worker(unsigned w,
+                std::function<void(const Job &, unsigned)> work) {
+        Job job;
+        while (take(w, job) || steal(w, job))
+            work(job, w);
+    }
+};
+
+#endif
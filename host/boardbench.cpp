@@ -0,0 +1,464 @@
+/**
+ * boardbench - the chip drivers on every board profile of Board.h, on the
+ * host shim.
+ *
+ * Each profile carries the same register stream through the drivers the
+ * sketches use: YM2612 writes one at a time (writeReg), the same writes
+ * deferred and flushed (YM2612Scheduler), SN76489 bytes (writeByte) and
+ * bare data bus writes. A hook on the profile's strobe pins decodes every
+ * write back off the bus, A1, A0 and dataBusRead() at the rising edge, and
+ * checks it against what was sent, so a profile with a wrong pin or bus
+ * mapping fails. Costs are in simulated time: the bus delays plus a cycle
+ * per port write, so a bus split over two ports shows against one that is
+ * a whole port.
+ *
+ * Every line a profile uses must be on a pin of its own: each data bus
+ * bit, found by setting it alone, the strobes and address lines of both
+ * chips and of the second pair where the profile has one, the chip
+ * clocks its begin() makes outputs and the YM2612's IRQ. A pin two of
+ * them share counts as an error.
+ *
+ * Results go to stdout as a table and, with -o, to a JSON file with one
+ * result per line. -b compares against such a file and exits 1 when a cost
+ * got worse by more than the tolerance. Any decoding mismatch exits 1.
+ *
+ * Usage: boardbench [-o results.json] [-b baseline.json] [-t percent]
+ *                   [-l label]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "YM2612.h"
+#include "SN76489.h"
+
+// the shim runs a sketch's loop(); this tool drives the drivers itself
+void loop() { }
+
+static const unsigned YM_WRITES = 256;
+static const unsigned SN_WRITES = 256;
+static const unsigned BUS_WRITES = 1024;
+
+struct Result {
+    std::string board;
+    unsigned checked; // writes decoded and compared
+    unsigned errors;
+    double ymUs, flushUs, snUs; // per write, 0 without the chip
+    double busCycles; // per dataBusWrite()
+};
+
+struct YmWrite {
+    byte part;
+    byte reg;
+    byte data;
+};
+
+/* what the strobe hooks expect and what they found */
+static std::vector<YmWrite> ymExpected;
+static std::vector<byte> snExpected;
+static size_t seen;
+static unsigned errors;
+static bool ymHaveAddress;
+static YmWrite ymCurrent;
+
+// deterministic register stream: channel and slot registers of both
+// parts, so A1 and the whole data bus toggle
+static std::vector<YmWrite> ymStream() {
+    std::vector<YmWrite> w;
+    uint32_t x = 0x2612;
+    for (unsigned i = 0; i < YM_WRITES; i++) {
+        x = x * 1103515245 + 12345;
+        YmWrite y;
+        y.part = x >> 31;
+        y.reg = 0x30 + (x >> 16) % (0xB7 - 0x30);
+        y.data = x >> 8;
+        w.push_back(y);
+    }
+    return w;
+}
+
+static std::vector<byte> snStream() {
+    std::vector<byte> w;
+    uint32_t x = 0x76489;
+    for (unsigned i = 0; i < SN_WRITES; i++) {
+        x = x * 1103515245 + 12345;
+        w.push_back(x >> 16);
+    }
+    return w;
+}
+
+template<class P> static bool rose(HostPort &port, uint8_t previous) {
+    return &port == &P::out() && !(previous & bit(P::BIT))
+        && (port & bit(P::BIT));
+}
+
+template<class B> static void onYmPort(HostPort &port, uint8_t previous) {
+    if (!rose<typename B::YM_WR>(port, previous))
+        return;
+    const byte data = B::dataBusRead();
+    const byte part = B::YM_A1::isHigh();
+    if (!B::YM_A0::isHigh()) {
+        ymCurrent.part = part;
+        ymCurrent.reg = data;
+        ymHaveAddress = true;
+        return;
+    }
+    const YmWrite *want = seen < ymExpected.size() ? &ymExpected[seen] : NULL;
+    if (!ymHaveAddress || !want || ymCurrent.part != want->part
+            || ymCurrent.reg != want->reg || part != want->part
+            || data != want->data) {
+        if (errors++ < 4)
+            fprintf(stderr, "YM2612 write %zu: got %u:%02X=%02X\n", seen,
+                    ymCurrent.part, ymCurrent.reg, data);
+    }
+    ymHaveAddress = false;
+    seen++;
+}
+
+template<class B> static void onSnPort(HostPort &port, uint8_t previous) {
+    if (!rose<typename B::SN_WE>(port, previous))
+        return;
+    const byte data = B::dataBusRead();
+    if (seen >= snExpected.size() || data != snExpected[seen]) {
+        if (errors++ < 4)
+            fprintf(stderr, "SN76489 write %zu: got %02X\n", seen, data);
+    }
+    seen++;
+}
+
+static double us(uint64_t cycles, unsigned writes) {
+    return cycles * 1e6 / F_CPU / writes;
+}
+
+template<bool> struct Has { };
+
+/* a line of a profile: port A-D and bit */
+struct Line {
+    std::string name;
+    int port;
+    byte bit;
+};
+
+static HostPort *const PORTS[] = { &PORTA, &PORTB, &PORTC, &PORTD };
+static HostPort *const DDRS[] = { &DDRA, &DDRB, &DDRC, &DDRD };
+static HostPort *const PINS[] = { &PINA, &PINB, &PINC, &PIND };
+static const int PORT_COUNT = sizeof(PORTS) / sizeof(PORTS[0]);
+
+static int portIndex(HostPort *const *regs, HostPort &reg) {
+    for (int i = 0; i < PORT_COUNT; i++) {
+        if (regs[i] == &reg)
+            return i;
+    }
+    return -1;
+}
+
+// adds the profile's pin if it has one by that name
+#define PROFILE_LINE(pin, regs, reg) \
+    template<class B> static auto line_##pin(std::vector<Line> &lines, \
+            int) -> decltype(B::pin::BIT, void()) { \
+        lines.push_back(Line { #pin, portIndex(regs, B::pin::reg()), \
+            B::pin::BIT }); \
+    } \
+    template<class B> static void line_##pin(std::vector<Line> &, long) { }
+
+PROFILE_LINE(YM_IC, PORTS, out)
+PROFILE_LINE(YM_CS, PORTS, out)
+PROFILE_LINE(YM_WR, PORTS, out)
+PROFILE_LINE(YM_WR2, PORTS, out)
+PROFILE_LINE(YM_RD, PORTS, out)
+PROFILE_LINE(YM_A0, PORTS, out)
+PROFILE_LINE(YM_A1, PORTS, out)
+PROFILE_LINE(SN_WE, PORTS, out)
+PROFILE_LINE(SN_WE2, PORTS, out)
+PROFILE_LINE(SN_CE, PORTS, out)
+PROFILE_LINE(SN_READY, PORTS, out)
+PROFILE_LINE(YM_IRQ, PINS, in)
+#undef PROFILE_LINE
+
+template<class B> static unsigned checkLines() {
+    std::vector<Line> lines;
+    unsigned clashes = 0;
+    hostReset();
+    byte outputs[PORT_COUNT];
+    for (int i = 0; i < PORT_COUNT; i++)
+        outputs[i] = *DDRS[i];
+    B::begin();
+    for (int i = 0; i < PORT_COUNT; i++)
+        outputs[i] = *DDRS[i] & ~outputs[i];
+
+    for (byte d = 0; d < 8; d++) {
+        byte before[PORT_COUNT];
+        B::dataBusWrite(0);
+        for (int i = 0; i < PORT_COUNT; i++)
+            before[i] = *PORTS[i];
+        B::dataBusWrite(bit(d));
+        unsigned found = 0;
+        for (int i = 0; i < PORT_COUNT; i++) {
+            for (byte b = 0; b < 8; b++) {
+                if (!((*PORTS[i] ^ before[i]) & bit(b)))
+                    continue;
+                lines.push_back(Line { "D" + std::to_string(d), i, b });
+                outputs[i] &= ~bit(b);
+                found++;
+            }
+        }
+        if (found != 1) {
+            fprintf(stderr, "data bus bit %u is on %u pins\n", d, found);
+            clashes++;
+        }
+    }
+    const size_t named = lines.size();
+    line_YM_IC<B>(lines, 0);
+    line_YM_CS<B>(lines, 0);
+    line_YM_WR<B>(lines, 0);
+    line_YM_WR2<B>(lines, 0);
+    line_YM_RD<B>(lines, 0);
+    line_YM_A0<B>(lines, 0);
+    line_YM_A1<B>(lines, 0);
+    line_SN_WE<B>(lines, 0);
+    line_SN_WE2<B>(lines, 0);
+    line_SN_CE<B>(lines, 0);
+    line_SN_READY<B>(lines, 0);
+    // what else begin() makes outputs is the chip clocks, but for the
+    // lines it sets once (see Board.h)
+    for (size_t i = named; i < lines.size(); i++) {
+        if (lines[i].name == "YM_CS" || lines[i].name == "YM_RD"
+                || lines[i].name == "SN_CE")
+            outputs[lines[i].port] &= ~bit(lines[i].bit);
+    }
+    line_YM_IRQ<B>(lines, 0);
+    for (int i = 0; i < PORT_COUNT; i++) {
+        for (byte b = 0; b < 8; b++) {
+            if (outputs[i] & bit(b))
+                lines.push_back(Line { "clock", i, b });
+        }
+    }
+
+    for (size_t i = 0; i < lines.size(); i++) {
+        for (size_t j = i + 1; j < lines.size(); j++) {
+            if (lines[i].port != lines[j].port || lines[i].bit != lines[j].bit)
+                continue;
+            fprintf(stderr, "%s and %s share P%c%u\n", lines[i].name.c_str(),
+                    lines[j].name.c_str(), 'A' + lines[i].port, lines[i].bit);
+            clashes++;
+        }
+    }
+    return clashes;
+}
+template<class B> static void benchYm(Result &, Has<false>) { }
+
+template<class B> static void benchYm(Result &r, Has<true>) {
+    typedef YM2612Chip<B> Chip;
+    static Chip ym; // the shadow state is too big for the stack of a test
+    hostReset();
+    B::begin();
+    Chip::resetChips();
+    ym.begin();
+    ymExpected = ymStream();
+    B::YM_WR::out().hook = onYmPort<B>;
+
+    // one write at a time, each waiting out the chip
+    seen = 0;
+    ymHaveAddress = false;
+    uint64_t start = hostCycles;
+    for (size_t i = 0; i < ymExpected.size(); i++) {
+        const YmWrite &w = ymExpected[i];
+        ym.writeReg(static_cast<YM2612Map::part_e>(w.part), w.reg, w.data);
+    }
+    r.ymUs = us(hostCycles - start, ymExpected.size());
+    r.checked += seen;
+    if (seen != ymExpected.size())
+        errors++;
+
+    // deferred and flushed in batches, as MegaSynth does for patch CCs
+    seen = 0;
+    start = hostCycles;
+    for (size_t i = 0; i < ymExpected.size(); i += YM2612_QUEUE_LENGTH) {
+        ym.defer();
+        for (size_t j = i; j < i + YM2612_QUEUE_LENGTH
+                && j < ymExpected.size(); j++) {
+            const YmWrite &w = ymExpected[j];
+            ym.writeReg(static_cast<YM2612Map::part_e>(w.part), w.reg,
+                        w.data);
+        }
+        YM2612Scheduler::flush(ym);
+    }
+    r.flushUs = us(hostCycles - start, ymExpected.size());
+    r.checked += seen;
+    if (seen != ymExpected.size())
+        errors++;
+}
+
+template<class B> static void benchSn(Result &, Has<false>) { }
+
+template<class B> static void benchSn(Result &r, Has<true>) {
+    typedef SN76489Chip<B> Chip;
+    hostReset();
+    B::begin();
+    Chip::begin();
+    snExpected = snStream();
+    B::SN_WE::out().hook = onSnPort<B>;
+    seen = 0;
+    const uint64_t start = hostCycles;
+    for (size_t i = 0; i < snExpected.size(); i++)
+        Chip::writeByte(snExpected[i]);
+    r.snUs = us(hostCycles - start, snExpected.size());
+    r.checked += seen;
+    if (seen != snExpected.size())
+        errors++;
+}
+
+template<class B> static Result run(const char *name) {
+    Result r = Result();
+    r.board = name;
+    errors = 0;
+    benchYm<B>(r, Has<B::HAS_YM>());
+    benchSn<B>(r, Has<B::HAS_SN>());
+    errors += checkLines<B>();
+
+    // the bus alone: every value, with the readback checked
+    hostReset();
+    B::begin();
+    const uint64_t start = hostCycles;
+    for (unsigned i = 0; i < BUS_WRITES; i++) {
+        B::dataBusWrite(i);
+        if (B::dataBusRead() != (byte)i)
+            errors++;
+    }
+    r.busCycles = (double)(hostCycles - start) / BUS_WRITES;
+    r.errors = errors;
+    return r;
+}
+
+static void writeJson(FILE *out, const char *label,
+                      const std::vector<Result> &results) {
+    fprintf(out, "{\"label\":\"%s\",\"results\":[\n", label);
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        fprintf(out, "{\"board\":\"%s\",\"checked\":%u,\"errors\":%u,"
+                "\"ym_us\":%.2f,\"flush_us\":%.2f,\"sn_us\":%.2f,"
+                "\"bus_cycles\":%.2f}%s\n",
+                r.board.c_str(), r.checked, r.errors, r.ymUs, r.flushUs,
+                r.snUs, r.busCycles, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "]}\n");
+}
+
+/* pull one number out of a result line written by writeJson */
+static bool field(const char *line, const char *key, double &value) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(line, pattern);
+    return p && sscanf(p + strlen(pattern), "%lf", &value) == 1;
+}
+
+static bool worse(double now, double base, double tolerance) {
+    // a little slack so tiny baselines do not trip on rounding
+    return now > base * (1 + tolerance / 100) + 0.05;
+}
+
+static int compare(const char *path, const std::vector<Result> &results,
+                   double tolerance) {
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return 2;
+    }
+    int regressions = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), in)) {
+        double ym, flush, sn, bus;
+        const char *name = strstr(line, "\"board\":\"");
+        if (!name || !field(line, "ym_us", ym) || !field(line, "flush_us", flush)
+                || !field(line, "sn_us", sn)
+                || !field(line, "bus_cycles", bus))
+            continue;
+        name += strlen("\"board\":\"");
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result &r = results[i];
+            if (strncmp(name, r.board.c_str(), r.board.size())
+                    || name[r.board.size()] != '"')
+                continue;
+            if (worse(r.ymUs, ym, tolerance)
+                    || worse(r.flushUs, flush, tolerance)
+                    || worse(r.snUs, sn, tolerance)
+                    || worse(r.busCycles, bus, tolerance)) {
+                printf("REGRESSION %s: ym %.2f -> %.2f us, flush %.2f -> "
+                       "%.2f us, sn %.2f -> %.2f us, bus %.2f -> %.2f "
+                       "cycles\n", r.board.c_str(), ym, r.ymUs, flush,
+                       r.flushUs, sn, r.snUs, bus, r.busCycles);
+                regressions++;
+            }
+        }
+    }
+    fclose(in);
+    return regressions ? 1 : 0;
+}
+
+#define BOARD(b) run<b>(#b)
+
+int main(int argc, char **argv) {
+    const char *outPath = NULL;
+    const char *baselinePath = NULL;
+    const char *label = "";
+    double tolerance = 5;
+    int opt;
+    while ((opt = getopt(argc, argv, "o:b:t:l:h")) != -1) {
+        switch (opt) {
+        case 'o':
+            outPath = optarg;
+            break;
+        case 'b':
+            baselinePath = optarg;
+            break;
+        case 't':
+            tolerance = atof(optarg);
+            break;
+        case 'l':
+            label = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: boardbench [-o results.json] "
+                    "[-b baseline.json] [-t percent] [-l label]\n");
+            return 2;
+        }
+    }
+
+    std::vector<Result> results;
+    results.push_back(BOARD(TrahageanBoard));
+    results.push_back(BOARD(Mighty1284Board));
+    results.push_back(BOARD(Mighty644Board));
+    results.push_back(BOARD(PortDYmBoard));
+    results.push_back(BOARD(ShiftedYmBoard));
+    results.push_back(BOARD(PortDSnBoard));
+    results.push_back(BOARD(ShiftedSnBoard));
+    results.push_back(BOARD(RewiredSnBoard));
+
+    int failed = 0;
+    printf("%-16s %7s %6s %9s %9s %9s %9s\n", "board", "writes", "errors",
+           "ym us", "flush us", "sn us", "bus cyc");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        printf("%-16s %7u %6u %9.2f %9.2f %9.2f %9.2f\n", r.board.c_str(),
+               r.checked, r.errors, r.ymUs, r.flushUs, r.snUs, r.busCycles);
+        if (r.errors)
+            failed++;
+    }
+
+    if (outPath) {
+        FILE *out = fopen(outPath, "w");
+        if (!out) {
+            perror(outPath);
+            return 2;
+        }
+        writeJson(out, label, results);
+        fclose(out);
+    }
+    int status = baselinePath ? compare(baselinePath, results, tolerance) : 0;
+    return failed && !status ? 1 : status;
+}
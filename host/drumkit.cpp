@@ -0,0 +1,247 @@
+/**
+ * drumkit - build the EEPROM image of custom drum kits for
+ * Trahagean/DrumKit.h. Each kit file is one kit, kit 1 first; a kit
+ * starts as a copy of the built in one and its lines replace keys:
+ *
+ *     # key  noise     rate   level  decay  period
+ *     36     periodic  tone3  0      8      130
+ *     38     white     1024   0      12     0
+ *
+ * noise is periodic or white, rate 512, 1024, 2048 or tone3; level adds
+ * 2dB steps, decay is ms per 2dB step (0 holds until the note off) and
+ * period is tone 3's for tone3 (0 follows the key). An output ending in
+ * .bin is a raw image of the whole EEPROM (synthrender -E); anything else
+ * is Intel HEX of the kits alone, for avrdude -U eeprom:w:kits.eep:i.
+ * Channel 9 selects kit n with CC 0 = n.
+ *
+ * With -c it writes nothing and checks DrumKit's lookup instead: kit 1
+ * is the built in one with every key's decay set to its place, kit 2 is
+ * erased. Every key 0-127 must resolve to the place of the same note in
+ * range, or the octave of it nearest the range, with the built in note
+ * there; only kits 0 and 1 can be selected. A failure exits 1.
+ *
+ * Usage: drumkit -o out kit1.txt [kit2.txt ...]
+ *        drumkit -c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Arduino.h"
+#include "DrumKit.h"
+
+// the shim's EEPROM, which DrumKit.h reads for kits other than the built in
+uint8_t hostEeprom[E2END + 1];
+
+static bool parseLine(char *line, unsigned lineNumber, byte *kit) {
+    char noise[16], rate[16];
+    unsigned key, level, decay, period;
+    char *hash = strchr(line, '#');
+    if (hash)
+        *hash = 0;
+    char extra;
+    int n = sscanf(line, "%u %15s %15s %u %u %u %c", &key, noise, rate,
+                   &level, &decay, &period, &extra);
+    if (n <= 0)
+        return true; // blank or comment
+    if (n != 6) {
+        fprintf(stderr, "line %u: expected key noise rate level decay "
+                "period\n", lineNumber);
+        return false;
+    }
+    if (key < DrumKit::KEY_FIRST
+            || key >= DrumKit::KEY_FIRST + DrumKit::KEY_COUNT) {
+        fprintf(stderr, "line %u: key %u is not in %u-%u\n", lineNumber, key,
+                DrumKit::KEY_FIRST, DrumKit::KEY_FIRST + DrumKit::KEY_COUNT - 1);
+        return false;
+    }
+    byte fb;
+    if (!strcmp(noise, "periodic")) {
+        fb = SN76489Map::PERIODIC_NOISE;
+    } else if (!strcmp(noise, "white")) {
+        fb = SN76489Map::WHITE_NOISE;
+    } else {
+        fprintf(stderr, "line %u: noise is periodic or white\n", lineNumber);
+        return false;
+    }
+    byte shift;
+    if (!strcmp(rate, "512")) {
+        shift = SN76489Map::SHIFT_512;
+    } else if (!strcmp(rate, "1024")) {
+        shift = SN76489Map::SHIFT_1024;
+    } else if (!strcmp(rate, "2048")) {
+        shift = SN76489Map::SHIFT_2048;
+    } else if (!strcmp(rate, "tone3")) {
+        shift = SN76489Map::SHIFT_CHAN3;
+    } else {
+        fprintf(stderr, "line %u: rate is 512, 1024, 2048 or tone3\n",
+                lineNumber);
+        return false;
+    }
+    if (level > 15 || decay > 255 || period > 0x3FF) {
+        fprintf(stderr, "line %u: level is 0-15, decay 0-255 and period "
+                "0-1023\n", lineNumber);
+        return false;
+    }
+    byte *note = kit + 1 + (key - DrumKit::KEY_FIRST) * DrumKit::NOTE_SIZE;
+    note[0] = level << 4 | fb << 2 | shift;
+    note[1] = decay;
+    note[2] = lowByte(period);
+    note[3] = highByte(period);
+    return true;
+}
+
+static void copyBuiltIn(byte *kit) {
+    DrumKit builtIn;
+    builtIn.begin();
+    kit[0] = DrumKit::KIT_MAGIC;
+    for (byte i = 0; i < DrumKit::KEY_COUNT; i++) {
+        DrumKit::Note note;
+        builtIn.lookup(DrumKit::KEY_FIRST + i, note);
+        byte *raw = kit + 1 + i * DrumKit::NOTE_SIZE;
+        raw[0] = note.noise;
+        raw[1] = note.decay;
+        raw[2] = lowByte(note.period);
+        raw[3] = highByte(note.period);
+    }
+}
+
+static bool readKit(const char *path, byte *kit) {
+    copyBuiltIn(kit);
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    unsigned lineNumber = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), in)) {
+        ok = parseLine(line, ++lineNumber, kit);
+    }
+    fclose(in);
+    if (!ok)
+        fprintf(stderr, "%s: not written\n", path);
+    return ok;
+}
+
+// the place a key should resolve to: itself in range, else the nearest
+// octave of it that is
+static unsigned expectedPlace(unsigned key) {
+    while (key < DrumKit::KEY_FIRST)
+        key += 12;
+    while (key >= DrumKit::KEY_FIRST + DrumKit::KEY_COUNT)
+        key -= 12;
+    return key - DrumKit::KEY_FIRST;
+}
+
+static unsigned checkLookup() {
+    memset(hostEeprom, 0xFF, sizeof(hostEeprom));
+    byte *first = hostEeprom + DRUM_EEPROM_BASE;
+    copyBuiltIn(first);
+    for (byte i = 0; i < DrumKit::KEY_COUNT; i++) {
+        first[1 + i * DrumKit::NOTE_SIZE + 1] = i + 1; // decay, never 0
+    }
+    unsigned errors = 0;
+    DrumKit kits;
+    kits.begin();
+    if (!kits.select(DrumKit::BUILT_IN) || !kits.select(1)) {
+        fprintf(stderr, "kits 0 and 1 cannot be selected\n");
+        errors++;
+    }
+    if (kits.select(2) || kits.select(DRUM_EEPROM_KITS + 1)) {
+        fprintf(stderr, "an erased or missing kit was selected\n");
+        errors++;
+    }
+    for (unsigned key = 0; key < 128; key++) {
+        // kit 1 is still selected after the selections that failed
+        DrumKit::Note marked, note;
+        kits.select(1);
+        kits.lookup(key, marked);
+        kits.select(DrumKit::BUILT_IN);
+        kits.lookup(key, note);
+        const unsigned place = marked.decay - 1;
+        if (place != expectedPlace(key)) {
+            fprintf(stderr, "key %u: place %u, %u expected\n", key, place,
+                    expectedPlace(key));
+            errors++;
+            continue;
+        }
+        DrumKit::Note there;
+        kits.lookup(DrumKit::KEY_FIRST + place, there);
+        if (marked.noise != note.noise || marked.period != note.period
+                || note.noise != there.noise || note.decay != there.decay
+                || note.period != there.period) {
+            fprintf(stderr, "key %u: not the built in note of key %u\n",
+                    key, DrumKit::KEY_FIRST + place);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+static void hexRecord(FILE *out, unsigned address, const byte *data,
+                      unsigned length, byte type) {
+    byte sum = length + (address >> 8) + address + type;
+    fprintf(out, ":%02X%04X%02X", length, address & 0xFFFF, type);
+    for (unsigned i = 0; i < length; i++) {
+        fprintf(out, "%02X", data[i]);
+        sum += data[i];
+    }
+    fprintf(out, "%02X\n", (byte)-sum);
+}
+
+int main(int argc, char **argv) {
+    const char *outPath = NULL;
+    bool check = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "o:ch")) != -1) {
+        if (opt == 'o') {
+            outPath = optarg;
+        } else if (opt == 'c') {
+            check = true;
+        } else {
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (check && optind == argc) {
+        const unsigned errors = checkLookup();
+        printf("keys 0-127 looked up in kits 0 and 1, %u errors\n", errors);
+        return errors ? 1 : 0;
+    }
+    const int kits = argc - optind;
+    if (!outPath || kits < 1 || kits > DRUM_EEPROM_KITS) {
+        fprintf(stderr, "usage: drumkit -o out kit1.txt [kit2.txt ...], "
+                "at most %d kits, or drumkit -c\n", DRUM_EEPROM_KITS);
+        return 2;
+    }
+    memset(hostEeprom, 0xFF, sizeof(hostEeprom));
+    byte *first = hostEeprom + DRUM_EEPROM_BASE;
+    for (int k = 0; k < kits; k++) {
+        if (!readKit(argv[optind + k], first + k * DrumKit::KIT_SIZE))
+            return 1;
+    }
+
+    FILE *out = fopen(outPath, "wb");
+    if (!out) {
+        perror(outPath);
+        return 2;
+    }
+    const size_t length = strlen(outPath);
+    if (length > 4 && !strcmp(outPath + length - 4, ".bin")) {
+        fwrite(hostEeprom, 1, sizeof(hostEeprom), out);
+    } else {
+        const unsigned end = DRUM_EEPROM_BASE + kits * DrumKit::KIT_SIZE;
+        for (unsigned a = DRUM_EEPROM_BASE; a < end; a += 16) {
+            hexRecord(out, a, hostEeprom + a, end - a < 16 ? end - a : 16, 0);
+        }
+        hexRecord(out, 0, NULL, 0, 1); // end of file
+    }
+    if (fclose(out)) {
+        perror(outPath);
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+/**
+ * SN76489AN software core, see SN76489Core.h
+ */
+#include "SN76489Core.h"
+
+#include <string.h>
+
+namespace {
+
+/* 2dB per attenuation step, 15 is off: FULL_SCALE * 10^(-step / 10) */
+const uint16_t volume[16] = {
+    4096, 3254, 2584, 2053, 1631, 1295, 1029, 817,
+    649, 516, 410, 325, 258, 205, 163, 0
+};
+
+/* Noise shift rates for rate 0..2, in ticks between output toggles */
+const uint16_t noisePeriod[3] = { 0x10, 0x20, 0x40 };
+
+const uint16_t SHIFTER_RESET = 0x4000; // 15 bit register, top bit set
+
+} // namespace
+
+
+SN76489Core::SN76489Core(uint32_t clock) : masterClock(clock) {
+    reset();
+}
+
+
+void SN76489Core::reset() {
+    tickAccumulator = 0;
+    latched = 0;
+    memset(period, 0, sizeof(period));
+    memset(attenuation, 0x0F, sizeof(attenuation));
+    memset(counter, 0, sizeof(counter));
+    memset(polarity, 0, sizeof(polarity));
+    shifter = SHIFTER_RESET;
+}
+
+
+void SN76489Core::write(uint8_t data) {
+    if (data & 0x80) { // latch/data byte: 1 r r r d d d d
+        latched = (data >> 4) & 0x07;
+        uint8_t chan = latched >> 1;
+        if (latched & 1)
+            attenuation[chan] = data & 0x0F;
+        else if (chan == 3) {
+            period[3] = data & 0x07;
+            shifter = SHIFTER_RESET;
+        }
+        else
+            period[chan] = (period[chan] & 0x3F0) | (data & 0x0F);
+        return;
+    }
+    // data byte: 0 x d d d d d d, goes to the latched register
+    uint8_t chan = latched >> 1;
+    if (latched & 1)
+        attenuation[chan] = data & 0x0F;
+    else if (chan == 3) {
+        period[3] = data & 0x07;
+        shifter = SHIFTER_RESET;
+    }
+    else
+        period[chan] = (period[chan] & 0x00F) | ((data & 0x3F) << 4);
+}
+
+
+void SN76489Core::tick() {
+    for (uint8_t c = 0; c < 3; c++) {
+        if (counter[c] > 1) {
+            counter[c]--;
+            continue;
+        }
+        counter[c] = period[c] ? period[c] : 0x400;
+        polarity[c] ^= 1;
+    }
+    if (counter[3] > 1) {
+        counter[3]--;
+        return;
+    }
+    uint8_t rate = period[3] & 3;
+    counter[3] = rate == 3
+        ? (period[2] ? period[2] : 0x400) // follow tone channel 3
+        : noisePeriod[rate];
+    polarity[3] ^= 1;
+    if (polarity[3]) { // shift on the rising edge
+        uint16_t fb = (period[3] & 0x04)
+            ? ((shifter ^ (shifter >> 1)) & 1) // white: taps 0 and 1
+            : (shifter & 1); // periodic
+        shifter = (shifter >> 1) | (fb << 14);
+    }
+}
+
+
+void SN76489Core::render(int32_t *out, size_t frames, uint32_t rate,
+                         uint8_t outputs) {
+    const uint32_t tickRate = masterClock / CLOCK_DIVIDER;
+    for (size_t i = 0; i < frames; i++) {
+        int32_t sum = 0;
+        int32_t ticks = 0;
+        tickAccumulator += tickRate;
+        while (tickAccumulator >= rate) {
+            tickAccumulator -= rate;
+            tick();
+            for (uint8_t c = 0; c < 3; c++)
+                sum += polarity[c] ? volume[attenuation[c]]
+                    : -volume[attenuation[c]];
+            sum += (shifter & 1) ? volume[attenuation[3]]
+                : -volume[attenuation[3]];
+            ticks++;
+        }
+        if (ticks) // box filter over the ticks of this sample
+            sum /= ticks;
+        if (outputs & OUT_LEFT)
+            out[2 * i] += sum;
+        if (outputs & OUT_RIGHT)
+            out[2 * i + 1] += sum;
+    }
+}
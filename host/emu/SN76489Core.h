@@ -0,0 +1,55 @@
+/**
+ * SN76489AN software core for host side rendering.
+ *
+ * Three square wave tone generators and a noise generator clocked at
+ * clock / 16, with the TI part's 15 bit noise shift register and a period
+ * of 0 meaning 0x400. Output is box filtered down to the caller's sample
+ * rate with integer arithmetic only, so renders are bit exact everywhere.
+ */
+#ifndef SN76489_CORE_H__
+#define SN76489_CORE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+class SN76489Core {
+    public:
+    enum {
+        CHAN_COUNT = 4,
+        CLOCK_DIVIDER = 16, // master clocks per generator tick
+        FULL_SCALE = 4096 // one channel at 0dB
+    };
+    enum {
+        OUT_LEFT = 1,
+        OUT_RIGHT = 2,
+        OUT_BOTH = OUT_LEFT | OUT_RIGHT
+    };
+
+    SN76489Core(uint32_t clock = 4000000);
+
+    void reset();
+
+    /* One byte strobed in with WE: latch/data or data byte */
+    void write(uint8_t data);
+
+    /* Render mono samples at the given rate and add them to the outputs
+     * halves of interleaved stereo out[2 * frames] */
+    void render(int32_t *out, size_t frames, uint32_t rate,
+                uint8_t outputs = OUT_BOTH);
+
+    uint32_t clock() const { return masterClock; }
+
+    private:
+    uint32_t masterClock;
+    uint32_t tickAccumulator; // fraction of a tick, in 1/rate units
+    uint8_t latched; // register selected by the last latch byte
+    uint16_t period[CHAN_COUNT]; // channel 4 holds the noise control
+    uint8_t attenuation[CHAN_COUNT];
+    uint16_t counter[CHAN_COUNT];
+    uint8_t polarity[CHAN_COUNT];
+    uint16_t shifter; // noise LFSR
+
+    void tick();
+};
+
+#endif
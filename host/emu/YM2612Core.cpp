@@ -0,0 +1,645 @@
+/**
+ * YM2612 software core, see YM2612Core.h
+ */
+#include "YM2612Core.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace {
+
+/* Quarter wave log-sin and exp ROMs, generated the way the YM3438 stores
+ * them: 256 entries each, -log2(sin) in 4.8 fixed point and 2^x - 1 in
+ * 0.10 fixed point */
+struct Tables {
+    uint16_t logSin[256];
+    uint16_t exp[256];
+
+    Tables() {
+        for (int i = 0; i < 256; i++) {
+            double s = sin((2 * i + 1) * M_PI / 1024.0);
+            logSin[i] = (uint16_t)floor(-log2(s) * 256.0 + 0.5);
+            exp[i] = (uint16_t)floor((pow(2.0, i / 256.0) - 1.0) * 1024.0 + 0.5);
+        }
+    }
+};
+
+const Tables &tables() {
+    static const Tables t; // thread safe initialization since C++11
+    return t;
+}
+
+/* Detune in phase increment units, [DT & 3][key code] */
+const uint8_t dtTable[4][32] = {
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2,
+      2, 3, 3, 3, 4, 4, 4, 5, 5, 6, 6, 7, 8, 8, 8, 8 },
+    { 1, 1, 1, 1, 2, 2, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5,
+      5, 6, 6, 7, 8, 8, 9,10,11,12,13,14,16,16,16,16 },
+    { 2, 2, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5, 5, 6, 6, 7,
+      8, 8, 9,10,11,12,13,14,16,17,19,20,22,22,22,22 }
+};
+
+/* Key code note from F-number bits 10..7 */
+const uint8_t fnNote[16] = {
+    0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 3, 3, 3, 3, 3, 3
+};
+
+/* Envelope increments, [row][cycle]; rows 0-3 rates 0-11, 4-15 rates 12-14,
+ * 16 rate 15 */
+const uint8_t egInc[18][8] = {
+    { 0, 1, 0, 1, 0, 1, 0, 1 },
+    { 0, 1, 0, 1, 1, 1, 0, 1 },
+    { 0, 1, 1, 1, 0, 1, 1, 1 },
+    { 0, 1, 1, 1, 1, 1, 1, 1 },
+    { 1, 1, 1, 1, 1, 1, 1, 1 },
+    { 1, 1, 1, 2, 1, 1, 1, 2 },
+    { 1, 2, 1, 2, 1, 2, 1, 2 },
+    { 1, 2, 2, 2, 1, 2, 2, 2 },
+    { 2, 2, 2, 2, 2, 2, 2, 2 },
+    { 2, 2, 2, 4, 2, 2, 2, 4 },
+    { 2, 4, 2, 4, 2, 4, 2, 4 },
+    { 2, 4, 4, 4, 2, 4, 4, 4 },
+    { 4, 4, 4, 4, 4, 4, 4, 4 },
+    { 4, 4, 4, 8, 4, 4, 4, 8 },
+    { 4, 8, 4, 8, 4, 8, 4, 8 },
+    { 4, 8, 8, 8, 4, 8, 8, 8 },
+    { 8, 8, 8, 8, 8, 8, 8, 8 },
+    { 0, 0, 0, 0, 0, 0, 0, 0 }
+};
+
+/* LFO samples per step for LFOFREQ 0..7 (3.98Hz .. 72.2Hz at 128 steps) */
+const uint8_t lfoPeriod[8] = { 108, 77, 71, 67, 62, 44, 8, 5 };
+
+/* AM depth as a right shift of the 0..126 LFO triangle: 0, 1.4, 5.9, 11.8dB */
+const uint8_t amsShift[4] = { 8, 3, 1, 0 };
+
+/* PM depth, (2^(cents / 1200) - 1) << 16 for 0..80 cents */
+const uint16_t pmScale[8] = { 0, 129, 254, 379, 531, 760, 1524, 3064 };
+
+/* Modulation sources of each slot, as a bitmask of slots, [algorithm][slot]
+ * with slots in register order S1, S3, S2, S4 */
+const uint8_t modSource[8][4] = {
+    { 0, 1 << 2,            1 << 0, 1 << 1 },            // S1-S2-S3-S4
+    { 0, (1 << 0) | (1 << 2), 0,    1 << 1 },            // (S1+S2)-S3-S4
+    { 0, 1 << 2,            0,      (1 << 0) | (1 << 1) }, // (S1+(S2-S3))-S4
+    { 0, 0,                 1 << 0, (1 << 2) | (1 << 1) }, // ((S1-S2)+S3)-S4
+    { 0, 0,                 1 << 0, 1 << 1 },            // (S1-S2)+(S3-S4)
+    { 0, 1 << 0,            1 << 0, 1 << 0 },            // S1-(S2+S3+S4)
+    { 0, 0,                 1 << 0, 0 },                 // (S1-S2)+S3+S4
+    { 0, 0,                 0,      0 }                  // S1+S2+S3+S4
+};
+
+/* Carrier slots of each algorithm, slots in register order */
+const uint8_t carriers[8] = {
+    1 << 3, 1 << 3, 1 << 3, 1 << 3,
+    (1 << 2) | (1 << 3),
+    (1 << 1) | (1 << 2) | (1 << 3),
+    (1 << 1) | (1 << 2) | (1 << 3),
+    0x0F
+};
+
+/* 0x28 operator bits S1, S2, S3, S4 to slots in register order */
+const uint8_t keySlot[4] = { 0, 2, 1, 3 };
+
+/* Channel 3 special mode: slot in register order to A8-AA index */
+const int8_t specialIndex[4] = { 1, 0, 2, -1 };
+
+inline int32_t operatorOutput(uint32_t phase10, uint32_t attenuation) {
+    const Tables &t = tables();
+    uint32_t quarter = phase10 & 0xFF;
+    if (phase10 & 0x100) // second and fourth quarter run backwards
+        quarter ^= 0xFF;
+    uint32_t level = t.logSin[quarter] + (attenuation << 2);
+    if (level > 0x1FFF)
+        level = 0x1FFF;
+    int32_t out = ((t.exp[(level & 0xFF) ^ 0xFF] | 0x400) << 2) >> (level >> 8);
+    return (phase10 & 0x200) ? -out : out;
+}
+
+} // namespace
+
+
+YM2612Core::YM2612Core(uint32_t clock) : masterClock(clock) {
+    tables();
+    reset();
+}
+
+
+void YM2612Core::reset() {
+    memset(latchedAddr, 0, sizeof(latchedAddr));
+    memset(phase, 0, sizeof(phase));
+    memset(increment, 0, sizeof(increment));
+    memset(output, 0, sizeof(output));
+    memset(egState, EG_RELEASE, sizeof(egState));
+    memset(keyed, 0, sizeof(keyed));
+    memset(ssgInverted, 0, sizeof(ssgInverted));
+    memset(rate, 0, sizeof(rate));
+    memset(totalLevel, 0, sizeof(totalLevel));
+    memset(sustainLevel, 0, sizeof(sustainLevel));
+    memset(regDtMul, 0, sizeof(regDtMul));
+    memset(regKsAr, 0, sizeof(regKsAr));
+    memset(regAmDr, 0, sizeof(regAmDr));
+    memset(regSr, 0, sizeof(regSr));
+    memset(regSlRr, 0, sizeof(regSlRr));
+    memset(regSsg, 0, sizeof(regSsg));
+    for (int s = 0; s < SLOT_COUNT; s++)
+        for (int c = 0; c < CHAN_COUNT; c++)
+            envelope[s][c] = 0x3FF;
+    memset(fnum, 0, sizeof(fnum));
+    memset(block, 0, sizeof(block));
+    freqLatch = 0;
+    memset(specialFnum, 0, sizeof(specialFnum));
+    memset(specialBlock, 0, sizeof(specialBlock));
+    specialLatch = 0;
+    memset(algorithm, 0, sizeof(algorithm));
+    memset(feedback, 0, sizeof(feedback));
+    memset(panLeft, 1, sizeof(panLeft));
+    memset(panRight, 1, sizeof(panRight));
+    memset(ams, 0, sizeof(ams));
+    memset(pms, 0, sizeof(pms));
+    memset(feedbackHistory, 0, sizeof(feedbackHistory));
+    memset(dirty, 1, sizeof(dirty));
+    lfoEnable = 0;
+    lfoFreq = 0;
+    lfoCounter = 0;
+    lfoStep = 0;
+    mode = 0;
+    timerA = 0;
+    timerB = 0;
+    timerControl = 0;
+    timerStatus = 0;
+    timerACount = 0;
+    timerBCount = 0;
+    csmKeyed = 0;
+    dacEnable = 0;
+    dacValue = 0;
+    egCounter = 0;
+    egDivider = 0;
+}
+
+
+void YM2612Core::busWrite(uint8_t a1, uint8_t a0, uint8_t data) {
+    a1 &= 1;
+    if (!a0)
+        latchedAddr[a1] = data;
+    else
+        write(a1, latchedAddr[a1], data);
+}
+
+
+void YM2612Core::write(uint8_t part, uint8_t reg, uint8_t data) {
+    part &= 1;
+    if (reg < 0x30) {
+        if (part) // no global registers in part 2
+            return;
+        switch (reg) {
+            case 0x22:
+            lfoEnable = (data >> 3) & 1;
+            lfoFreq = data & 7;
+            if (!lfoEnable)
+                lfoStep = 0;
+            memset(dirty, 1, sizeof(dirty));
+            break;
+
+            case 0x24:
+            timerA = (timerA & 0x003) | (data << 2);
+            break;
+
+            case 0x25:
+            timerA = (timerA & 0x3FC) | (data & 3);
+            break;
+
+            case 0x26:
+            timerB = data;
+            break;
+
+            case 0x27:
+            if ((data ^ mode) & 0xC0)
+                dirty[2] = 1;
+            mode = data & 0xC0;
+            if ((data & 0x01) && !(timerControl & 0x01))
+                timerACount = 1024 - timerA;
+            if ((data & 0x02) && !(timerControl & 0x02))
+                timerBCount = (256 - timerB) * 16;
+            if (data & 0x10)
+                timerStatus &= ~0x01;
+            if (data & 0x20)
+                timerStatus &= ~0x02;
+            timerControl = data & 0x0F;
+            break;
+
+            case 0x28: {
+                uint8_t c = data & 3;
+                if (c == 3) // there is no channel 011 or 111
+                    break;
+                if (data & 4)
+                    c += 3;
+                for (int k = 0; k < SLOT_COUNT; k++) {
+                    if (data & (0x10 << k))
+                        keyOn(keySlot[k], c);
+                    else
+                        keyOff(keySlot[k], c);
+                }
+            }
+            break;
+
+            case 0x2A:
+            dacValue = ((int32_t)data - 128) << 1;
+            break;
+
+            case 0x2B:
+            dacEnable = data >> 7;
+            break;
+
+            default:
+            break;
+        }
+        return;
+    }
+    if ((reg & 3) == 3) // padding in every block
+        return;
+    uint8_t c = part * 3 + (reg & 3);
+    if (reg < 0xA0) {
+        writeSlot((reg >> 2) & 3, c, reg & 0xF0, data);
+        return;
+    }
+    switch (reg & 0xFC) {
+        case 0xA0:
+        fnum[c] = ((freqLatch & 7) << 8) | data;
+        block[c] = (freqLatch >> 3) & 7;
+        dirty[c] = 1;
+        break;
+
+        case 0xA4:
+        freqLatch = data & 0x3F;
+        break;
+
+        case 0xA8:
+        if (!part) {
+            specialFnum[reg & 3] = ((specialLatch & 7) << 8) | data;
+            specialBlock[reg & 3] = (specialLatch >> 3) & 7;
+            dirty[2] = 1;
+        }
+        break;
+
+        case 0xAC:
+        if (!part)
+            specialLatch = data & 0x3F;
+        break;
+
+        case 0xB0:
+        algorithm[c] = data & 7;
+        feedback[c] = (data >> 3) & 7;
+        break;
+
+        case 0xB4:
+        panLeft[c] = data >> 7;
+        panRight[c] = (data >> 6) & 1;
+        ams[c] = (data >> 4) & 3;
+        pms[c] = data & 7;
+        dirty[c] = 1;
+        break;
+
+        default:
+        break;
+    }
+}
+
+
+void YM2612Core::writeSlot(
+    uint8_t slot, uint8_t channel, uint8_t reg, uint8_t data) {
+    switch (reg) {
+        case 0x30:
+        regDtMul[slot][channel] = data;
+        dirty[channel] = 1;
+        break;
+
+        case 0x40:
+        totalLevel[slot][channel] = (data & 0x7F) << 3;
+        break;
+
+        case 0x50:
+        regKsAr[slot][channel] = data;
+        dirty[channel] = 1;
+        break;
+
+        case 0x60:
+        regAmDr[slot][channel] = data;
+        dirty[channel] = 1;
+        break;
+
+        case 0x70:
+        regSr[slot][channel] = data;
+        dirty[channel] = 1;
+        break;
+
+        case 0x80: {
+            uint8_t sl = data >> 4;
+            regSlRr[slot][channel] = data;
+            sustainLevel[slot][channel] = (sl == 15 ? 31 : sl) << 5;
+            dirty[channel] = 1;
+        }
+        break;
+
+        case 0x90:
+        regSsg[slot][channel] = data & 0x0F;
+        break;
+
+        default:
+        break;
+    }
+}
+
+
+void YM2612Core::keyOn(uint8_t slot, uint8_t channel) {
+    if (keyed[slot][channel])
+        return;
+    if (dirty[channel])
+        refresh(channel);
+    keyed[slot][channel] = 1;
+    phase[slot][channel] = 0;
+    uint8_t ssg = regSsg[slot][channel];
+    ssgInverted[slot][channel] = (ssg & 0x08) && (ssg & 0x04);
+    if (rate[slot][channel][EG_ATTACK] >= 62) {
+        envelope[slot][channel] = 0;
+        egState[slot][channel] = sustainLevel[slot][channel]
+            ? EG_DECAY : EG_SUSTAIN;
+    }
+    else {
+        egState[slot][channel] = EG_ATTACK;
+    }
+}
+
+
+void YM2612Core::keyOff(uint8_t slot, uint8_t channel) {
+    if (!keyed[slot][channel])
+        return;
+    keyed[slot][channel] = 0;
+    if (ssgInverted[slot][channel] & 1) // release from the level heard
+        envelope[slot][channel] = (0x200 - envelope[slot][channel]) & 0x3FF;
+    ssgInverted[slot][channel] = 0;
+    egState[slot][channel] = EG_RELEASE;
+}
+
+
+uint8_t YM2612Core::keyCode(uint8_t channel, uint8_t slot) const {
+    uint16_t f = fnum[channel];
+    uint8_t b = block[channel];
+    if (channel == 2 && mode && specialIndex[slot] >= 0) {
+        f = specialFnum[specialIndex[slot]];
+        b = specialBlock[specialIndex[slot]];
+    }
+    return (b << 2) | fnNote[f >> 7];
+}
+
+
+uint32_t YM2612Core::phaseIncrement(
+    uint16_t f, uint8_t b, uint8_t dtMul, int32_t pmOffset) const {
+    int32_t fm = f + pmOffset;
+    if (fm < 0)
+        fm = 0;
+    else if (fm > 0x7FF)
+        fm = 0x7FF;
+    uint32_t base = ((uint32_t)fm << b) >> 1;
+    uint8_t kc = (b << 2) | fnNote[fm >> 7];
+    uint8_t dt = (dtMul >> 4) & 7;
+    if (dt & 4)
+        base -= dtTable[dt & 3][kc];
+    else
+        base += dtTable[dt & 3][kc];
+    base &= 0x1FFFF;
+    uint8_t mul = dtMul & 0x0F;
+    return mul ? (base * mul) & 0xFFFFF : base >> 1;
+}
+
+
+void YM2612Core::refresh(uint8_t channel) {
+    dirty[channel] = 0;
+    int32_t tri = 0; // LFO vibrato position, -8..8
+    if (lfoEnable && pms[channel]) {
+        uint8_t step = lfoStep >> 2;
+        tri = step < 8 ? step : step < 24 ? 16 - step : step - 32;
+    }
+    for (uint8_t s = 0; s < SLOT_COUNT; s++) {
+        uint16_t f = fnum[channel];
+        uint8_t b = block[channel];
+        if (channel == 2 && mode && specialIndex[s] >= 0) {
+            f = specialFnum[specialIndex[s]];
+            b = specialBlock[specialIndex[s]];
+        }
+        int32_t pm = ((int32_t)f * pmScale[pms[channel]] * tri) >> 19;
+        increment[s][channel] = phaseIncrement(f, b, regDtMul[s][channel], pm);
+
+        uint8_t kc = keyCode(channel, s);
+        uint8_t ksr = kc >> (3 - (regKsAr[s][channel] >> 6));
+        uint8_t r[4] = {
+            (uint8_t)(regKsAr[s][channel] & 0x1F),
+            (uint8_t)(regAmDr[s][channel] & 0x1F),
+            (uint8_t)(regSr[s][channel] & 0x1F),
+            (uint8_t)((regSlRr[s][channel] & 0x0F) * 2 + 1)
+        };
+        for (int i = 0; i < 4; i++) {
+            uint8_t effective = r[i] ? 2 * r[i] + ksr : 0;
+            rate[s][channel][i] = effective > 63 ? 63 : effective;
+        }
+    }
+}
+
+
+void YM2612Core::clockEnvelopes() {
+    egCounter = (egCounter + 1) & 0xFFF;
+    if (!egCounter)
+        egCounter = 1;
+    for (uint8_t s = 0; s < SLOT_COUNT; s++) {
+        for (uint8_t c = 0; c < CHAN_COUNT; c++) {
+            uint8_t state = egState[s][c];
+            uint8_t r = rate[s][c][state];
+            if (r < 2)
+                continue;
+            uint8_t shift = r < 48 ? 11 - (r >> 2) : 0;
+            if (egCounter & ((1 << shift) - 1))
+                continue;
+            uint8_t row = r < 48 ? (r & 3) : r < 60 ? r - 44 : 16;
+            int32_t inc = egInc[row][(egCounter >> shift) & 7];
+            int32_t env = envelope[s][c];
+            uint8_t ssg = regSsg[s][c];
+            if (state == EG_ATTACK) {
+                if (r >= 62)
+                    env = 0;
+                else
+                    env += (~env * inc) >> 4;
+                if (env <= 0) {
+                    env = 0;
+                    egState[s][c] = sustainLevel[s][c] ? EG_DECAY : EG_SUSTAIN;
+                }
+            }
+            else {
+                if ((ssg & 0x08) && state != EG_RELEASE) {
+                    if (ssgInverted[s][c] & 2) // holding
+                        continue;
+                    env += inc << 2; // SSG-EG runs the decay 4x faster
+                    if (env >= 0x200) {
+                        if (ssg & 0x02) // alternate
+                            ssgInverted[s][c] ^= 1;
+                        if (ssg & 0x01) { // hold
+                            ssgInverted[s][c] |= 2;
+                            env = 0x200;
+                        }
+                        else { // repeat
+                            if (!(ssg & 0x02))
+                                phase[s][c] = 0;
+                            env = 0x200;
+                            egState[s][c] = EG_ATTACK;
+                        }
+                    }
+                }
+                else {
+                    env += inc;
+                }
+                if (state == EG_DECAY && env >= sustainLevel[s][c])
+                    egState[s][c] = EG_SUSTAIN;
+                if (env > 0x3FF)
+                    env = 0x3FF;
+            }
+            envelope[s][c] = env;
+        }
+    }
+}
+
+
+void YM2612Core::clockTimers() {
+    if (timerControl & 0x01) {
+        if (--timerACount <= 0) {
+            timerACount += 1024 - timerA;
+            if (timerControl & 0x04)
+                timerStatus |= 0x01;
+            if (mode == 0x80) { // CSM: timer A keys channel 3 on
+                for (uint8_t s = 0; s < SLOT_COUNT; s++)
+                    keyOn(s, 2);
+                csmKeyed = 1;
+            }
+        }
+    }
+    if (timerControl & 0x02) {
+        if (--timerBCount <= 0) {
+            timerBCount += (256 - timerB) * 16;
+            if (timerControl & 0x08)
+                timerStatus |= 0x02;
+        }
+    }
+}
+
+
+uint64_t YM2612Core::samplesToIrq() const {
+    if (timerStatus)
+        return UINT64_MAX;
+    uint64_t samples = UINT64_MAX;
+    // a count of 0 or less overflows on the next sample
+    if ((timerControl & 0x05) == 0x05)
+        samples = timerACount > 0 ? timerACount : 1;
+    if ((timerControl & 0x0A) == 0x0A) {
+        const uint64_t b = timerBCount > 0 ? timerBCount : 1;
+        if (b < samples)
+            samples = b;
+    }
+    return samples;
+}
+
+
+void YM2612Core::render(int32_t *out, size_t frames) {
+    uint32_t attenuation[SLOT_COUNT][CHAN_COUNT];
+    for (size_t i = 0; i < frames; i++) {
+        if (csmKeyed) { // CSM key on lasts one sample
+            csmKeyed = 0;
+            for (uint8_t s = 0; s < SLOT_COUNT; s++)
+                keyOff(s, 2);
+        }
+        clockTimers();
+        if (lfoEnable && ++lfoCounter >= lfoPeriod[lfoFreq]) {
+            lfoCounter = 0;
+            lfoStep = (lfoStep + 1) & 0x7F;
+            if (!(lfoStep & 3)) // vibrato moved
+                for (uint8_t c = 0; c < CHAN_COUNT; c++)
+                    if (pms[c])
+                        dirty[c] = 1;
+        }
+        if (++egDivider == 3) {
+            egDivider = 0;
+            clockEnvelopes();
+        }
+        for (uint8_t c = 0; c < CHAN_COUNT; c++)
+            if (dirty[c])
+                refresh(c);
+
+        /* phase generators, all operators in lockstep */
+        for (uint8_t s = 0; s < SLOT_COUNT; s++)
+            for (uint8_t c = 0; c < CHAN_COUNT; c++)
+                phase[s][c] = (phase[s][c] + increment[s][c]) & 0xFFFFF;
+
+        /* envelope + total level + tremolo, all operators in lockstep */
+        uint32_t am = lfoStep < 64 ? lfoStep * 2 : 254 - lfoStep * 2;
+        for (uint8_t s = 0; s < SLOT_COUNT; s++) {
+            for (uint8_t c = 0; c < CHAN_COUNT; c++) {
+                uint32_t env = envelope[s][c];
+                if (ssgInverted[s][c] & 1)
+                    env = (0x200 - env) & 0x3FF;
+                else if ((regSsg[s][c] & 0x08) && env >= 0x200)
+                    env = 0x3FF;
+                env += totalLevel[s][c];
+                if (regAmDr[s][c] & 0x80)
+                    env += am >> amsShift[ams[c]];
+                attenuation[s][c] = env > 0x3FF ? 0x3FF : env;
+            }
+        }
+
+        /* operators in the chip's calculation order S1, S3, S2, S4, so a
+         * modulator calculated later is heard one sample late */
+        for (uint8_t c = 0; c < CHAN_COUNT; c++) {
+            int32_t mod = 0;
+            if (feedback[c])
+                mod = (feedbackHistory[c][0] + feedbackHistory[c][1])
+                    >> (10 - feedback[c]);
+            output[0][c] = operatorOutput(
+                ((phase[0][c] >> 10) + mod) & 0x3FF, attenuation[0][c]);
+            feedbackHistory[c][1] = feedbackHistory[c][0];
+            feedbackHistory[c][0] = output[0][c];
+        }
+        for (uint8_t s = 1; s < SLOT_COUNT; s++) {
+            for (uint8_t c = 0; c < CHAN_COUNT; c++) {
+                uint8_t sources = modSource[algorithm[c]][s];
+                int32_t mod = 0;
+                for (uint8_t k = 0; k < SLOT_COUNT; k++)
+                    if (sources & (1 << k))
+                        mod += output[k][c];
+                output[s][c] = operatorOutput(
+                    ((phase[s][c] >> 10) + (mod >> 1)) & 0x3FF,
+                    attenuation[s][c]);
+            }
+        }
+
+        /* 9 bit channel outputs */
+        int32_t left = 0;
+        int32_t right = 0;
+        for (uint8_t c = 0; c < CHAN_COUNT; c++) {
+            int32_t sum = 0;
+            for (uint8_t s = 0; s < SLOT_COUNT; s++)
+                if (carriers[algorithm[c]] & (1 << s))
+                    sum += output[s][c];
+            if (sum > 8191)
+                sum = 8191;
+            else if (sum < -8192)
+                sum = -8192;
+            sum >>= 5;
+            if (c == 5 && dacEnable)
+                sum = dacValue;
+            if (panLeft[c])
+                left += sum;
+            if (panRight[c])
+                right += sum;
+        }
+        out[2 * i] = left << OUTPUT_SHIFT;
+        out[2 * i + 1] = right << OUTPUT_SHIFT;
+    }
+}
@@ -0,0 +1,132 @@
+/**
+ * YM2612 software core for host side rendering.
+ *
+ * Follows the YM3438 application manual and the die-level behaviour known
+ * from it where documented: log-sin/exp operator tables, 10 bit envelope
+ * attenuation clocked every 3 samples, 17 bit detuned phase increment,
+ * one sample delayed modulation in the S1, S3, S2, S4 calculation order,
+ * 9 bit per channel DAC output. LFO vibrato is an approximation.
+ *
+ * Operator state is kept as structure-of-arrays indexed [slot][channel] so
+ * the per-sample loops run over the six channels in lockstep and the
+ * compiler can vectorize them.
+ *
+ * Slots are in register order (S1, S3, S2, S4) like YM2612::slot_e.
+ */
+#ifndef YM2612_CORE_H__
+#define YM2612_CORE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+class YM2612Core {
+    public:
+    enum {
+        CHAN_COUNT = 6,
+        SLOT_COUNT = 4,
+        CLOCK_DIVIDER = 144 // master clocks per output sample
+    };
+
+    YM2612Core(uint32_t clock = 8000000);
+
+    void reset();
+
+    /* Register interface: one write to an already selected register */
+    void write(uint8_t part, uint8_t reg, uint8_t data);
+
+    /* Pin interface: a WR strobe with A1/A0 and the data bus as given,
+     * A0 low latches a register address, A0 high writes its data */
+    void busWrite(uint8_t a1, uint8_t a0, uint8_t data);
+
+    /* Status register: bit 0 timer A overflow, bit 1 timer B overflow */
+    uint8_t status() const { return timerStatus; }
+    bool irq() const { return timerStatus != 0; }
+    /* Samples rendered from now until a timer raises IRQ, UINT64_MAX if
+     * it is already raised or no enabled timer runs */
+    uint64_t samplesToIrq() const;
+
+    uint32_t clock() const { return masterClock; }
+    uint32_t sampleRate() const { return masterClock / CLOCK_DIVIDER; }
+
+    /* Render interleaved stereo samples, overwriting out[2 * frames].
+     * Full scale of one channel is +-256 << OUTPUT_SHIFT. */
+    enum {
+        OUTPUT_SHIFT = 4
+    };
+    void render(int32_t *out, size_t frames);
+
+    private:
+    enum egState_e {
+        EG_ATTACK,
+        EG_DECAY,
+        EG_SUSTAIN,
+        EG_RELEASE
+    };
+
+    uint32_t masterClock;
+    uint8_t latchedAddr[2];
+
+    /* operator state, [slot][channel] */
+    uint32_t phase[SLOT_COUNT][CHAN_COUNT];
+    uint32_t increment[SLOT_COUNT][CHAN_COUNT];
+    int32_t output[SLOT_COUNT][CHAN_COUNT];
+    uint16_t envelope[SLOT_COUNT][CHAN_COUNT]; // 10 bit attenuation
+    uint8_t egState[SLOT_COUNT][CHAN_COUNT];
+    uint8_t keyed[SLOT_COUNT][CHAN_COUNT];
+    uint8_t ssgInverted[SLOT_COUNT][CHAN_COUNT];
+    uint8_t rate[SLOT_COUNT][CHAN_COUNT][4]; // effective AR, DR, SR, RR
+    uint16_t totalLevel[SLOT_COUNT][CHAN_COUNT]; // TL << 3
+    uint16_t sustainLevel[SLOT_COUNT][CHAN_COUNT]; // in envelope units
+    uint8_t regDtMul[SLOT_COUNT][CHAN_COUNT];
+    uint8_t regKsAr[SLOT_COUNT][CHAN_COUNT];
+    uint8_t regAmDr[SLOT_COUNT][CHAN_COUNT];
+    uint8_t regSr[SLOT_COUNT][CHAN_COUNT];
+    uint8_t regSlRr[SLOT_COUNT][CHAN_COUNT];
+    uint8_t regSsg[SLOT_COUNT][CHAN_COUNT];
+
+    /* channel state */
+    uint16_t fnum[CHAN_COUNT];
+    uint8_t block[CHAN_COUNT];
+    uint8_t freqLatch; // shared A4-A6 latch
+    uint16_t specialFnum[3]; // A8, A9, AA (operators 3, 1, 2)
+    uint8_t specialBlock[3];
+    uint8_t specialLatch; // shared AC-AE latch
+    uint8_t algorithm[CHAN_COUNT];
+    uint8_t feedback[CHAN_COUNT];
+    uint8_t panLeft[CHAN_COUNT];
+    uint8_t panRight[CHAN_COUNT];
+    uint8_t ams[CHAN_COUNT];
+    uint8_t pms[CHAN_COUNT];
+    int32_t feedbackHistory[CHAN_COUNT][2];
+    uint8_t dirty[CHAN_COUNT]; // increments and rates need recalculating
+
+    /* global state */
+    uint8_t lfoEnable;
+    uint8_t lfoFreq;
+    uint32_t lfoCounter;
+    uint8_t lfoStep; // 0..127
+    uint8_t mode; // reg 0x27 bits 6-7: channel 3 normal/special/CSM
+    uint16_t timerA;
+    uint8_t timerB;
+    uint8_t timerControl;
+    uint8_t timerStatus;
+    int32_t timerACount;
+    int32_t timerBCount;
+    uint8_t csmKeyed; // channel 3 keyed on by a CSM timer A overflow
+    uint8_t dacEnable;
+    int32_t dacValue;
+    uint32_t egCounter;
+    uint8_t egDivider;
+
+    void writeSlot(uint8_t slot, uint8_t channel, uint8_t reg, uint8_t data);
+    void keyOn(uint8_t slot, uint8_t channel);
+    void keyOff(uint8_t slot, uint8_t channel);
+    void refresh(uint8_t channel);
+    uint32_t phaseIncrement(
+        uint16_t f, uint8_t b, uint8_t dtMul, int32_t pmOffset) const;
+    uint8_t keyCode(uint8_t channel, uint8_t slot) const;
+    void clockEnvelopes();
+    void clockTimers();
+};
+
+#endif
@@ -0,0 +1,369 @@
+/**
+ * latencybench - MIDI to sound latency of the Trahagean firmware on the
+ * host shim.
+ *
+ * Each scenario is sent over the simulated serial wire at MIDI
+ * (31250) and MIDI bridge (38400) baud. A message's latency runs from the
+ * stop bit of its last byte to the WR/WE strobe of the last chip write
+ * made while handling it, which covers the core RX interrupt,
+ * MidiPacketizer::receive, MegaSynth::parseMidiPacket and the bus writes.
+ *
+ * Results go to stdout as a table and, with -o, to a JSON file with one
+ * result per line. -b compares against such a file and exits 1 when a
+ * median or p99 got worse by more than the tolerance.
+ *
+ * Each run also records the worst interrupt latency, from a byte landing
+ * in the USART (or another interrupt going pending) to its ISR starting.
+ * -i exits 1 when that exceeds the given bound in any run.
+ *
+ * Built with USE_IDLE_SLEEP (latencybench-sleep) it reports how much of
+ * each run the CPU slept and the worst time from the interrupt ending a
+ * sleep to the firmware acting on it.
+ *
+ * Usage: latencybench [-o results.json] [-b baseline.json] [-t percent]
+ *                     [-l label] [-i us]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "Trahagean.ino"
+
+struct Message {
+    std::vector<uint8_t> bytes;
+    uint32_t at; // us after the scenario starts, sent no earlier than this
+};
+
+struct Scenario {
+    const char *name;
+    std::vector<Message> (*build)();
+};
+
+struct Result {
+    std::string scenario;
+    unsigned long baud;
+    size_t messages;
+    size_t measured; // messages that wrote to a chip
+    double min, median, p99, max; // us
+    unsigned long dropped, overruns;
+    double irqOff; // longest interrupts-off window, us
+    double irqLatency; // worst interrupt latency, us
+    double idle; // percent of the run asleep
+    double wake; // worst wake to dispatch, us
+};
+
+static Message message(uint32_t at, uint8_t status, uint8_t a, uint8_t b) {
+    Message m;
+    m.at = at;
+    m.bytes.push_back(status);
+    m.bytes.push_back(a);
+    m.bytes.push_back(b);
+    return m;
+}
+
+/* one note at a time on an FM channel */
+static std::vector<Message> singleNotes() {
+    std::vector<Message> m;
+    for (uint32_t i = 0; i < 40; i++) {
+        uint8_t key = 48 + i % 24;
+        m.push_back(message(i * 100000, 0x90, key, 100));
+        m.push_back(message(i * 100000 + 50000, 0x80, key, 0));
+    }
+    return m;
+}
+
+/* all six FM channels keyed at once, then released at once */
+static std::vector<Message> sixNoteChords() {
+    static const uint8_t chord[6] = { 48, 55, 60, 64, 67, 72 };
+    std::vector<Message> m;
+    for (uint32_t i = 0; i < 20; i++) {
+        for (uint8_t c = 0; c < 6; c++)
+            m.push_back(message(i * 200000, 0x90 | c, chord[c] + i % 5, 100));
+        for (uint8_t c = 0; c < 6; c++)
+            m.push_back(message(i * 200000 + 100000, 0x80 | c, chord[c] + i % 5, 0));
+    }
+    return m;
+}
+
+/* operator 1 level swept as fast as the wire allows on every FM channel,
+ * with a note held so the writes are audible */
+static std::vector<Message> ccSweeps() {
+    std::vector<Message> m;
+    for (uint8_t c = 0; c < 6; c++)
+        m.push_back(message(0, 0x90 | c, 60, 100));
+    for (uint8_t pass = 0; pass < 2; pass++)
+        for (uint8_t c = 0; c < 6; c++)
+            for (uint8_t v = 0; v < 128; v++)
+                m.push_back(message(10000, 0xB0 | c, 16, pass ? 127 - v : v));
+    return m;
+}
+
+/* SN76489 notes as fast as the wire allows, each one a period and a
+ * level write, so the chip's long strobes run back to back */
+static std::vector<Message> snBursts() {
+    std::vector<Message> m;
+    for (uint32_t i = 0; i < 60; i++) {
+        uint8_t c = 6 + i % 3, key = 48 + (i * 7) % 36;
+        m.push_back(message(0, 0x90 | c, key, 100));
+        m.push_back(message(0, 0x80 | c, key, 0));
+    }
+    return m;
+}
+
+/* notes on FM and SN channels with CCs in between, bursty timing */
+static std::vector<Message> mixedTraffic() {
+    std::vector<Message> m;
+    uint32_t seed = 12345, at = 0;
+    bool held[10] = { false };
+    uint8_t heldKey[10];
+    for (int i = 0; i < 400; i++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t r = seed >> 8;
+        at += r % 4 ? r % 1000 : 5000 + r % 20000; // mostly bursts
+        uint8_t channel = (r >> 4) % 9; // FM 0-5, SN 6-8
+        switch ((r >> 8) % 4) {
+        case 0:
+        case 1:
+            if (held[channel]) {
+                m.push_back(message(at, 0x80 | channel, heldKey[channel], 0));
+            } else {
+                heldKey[channel] = 40 + (r >> 12) % 48;
+                m.push_back(message(at, 0x90 | channel, heldKey[channel],
+                                    64 + (r >> 20) % 64));
+            }
+            held[channel] = !held[channel];
+            break;
+        case 2:
+            m.push_back(message(at, 0xB0 | channel % 6, 16 + (r >> 12) % 4,
+                                (r >> 16) % 128));
+            break;
+        default:
+            m.push_back(message(at, 0xB0 | channel % 6, 77, 3)); // pan center
+            break;
+        }
+    }
+    return m;
+}
+
+static const Scenario scenarios[] = {
+    { "single", singleNotes },
+    { "chord6", sixNoteChords },
+    { "ccsweep", ccSweeps },
+    { "snburst", snBursts },
+    { "mixed", mixedTraffic }
+};
+
+static const unsigned long bauds[] = {
+    MIDI_NATIVE_BAUDRATE, MIDI_SOFTWARE_BAUDRATE
+};
+
+/* per run measurement state, filled in by the strobe hook */
+static std::vector<size_t> byteMessage; // byte index -> message index
+static std::vector<uint64_t> lastWrite; // per message, 0 if none
+
+template<class P> static bool rose(HostPort &port, uint8_t previous) {
+    return &port == &P::out() && !(previous & bit(P::BIT))
+        && (port & bit(P::BIT));
+}
+
+static void onPortWrite(HostPort &port, uint8_t previous) {
+    bool ym = rose<SynthBoard::YM_WR>(port, previous)
+        || rose<SynthBoard::YM_WR2>(port, previous);
+    bool sn = rose<SynthBoard::SN_WE>(port, previous)
+        || rose<SynthBoard::SN_WE2>(port, previous);
+    // only the data strobe of a YM2612 write counts, A0 high
+    if (ym && !SynthBoard::YM_A0::isHigh())
+        ym = false;
+    if ((ym || sn) && Serial.reads) {
+        size_t byte = Serial.reads - 1; // serialEvent handling this byte
+        if (byte < byteMessage.size())
+            lastWrite[byteMessage[byte]] = hostCycles;
+    }
+}
+
+static Result run(const Scenario &scenario, unsigned long baud) {
+    std::vector<Message> messages = scenario.build();
+    hostReset();
+    SynthBoard::YM_WR::out().hook = onPortWrite;
+    SynthBoard::YM_WR2::out().hook = onPortWrite;
+    SynthBoard::SN_WE::out().hook = onPortWrite;
+    SynthBoard::SN_WE2::out().hook = onPortWrite;
+    setup();
+    Serial.baud = baud; // the wire rate under test
+    hostInterruptsOffMax = 0; // only count the scenario
+    hostInterruptLatencyMax = 0;
+    uint64_t slept = hostSleptCycles;
+
+    uint64_t start = hostCycles;
+    std::vector<uint64_t> arrived(messages.size());
+    byteMessage.clear();
+    lastWrite.assign(messages.size(), 0);
+    for (size_t i = 0; i < messages.size(); i++) {
+        uint64_t at = start + (uint64_t)messages[i].at * (F_CPU / 1000000UL);
+        for (size_t b = 0; b < messages[i].bytes.size(); b++) {
+            arrived[i] = hostSerialSend(messages[i].bytes[b], at);
+            byteMessage.push_back(i);
+        }
+    }
+    hostRunUntil(arrived.back() + F_CPU / 10); // 100ms to drain
+
+    std::vector<double> us;
+    for (size_t i = 0; i < messages.size(); i++)
+        if (lastWrite[i])
+            us.push_back((lastWrite[i] - arrived[i]) * 1e6 / F_CPU);
+    std::sort(us.begin(), us.end());
+
+    Result r = Result();
+    r.scenario = scenario.name;
+    r.baud = baud;
+    r.messages = messages.size();
+    r.measured = us.size();
+    if (!us.empty()) {
+        r.min = us.front();
+        r.median = us[us.size() / 2];
+        r.p99 = us[std::min(us.size() - 1, us.size() * 99 / 100)];
+        r.max = us.back();
+    }
+    r.dropped = Serial.dropped;
+    r.overruns = Serial.overruns;
+    r.irqOff = hostInterruptsOffMax * 1e6 / F_CPU;
+    r.irqLatency = hostInterruptLatencyMax * 1e6 / F_CPU;
+    r.idle = 100.0 * (hostSleptCycles - slept) / (hostCycles - start);
+    r.wake = hostWakeLatencyMax * 1e6 / F_CPU;
+    return r;
+}
+
+static void writeJson(FILE *out, const char *label,
+                      const std::vector<Result> &results) {
+    fprintf(out, "{\"label\":\"%s\",\"results\":[\n", label);
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        fprintf(out, "{\"scenario\":\"%s\",\"baud\":%lu,\"messages\":%zu,"
+                "\"measured\":%zu,\"min_us\":%.1f,\"median_us\":%.1f,"
+                "\"p99_us\":%.1f,\"max_us\":%.1f,\"dropped\":%lu,"
+                "\"overruns\":%lu,\"irq_off_us\":%.1f,"
+                "\"irq_latency_us\":%.1f,\"idle_pct\":%.1f,"
+                "\"wake_us\":%.1f}%s\n",
+                r.scenario.c_str(), r.baud, r.messages, r.measured, r.min,
+                r.median, r.p99, r.max, r.dropped, r.overruns, r.irqOff,
+                r.irqLatency, r.idle, r.wake,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "]}\n");
+}
+
+/* pull one number out of a result line written by writeJson */
+static bool field(const char *line, const char *key, double &value) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(line, pattern);
+    return p && sscanf(p + strlen(pattern), "%lf", &value) == 1;
+}
+
+static int compare(const char *path, const std::vector<Result> &results,
+                   double tolerance) {
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return 2;
+    }
+    int worse = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), in)) {
+        double baud, median, p99;
+        const char *name = strstr(line, "\"scenario\":\"");
+        if (!name || !field(line, "baud", baud) || !field(line, "median_us", median)
+                || !field(line, "p99_us", p99))
+            continue;
+        name += strlen("\"scenario\":\"");
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result &r = results[i];
+            if (r.baud != (unsigned long)baud
+                    || strncmp(name, r.scenario.c_str(), r.scenario.size())
+                    || name[r.scenario.size()] != '"')
+                continue;
+            // 1us of slack so tiny baselines do not trip on rounding
+            if (r.median > median * (1 + tolerance / 100) + 1
+                    || r.p99 > p99 * (1 + tolerance / 100) + 1) {
+                printf("REGRESSION %s @%lu: median %.1f -> %.1f us, "
+                       "p99 %.1f -> %.1f us\n", r.scenario.c_str(), r.baud,
+                       median, r.median, p99, r.p99);
+                worse++;
+            }
+        }
+    }
+    fclose(in);
+    return worse ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    const char *outPath = NULL;
+    const char *baselinePath = NULL;
+    const char *label = "";
+    double tolerance = 5;
+    double latencyBound = 0; // us, 0 for none
+    int opt;
+    while ((opt = getopt(argc, argv, "o:b:t:l:i:h")) != -1) {
+        switch (opt) {
+        case 'o':
+            outPath = optarg;
+            break;
+        case 'b':
+            baselinePath = optarg;
+            break;
+        case 't':
+            tolerance = atof(optarg);
+            break;
+        case 'l':
+            label = optarg;
+            break;
+        case 'i':
+            latencyBound = atof(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: latencybench [-o results.json] "
+                    "[-b baseline.json] [-t percent] [-l label] [-i us]\n");
+            return 2;
+        }
+    }
+
+    std::vector<Result> results;
+    int late = 0;
+    printf("%-8s %6s %5s %9s %9s %9s %9s %5s %8s %8s %6s %7s\n", "scenario",
+           "baud", "msgs", "min us", "median", "p99", "max", "lost",
+           "irq off", "irq lat", "idle %", "wake");
+    for (size_t b = 0; b < sizeof(bauds) / sizeof(bauds[0]); b++) {
+        for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+            Result r = run(scenarios[s], bauds[b]);
+            results.push_back(r);
+            printf("%-8s %6lu %5zu %9.1f %9.1f %9.1f %9.1f %5lu %8.1f %8.1f "
+                   "%6.1f %7.1f\n",
+                   r.scenario.c_str(), r.baud, r.measured, r.min, r.median,
+                   r.p99, r.max, r.dropped + r.overruns, r.irqOff,
+                   r.irqLatency, r.idle, r.wake);
+            if (latencyBound && r.irqLatency > latencyBound) {
+                printf("LATE %s @%lu: interrupt latency %.1f us > %.1f us\n",
+                       r.scenario.c_str(), r.baud, r.irqLatency, latencyBound);
+                late++;
+            }
+        }
+    }
+
+    if (outPath) {
+        FILE *out = fopen(outPath, "w");
+        if (!out) {
+            perror(outPath);
+            return 2;
+        }
+        writeJson(out, label, results);
+        fclose(out);
+    }
+    int status = baselinePath ? compare(baselinePath, results, tolerance) : 0;
+    return late && !status ? 1 : status;
+}
@@ -0,0 +1,113 @@
+/**
+ * linkdevice - the firmware built with USE_HOST_LINK, running in real time
+ * behind a pseudo terminal so host link tools can be tried without a
+ * board. It prints the pty path to connect to; interrupt it to stop.
+ *
+ *     bin/linkdevice -w out.wav &
+ *     bin/linksend /dev/pts/N session.txt
+ *
+ * Usage: linkdevice [-w out.wav]
+ */
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#undef B0 // termios hangup rate, clashes with binary.h
+
+#include <vector>
+
+#include "Arduino.h"
+#include "Trahagean.ino"
+#include "ChipBus.h"
+
+#ifndef USE_HOST_LINK
+#error "build linkdevice with -DUSE_HOST_LINK"
+#endif
+
+static volatile sig_atomic_t stopping;
+static std::vector<uint8_t> transmitted;
+
+static void onSignal(int) {
+    stopping = 1;
+}
+
+static void transmit(uint8_t data) {
+    transmitted.push_back(data);
+}
+
+static uint64_t wallCycles(const struct timespec &start) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)(ts.tv_sec - start.tv_sec) * F_CPU
+        + (int64_t)(ts.tv_nsec - start.tv_nsec) * (int64_t)(F_CPU / 1000000)
+        / 1000;
+}
+
+int main(int argc, char **argv) {
+    const char *wavPath = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "w:h")) != -1) {
+        if (opt == 'w') {
+            wavPath = optarg;
+        } else {
+            fprintf(stderr, "usage: linkdevice [-w out.wav]\n");
+            return 2;
+        }
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master)) {
+        perror("pty");
+        return 2;
+    }
+    // hold the slave open so the master does not see hangups between
+    // clients, and make it raw for clients that do not set it up
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    struct termios tio;
+    if (slave >= 0 && tcgetattr(slave, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(slave, TCSANOW, &tio);
+    }
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+    printf("%s\n", ptsname(master));
+    fflush(stdout);
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    hostReset();
+    LINK_SERIAL.txHook = transmit;
+    static ChipBus bus(8000000, 4000000);
+    bus.attach();
+    setup();
+    bus.record(wavPath);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t origin = hostCycles;
+    while (!stopping) {
+        uint8_t buffer[512];
+        ssize_t n = read(master, buffer, sizeof(buffer));
+        for (ssize_t i = 0; i < n; i++)
+            hostSerialSend(LINK_SERIAL, buffer[i], hostCycles);
+        hostRunUntil(origin + wallCycles(start));
+        if (!transmitted.empty()) {
+            if (write(master, transmitted.data(), transmitted.size()) < 0)
+                perror("pty write");
+            transmitted.clear();
+        }
+        usleep(500);
+    }
+    bus.finish();
+    fprintf(stderr, "YM2612 %lu writes, SN76489 %lu writes, %lu bytes lost "
+            "to a full buffer, %lu overruns\n", bus.ymWrites, bus.snWrites,
+            LINK_SERIAL.dropped, LINK_SERIAL.overruns);
+    if (hostSleptCycles)
+        fprintf(stderr, "%.1f%% asleep, %lu wakes, %.1f us wake to dispatch "
+                "worst\n", 100.0 * hostSleptCycles / hostCycles, hostWakes,
+                hostWakeLatencyMax * 1e6 / F_CPU);
+    return 0;
+}
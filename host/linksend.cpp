@@ -0,0 +1,133 @@
+/**
+ * linksend - play a session to the device over the framed host link
+ * (firmware built with USE_HOST_LINK, see Trahagean/HostLink.h).
+ *
+ * The session format is synthrender's, one event per line with the time
+ * in microseconds first, plus raw register writes in hex:
+ *
+ *     0       90 3C 7F        MIDI bytes
+ *     1000    ym 0 28 F0      YM2612 part, register, data
+ *     1000    sn 9F           SN76489 byte
+ *
+ * Writes with the same time are batched into as few frames as possible.
+ *
+ * Usage: linksend [-b baud] device session.txt
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "LinkSender.h"
+
+static double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool parseHex(char *&p, unsigned long &value) {
+    char *end;
+    value = strtoul(p, &end, 16);
+    if (end == p)
+        return false;
+    p = end;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    unsigned long baud = LINK_BAUDRATE;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:h")) != -1) {
+        if (opt == 'b') {
+            baud = strtoul(optarg, NULL, 10);
+        } else {
+            fprintf(stderr, "usage: linksend [-b baud] device session.txt\n");
+            return 2;
+        }
+    }
+    if (argc - optind != 2) {
+        fprintf(stderr, "usage: linksend [-b baud] device session.txt\n");
+        return 2;
+    }
+    int fd = LinkSender::openSerial(argv[optind], baud);
+    if (fd < 0) {
+        perror(argv[optind]);
+        return 2;
+    }
+    FILE *in = fopen(argv[optind + 1], "r");
+    if (!in) {
+        perror(argv[optind + 1]);
+        return 2;
+    }
+
+    LinkSender link(fd);
+    if (!link.hello()) {
+        fprintf(stderr, "no answer from the device\n");
+        return 1;
+    }
+    fprintf(stderr, "device window %zu bytes\n", link.window());
+
+    double start = nowSeconds();
+    char line[1024];
+    unsigned lineNumber = 0;
+    bool ok = true;
+    while (ok && link.connected() && fgets(line, sizeof(line), in)) {
+        lineNumber++;
+        char *p = line;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '#' || *p == '\n' || *p == '\r' || !*p)
+            continue;
+        char *end;
+        double at = strtod(p, &end) * 1e-6;
+        if (end == p) {
+            fprintf(stderr, "line %u: expected a time in us\n", lineNumber);
+            return 2;
+        }
+        p = end;
+        double wait = start + at - nowSeconds();
+        if (wait > 0) {
+            ok = link.flush(); // the batch so far is due now
+            while (ok && (wait = start + at - nowSeconds()) > 0)
+                link.poll(wait * 1000);
+        }
+        while (*p == ' ' || *p == '\t')
+            p++;
+        unsigned long part, reg, data;
+        if (!strncmp(p, "ym", 2)) {
+            p += 2;
+            if (!parseHex(p, part) || !parseHex(p, reg) || !parseHex(p, data)) {
+                fprintf(stderr, "line %u: ym part reg data\n", lineNumber);
+                return 2;
+            }
+            link.ym(part, reg, data);
+        } else if (!strncmp(p, "sn", 2)) {
+            p += 2;
+            if (!parseHex(p, data)) {
+                fprintf(stderr, "line %u: sn data\n", lineNumber);
+                return 2;
+            }
+            link.sn(data);
+        } else {
+            uint8_t bytes[512];
+            size_t n = 0;
+            while (n < sizeof(bytes) && parseHex(p, data))
+                bytes[n++] = data;
+            link.midi(bytes, n);
+        }
+    }
+    ok = ok && link.flush();
+    double elapsed = nowSeconds() - start;
+    const LinkSender::Stats &s = link.stats();
+    fprintf(stderr, "%lu frames, %lu bytes in %.2f s (%.0f B/s), "
+            "%lu credit waits, %lu resyncs, %lu dropped by the device\n",
+            s.frames, s.bytes, elapsed, elapsed > 0 ? s.bytes / elapsed : 0,
+            s.creditWaits, s.resyncs, s.naks);
+    if (!ok || !link.connected()) {
+        fprintf(stderr, "device stopped granting credit or hung up\n");
+        return 1;
+    }
+    return 0;
+}
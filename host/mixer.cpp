@@ -0,0 +1,102 @@
+/**
+ * mixer - the levels of Trahagean/Mixer.h: for every 7 bit value, the
+ * attenuation gainTable gives in TL steps, in dB, the General MIDI curve
+ * 40 log10(value / 127) dB it stands for and the SN76489 steps
+ * toSnAttn() makes of it.
+ *
+ * The table is checked against that curve rounded to 0.75dB steps,
+ * toSnAttn() against the attenuation rounded to 2dB steps, and a
+ * channel's note levels against the sum of its four gains saturating at
+ * ATTEN_MAX, for every velocity and volume and a spread of expressions
+ * and master volumes. A mismatch exits 1.
+ *
+ * Usage: mixer
+ */
+#include <math.h>
+#include <stdio.h>
+
+#include "Arduino.h"
+#include "Mixer.h"
+
+static const double TL_DB = 0.75; // a YM2612 TL step
+static const double SN_DB = 2; // an SN76489 attenuation step
+static const byte SPREAD[] = { 0, 1, 64, 100, 127 };
+static const unsigned SPREAD_COUNT = sizeof(SPREAD) / sizeof(SPREAD[0]);
+
+static unsigned expectedGain(unsigned val) {
+    if (val == 0)
+        return Mixer::ATTEN_MAX;
+    const double steps = floor(-40 * log10(val / 127.0) / TL_DB + 0.5);
+    return steps > Mixer::ATTEN_MAX ? Mixer::ATTEN_MAX : (unsigned)steps;
+}
+
+
+static unsigned checkTable() {
+    unsigned errors = 0;
+    printf("value  steps      dB     curve  SN steps\n");
+    for (unsigned val = 0; val < 128; val++) {
+        const byte steps = Mixer::gain(val);
+        const double curve = val ? 40 * log10(val / 127.0) : -INFINITY;
+        printf("%5u  %5u %7.2f %9.2f  %8u\n", val, steps, -steps * TL_DB,
+               curve, Mixer::toSnAttn(steps));
+        if (steps != expectedGain(val)) {
+            fprintf(stderr, "value %u: %u steps, %u expected\n", val, steps,
+                    expectedGain(val));
+            errors++;
+        }
+    }
+    for (unsigned atten = 0; atten <= Mixer::ATTEN_MAX; atten++) {
+        unsigned sn = (unsigned)floor(atten * TL_DB / SN_DB + 0.5);
+        if (sn > Mixer::SN_ATTN_MAX)
+            sn = Mixer::SN_ATTN_MAX;
+        if (Mixer::toSnAttn(atten) != sn) {
+            fprintf(stderr, "%u steps: SN76489 %u, %u expected\n", atten,
+                    Mixer::toSnAttn(atten), sn);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+
+// noteAtten() against the gains summed, one channel's CCs at a time
+static unsigned checkSums() {
+    unsigned errors = 0;
+    Mixer mixer;
+    mixer.begin();
+    for (unsigned m = 0; m < SPREAD_COUNT; m++) {
+        mixer.setMaster(SPREAD[m]);
+        for (unsigned e = 0; e < SPREAD_COUNT; e++) {
+            mixer.setExpression(0, SPREAD[e]);
+            for (unsigned volume = 0; volume < 128; volume++) {
+                mixer.setVolume(0, volume);
+                for (unsigned velocity = 0; velocity < 128; velocity++) {
+                    unsigned sum = Mixer::gain(SPREAD[m])
+                        + Mixer::gain(SPREAD[e]) + Mixer::gain(volume)
+                        + Mixer::gain(velocity);
+                    if (sum > Mixer::ATTEN_MAX)
+                        sum = Mixer::ATTEN_MAX;
+                    if (mixer.noteAtten(0, velocity) != sum) {
+                        fprintf(stderr, "master %u expression %u volume %u "
+                                "velocity %u: %u steps, %u expected\n",
+                                SPREAD[m], SPREAD[e], volume, velocity,
+                                mixer.noteAtten(0, velocity), sum);
+                        errors++;
+                    }
+                }
+            }
+        }
+    }
+    return errors;
+}
+
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        fprintf(stderr, "usage: mixer\n");
+        return 2;
+    }
+    const unsigned errors = checkTable() + checkSums();
+    printf("\n%u errors\n", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+/**
+ * patchsysex - wraps a YM2612 patch file in the SysEx message of
+ * Trahagean/Patch.h that loads it into a channel, or writes the message
+ * asking for a channel's patch back (-r).
+ *
+ * The patch's format goes by its extension: .tfi (TFM Music Maker), .dmp
+ * (a DefleMask Genesis FM preset, version 11) or anything else for the
+ * channel's CHAN_STATE_LENGTH shadow registers, as a dump in that format
+ * comes back. An output ending in .syx is the raw message, for any MIDI
+ * tool that sends SysEx files; any other is a synthrender session line at
+ * -t microseconds, to append to a session.
+ *
+ * Usage: patchsysex [-c channel] [-t time_us] patch.tfi out.syx
+ *        patchsysex -r format [-c channel] [-t time_us] out.txt
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Arduino.h"
+#include "Patch.h"
+
+// the shim runs a sketch's loop(); this tool only needs the layout
+void loop() { }
+
+static bool endsWith(const char *s, const char *end) {
+    const size_t length = strlen(s), n = strlen(end);
+    return length > n && !strcasecmp(s + length - n, end);
+}
+
+
+static byte formatOf(const char *path) {
+    if (endsWith(path, ".tfi"))
+        return Patch::FORMAT_TFI;
+    if (endsWith(path, ".dmp"))
+        return Patch::FORMAT_DMP;
+    return Patch::FORMAT_REGISTERS;
+}
+
+
+// the patch's bytes 7 bits at a time, as PatchSysex decodes them
+static size_t pack(const byte *data, byte length, byte *out) {
+    size_t n = 0;
+    for (byte i = 0; i < length; i += Patch::GROUP) {
+        byte &msbs = out[n++];
+        msbs = 0;
+        for (byte g = 0; g < Patch::GROUP && i + g < length; g++) {
+            msbs |= (data[i + g] >> 7) << g;
+            out[n++] = data[i + g] & 0x7F;
+        }
+    }
+    return n;
+}
+
+
+int main(int argc, char **argv) {
+    unsigned channel = 0;
+    unsigned long time = 0;
+    int requested = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:t:r:h")) != -1) {
+        if (opt == 'c') {
+            channel = atoi(optarg);
+        } else if (opt == 't') {
+            time = strtoul(optarg, NULL, 0);
+        } else if (opt == 'r') {
+            requested = atoi(optarg);
+        } else {
+            optind = argc + 1;
+            break;
+        }
+    }
+    const int files = requested < 0 ? 2 : 1;
+    if (argc - optind != files || channel >= Patch::CHAN_COUNT
+            || requested >= Patch::FORMAT_COUNT) {
+        fprintf(stderr, "usage: patchsysex [-c channel] [-t time_us] "
+                "patch out\n       patchsysex -r format [-c channel] "
+                "[-t time_us] out\nchannel 0-5, format 0 registers, "
+                "1 tfi, 2 dmp\n");
+        return 2;
+    }
+
+    byte message[8 + 2 * Patch::DMP_LENGTH];
+    size_t length = 0;
+    message[length++] = MIDI_SYSEX;
+    message[length++] = Patch::SYSEX_ID;
+    if (requested >= 0) {
+        message[length++] = Patch::PATCH_REQUEST;
+        message[length++] = channel;
+        message[length++] = requested;
+    } else {
+        const char *path = argv[optind];
+        const byte format = formatOf(path);
+        byte patch[Patch::DMP_LENGTH + 1];
+        FILE *in = fopen(path, "rb");
+        if (!in) {
+            perror(path);
+            return 2;
+        }
+        const size_t got = fread(patch, 1, sizeof(patch), in);
+        fclose(in);
+        if (got != Patch::length(format)) {
+            fprintf(stderr, "%s: %u bytes, a patch in its format is %u\n",
+                    path, (unsigned)got, Patch::length(format));
+            return 1;
+        }
+        if (format == Patch::FORMAT_DMP && (patch[0] != Patch::DMP_VERSION
+                || patch[1] != Patch::DMP_GENESIS
+                || patch[2] != Patch::DMP_FM)) {
+            fprintf(stderr, "%s: not a version 11 Genesis FM preset\n",
+                    path);
+            return 1;
+        }
+        message[length++] = Patch::PATCH_DATA;
+        message[length++] = channel;
+        message[length++] = format;
+        length += pack(patch, got, message + length);
+    }
+    message[length++] = MIDI_SYSEX_END;
+
+    const char *outPath = argv[argc - 1];
+    FILE *out = fopen(outPath, "wb");
+    if (!out) {
+        perror(outPath);
+        return 2;
+    }
+    if (endsWith(outPath, ".syx")) {
+        fwrite(message, 1, length, out);
+    } else {
+        fprintf(out, "%lu ", time);
+        for (size_t i = 0; i < length; i++) {
+            fprintf(out, " %02X", message[i]);
+        }
+        fputc('\n', out);
+    }
+    if (fclose(out)) {
+        perror(outPath);
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,156 @@
+/**
+ * seqpattern - build the EEPROM image of sequencer patterns for
+ * Trahagean/Sequencer.h. Each file is one pattern, pattern 1 first, a
+ * step a line:
+ *
+ *     # note  velocity  [tie]
+ *     0       100
+ *     7       80        tie
+ *     12      0
+ *
+ * note is the half steps from the key held (-64 to 63), velocity 1-127
+ * scales the key's and 0 rests; tie holds the note to the next step. An
+ * output ending in .bin is a raw image of the whole EEPROM (synthrender
+ * -E), starting from the image -i names, e.g. drumkit's, or erased; any
+ * other is Intel HEX of the patterns alone, for avrdude -U
+ * eeprom:w:patterns.eep:i, which leaves the kits be. A channel plays
+ * pattern n with CC 102 = Sequencer::MODE_PATTERN1 + n - 1.
+ *
+ * Usage: seqpattern [-i eeprom.bin] -o out pattern1.txt [pattern2.txt ...]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Arduino.h"
+#include "Sequencer.h"
+
+// the shim runs a sketch's loop(); this tool only needs the layout
+void loop() { }
+
+static bool parseLine(char *line, unsigned lineNumber, byte *pattern) {
+    char *hash = strchr(line, '#');
+    if (hash)
+        *hash = 0;
+    int note;
+    unsigned velocity;
+    char tie[16], extra;
+    int n = sscanf(line, "%d %u %15s %c", &note, &velocity, tie, &extra);
+    if (n <= 0)
+        return true; // blank or comment
+    if (n < 2 || n > 3 || (n == 3 && strcmp(tie, "tie"))) {
+        fprintf(stderr, "line %u: expected note velocity [tie]\n",
+                lineNumber);
+        return false;
+    }
+    if (note < -Sequencer::STEP_ROOT || note >= Sequencer::STEP_ROOT
+            || velocity > 127) {
+        fprintf(stderr, "line %u: note is -64-63 and velocity 0-127\n",
+                lineNumber);
+        return false;
+    }
+    if (pattern[1] == Sequencer::PATTERN_STEPS) {
+        fprintf(stderr, "line %u: over %d steps\n", lineNumber,
+                Sequencer::PATTERN_STEPS);
+        return false;
+    }
+    byte *step = pattern + 2 + pattern[1]++ * Sequencer::STEP_SIZE;
+    step[0] = note + Sequencer::STEP_ROOT;
+    step[1] = velocity | (n == 3 ? Sequencer::STEP_TIE : 0);
+    return true;
+}
+
+static bool readPattern(const char *path, byte *pattern) {
+    memset(pattern, 0, Sequencer::PATTERN_SIZE);
+    pattern[0] = Sequencer::PATTERN_MAGIC;
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    unsigned lineNumber = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), in)) {
+        ok = parseLine(line, ++lineNumber, pattern);
+    }
+    fclose(in);
+    if (ok && !pattern[1]) {
+        fprintf(stderr, "%s: no steps\n", path);
+        ok = false;
+    }
+    if (!ok)
+        fprintf(stderr, "%s: not written\n", path);
+    return ok;
+}
+
+static void hexRecord(FILE *out, unsigned address, const byte *data,
+                      unsigned length, byte type) {
+    byte sum = length + (address >> 8) + address + type;
+    fprintf(out, ":%02X%04X%02X", length, address & 0xFFFF, type);
+    for (unsigned i = 0; i < length; i++) {
+        fprintf(out, "%02X", data[i]);
+        sum += data[i];
+    }
+    fprintf(out, "%02X\n", (byte)-sum);
+}
+
+int main(int argc, char **argv) {
+    const char *outPath = NULL, *imagePath = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:o:h")) != -1) {
+        if (opt == 'o') {
+            outPath = optarg;
+        } else if (opt == 'i') {
+            imagePath = optarg;
+        } else {
+            optind = argc + 1;
+            break;
+        }
+    }
+    const int patterns = argc - optind;
+    if (!outPath || patterns < 1 || patterns > SEQ_EEPROM_PATTERNS) {
+        fprintf(stderr, "usage: seqpattern [-i eeprom.bin] -o out "
+                "pattern1.txt [pattern2.txt ...], at most %d patterns\n",
+                SEQ_EEPROM_PATTERNS);
+        return 2;
+    }
+    memset(hostEeprom, 0xFF, sizeof(hostEeprom));
+    if (imagePath) {
+        FILE *image = fopen(imagePath, "rb");
+        if (!image) {
+            perror(imagePath);
+            return 2;
+        }
+        fread(hostEeprom, 1, sizeof(hostEeprom), image);
+        fclose(image);
+    }
+    const unsigned base = SEQ_EEPROM_BASE;
+    for (int p = 0; p < patterns; p++) {
+        if (!readPattern(argv[optind + p],
+                         hostEeprom + base + p * Sequencer::PATTERN_SIZE))
+            return 1;
+    }
+
+    FILE *out = fopen(outPath, "wb");
+    if (!out) {
+        perror(outPath);
+        return 2;
+    }
+    const size_t length = strlen(outPath);
+    if (length > 4 && !strcmp(outPath + length - 4, ".bin")) {
+        fwrite(hostEeprom, 1, sizeof(hostEeprom), out);
+    } else {
+        const unsigned end = base + patterns * Sequencer::PATTERN_SIZE;
+        for (unsigned a = base; a < end; a += 16) {
+            hexRecord(out, a, hostEeprom + a, end - a < 16 ? end - a : 16, 0);
+        }
+        hexRecord(out, 0, NULL, 0, 1); // end of file
+    }
+    if (fclose(out)) {
+        perror(outPath);
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,494 @@
+/* Host shim storage, see Arduino.h */
+#include "Arduino.h"
+#include "avr/eeprom.h"
+
+#include <deque>
+
+uint64_t hostCycles;
+bool hostInterruptsEnabled;
+uint64_t hostInterruptsOffSince;
+uint64_t hostInterruptsOffMax;
+uint64_t hostInterruptLatencyMax;
+bool hostInterruptOnEnable;
+uint64_t hostSleptCycles;
+unsigned long hostWakes;
+uint64_t hostWakeLatencyMax;
+bool hostWakePending;
+uint64_t hostWakeSince;
+
+HostPort PORTA, PORTB, PORTC, PORTD, DDRA, DDRB, DDRC, DDRD;
+HostPort PINA, PINB, PINC, PIND;
+
+volatile uint8_t TCCR0A, TCCR0B, OCR0A, OCR0B, TIMSK0, TIFR0;
+volatile uint8_t TCCR2A, TCCR2B, OCR2A, OCR2B, TIMSK2, TIFR2;
+volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIMSK1;
+HostFlags TIFR1;
+volatile uint16_t OCR1A, OCR1B, ICR1;
+HostTimer16 TCNT1 = { &TCCR1B };
+volatile uint8_t TCCR3A, TCCR3B, TCCR3C, TIMSK3;
+HostFlags TIFR3;
+volatile uint16_t OCR3A, OCR3B, ICR3;
+HostTimer16 TCNT3 = { &TCCR3B };
+uint8_t hostEeprom[E2END + 1];
+volatile uint8_t UCSR0A, UCSR0B, UCSR0C, UDR0, UBRR0H, UBRR0L;
+volatile uint16_t UBRR0;
+volatile uint8_t UCSR1A, UCSR1B, UCSR1C, UDR1, UBRR1H, UBRR1L;
+volatile uint16_t UBRR1;
+volatile uint8_t EICRA, EIMSK, EIFR, SMCR, MCUCR, PRR, GPIOR0;
+volatile uint8_t PCICR, PCMSK0, PCMSK1, PCMSK2, PCMSK3;
+HostFlags PCIFR;
+uint64_t hostLineDue;
+void (*hostLineHook)();
+HostSreg SREG;
+
+HostSerial Serial, Serial1;
+
+/* Vectors the firmware may define with ISR() */
+extern "C" void TIMER1_OVF_vect(void) __attribute__((weak));
+extern "C" void TIMER1_COMPA_vect(void) __attribute__((weak));
+extern "C" void TIMER1_COMPB_vect(void) __attribute__((weak));
+extern "C" void TIMER3_OVF_vect(void) __attribute__((weak));
+extern "C" void TIMER3_COMPA_vect(void) __attribute__((weak));
+extern "C" void TIMER3_COMPB_vect(void) __attribute__((weak));
+extern "C" void PCINT0_vect(void) __attribute__((weak));
+extern "C" void PCINT1_vect(void) __attribute__((weak));
+extern "C" void PCINT2_vect(void) __attribute__((weak));
+extern "C" void PCINT3_vect(void) __attribute__((weak));
+
+/* The sketch */
+void loop();
+void serialEvent() __attribute__((weak));
+void serialEvent1() __attribute__((weak));
+
+struct WireByte {
+    uint64_t end; // cycle the stop bit ends
+    uint8_t data;
+};
+
+/* a USART's receive side: the wire into it and when its FIFO bytes landed */
+struct HostUsart {
+    HostSerial &port;
+    std::deque<WireByte> wire;
+    uint64_t wireFree; // cycle the last scheduled byte ends
+    uint64_t fifoPending[HostSerial::FIFO_SIZE]; // cycle each byte landed
+};
+
+static HostUsart usarts[] = { { Serial }, { Serial1 } };
+static const size_t USART_COUNT = sizeof(usarts) / sizeof(usarts[0]);
+
+/* a 16 bit timer and its interrupts */
+struct HostTimerUnit {
+    HostTimer16 &counter;
+    volatile uint8_t &mask; // TIMSKn
+    HostFlags &flags; // TIFRn
+    volatile uint16_t &compareA; // OCRnA
+    volatile uint16_t &compareB; // OCRnB
+    void (*overflowVector)(void);
+    void (*compareVector)(void);
+    void (*compareBVector)(void);
+    uint64_t overflowPending; // cycle TOVn was last set
+    uint64_t comparePending; // cycle OCFnA was last set
+    uint64_t compareBPending; // cycle OCFnB was last set
+};
+
+// in vector order, so Timer1 goes first; the bit numbers are the same
+static HostTimerUnit timers[] = {
+    { TCNT1, TIMSK1, TIFR1, OCR1A, OCR1B, TIMER1_OVF_vect, TIMER1_COMPA_vect,
+        TIMER1_COMPB_vect },
+    { TCNT3, TIMSK3, TIFR3, OCR3A, OCR3B, TIMER3_OVF_vect, TIMER3_COMPA_vect,
+        TIMER3_COMPB_vect }
+};
+static const size_t TIMER_COUNT = sizeof(timers) / sizeof(timers[0]);
+
+/* a pin change interrupt: the PINx it watches and its PCMSKn */
+struct HostPinGroup {
+    HostPort &pins;
+    volatile uint8_t &mask;
+    void (*vector)(void);
+    uint64_t pending; // cycle PCIFn was last set
+};
+
+#ifdef PCMSK3
+static HostPinGroup pinGroups[] = {
+    { PINA, PCMSK0, PCINT0_vect }, { PINB, PCMSK1, PCINT1_vect },
+    { PINC, PCMSK2, PCINT2_vect }, { PIND, PCMSK3, PCINT3_vect }
+};
+#else
+static HostPinGroup pinGroups[] = {
+    { PINB, PCMSK0, PCINT0_vect }, { PINC, PCMSK1, PCINT1_vect },
+    { PIND, PCMSK2, PCINT2_vect }
+};
+#endif
+static const size_t PIN_GROUP_COUNT = sizeof(pinGroups) / sizeof(pinGroups[0]);
+
+static uint64_t runLimit; // where hostRunUntil() stops, sleep ends there too
+
+enum {
+    LOOP_CYCLES = 12, // main(): call loop(), serialEventRun() check
+    IDLE_STEP = 1024, // longest jump while idle, so loop() still polls
+    RX_ISR_CYCLES = 60, // core USART_RX_vect: read UDR0, store in buffer
+    WAKE_CYCLES = 4 // the CPU stays halted this long after an idle wake
+};
+
+static const uint16_t timerPrescale[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+
+static uint16_t prescaler(const HostTimer16 &counter) {
+    return timerPrescale[*counter.control & 7];
+}
+
+uint64_t HostTimer16::ticks() const {
+    uint16_t prescale = prescaler(*this);
+    if (!prescale)
+        return start;
+    return start + (hostCycles - base) / prescale;
+}
+
+HostTimer16 &HostTimer16::operator=(uint16_t v) {
+    base = hostCycles;
+    start = v;
+    overflows = 0;
+    compared = v;
+    comparedB = v;
+    return *this;
+}
+
+/* cycle of the timer's next overflow, UINT64_MAX while it is stopped */
+static uint64_t nextOverflow(const HostTimerUnit &t) {
+    uint16_t prescale = prescaler(t.counter);
+    if (!prescale)
+        return UINT64_MAX;
+    return t.counter.base
+        + (((t.counter.overflows + 1) << 16) - t.counter.start) * prescale;
+}
+
+/* cycle of the first match with ocr after the ticks already compared */
+static uint64_t nextMatch(const HostTimerUnit &t, uint16_t ocr,
+                          uint64_t compared) {
+    uint16_t prescale = prescaler(t.counter);
+    if (!prescale)
+        return UINT64_MAX;
+    uint32_t distance = (uint16_t)(ocr - compared);
+    if (!distance)
+        distance = 0x10000;
+    return t.counter.base + (compared + distance - t.counter.start) * prescale;
+}
+
+static uint64_t nextCompare(const HostTimerUnit &t) {
+    return nextMatch(t, t.compareA, t.counter.compared);
+}
+
+static uint64_t nextCompareB(const HostTimerUnit &t) {
+    return nextMatch(t, t.compareB, t.counter.comparedB);
+}
+
+/* cycle the first byte still on a wire ends, UINT64_MAX if none */
+static uint64_t nextWireByte() {
+    uint64_t next = UINT64_MAX;
+    for (size_t i = 0; i < USART_COUNT; i++) {
+        if (!usarts[i].wire.empty() && usarts[i].wire.front().end < next)
+            next = usarts[i].wire.front().end;
+    }
+    return next;
+}
+
+/* cycle of the next interrupt that can be taken, UINT64_MAX if none */
+static uint64_t nextInterrupt() {
+    uint64_t next = nextWireByte();
+    if (PCICR && hostLineDue < next) // a pin the device drives may change
+        next = hostLineDue;
+    for (size_t i = 0; i < TIMER_COUNT; i++) {
+        const HostTimerUnit &t = timers[i];
+        // TOIEn and OCIEnA are bits 0 and 1 of every TIMSKn
+        if ((t.mask & bit(TOIE1)) && t.overflowVector
+                && nextOverflow(t) < next)
+            next = nextOverflow(t);
+        if ((t.mask & bit(OCIE1A)) && t.compareVector
+                && nextCompare(t) < next)
+            next = nextCompare(t);
+        if ((t.mask & bit(OCIE1B)) && t.compareBVector
+                && nextCompareB(t) < next)
+            next = nextCompareB(t);
+    }
+    return next;
+}
+
+/* Run an ISR the way the AVR does: I cleared on entry, set by RETI */
+static void hostInterrupt(void (*vector)(void), uint64_t pendingSince) {
+    if (hostCycles - pendingSince > hostInterruptLatencyMax)
+        hostInterruptLatencyMax = hostCycles - pendingSince;
+    hostInterruptOnEnable = true;
+    noInterrupts();
+    hostCycles += 7; // entry: push PC, jump through the vector table
+    vector();
+    hostCycles += 5; // RETI
+    hostInterruptsEnabled = true;
+    if (hostCycles - hostInterruptsOffSince > hostInterruptsOffMax)
+        hostInterruptsOffMax = hostCycles - hostInterruptsOffSince;
+}
+
+/* what the Arduino core's USART_RX_vect does */
+static void serialRxInterrupt(HostUsart &u) {
+    HostSerial &port = u.port;
+    uint8_t data = port.fifo[0];
+    port.fifo[0] = port.fifo[1];
+    u.fifoPending[0] = u.fifoPending[1];
+    port.fifoCount--;
+    hostCycles += RX_ISR_CYCLES;
+    port.inject(data);
+}
+
+static void serial0RxInterrupt() {
+    serialRxInterrupt(usarts[0]);
+}
+
+static void serial1RxInterrupt() {
+    serialRxInterrupt(usarts[1]);
+}
+
+static void (*const serialRxVectors[])(void) = {
+    serial0RxInterrupt, serial1RxInterrupt
+};
+
+static HostUsart &usart(HostSerial &port) {
+    return &port == &Serial1 ? usarts[1] : usarts[0];
+}
+
+uint64_t hostSerialSend(HostSerial &port, uint8_t data, uint64_t notBefore) {
+    HostUsart &u = usart(port);
+    uint64_t start = notBefore > u.wireFree ? notBefore : u.wireFree;
+    WireByte b = { start + 10ULL * F_CPU / port.baud, data };
+    u.wire.push_back(b);
+    u.wireFree = b.end;
+    return b.end;
+}
+
+size_t hostSerialPending(HostSerial &port) {
+    return usart(port).wire.size();
+}
+
+void hostRunUntil(uint64_t cycles) {
+    runLimit = cycles;
+    while (hostCycles < cycles) {
+        uint64_t slept = hostSleptCycles;
+        loop();
+        hostDelayCycles(LOOP_CYCLES);
+        // the core's serialEventRun(), each port with input in turn
+        bool events = false;
+        if (serialEvent && Serial.available()) {
+            serialEvent();
+            events = true;
+        }
+        if (serialEvent1 && Serial1.available()) {
+            serialEvent1();
+            events = true;
+        }
+        if (events)
+            continue;
+        if (hostSleptCycles != slept)
+            continue; // loop() slept until there was work, no polling
+
+        uint64_t next = cycles;
+        if (nextWireByte() < next)
+            next = nextWireByte();
+        if (next > hostCycles)
+            hostDelayCycles(next - hostCycles < IDLE_STEP
+                ? next - hostCycles : IDLE_STEP);
+    }
+}
+
+void hostDelayCycles(uint64_t cycles) {
+    while (cycles) {
+        uint64_t step = cycles;
+        if (hostInterruptsEnabled) {
+            uint64_t next = nextInterrupt();
+            if (next > hostCycles && next - hostCycles < step)
+                step = next - hostCycles;
+        }
+        hostCycles += step;
+        cycles -= step;
+        hostService();
+    }
+}
+
+void hostSleep() {
+    hostWakePending = false; // the last wake had nothing to dispatch
+    // the pattern is sei(); sleep_cpu(); and an interrupt already pending
+    // at the sei() is taken right after the sleep instruction, waking it
+    if (hostInterruptOnEnable || !hostInterruptsEnabled) {
+        hostInterruptOnEnable = false;
+        return;
+    }
+    uint64_t next = nextInterrupt();
+    if (next < hostCycles)
+        next = hostCycles;
+    if (next >= runLimit) { // nothing to wake for before the run ends
+        if (runLimit > hostCycles) {
+            hostSleptCycles += runLimit - hostCycles;
+            hostCycles = runLimit;
+        }
+        return;
+    }
+    hostSleptCycles += next - hostCycles;
+    hostCycles = next + WAKE_CYCLES;
+    hostWakes++;
+    hostWakePending = true;
+    hostWakeSince = next;
+    hostService();
+}
+
+void hostPinsChanged(HostPort &pins, uint8_t previous) {
+    for (size_t i = 0; i < PIN_GROUP_COUNT; i++) {
+        HostPinGroup &g = pinGroups[i];
+        if (&g.pins == &pins && ((pins ^ previous) & g.mask)) {
+            g.pending = hostCycles;
+            PCIFR.value |= bit(i);
+        }
+    }
+    hostService();
+}
+
+/* Take the first pending interrupt in vector order: the pin changes,
+ * Timer1, the USARTs' RX, then Timer3, as on the 1284P. False if none is
+ * pending. */
+static bool takeInterrupt() {
+    for (size_t i = 0; i < PIN_GROUP_COUNT; i++) {
+        HostPinGroup &g = pinGroups[i];
+        if ((PCIFR & bit(i)) && (PCICR & bit(i)) && g.vector) {
+            PCIFR.value &= ~bit(i);
+            hostInterrupt(g.vector, g.pending);
+            return true;
+        }
+    }
+    for (size_t i = 0; i < TIMER_COUNT; i++) {
+        HostTimerUnit &t = timers[i];
+        if (i == 1) {
+            for (size_t j = 0; j < USART_COUNT; j++) {
+                if (usarts[j].port.fifoCount) {
+                    hostInterrupt(serialRxVectors[j],
+                                  usarts[j].fifoPending[0]);
+                    return true;
+                }
+            }
+        }
+        if ((t.flags & bit(TOV1)) && (t.mask & bit(TOIE1))
+                && t.overflowVector) {
+            t.flags.value &= ~bit(TOV1);
+            hostInterrupt(t.overflowVector, t.overflowPending);
+            return true;
+        }
+        if ((t.flags & bit(OCF1A)) && (t.mask & bit(OCIE1A))
+                && t.compareVector) {
+            t.flags.value &= ~bit(OCF1A);
+            hostInterrupt(t.compareVector, t.comparePending);
+            return true;
+        }
+        if ((t.flags & bit(OCF1B)) && (t.mask & bit(OCIE1B))
+                && t.compareBVector) {
+            t.flags.value &= ~bit(OCF1B);
+            hostInterrupt(t.compareBVector, t.compareBPending);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* nothing left to flag or deliver up to hostCycles */
+static bool quiet() {
+    for (size_t i = 0; i < TIMER_COUNT; i++) {
+        const HostTimerUnit &t = timers[i];
+        if (t.counter.overflows < t.counter.ticks() >> 16
+                || (prescaler(t.counter) && (nextCompare(t) <= hostCycles
+                    || nextCompareB(t) <= hostCycles)))
+            return false;
+    }
+    return nextWireByte() > hostCycles && hostLineDue > hostCycles;
+}
+
+void hostService() {
+    static bool servicing; // ISRs advance time and land back here
+    if (servicing)
+        return;
+    servicing = true;
+    for (;;) {
+        for (size_t i = 0; i < TIMER_COUNT; i++) {
+            HostTimerUnit &t = timers[i];
+            if (t.counter.overflows < t.counter.ticks() >> 16) {
+                t.overflowPending = nextOverflow(t);
+                t.counter.overflows++;
+                t.flags.value |= bit(TOV1);
+            }
+            if (prescaler(t.counter) && nextCompare(t) <= hostCycles) {
+                t.comparePending = nextCompare(t);
+                t.counter.compared = t.counter.ticks();
+                t.flags.value |= bit(OCF1A);
+            }
+            if (prescaler(t.counter) && nextCompareB(t) <= hostCycles) {
+                t.compareBPending = nextCompareB(t);
+                t.counter.comparedB = t.counter.ticks();
+                t.flags.value |= bit(OCF1B);
+            }
+        }
+        if (hostLineDue <= hostCycles) {
+            hostLineDue = UINT64_MAX;
+            if (hostLineHook)
+                hostLineHook(); // may set PINx bits and the next due
+        }
+        for (size_t i = 0; i < USART_COUNT; i++) {
+            HostUsart &u = usarts[i];
+            if (!u.wire.empty() && u.wire.front().end <= hostCycles) {
+                if (u.port.fifoCount < HostSerial::FIFO_SIZE) {
+                    u.fifoPending[u.port.fifoCount] = u.wire.front().end;
+                    u.port.fifo[u.port.fifoCount++] = u.wire.front().data;
+                }
+                else
+                    u.port.overruns++;
+                u.wire.pop_front();
+            }
+        }
+        if (hostInterruptsEnabled && takeInterrupt())
+            continue;
+        if (quiet())
+            break;
+    }
+    servicing = false;
+}
+
+void hostReset() {
+    HostPort *ports[] = {
+        &PORTA, &PORTB, &PORTC, &PORTD, &DDRA, &DDRB, &DDRC, &DDRD,
+        &PINA, &PINB, &PINC, &PIND
+    };
+    for (size_t i = 0; i < sizeof(ports) / sizeof(ports[0]); i++) {
+        ports[i]->value = 0;
+        ports[i]->hook = NULL;
+    }
+    hostCycles = 0;
+    hostInterruptsEnabled = true;
+    hostInterruptsOffSince = 0;
+    hostInterruptsOffMax = 0;
+    hostInterruptLatencyMax = 0;
+    hostInterruptOnEnable = false;
+    hostSleptCycles = 0;
+    hostWakes = 0;
+    hostWakeLatencyMax = 0;
+    hostWakePending = false;
+    runLimit = 0;
+    TCCR1A = TCCR1B = TIMSK1 = 0;
+    TIFR1.value = 0;
+    OCR1A = OCR1B = 0;
+    TCNT1 = 0;
+    TCCR3A = TCCR3B = TIMSK3 = 0;
+    TIFR3.value = 0;
+    OCR3A = OCR3B = 0;
+    TCNT3 = 0;
+    PCICR = PCMSK0 = PCMSK1 = PCMSK2 = PCMSK3 = 0;
+    PCIFR.value = 0;
+    hostLineDue = UINT64_MAX;
+    hostLineHook = NULL;
+    for (size_t i = 0; i < USART_COUNT; i++) {
+        memset(&usarts[i].port, 0, sizeof(HostSerial));
+        usarts[i].wire.clear();
+        usarts[i].wireFree = 0;
+    }
+    memset(hostEeprom, 0xFF, sizeof(hostEeprom));
+}
@@ -0,0 +1,447 @@
+/**
+ * Host shim for the Arduino/AVR API.
+ *
+ * Lets the firmware headers (YM2612.h, SN76489.h, MegaSynth.h, ...) and the
+ * sketches compile unmodified on Linux. GPIO ports are objects that call a
+ * hook on every write, so a host tool can decode the chip buses exactly as
+ * the sound chips see them. Time is simulated: delays advance hostCycles
+ * instead of sleeping.
+ */
+#ifndef HOST_ARDUINO_H__
+#define HOST_ARDUINO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "binary.h"
+
+typedef uint8_t byte;
+typedef uint16_t word;
+typedef bool boolean;
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+/* The peripherals are a superset of the ATmega328P and 1284P: PORTA,
+ * Timer3 and USART1 are there whatever the part. The RAM and EEPROM sizes
+ * follow the part's macro, as avr-gcc -mmcu defines it, so the firmware's
+ * buffers scale as they would on it. Without one it is a 328P. */
+#if defined(__AVR_ATmega1284P__) || defined(__AVR_ATmega1284__)
+#define RAMEND 0x40FF // 16KB
+#define E2END 0xFFF // 4KB
+#elif defined(__AVR_ATmega644P__) || defined(__AVR_ATmega644__)
+#define RAMEND 0x10FF // 4KB
+#define E2END 0x7FF // 2KB
+#else
+#define RAMEND 0x08FF // 2KB
+#define E2END 0x3FF // 1KB
+#endif
+#define RAMSTART 0x100
+
+#define PROGMEM
+#define EEMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define memcpy_P(d, s, n) memcpy((d), (s), (n))
+
+#define bit(b) (1UL << (b))
+#define lowByte(w) ((uint8_t)((w) & 0xFF))
+#define highByte(w) ((uint8_t)((w) >> 8))
+inline word makeWord(uint16_t w) { return w; }
+inline word makeWord(uint8_t h, uint8_t l) { return h << 8 | l; }
+#define word(...) makeWord(__VA_ARGS__)
+#define bitRead(value, b) (((value) >> (b)) & 0x01)
+#define bitSet(value, b) ((value) |= bit(b))
+#define bitClear(value, b) ((value) &= ~bit(b))
+#define _BV(b) (1 << (b))
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define LED_BUILTIN 13
+
+/* Simulated CPU clock, in F_CPU cycles since hostReset() */
+extern uint64_t hostCycles;
+
+/* Bring the simulated peripherals up to hostCycles: timer overflows and
+ * any interrupt that became deliverable */
+void hostService();
+
+/* Spend cycles, stopping at each interrupt that may be taken on the way,
+ * so an ISR preempts a busy wait the way it does on the AVR and stretches
+ * it by its own run time */
+void hostDelayCycles(uint64_t cycles);
+
+/* Idle sleep (avr/sleep.h): time is measured from the interrupt that ends
+ * a sleep to the firmware's first port write or Serial.read(), which is
+ * where it starts acting on the wake */
+extern uint64_t hostSleptCycles;
+extern unsigned long hostWakes;
+extern uint64_t hostWakeLatencyMax;
+extern bool hostWakePending;
+extern uint64_t hostWakeSince;
+
+inline void hostWakeDispatched() {
+    if (hostWakePending) {
+        hostWakePending = false;
+        if (hostCycles - hostWakeSince > hostWakeLatencyMax)
+            hostWakeLatencyMax = hostCycles - hostWakeSince;
+    }
+}
+
+/* sleep_cpu(): jump to the next interrupt and take it */
+void hostSleep();
+
+/* An 8 bit I/O register that reports every write to an optional hook */
+class HostPort {
+    public:
+    typedef void (*hook_t)(HostPort &port, uint8_t previous);
+    uint8_t value;
+    hook_t hook;
+
+    HostPort &operator=(uint8_t v) {
+        uint8_t previous = value;
+        value = v;
+        hostWakeDispatched();
+        hostDelayCycles(1); // OUT/SBI/CBI
+        if (hook)
+            hook(*this, previous);
+        return *this;
+    }
+    // masks arrive as int or long like on the AVR and are truncated there
+    HostPort &operator|=(unsigned long v) { return *this = value | (uint8_t)v; }
+    HostPort &operator&=(unsigned long v) { return *this = value & (uint8_t)v; }
+    HostPort &operator^=(unsigned long v) { return *this = value ^ (uint8_t)v; }
+    operator uint8_t() const { return value; }
+};
+
+/* GPIO */
+extern HostPort PORTA, PORTB, PORTC, PORTD, DDRA, DDRB, DDRC, DDRD;
+extern HostPort PINA, PINB, PINC, PIND;
+
+/* everything else is plain memory */
+extern volatile uint8_t TCCR0A, TCCR0B, OCR0A, OCR0B, TIMSK0, TIFR0;
+extern volatile uint8_t TCCR2A, TCCR2B, OCR2A, OCR2B, TIMSK2, TIFR2;
+extern volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIMSK1;
+extern volatile uint16_t OCR1A, OCR1B, ICR1;
+extern volatile uint8_t TCCR3A, TCCR3B, TCCR3C, TIMSK3;
+extern volatile uint16_t OCR3A, OCR3B, ICR3;
+// avr/io.h defines registers as macros, and #ifdef TCCR3A is how code
+// tells a part with Timer3
+#define TCCR3A TCCR3A
+extern volatile uint8_t UCSR0A, UCSR0B, UCSR0C, UDR0, UBRR0H, UBRR0L;
+extern volatile uint16_t UBRR0;
+extern volatile uint8_t UCSR1A, UCSR1B, UCSR1C, UDR1, UBRR1H, UBRR1L;
+extern volatile uint16_t UBRR1;
+extern volatile uint8_t EICRA, EIMSK, EIFR, SMCR, MCUCR, PRR, GPIOR0;
+extern volatile uint8_t PCICR, PCMSK0, PCMSK1, PCMSK2, PCMSK3;
+// and #ifdef PCMSK3 how it tells a part with PORTA, whose PORTD is pin
+// change group 3
+#if defined(__AVR_ATmega1284P__) || defined(__AVR_ATmega1284__) \
+    || defined(__AVR_ATmega644P__) || defined(__AVR_ATmega644__)
+#define PCMSK3 PCMSK3
+#endif
+
+/* Timer1 and Timer3 in normal mode: count hostCycles at the TCCRnB
+ * prescaler from the last TCNTn write and set TOVn, raising
+ * TIMERn_OVF_vect when TOIEn is set, and OCFnA and OCFnB on a match with
+ * OCRnA and OCRnB, raising TIMERn_COMPA_vect and TIMERn_COMPB_vect when
+ * OCIEnA and OCIEnB are set. CTC and PWM modes are not simulated. */
+class HostTimer16 {
+    public:
+    volatile uint8_t *control; // TCCRnB, for the prescaler
+    uint64_t base; // hostCycles at the last write
+    uint16_t start; // the value written
+    uint64_t overflows; // overflows already flagged since the write
+    uint64_t compared; // ticks checked against OCRnA
+    uint64_t comparedB; // and OCRnB
+
+    uint64_t ticks() const;
+    operator uint16_t() const { return (uint16_t)ticks(); }
+    HostTimer16 &operator=(uint16_t v);
+};
+
+extern HostTimer16 TCNT1, TCNT3;
+
+/* An interrupt flag register: writing a 1 to a flag clears it, as on the
+ * AVR. The shim sets flags through value. */
+class HostFlags {
+    public:
+    uint8_t value;
+
+    HostFlags &operator=(uint8_t v) {
+        value &= ~v;
+        return *this;
+    }
+    operator uint8_t() const { return value; }
+};
+
+extern HostFlags TIFR1, TIFR3, PCIFR;
+
+/* Pin change interrupts: a change of a PINx bit that its PCMSKn lets
+ * through sets PCIFn, raising PCINTn_vect when PCIEn is set in PCICR. The
+ * groups are numbered as the part numbers them, PORTA's first on the
+ * 1284P and PORTB's on the 328P. Nothing on the AVR side drives PINx, so
+ * a device outside it that does calls hostPinsChanged() after it sets
+ * the bits. */
+void hostPinsChanged(HostPort &pins, uint8_t previous);
+
+/* Such a device's next change: hostLineHook() runs once the simulated
+ * clock reaches hostLineDue, UINT64_MAX while there is nothing to do, and
+ * sets the next due itself. ChipBus.h drives the YM2612's IRQ this way. */
+extern uint64_t hostLineDue;
+extern void (*hostLineHook)();
+
+enum {PORTA0, PORTA1, PORTA2, PORTA3, PORTA4, PORTA5, PORTA6, PORTA7};
+enum {PORTB0, PORTB1, PORTB2, PORTB3, PORTB4, PORTB5, PORTB6, PORTB7};
+enum {PORTC0, PORTC1, PORTC2, PORTC3, PORTC4, PORTC5, PORTC6, PORTC7};
+enum {PORTD0, PORTD1, PORTD2, PORTD3, PORTD4, PORTD5, PORTD6, PORTD7};
+enum {PINA0, PINA1, PINA2, PINA3, PINA4, PINA5, PINA6, PINA7};
+enum {PINB0, PINB1, PINB2, PINB3, PINB4, PINB5, PINB6, PINB7};
+enum {PINC0, PINC1, PINC2, PINC3, PINC4, PINC5, PINC6, PINC7};
+enum {PIND0, PIND1, PIND2, PIND3, PIND4, PIND5, PIND6, PIND7};
+
+/* ATmega328p and 1284p register bits used by the firmware */
+#define CS00 0
+#define WGM01 1
+#define COM0B0 4
+#define COM0A0 6
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM10 0
+#define WGM11 1
+#define WGM12 3
+#define WGM13 4
+#define COM1B0 4
+#define COM1B1 5
+#define COM1A0 6
+#define TOIE1 0
+#define OCIE1A 1
+#define OCIE1B 2
+#define OCF1A 1
+#define OCF1B 2
+#define TOV1 0
+#define CS30 0
+#define CS31 1
+#define CS32 2
+#define TOIE3 0
+#define OCIE3A 1
+#define OCIE3B 2
+#define OCF3A 1
+#define OCF3B 2
+#define TOV3 0
+#define CS20 0
+#define WGM21 1
+#define COM2B0 4
+#define COM2A0 6
+#define U2X0 1
+#define UDRE0 5
+#define RXC0 7
+#define UCSZ00 1
+#define UCSZ01 2
+#define TXEN0 3
+#define RXEN0 4
+#define UDRIE0 5
+#define RXCIE0 7
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PCIE3 3
+#define PCIF0 0
+#define PCIF1 1
+#define PCIF2 2
+#define PCIF3 3
+#define PCINT20 4
+#define PCINT28 4
+#define PCINT31 7
+#define INT0 0
+#define INT1 1
+#define INTF0 0
+#define INTF1 1
+#define ISC00 0
+#define ISC01 1
+#define ISC10 2
+#define ISC11 3
+#define SE 0
+#define SM0 1
+#define SM1 2
+#define SM2 3
+
+/* Interrupts: tracked so tools can measure how long they stay masked, and
+ * the worst latency from an interrupt going pending (a byte done in the
+ * USART, a Timer1 overflow) to its ISR being entered */
+extern bool hostInterruptsEnabled;
+extern uint64_t hostInterruptsOffSince;
+extern uint64_t hostInterruptsOffMax;
+extern uint64_t hostInterruptLatencyMax;
+extern bool hostInterruptOnEnable; // the last interrupts() took one
+
+inline void noInterrupts() {
+    if (hostInterruptsEnabled) {
+        hostInterruptsEnabled = false;
+        hostInterruptsOffSince = hostCycles;
+    }
+}
+
+inline void interrupts() {
+    hostInterruptOnEnable = false;
+    if (!hostInterruptsEnabled) {
+        hostInterruptsEnabled = true;
+        if (hostCycles - hostInterruptsOffSince > hostInterruptsOffMax)
+            hostInterruptsOffMax = hostCycles - hostInterruptsOffSince;
+        hostService(); // anything that went pending while masked
+    }
+}
+
+/* Only the I bit is simulated, so saving and restoring SREG around a
+ * critical section works */
+class HostSreg {
+    public:
+    operator uint8_t() const { return hostInterruptsEnabled ? 0x80 : 0; }
+    HostSreg &operator=(uint8_t v) {
+        if (v & 0x80)
+            interrupts();
+        else
+            noInterrupts();
+        return *this;
+    }
+};
+
+extern HostSreg SREG;
+
+inline void cli() { noInterrupts(); }
+inline void sei() { interrupts(); }
+
+#define ISR(vector) extern "C" void vector(void)
+#define EMPTY_INTERRUPT(vector) ISR(vector) { }
+
+/* Digital I/O and timing */
+inline void pinMode(uint8_t pin, uint8_t mode) { }
+inline void digitalWrite(uint8_t pin, uint8_t val) { hostDelayCycles(50); }
+inline int digitalRead(uint8_t pin) { return LOW; }
+
+inline unsigned long micros() {
+    return hostCycles / (F_CPU / 1000000UL);
+}
+
+inline unsigned long millis() {
+    return hostCycles / (F_CPU / 1000UL);
+}
+
+inline void delayMicroseconds(unsigned int us) {
+    hostDelayCycles((uint64_t)us * (F_CPU / 1000000UL));
+}
+
+inline void delay(unsigned long ms) {
+    hostDelayCycles((uint64_t)ms * (F_CPU / 1000UL));
+}
+
+/* The top level Makefile gives the Arduino core the same sizes for each
+ * part, see BY_RAM() in Trahagean/Board.h */
+#ifndef SERIAL_RX_BUFFER_SIZE
+#if RAMEND >= 0x40FF
+#define SERIAL_RX_BUFFER_SIZE 256
+#elif RAMEND >= 0x10FF
+#define SERIAL_RX_BUFFER_SIZE 128
+#else
+#define SERIAL_RX_BUFFER_SIZE 64 // the Arduino core's default
+#endif
+#endif
+
+/* Serial ports fed from a host side buffer. Bytes scheduled with
+ * hostSerialSend() land in the USART's two byte receive FIFO when their
+ * stop bit ends and are moved to the RX buffer by a simulated core RX
+ * interrupt, so they wait while interrupts are masked and are lost on
+ * overrun like on the AVR. Serial is USART0, Serial1 USART1. */
+class HostSerial {
+    public:
+    enum {
+        BUFFER_SIZE = SERIAL_RX_BUFFER_SIZE,
+        FIFO_SIZE = 2 // UDR0 receive FIFO
+    };
+    static_assert(BUFFER_SIZE <= 256 && !(BUFFER_SIZE & (BUFFER_SIZE - 1)),
+        "SERIAL_RX_BUFFER_SIZE must be a power of two <= 256");
+    uint8_t rx[BUFFER_SIZE];
+    uint8_t rxHead;
+    uint8_t rxTail;
+    uint8_t fifo[FIFO_SIZE];
+    uint8_t fifoCount;
+    unsigned long dropped; // bytes lost to a full RX buffer
+    unsigned long overruns; // bytes lost to a full FIFO (DOR0)
+    unsigned long reads; // bytes taken with read()
+    unsigned long baud;
+    void (*txHook)(uint8_t data);
+
+    void begin(unsigned long rate) { baud = rate; }
+    void end() { }
+    int available() {
+        return (uint8_t)(rxHead - rxTail) % BUFFER_SIZE;
+    }
+    int peek() {
+        return rxHead == rxTail ? -1 : rx[rxTail];
+    }
+    int read() {
+        hostWakeDispatched();
+        if (rxHead == rxTail)
+            return -1;
+        uint8_t data = rx[rxTail];
+        rxTail = (rxTail + 1) % BUFFER_SIZE;
+        reads++;
+        return data;
+    }
+    size_t write(uint8_t data) {
+        if (txHook)
+            txHook(data);
+        return 1;
+    }
+    size_t write(const uint8_t *data, size_t length) {
+        for (size_t i = 0; i < length; i++)
+            write(data[i]);
+        return length;
+    }
+    void flush() { }
+    operator bool() { return true; }
+
+    /* host side: put a byte straight into the RX buffer */
+    void inject(uint8_t data) {
+        uint8_t next = (rxHead + 1) % BUFFER_SIZE;
+        if (next == rxTail) {
+            dropped++;
+            return;
+        }
+        rx[rxHead] = data;
+        rxHead = next;
+    }
+};
+
+extern HostSerial Serial, Serial1;
+
+/* Schedule a byte on a port's RX wire, Serial's by default. It starts at
+ * notBefore or when the previous byte has finished, whichever is later,
+ * and takes 10 bit times at the port's baud. Returns the cycle its stop
+ * bit ends. */
+uint64_t hostSerialSend(HostSerial &port, uint8_t data, uint64_t notBefore);
+inline uint64_t hostSerialSend(uint8_t data, uint64_t notBefore) {
+    return hostSerialSend(Serial, data, notBefore);
+}
+
+/* Bytes scheduled but not yet off the wire */
+size_t hostSerialPending(HostSerial &port);
+inline size_t hostSerialPending() {
+    return hostSerialPending(Serial);
+}
+
+/* Run the Arduino main loop, loop() then serialEvent() and serialEvent1()
+ * when their port has input, until hostCycles reaches cycles */
+void hostRunUntil(uint64_t cycles);
+
+/* Put the shim back in its power-on state */
+void hostReset();
+
+#endif
@@ -0,0 +1,2 @@
+/* Host shim: deprecated avr-libc location of util/delay.h */
+#include "../util/delay.h"
@@ -0,0 +1,38 @@
+/* Host shim: the EEPROM is an array, erased (0xFF) by hostReset(). Host
+ * tools can fill it after the reset, as avrdude would, before setup().
+ * E2END follows the part, see Arduino.h. */
+#ifndef HOST_EEPROM_H__
+#define HOST_EEPROM_H__
+
+#include "../Arduino.h"
+
+extern uint8_t hostEeprom[E2END + 1];
+
+inline uint8_t eeprom_read_byte(const uint8_t *address) {
+    return hostEeprom[(uintptr_t)address & E2END];
+}
+
+inline uint16_t eeprom_read_word(const uint16_t *address) {
+    return eeprom_read_byte((const uint8_t *)address)
+        | eeprom_read_byte((const uint8_t *)address + 1) << 8;
+}
+
+inline void eeprom_read_block(void *dst, const void *src, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        ((uint8_t *)dst)[i] = eeprom_read_byte((const uint8_t *)src + i);
+}
+
+inline void eeprom_update_byte(uint8_t *address, uint8_t value) {
+    hostEeprom[(uintptr_t)address & E2END] = value;
+}
+
+inline void eeprom_write_byte(uint8_t *address, uint8_t value) {
+    eeprom_update_byte(address, value);
+}
+
+inline void eeprom_update_block(const void *src, void *dst, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        eeprom_update_byte((uint8_t *)dst + i, ((const uint8_t *)src)[i]);
+}
+
+#endif
@@ -0,0 +1,2 @@
+/* Host shim: see noInterrupts()/interrupts() in Arduino.h */
+#include "../Arduino.h"
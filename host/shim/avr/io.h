@@ -0,0 +1,2 @@
+/* Host shim: all I/O registers are declared by Arduino.h */
+#include "../Arduino.h"
@@ -0,0 +1,2 @@
+/* Host shim: program memory is ordinary memory */
+#include "../Arduino.h"
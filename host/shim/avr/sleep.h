@@ -0,0 +1,14 @@
+/* Host shim: idle sleep, see hostSleep() in Arduino.h */
+#ifndef HOST_AVR_SLEEP_H__
+#define HOST_AVR_SLEEP_H__
+
+#include "../Arduino.h"
+
+#define SLEEP_MODE_IDLE 0
+
+inline void set_sleep_mode(uint8_t mode) { }
+inline void sleep_enable() { }
+inline void sleep_disable() { }
+inline void sleep_cpu() { hostSleep(); }
+
+#endif
@@ -0,0 +1,26 @@
+/* Host shim: the Arduino B... binary constants used in the firmware */
+#ifndef HOST_BINARY_H__
+#define HOST_BINARY_H__
+
+#define B0 0
+#define B1 1
+#define B10 2
+#define B11 3
+#define B100 4
+#define B111 7
+#define B1111 15
+#define B00000000 0
+#define B00001100 12
+#define B00001111 15
+#define B00111111 63
+#define B01110000 112
+#define B10000000 128
+#define B11000000 192
+#define B11110000 240
+#define B11110001 241
+#define B11110010 242
+#define B11110011 243
+#define B11111100 252
+#define B11111111 255
+
+#endif
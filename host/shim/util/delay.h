@@ -0,0 +1,15 @@
+/* Host shim: busy-wait delays advance the simulated clock */
+#ifndef HOST_UTIL_DELAY_H__
+#define HOST_UTIL_DELAY_H__
+
+#include "Arduino.h"
+
+inline void _delay_us(double us) {
+    hostDelayCycles((uint64_t)(us * (F_CPU / 1000000.0) + 0.5));
+}
+
+inline void _delay_ms(double ms) {
+    hostDelayCycles((uint64_t)(ms * (F_CPU / 1000.0) + 0.5));
+}
+
+#endif
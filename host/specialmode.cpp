@@ -0,0 +1,146 @@
+/**
+ * specialmode - the check that the first YM2612's channel 3 special mode
+ * (global CC 80, MIDI channels 10-13) and MIDI channel 2, which plays
+ * channel 3 out of it, stay apart. The chips' writes are decoded off the
+ * bus; each step sends its MIDI, runs the firmware and checks them:
+ *
+ * - out of special mode, notes on channels 10-13 write nothing
+ * - CC 80 = 64 turns the mode on, setting channel 3 to algorithm 7 and
+ *   keying off channel 2's note
+ * - in it, a note and CC 14 on channel 2 leave the first chip alone, the
+ *   keys of the special voices included; with DUAL_CHIPS (specialmode-
+ *   dual) the second chip plays the note instead
+ * - CC 80 = 0 gives channel 3 back its algorithm, that CC 14's
+ * - out of it again, channel 2 plays channel 3 and channels 10-13 nothing
+ *
+ * A failed step exits 1.
+ *
+ * Usage: specialmode
+ */
+#include <stdio.h>
+
+#include <vector>
+
+#include "Arduino.h"
+#include "Trahagean.ino"
+
+struct Write {
+    uint8_t chip, part, address, data;
+};
+
+static std::vector<Write> writes;
+static uint8_t address[2];
+
+/* the YM2612 writes, on the rising edge of either chip's WR */
+static void watch(HostPort &port, uint8_t previous) {
+    if (&port != &SynthBoard::YM_WR::out())
+        return;
+    const uint8_t wr[2] = {
+        bit(SynthBoard::YM_WR::BIT), bit(SynthBoard::YM_WR2::BIT) };
+    for (uint8_t chip = 0; chip < 2; chip++) {
+        if ((previous & wr[chip]) || !(port & wr[chip]))
+            continue;
+        const uint8_t data = SynthBoard::dataBusRead();
+        if (!SynthBoard::YM_A0::isHigh()) {
+            address[chip] = data;
+        } else {
+            const Write w = { chip, SynthBoard::YM_A1::isHigh(),
+                address[chip], data };
+            writes.push_back(w);
+        }
+    }
+}
+
+static void midi(const std::vector<uint8_t> &data) {
+    writes.clear();
+    for (size_t i = 0; i < data.size(); i++)
+        hostSerialSend(data[i], hostCycles);
+    hostRunUntil(hostCycles + F_CPU / 20);
+}
+
+static unsigned count(uint8_t chip) {
+    unsigned n = 0;
+    for (size_t i = 0; i < writes.size(); i++)
+        n += writes[i].chip == chip;
+    return n;
+}
+
+// the last value written to a register of part 1, -1 if none was
+static int last(uint8_t chip, uint8_t reg) {
+    int data = -1;
+    for (size_t i = 0; i < writes.size(); i++) {
+        if (writes[i].chip == chip && !writes[i].part
+                && writes[i].address == reg)
+            data = writes[i].data;
+    }
+    return data;
+}
+
+static unsigned errors;
+
+static void expect(const char *step, const char *what, int got, int want) {
+    printf("%-28s %-22s %4d %4d\n", step, what, got, want);
+    if (got != want) {
+        fprintf(stderr, "%s: %s %d, %d expected\n", step, what, got, want);
+        errors++;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        fprintf(stderr, "usage: specialmode\n");
+        return 2;
+    }
+    hostReset();
+    SynthBoard::YM_WR::out().hook = watch;
+    setup();
+    hostRunUntil(hostCycles + F_CPU / 100);
+
+    // 0x28 keys channel 3 of part 1 with 2, 0xB2 is its FB and ALGO
+    const uint8_t KEY = 0x28, ALGO = 0xB2, CHAN3 = 2, ALL = 0xF0;
+    printf("%-28s %-22s %4s %4s\n", "step", "", "got", "want");
+
+    midi({ 0xB2, 14, 4 });
+    expect("channel 2 CC 14 = 4", "algorithm", last(0, ALGO) & 7, 4);
+    midi({ 0x9A, 60, 127, 0x9B, 64, 127 });
+    expect("channels 10-11 note on", "chip 1 writes", count(0), 0);
+    midi({ 0x8A, 60, 0, 0x8B, 64, 0 });
+    expect("channels 10-11 note off", "chip 1 writes", count(0), 0);
+    midi({ 0x92, 60, 127 });
+    expect("channel 2 note on", "channel 3 keys", last(0, KEY), ALL | CHAN3);
+
+    midi({ 0xB0, 80, 64 });
+    expect("CC 80 = 64", "algorithm", last(0, ALGO) & 7, 7);
+    expect("CC 80 = 64", "channel 3 keys", last(0, KEY), CHAN3);
+    midi({ 0x9A, 60, 127, 0x9B, 64, 127, 0x9C, 67, 127 });
+    expect("channels 10-12 note on", "channel 3 keys", last(0, KEY),
+           0x70 | CHAN3);
+    midi({ 0x92, 62, 127, 0xB2, 14, 5 });
+    expect("channel 2 note on, CC 14", "chip 1 writes", count(0), 0);
+#ifdef DUAL_CHIPS
+    expect("channel 2 note on, CC 14", "chip 2 channel 3 keys",
+           last(1, KEY), ALL | CHAN3);
+    expect("channel 2 note on, CC 14", "chip 2 algorithm",
+           last(1, ALGO) & 7, 5);
+#endif
+    midi({ 0x82, 62, 0 });
+    expect("channel 2 note off", "chip 1 writes", count(0), 0);
+#ifdef DUAL_CHIPS
+    expect("channel 2 note off", "chip 2 channel 3 keys", last(1, KEY),
+           CHAN3);
+#endif
+
+    midi({ 0xB0, 80, 0 });
+    expect("CC 80 = 0", "algorithm", last(0, ALGO) & 7, 5);
+    expect("CC 80 = 0", "channel 3 keys", last(0, KEY), CHAN3);
+    midi({ 0x9A, 60, 127 });
+    expect("channel 10 note on", "chip 1 writes", count(0), 0);
+    midi({ 0x92, 60, 127 });
+    expect("channel 2 note on", "channel 3 keys", last(0, KEY), ALL | CHAN3);
+#ifdef DUAL_CHIPS
+    expect("channel 2 note on", "chip 2 writes", count(1), 0);
+#endif
+
+    printf("\n%u errors\n", errors);
+    return errors ? 1 : 0;
+}
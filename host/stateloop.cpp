@@ -0,0 +1,227 @@
+/**
+ * stateloop - the loopback check of Trahagean/StateSync.h: the firmware
+ * built with USE_HOST_LINK runs on the shim, and the StateMirror of
+ * host/statesync queries it over LINK_SERIAL after each change below.
+ * Each answer has to bring the copy to the YM2612's actual State, with
+ * no more blocks than the change touched:
+ *
+ *     full     an empty copy, all of the State comes over
+ *     same     nothing changed, only LINK_STATE_END
+ *     cc       CC 15 (feedback) on channel 2: one block
+ *     note     a note on channel 0: its carriers' TLs
+ *     patch    a .tfi over SysEx (Patch.h) into channel 3: its slice
+ *     stale    a byte of the copy gone wrong on the host: its block
+ *     nochip   chip 1 without DUAL_CHIPS: an empty answer
+ *
+ * It prints what each sync cost on the wire, against sending the whole
+ * State, and exits 1 when a sync fails.
+ *
+ * Usage: stateloop
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <deque>
+#include <vector>
+
+#include "Arduino.h"
+#include "Trahagean.ino"
+#include "StateMirror.h"
+
+#ifndef USE_HOST_LINK
+#error "build stateloop with -DUSE_HOST_LINK"
+#endif
+
+static const uint64_t STEP_US = 50;
+static const uint64_t ANSWER_US = 100000;
+static const uint64_t CYCLES_PER_US = F_CPU / 1000000UL;
+
+/* The host end of the link, with what the device sends arriving at once */
+struct Host {
+    std::deque<uint8_t> incoming;
+    std::vector<uint8_t> rx;
+    size_t credit;
+    bool greeted;
+    size_t answerBytes; // LINK_STATE and LINK_STATE_END, framing included
+    StateMirror *mirror;
+
+    void reset() {
+        incoming.clear();
+        rx.clear();
+        credit = 0;
+        greeted = false;
+        answerBytes = 0;
+        mirror = NULL;
+    }
+
+    void handle(uint8_t type, const uint8_t *payload, uint8_t length) {
+        if (type == LINK_HELLO && length >= 2) {
+            credit = payload[1];
+            greeted = true;
+        } else if (type == LINK_CREDIT && length >= 1) {
+            credit += payload[0];
+        } else if (type == LINK_STATE || type == LINK_STATE_END) {
+            answerBytes += 4 + length;
+            if (mirror)
+                mirror->handle(type, payload, length);
+        }
+    }
+
+    void poll() {
+        while (!incoming.empty()) {
+            rx.push_back(incoming.front());
+            incoming.pop_front();
+            if (rx[0] != LINK_SYNC) {
+                rx.clear();
+                continue;
+            }
+            if (rx.size() < 3 || rx.size() < 4u + rx[2])
+                continue;
+            handle(rx[1], &rx[3], rx[2]);
+            rx.clear();
+        }
+    }
+
+    void step() {
+        hostRunUntil(hostCycles + STEP_US * CYCLES_PER_US);
+        poll();
+    }
+
+    // a frame once the device has credit for it
+    void send(uint8_t type, const uint8_t *payload, uint8_t length) {
+        while (greeted && credit < 4u + length)
+            step();
+        uint8_t sum = type + length;
+        hostSerialSend(LINK_SERIAL, LINK_SYNC, hostCycles);
+        hostSerialSend(LINK_SERIAL, type, hostCycles);
+        hostSerialSend(LINK_SERIAL, length, hostCycles);
+        for (uint8_t i = 0; i < length; i++) {
+            hostSerialSend(LINK_SERIAL, payload[i], hostCycles);
+            sum += payload[i];
+        }
+        hostSerialSend(LINK_SERIAL, (uint8_t)-sum, hostCycles);
+        credit -= greeted ? 4 + length : 0;
+    }
+
+    // MIDI bytes, played out before this returns
+    void midi(const uint8_t *data, uint8_t length) {
+        for (uint8_t i = 0; i < length; i += LINK_PAYLOAD_MAX) {
+            send(LINK_MIDI, data + i, length - i < LINK_PAYLOAD_MAX
+                ? length - i : LINK_PAYLOAD_MAX);
+        }
+        for (unsigned i = 0; i < 100; i++)
+            step();
+    }
+};
+
+static Host host;
+
+static void transmit(uint8_t data) {
+    host.incoming.push_back(data);
+}
+
+/* One query of the mirror and its answer. False if it did not come, or
+ * the copy does not match the device's State or took more blocks. */
+static bool sync(const char *scenario, StateMirror &mirror,
+                 unsigned maxBlocks) {
+    uint8_t payload[LINK_PAYLOAD_MAX];
+    const uint8_t querySize = mirror.query(payload);
+    host.mirror = &mirror;
+    host.answerBytes = 0;
+    host.send(LINK_STATE_QUERY, payload, querySize);
+    const uint64_t deadline = hostCycles + ANSWER_US * CYCLES_PER_US;
+    while (!mirror.done && hostCycles < deadline)
+        host.step();
+    host.mirror = NULL;
+
+    const uint8_t *state = synth.ymState(mirror.chip);
+    const size_t length = state ? YM2612::STATE_LENGTH : 0;
+    const bool same = mirror.copy.size() == length
+        && !memcmp(mirror.copy.data(), state, length);
+    // the whole State in LINK_STATE frames and the end, with framing
+    const unsigned frames = (YM2612::STATE_LENGTH + STATE_FRAME_BYTES - 1)
+        / STATE_FRAME_BYTES;
+    const size_t whole = YM2612::STATE_LENGTH
+        + frames * (4 + STATE_DATA_INDEX) + 4 + STATE_END_LENGTH;
+    printf("%-8s %5u %6zu %6zu %7u %6.1f%%\n", scenario, 4u + querySize,
+           host.answerBytes, mirror.received, mirror.blocks,
+           100.0 * (4 + querySize + host.answerBytes) / whole);
+    if (!mirror.done) {
+        fprintf(stderr, "%s: no answer\n", scenario);
+        return false;
+    }
+    if (!mirror.ok || !same) {
+        fprintf(stderr, "%s: the copy does not match the device\n",
+                scenario);
+        return false;
+    }
+    if (mirror.blocks > maxBlocks) {
+        fprintf(stderr, "%s: %u blocks sent, %u changed at most\n",
+                scenario, mirror.blocks, maxBlocks);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        fprintf(stderr, "usage: stateloop\n");
+        return 2;
+    }
+    hostReset();
+    host.reset();
+    LINK_SERIAL.txHook = transmit;
+    setup();
+    host.send(LINK_HELLO, NULL, 0);
+    while (!host.greeted)
+        host.step();
+
+    printf("sync     query answer  state  blocks  of all\n");
+    const unsigned all = (YM2612::STATE_LENGTH + STATE_BLOCK - 1)
+        / STATE_BLOCK;
+    StateMirror mirror;
+    bool ok = sync("full", mirror, all);
+    ok = sync("same", mirror, 0) && ok;
+
+    const uint8_t feedback[] = { 0xB2, 15, 5 };
+    host.midi(feedback, sizeof(feedback));
+    ok = sync("cc", mirror, 1) && ok;
+
+    const uint8_t note[] = { 0x90, 60, 100 };
+    host.midi(note, sizeof(note));
+    ok = sync("note", mirror, 4) && ok; // up to a carrier per slot
+
+    // algorithm 7, feedback 3, then the same operator four times
+    uint8_t tfi[Patch::TFI_LENGTH] = { 7, 3 };
+    const uint8_t op[10] = { 2, 4, 20, 1, 31, 12, 3, 7, 5, 0 };
+    for (byte s = 0; s < Patch::SLOT_COUNT; s++)
+        memcpy(tfi + 2 + s * sizeof(op), op, sizeof(op));
+    uint8_t sysex[8 + 2 * Patch::TFI_LENGTH] = {
+        MIDI_SYSEX, Patch::SYSEX_ID, Patch::PATCH_DATA, 3,
+        Patch::FORMAT_TFI };
+    uint8_t length = 5;
+    for (uint8_t i = 0; i < Patch::TFI_LENGTH; i += Patch::GROUP) {
+        uint8_t &msbs = sysex[length++];
+        msbs = 0;
+        for (uint8_t g = 0; g < Patch::GROUP && i + g < Patch::TFI_LENGTH;
+                g++)
+            sysex[length++] = tfi[i + g];
+    }
+    sysex[length++] = MIDI_SYSEX_END;
+    host.midi(sysex, length);
+    // the slice is 30 bytes, over five blocks where it falls
+    ok = sync("patch", mirror, (YM2612::CHAN_STATE_LENGTH + 2 * STATE_BLOCK
+        - 2) / STATE_BLOCK) && ok;
+
+    mirror.copy[YM2612::STATE_LENGTH / 2] ^= 0x40;
+    ok = sync("stale", mirror, 1) && ok;
+
+    StateMirror second(1);
+#ifdef DUAL_CHIPS
+    ok = sync("chip1", second, all) && ok;
+#else
+    ok = sync("nochip", second, 0) && ok;
+#endif
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+/**
+ * statesync - the reference client of Trahagean/StateSync.h: brings a
+ * cached copy of a YM2612's shadow registers up to date with the device
+ * over the framed host link (firmware built with USE_HOST_LINK), sending
+ * only block hashes and getting back only the blocks that changed.
+ *
+ * The copy is kept in the -s file between runs, so an editor that
+ * reconnects transfers what changed while it was away; without one, or
+ * the first time, the whole State comes over. -v lists the bytes that
+ * changed as State offset, old and new value. The copy is checked against
+ * the device's crc, and asked for whole once more if it does not match.
+ *
+ *     bin/linkdevice &
+ *     bin/statesync -s ym.bin /dev/pts/N
+ *
+ * Usage: statesync [-b baud] [-c chip] [-s state.bin] [-v] device
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "LinkSender.h"
+#include "StateMirror.h"
+
+static const int ANSWER_MS = 1000;
+
+static long long nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static void onFrame(uint8_t type, const uint8_t *payload, uint8_t length,
+                    void *context) {
+    static_cast<StateMirror *>(context)->handle(type, payload, length);
+}
+
+// one query and its answer, false if none came
+static bool sync(LinkSender &link, StateMirror &mirror, uint8_t &sent) {
+    uint8_t payload[LINK_PAYLOAD_MAX];
+    sent = mirror.query(payload);
+    if (!link.frame(LINK_STATE_QUERY, payload, sent))
+        return false;
+    const long long deadline = nowMs() + ANSWER_MS;
+    while (!mirror.done && link.connected() && nowMs() < deadline)
+        link.poll(10);
+    return mirror.done;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: statesync [-b baud] [-c chip] [-s state.bin] "
+            "[-v] device\n");
+}
+
+int main(int argc, char **argv) {
+    unsigned long baud = LINK_BAUDRATE;
+    const char *cachePath = NULL;
+    StateMirror mirror;
+    bool verbose = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:c:s:vh")) != -1) {
+        if (opt == 'b') {
+            baud = strtoul(optarg, NULL, 10);
+        } else if (opt == 'c') {
+            mirror.chip = atoi(optarg);
+        } else if (opt == 's') {
+            cachePath = optarg;
+        } else if (opt == 'v') {
+            verbose = true;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (argc - optind != 1) {
+        usage();
+        return 2;
+    }
+    if (cachePath) {
+        FILE *cache = fopen(cachePath, "rb");
+        if (cache) {
+            uint8_t buffer[256];
+            mirror.copy.assign(buffer,
+                buffer + fread(buffer, 1, sizeof(buffer), cache));
+            fclose(cache);
+        }
+    }
+    int fd = LinkSender::openSerial(argv[optind], baud);
+    if (fd < 0) {
+        perror(argv[optind]);
+        return 2;
+    }
+
+    LinkSender link(fd);
+    link.onFrame = onFrame;
+    link.context = &mirror;
+    if (!link.hello()) {
+        fprintf(stderr, "no answer from the device\n");
+        return 1;
+    }
+    uint8_t querySize;
+    const std::vector<uint8_t> cached = mirror.copy;
+    bool answered = sync(link, mirror, querySize);
+    if (answered && !mirror.ok) {
+        fprintf(stderr, "copy still differs, asking for all of it\n");
+        answered = sync(link, mirror, querySize);
+    }
+    if (!answered) {
+        fprintf(stderr, "no answer to the query\n");
+        return 1;
+    }
+    if (!mirror.ok) {
+        fprintf(stderr, "the device's state keeps changing under the "
+                "query, try again\n");
+        return 1;
+    }
+    if (mirror.copy.empty()) {
+        fprintf(stderr, "the device has no chip %u\n", mirror.chip);
+        return 1;
+    }
+
+    unsigned changed = 0;
+    for (size_t i = 0; i < mirror.copy.size(); i++) {
+        const bool had = i < cached.size();
+        if (had && cached[i] == mirror.copy[i])
+            continue;
+        changed++;
+        if (verbose && had)
+            printf("%3zu  %02X -> %02X\n", i, cached[i], mirror.copy[i]);
+        else if (verbose)
+            printf("%3zu  -- -> %02X\n", i, mirror.copy[i]);
+    }
+    fprintf(stderr, "%u of %zu bytes changed, %zu bytes in %u frames for "
+            "%u blocks, query %u bytes\n", changed, mirror.copy.size(),
+            mirror.received, mirror.frames, mirror.blocks, querySize);
+
+    if (cachePath) {
+        FILE *cache = fopen(cachePath, "wb");
+        if (!cache || fwrite(mirror.copy.data(), 1, mirror.copy.size(), cache)
+                != mirror.copy.size() || fclose(cache)) {
+            perror(cachePath);
+            return 2;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,489 @@
+/**
+ * streambench - what the RAM scaled buffers of Trahagean/Board.h buy, on
+ * the host shim.
+ *
+ * The firmware is built with USE_HOST_LINK for one part at a time
+ * (streambench-328p, -644p and -1284p), so each build has that part's
+ * serial RX buffer, YM2612_QUEUE_LENGTH, STREAM_BUFFER_SIZE and
+ * SynthBoard. A simulated host talks to it over LINK_SERIAL and sees what
+ * the device sends HOST_LATENCY_US late, as through a USB serial adapter.
+ *
+ *     link        LINK_YM frames as fast as the link's credit allows. The
+ *                 window is the serial RX buffer, so with the credit
+ *                 coming back late it bounds the throughput.
+ *     stall N     a dense stream through VgmStream, paced like
+ *                 host/vgmstream, with the host stalling N ms once a
+ *                 second. Counts underruns and the least time buffered.
+ *     flush N     N register writes deferred on each of two YM2612s and
+ *                 flushed interleaved. Past YM2612_QUEUE_LENGTH a chip
+ *                 flushes on its own, without the other's writes to fill
+ *                 its waits.
+ *
+ * Results go to stdout as a table and, with -o, to a JSON file with one
+ * result per line. -b compares against such a file and exits 1 when the
+ * cost per write got worse by more than the tolerance or there were more
+ * underruns.
+ *
+ * Usage: streambench [-o results.json] [-b baseline.json] [-t percent]
+ *                    [-l label]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "Trahagean.ino"
+
+#ifndef USE_HOST_LINK
+#error "build streambench with -DUSE_HOST_LINK"
+#endif
+
+#if defined(__AVR_ATmega1284P__)
+#define PART "atmega1284p"
+#elif defined(__AVR_ATmega644P__)
+#define PART "atmega644p"
+#else
+#define PART "atmega328p"
+#endif
+
+static const uint64_t HOST_LATENCY_US = 1000;
+static const uint64_t STEP_US = 50; // how often the host looks
+static const unsigned LINK_WRITES = 4096;
+static const uint32_t STREAM_TARGET_MS = 400;
+static const uint32_t STREAM_RUN_MS = 6000;
+static const uint32_t TICK_SAMPLES = 735; // 60Hz
+static const unsigned TICK_WRITES = 20;
+
+static const uint64_t CYCLES_PER_US = F_CPU / 1000000UL;
+
+struct Result {
+    std::string scenario;
+    unsigned writes;
+    double usPerWrite; // 0 where it does not apply
+    unsigned long underruns;
+    double lowestMs; // least time buffered while playing, stall only
+};
+
+/* The host end of the link: frames go out only with credit, and what
+ * the device sends arrives HOST_LATENCY_US after it was sent */
+struct Host {
+    struct Sent {
+        uint8_t seq;
+        size_t bytes;
+        uint32_t samples;
+    };
+
+    std::deque<std::pair<uint64_t, uint8_t> > incoming;
+    std::vector<uint8_t> rx; // device frame being parsed
+    size_t credit;
+    bool greeted;
+
+    // stream state from the fill reports, as in host/vgmstream
+    std::deque<Sent> inFlight;
+    uint8_t sent;
+    uint32_t room;
+    uint32_t buffered;
+    uint8_t underruns;
+    bool playing;
+    uint32_t lowest;
+
+    void reset() {
+        incoming.clear();
+        rx.clear();
+        credit = 0;
+        greeted = false;
+        inFlight.clear();
+        sent = 0;
+        room = 0;
+        buffered = 0;
+        underruns = 0;
+        playing = false;
+        lowest = UINT32_MAX;
+    }
+
+    void report(const uint8_t *payload) {
+        room = payload[0] | payload[1] << 8;
+        buffered = payload[2] | payload[3] << 8;
+        underruns = payload[4];
+        const uint8_t acked = payload[5];
+        playing = payload[6];
+        while (!inFlight.empty()
+                && (uint8_t)(acked - inFlight.front().seq) < 0x80)
+            inFlight.pop_front();
+        if (playing && buffered < lowest)
+            lowest = buffered;
+    }
+
+    void handle(uint8_t type, const uint8_t *payload, uint8_t length) {
+        if (type == LINK_HELLO && length >= 2) {
+            credit = payload[1];
+            greeted = true;
+        } else if (type == LINK_CREDIT && length >= 1) {
+            credit += payload[0];
+        } else if (type == LINK_STREAM_FILL && length >= STREAM_FILL_LENGTH) {
+            report(payload);
+        }
+    }
+
+    // take in what has reached the host by now
+    void poll() {
+        while (!incoming.empty() && incoming.front().first
+                + HOST_LATENCY_US * CYCLES_PER_US <= hostCycles) {
+            rx.push_back(incoming.front().second);
+            incoming.pop_front();
+            if (rx[0] != LINK_SYNC) {
+                rx.clear();
+                continue;
+            }
+            if (rx.size() < 3 || rx.size() < 4u + rx[2])
+                continue;
+            handle(rx[1], &rx[3], rx[2]);
+            rx.clear();
+        }
+    }
+
+    // a frame on the wire now, after whatever is still going out
+    void send(uint8_t type, const uint8_t *payload, uint8_t length) {
+        uint8_t sum = type + length;
+        hostSerialSend(LINK_SERIAL, LINK_SYNC, hostCycles);
+        hostSerialSend(LINK_SERIAL, type, hostCycles);
+        hostSerialSend(LINK_SERIAL, length, hostCycles);
+        for (uint8_t i = 0; i < length; i++) {
+            hostSerialSend(LINK_SERIAL, payload[i], hostCycles);
+            sum += payload[i];
+        }
+        hostSerialSend(LINK_SERIAL, (uint8_t)-sum, hostCycles);
+        credit -= greeted ? 4 + length : 0;
+    }
+
+    bool canSend(uint8_t length) const {
+        return greeted && credit >= 4u + length;
+    }
+
+    void step() {
+        hostRunUntil(hostCycles + STEP_US * CYCLES_PER_US);
+        poll();
+    }
+};
+
+static Host host;
+
+static void transmit(uint8_t data) {
+    host.incoming.push_back(std::make_pair(hostCycles, data));
+}
+
+/* YM2612 data strobes seen, and when the last one was */
+static unsigned ymWrites;
+static uint64_t lastYmWrite;
+
+template<class P> static bool rose(HostPort &port, uint8_t previous) {
+    return &port == &P::out() && !(previous & bit(P::BIT))
+        && (port & bit(P::BIT));
+}
+
+static void onPortWrite(HostPort &port, uint8_t previous) {
+    if (rose<SynthBoard::YM_WR>(port, previous)
+            && SynthBoard::YM_A0::isHigh()) {
+        ymWrites++;
+        lastYmWrite = hostCycles;
+    }
+}
+
+// the firmware up and greeted, with the host at the other end
+static void start() {
+    hostReset();
+    host.reset();
+    LINK_SERIAL.txHook = transmit;
+    SynthBoard::YM_WR::out().hook = onPortWrite;
+    setup();
+    host.send(LINK_HELLO, NULL, 0);
+    while (!host.greeted)
+        host.step();
+    ymWrites = 0;
+}
+
+static Result linkThroughput() {
+    start();
+    uint8_t payload[LINK_PAYLOAD_MAX];
+    const unsigned perFrame = LINK_PAYLOAD_MAX / 3;
+    uint32_t x = 0x2612;
+    const uint64_t begin = hostCycles;
+    unsigned sent = 0;
+    while (sent < LINK_WRITES) {
+        const unsigned n = LINK_WRITES - sent < perFrame
+            ? LINK_WRITES - sent : perFrame;
+        while (!host.canSend(3 * n))
+            host.step();
+        for (unsigned i = 0; i < n; i++) {
+            x = x * 1103515245 + 12345;
+            payload[3 * i] = x >> 31; // part
+            payload[3 * i + 1] = 0x30 + (x >> 16) % (0xB7 - 0x30);
+            payload[3 * i + 2] = x >> 8;
+        }
+        host.send(LINK_YM, payload, 3 * n);
+        sent += n;
+    }
+    while (ymWrites < LINK_WRITES
+            && hostCycles - begin < 10 * F_CPU)
+        host.step();
+
+    Result r = Result();
+    r.scenario = "link";
+    r.writes = ymWrites;
+    r.usPerWrite = (double)(lastYmWrite - begin) / CYCLES_PER_US / ymWrites;
+    return r;
+}
+
+/* An endless 60Hz stream: TICK_WRITES register writes, then a wait */
+struct StreamSource {
+    uint32_t x;
+    unsigned written; // in this tick
+
+    StreamSource() : x(0x76489), written(0) { }
+
+    // the next command, its length and samples
+    uint8_t next(uint8_t *command, uint32_t &samples) {
+        samples = 0;
+        if (written == TICK_WRITES) {
+            written = 0;
+            command[0] = STREAM_WAIT;
+            command[1] = lowByte(TICK_SAMPLES);
+            command[2] = highByte(TICK_SAMPLES);
+            samples = TICK_SAMPLES;
+            return 3;
+        }
+        written++;
+        x = x * 1103515245 + 12345;
+        command[0] = x >> 31 ? STREAM_YM1 : STREAM_YM0;
+        command[1] = 0x30 + (x >> 16) % (0xB7 - 0x30);
+        command[2] = x >> 8;
+        return 3;
+    }
+};
+
+static Result stall(uint32_t stallMs) {
+    start();
+    const uint32_t target = STREAM_TARGET_MS * STREAM_RATE / 1000;
+    StreamSource source;
+    uint8_t payload[LINK_PAYLOAD_MAX];
+    uint8_t length = 0;
+    uint32_t frameSamples = 0;
+    uint8_t command[3];
+    uint32_t commandSamples = 0;
+    uint8_t commandLength = 0;
+
+    host.send(LINK_STREAM, NULL, 0); // a new stream
+    const uint64_t begin = hostCycles;
+    const uint64_t end = begin + (uint64_t)STREAM_RUN_MS * 1000 * CYCLES_PER_US;
+    while (hostCycles < end) {
+        const uint64_t ms = (hostCycles - begin) / 1000 / CYCLES_PER_US;
+        // stalls start half way through each second after the first
+        if (ms >= 1500 && ms % 1000 >= 500 && ms % 1000 < 500 + stallMs) {
+            host.step();
+            continue;
+        }
+        // fill a frame with whole commands
+        for (;;) {
+            if (!commandLength)
+                commandLength = source.next(command, commandSamples);
+            if (length + commandLength > LINK_PAYLOAD_MAX)
+                break;
+            memcpy(payload + length, command, commandLength);
+            length += commandLength;
+            frameSamples += commandSamples;
+            commandLength = 0;
+        }
+        uint32_t ahead = host.buffered, bytes = 0;
+        for (size_t i = 0; i < host.inFlight.size(); i++) {
+            ahead += host.inFlight[i].samples;
+            bytes += host.inFlight[i].bytes;
+        }
+        if (bytes + length <= host.room
+                && (ahead < target || !host.playing)
+                && host.canSend(length)) {
+            host.send(LINK_STREAM, payload, length);
+            Host::Sent s = { ++host.sent, length, frameSamples };
+            host.inFlight.push_back(s);
+            length = 0;
+            frameSamples = 0;
+        } else {
+            host.step();
+        }
+    }
+
+    Result r = Result();
+    char name[32];
+    snprintf(name, sizeof(name), "stall%u", stallMs);
+    r.scenario = name;
+    r.writes = ymWrites;
+    r.underruns = host.underruns;
+    r.lowestMs = host.lowest == UINT32_MAX ? 0
+        : host.lowest * 1000.0 / STREAM_RATE;
+    return r;
+}
+
+static Result flush(unsigned writes) {
+    // static, the shadow state is too big for the stack of a test
+    static YM2612 first;
+    static YM2612B second;
+    hostReset();
+    SynthBoard::begin();
+    YM2612::resetChips();
+    first.begin();
+    second.begin();
+    SynthBoard::YM_WR::out().hook = onPortWrite;
+    ymWrites = 0;
+
+    uint32_t x = 0x5EED;
+    const unsigned ROUNDS = 16;
+    const uint64_t begin = hostCycles;
+    for (unsigned round = 0; round < ROUNDS; round++) {
+        // as MegaSynth does with DUAL_CHIPS: one chip's writes, then the
+        // other's, then both flushed together
+        first.defer();
+        second.defer();
+        for (unsigned i = 0; i < 2 * writes; i++) {
+            x = x * 1103515245 + 12345;
+            const YM2612Map::part_e part
+                = static_cast<YM2612Map::part_e>(x >> 31);
+            const byte reg = 0x30 + (x >> 16) % (0xB7 - 0x30);
+            if (i < writes)
+                first.writeReg(part, reg, x >> 8);
+            else
+                second.writeReg(part, reg, x >> 8);
+        }
+        YM2612Scheduler::flush(first, second);
+    }
+
+    Result r = Result();
+    char name[32];
+    snprintf(name, sizeof(name), "flush%u", writes);
+    r.scenario = name;
+    r.writes = 2 * writes * ROUNDS;
+    r.usPerWrite = (double)(hostCycles - begin) / CYCLES_PER_US / r.writes;
+    return r;
+}
+
+static void writeJson(FILE *out, const char *label,
+                      const std::vector<Result> &results) {
+    fprintf(out, "{\"label\":\"%s\",\"part\":\"%s\",\"rx_buffer\":%u,"
+            "\"queue\":%u,\"stream_buffer\":%u,\"results\":[\n", label, PART,
+            SERIAL_RX_BUFFER_SIZE, YM2612_QUEUE_LENGTH, STREAM_BUFFER_SIZE);
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        fprintf(out, "{\"scenario\":\"%s\",\"writes\":%u,"
+                "\"us_per_write\":%.2f,\"underruns\":%lu,"
+                "\"lowest_ms\":%.1f}%s\n",
+                r.scenario.c_str(), r.writes, r.usPerWrite, r.underruns,
+                r.lowestMs, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "]}\n");
+}
+
+/* pull one number out of a result line written by writeJson */
+static bool field(const char *line, const char *key, double &value) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(line, pattern);
+    return p && sscanf(p + strlen(pattern), "%lf", &value) == 1;
+}
+
+static int compare(const char *path, const std::vector<Result> &results,
+                   double tolerance) {
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return 2;
+    }
+    int regressions = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), in)) {
+        double cost, underruns;
+        const char *name = strstr(line, "\"scenario\":\"");
+        if (!name || !field(line, "us_per_write", cost)
+                || !field(line, "underruns", underruns))
+            continue;
+        name += strlen("\"scenario\":\"");
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result &r = results[i];
+            if (strncmp(name, r.scenario.c_str(), r.scenario.size())
+                    || name[r.scenario.size()] != '"')
+                continue;
+            // a little slack so tiny baselines do not trip on rounding
+            if (r.usPerWrite > cost * (1 + tolerance / 100) + 0.05
+                    || r.underruns > underruns) {
+                printf("REGRESSION %s %s: %.2f -> %.2f us per write, "
+                       "underruns %.0f -> %lu\n", PART, r.scenario.c_str(),
+                       cost, r.usPerWrite, underruns, r.underruns);
+                regressions++;
+            }
+        }
+    }
+    fclose(in);
+    return regressions ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    const char *outPath = NULL;
+    const char *baselinePath = NULL;
+    const char *label = "";
+    double tolerance = 5;
+    int opt;
+    while ((opt = getopt(argc, argv, "o:b:t:l:h")) != -1) {
+        switch (opt) {
+        case 'o':
+            outPath = optarg;
+            break;
+        case 'b':
+            baselinePath = optarg;
+            break;
+        case 't':
+            tolerance = atof(optarg);
+            break;
+        case 'l':
+            label = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: streambench [-o results.json] "
+                    "[-b baseline.json] [-t percent] [-l label]\n");
+            return 2;
+        }
+    }
+
+    std::vector<Result> results;
+    results.push_back(linkThroughput());
+    results.push_back(stall(50));
+    results.push_back(stall(150));
+    results.push_back(stall(300));
+    results.push_back(flush(8));
+    results.push_back(flush(24));
+    results.push_back(flush(48));
+
+    printf("%s: serial RX %u, YM2612 queue %u, stream buffer %u bytes\n",
+           PART, SERIAL_RX_BUFFER_SIZE, YM2612_QUEUE_LENGTH,
+           STREAM_BUFFER_SIZE);
+    printf("%-10s %7s %9s %10s %9s %10s\n", "scenario", "writes", "us/write",
+           "writes/s", "underruns", "lowest ms");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        printf("%-10s %7u %9.2f %10.0f %9lu %10.1f\n", r.scenario.c_str(),
+               r.writes, r.usPerWrite, r.usPerWrite ? 1e6 / r.usPerWrite : 0,
+               r.underruns, r.lowestMs);
+    }
+
+    if (outPath) {
+        FILE *out = fopen(outPath, "w");
+        if (!out) {
+            perror(outPath);
+            return 2;
+        }
+        writeJson(out, label, results);
+        fclose(out);
+    }
+    return baselinePath ? compare(baselinePath, results, tolerance) : 0;
+}
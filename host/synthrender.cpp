@@ -0,0 +1,186 @@
+/**
+ * synthrender - run the Trahagean firmware on the host and render what the
+ * chips would play to a WAV file.
+ *
+ * The sketch is compiled unchanged against the shim in host/shim. Its
+ * GPIO writes are decoded by ChipBus into YM2612 and SN76489 bus cycles at
+ * the simulated time they happen, so the render also reflects the
+ * firmware's write timing.
+ *
+ * Session files are text, one MIDI chunk per line:
+ *
+ *     # time in microseconds after setup(), then the bytes in hex
+ *     0       90 3C 7F
+ *     500000  80 3C 00
+ *
+ * Usage: synthrender [-t tail_ms] [-e hash] [-d dump] [-E eeprom.bin]
+ *                    session.txt [out.wav]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "Arduino.h"
+#include "avr/eeprom.h"
+#include "Trahagean.ino"
+#include "ChipBus.h"
+
+static const uint32_t YM_CLOCK = 8000000;
+static const uint32_t SN_CLOCK = 4000000;
+
+static FILE *serialOut; // what the firmware sends back, e.g. trace dumps
+
+static void transmit(uint8_t data) {
+    if (serialOut)
+        fputc(data, serialOut);
+}
+
+static double wallSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* schedule the session's bytes on the serial wire, last is set to the
+ * cycle the last one arrives */
+static bool playSession(FILE *in, uint64_t start, uint64_t &last) {
+    char line[1024];
+    unsigned lineNumber = 0;
+    while (fgets(line, sizeof(line), in)) {
+        lineNumber++;
+        char *p = line;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '#' || *p == '\n' || *p == '\r' || !*p)
+            continue;
+        char *end;
+        unsigned long long time = strtoull(p, &end, 10);
+        if (end == p) {
+            fprintf(stderr, "line %u: expected a time in us\n", lineNumber);
+            return false;
+        }
+        uint64_t due = start + time * (F_CPU / 1000000UL);
+        for (p = end;;) {
+            unsigned long data = strtoul(p, &end, 16);
+            if (end == p)
+                break;
+            if (data > 0xFF) {
+                fprintf(stderr, "line %u: %lx is not a byte\n",
+                        lineNumber, data);
+                return false;
+            }
+            last = hostSerialSend((uint8_t)data, due);
+            p = end;
+        }
+    }
+    return true;
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: synthrender [-t tail_ms] [-e hash] [-d dump] [-E eeprom.bin]\n"
+            "                   session.txt [out.wav]\n"
+            "  -t  audio rendered after the last event (default 1000)\n"
+            "  -e  expected fingerprint, exit 1 if the render differs\n"
+            "  -d  save the firmware's serial output to this file\n"
+            "  -E  EEPROM image, e.g. drum kits from drumkit\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    unsigned long tailMs = 1000;
+    const char *expect = NULL;
+    const char *dumpPath = NULL;
+    const char *eepromPath = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:e:d:E:h")) != -1) {
+        switch (opt) {
+        case 't':
+            tailMs = strtoul(optarg, NULL, 10);
+            break;
+        case 'e':
+            expect = optarg;
+            break;
+        case 'd':
+            dumpPath = optarg;
+            break;
+        case 'E':
+            eepromPath = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (argc - optind < 1 || argc - optind > 2)
+        usage();
+    const char *sessionPath = argv[optind];
+    const char *wavPath = argc - optind > 1 ? argv[optind + 1] : NULL;
+
+    FILE *in = strcmp(sessionPath, "-") ? fopen(sessionPath, "r") : stdin;
+    if (!in) {
+        perror(sessionPath);
+        return 2;
+    }
+
+    if (dumpPath && !(serialOut = fopen(dumpPath, "wb"))) {
+        perror(dumpPath);
+        return 2;
+    }
+
+    double wallStart = wallSeconds();
+    hostReset();
+    if (eepromPath) {
+        FILE *image = fopen(eepromPath, "rb");
+        if (!image) {
+            perror(eepromPath);
+            return 2;
+        }
+        fread(hostEeprom, 1, sizeof(hostEeprom), image);
+        fclose(image);
+    }
+    Serial.txHook = transmit;
+    static ChipBus bus(YM_CLOCK, SN_CLOCK);
+    bus.attach();
+    setup();
+    if (!bus.record(wavPath)) {
+        perror(wavPath);
+        return 2;
+    }
+    uint64_t end = hostCycles;
+    bool ok = playSession(in, hostCycles, end);
+    if (in != stdin)
+        fclose(in);
+    hostRunUntil(end + tailMs * (F_CPU / 1000UL));
+    bus.finish();
+    if (serialOut)
+        fclose(serialOut);
+    double wall = wallSeconds() - wallStart;
+    if (!ok)
+        return 2;
+
+    char hash[17];
+    snprintf(hash, sizeof(hash), "%016llx",
+             (unsigned long long)bus.wav.fingerprint());
+    printf("audio     %.3f s at %lu Hz\n", bus.seconds(),
+           (unsigned long)bus.ym.sampleRate());
+    printf("writes    YM2612 %lu, SN76489 %lu\n", bus.ymWrites, bus.snWrites);
+    printf("dropped   %lu serial bytes, %lu overruns\n",
+           Serial.dropped, Serial.overruns);
+    printf("irq off   %.1f us longest\n",
+           hostInterruptsOffMax * 1e6 / F_CPU);
+    printf("irq lat   %.1f us worst\n",
+           hostInterruptLatencyMax * 1e6 / F_CPU);
+    if (hostWakes)
+        printf("sleep     %.1f%% idle, %lu wakes, %.1f us wake to dispatch "
+               "worst\n", 100.0 * hostSleptCycles / hostCycles, hostWakes,
+               hostWakeLatencyMax * 1e6 / F_CPU);
+    printf("speed     %.1fx realtime\n", wall > 0 ? bus.seconds() / wall : 0);
+    printf("hash      %s\n", hash);
+    if (expect && strcasecmp(expect, hash)) {
+        fprintf(stderr, "fingerprint mismatch, expected %s\n", expect);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,305 @@
+/**
+ * tracedecode - turn Trace.h dumps captured from the serial port into
+ * latency statistics and a Chrome trace (chrome://tracing, Perfetto).
+ *
+ * The capture may hold several dumps and unrelated bytes in between.
+ * Latencies are measured per MIDI packet:
+ *
+ *   byte to sound  first byte of the packet read -> last chip write
+ *   byte to write  first byte of the packet read -> first chip write
+ *   dispatch       parseMidiPacket entry -> exit
+ *
+ * and the time in each traced ISR, entry -> exit, when the dump has any.
+ *
+ * Usage: tracedecode [-j trace.json] capture.bin
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "Trace.h"
+
+struct Event {
+    uint8_t event;
+    uint8_t arg;
+    uint64_t ticks; // unwrapped
+};
+
+struct Series {
+    const char *name;
+    std::vector<double> us;
+};
+
+static const char *eventName(uint8_t event) {
+    switch (event) {
+    case TRACE_MIDI_BYTE: return "midi byte";
+    case TRACE_PACKET: return "packet";
+    case TRACE_DISPATCH_BEGIN: return "dispatch begin";
+    case TRACE_DISPATCH_END: return "dispatch end";
+    case TRACE_YM_WRITE: return "ym write";
+    case TRACE_SN_WRITE: return "sn write";
+    case TRACE_ISR_ENTER: return "isr enter";
+    case TRACE_ISR_EXIT: return "isr exit";
+    case TRACE_WAKE: return "wake";
+    default: return "unknown";
+    }
+}
+
+static const char *isrName(uint8_t id) {
+    switch (id) {
+    case TRACE_ISR_YM_IRQ: return "ym irq";
+    case TRACE_ISR_CLOCK_COMPA: return "clock wake";
+    default: return "isr";
+    }
+}
+
+static const char *commandName(uint8_t status) {
+    switch (status & 0xF0) {
+    case 0x80: return "note off";
+    case 0x90: return "note on";
+    case 0xA0: return "aftertouch";
+    case 0xB0: return "cc";
+    case 0xC0: return "program";
+    case 0xD0: return "pressure";
+    case 0xE0: return "pitch bend";
+    default: return "system";
+    }
+}
+
+/* find and parse every dump in the capture */
+static bool parse(const std::vector<uint8_t> &in, std::vector<Event> &events,
+                  uint32_t &rate) {
+    uint64_t wraps = 0;
+    uint32_t previous = 0;
+    size_t dumps = 0;
+    for (size_t i = 0; i + 9 <= in.size(); ) {
+        if (in[i] != 'T' || in[i + 1] != 'R' || in[i + 2] != 'C'
+                || in[i + 3] != TRACE_VERSION) {
+            i++;
+            continue;
+        }
+        rate = in[i + 4] | in[i + 5] << 8 | in[i + 6] << 16
+            | (uint32_t)in[i + 7] << 24;
+        size_t count = in[i + 8];
+        i += 9;
+        if (i + 5 * count > in.size()) {
+            fprintf(stderr, "dump %zu is truncated\n", dumps + 1);
+            break;
+        }
+        for (size_t n = 0; n < count; n++, i += 5) {
+            uint32_t t = in[i + 2] << 16 | in[i + 4] << 8 | in[i + 3];
+            if (t < previous)
+                wraps += 1 << 24;
+            previous = t;
+            Event e = { in[i], in[i + 1], wraps + t };
+            events.push_back(e);
+        }
+        dumps++;
+    }
+    fprintf(stderr, "%zu dumps, %zu events\n", dumps, events.size());
+    return dumps > 0 && rate;
+}
+
+static void report(Series &s) {
+    if (s.us.empty()) {
+        printf("%s: no samples\n\n", s.name);
+        return;
+    }
+    std::sort(s.us.begin(), s.us.end());
+    size_t n = s.us.size();
+    printf("%s: n %zu  min %.1f  median %.1f  p99 %.1f  max %.1f us\n",
+           s.name, n, s.us[0], s.us[n / 2], s.us[(n * 99) / 100 < n ?
+           (n * 99) / 100 : n - 1], s.us[n - 1]);
+    // power of two buckets
+    size_t buckets[32] = { 0 };
+    int bottom = 31, top = 0;
+    for (size_t i = 0; i < n; i++) {
+        int b = 0;
+        while (b < 31 && s.us[i] >= (double)(1u << b))
+            b++;
+        buckets[b]++;
+        bottom = std::min(bottom, b);
+        top = std::max(top, b);
+    }
+    size_t most = *std::max_element(buckets, buckets + 32);
+    for (int b = bottom; b <= top; b++) {
+        char range[32];
+        if (b == 0)
+            snprintf(range, sizeof(range), "< 1");
+        else
+            snprintf(range, sizeof(range), "%u-%u", 1u << (b - 1), 1u << b);
+        printf("  %12s us %6zu ", range, buckets[b]);
+        for (size_t i = 0; i < buckets[b] * 50 / most; i++)
+            putchar('#');
+        putchar('\n');
+    }
+    putchar('\n');
+}
+
+static void writeChromeTrace(FILE *out, const std::vector<Event> &events,
+                             uint32_t rate) {
+    const double usPerTick = 1e6 / rate;
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    const char *sep = "";
+    for (size_t i = 0; i < events.size(); i++) {
+        const Event &e = events[i];
+        double ts = e.ticks * usPerTick;
+        int tid;
+        const char *ph = "i";
+        std::string name = eventName(e.event);
+        switch (e.event) {
+        case TRACE_DISPATCH_BEGIN:
+        case TRACE_DISPATCH_END:
+            tid = 2;
+            ph = e.event == TRACE_DISPATCH_BEGIN ? "B" : "E";
+            name = commandName(e.arg);
+            break;
+        case TRACE_YM_WRITE:
+        case TRACE_SN_WRITE:
+            tid = 3;
+            break;
+        case TRACE_ISR_ENTER:
+        case TRACE_ISR_EXIT:
+            tid = 4;
+            ph = e.event == TRACE_ISR_ENTER ? "B" : "E";
+            name = isrName(e.arg);
+            break;
+        default:
+            tid = 1;
+        }
+        fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,"
+                "\"pid\":1,\"tid\":%d,\"args\":{\"arg\":\"0x%02X\"}%s}",
+                sep, name.c_str(), ph, ts, tid, e.arg,
+                *ph == 'i' ? ",\"s\":\"t\"" : "");
+        sep = ",\n";
+    }
+    fprintf(out, "\n]}\n");
+}
+
+int main(int argc, char **argv) {
+    const char *jsonPath = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:h")) != -1) {
+        if (opt == 'j') {
+            jsonPath = optarg;
+        } else {
+            fprintf(stderr, "usage: tracedecode [-j trace.json] capture.bin\n");
+            return 2;
+        }
+    }
+    if (optind + 1 != argc) {
+        fprintf(stderr, "usage: tracedecode [-j trace.json] capture.bin\n");
+        return 2;
+    }
+    FILE *in = strcmp(argv[optind], "-") ? fopen(argv[optind], "rb") : stdin;
+    if (!in) {
+        perror(argv[optind]);
+        return 2;
+    }
+    std::vector<uint8_t> capture;
+    int c;
+    while ((c = fgetc(in)) != EOF)
+        capture.push_back(c);
+    if (in != stdin)
+        fclose(in);
+
+    std::vector<Event> events;
+    uint32_t rate = 0;
+    if (!parse(capture, events, rate)) {
+        fprintf(stderr, "no trace dumps found\n");
+        return 1;
+    }
+    const double usPerTick = 1e6 / rate;
+
+    Series byteToSound = { "byte to sound", std::vector<double>() };
+    Series byteToWrite = { "byte to write", std::vector<double>() };
+    Series dispatch = { "dispatch", std::vector<double>() };
+    Series wakeToByte = { "wake to byte", std::vector<double>() };
+    Series isr = { "isr", std::vector<double>() };
+    uint64_t isrEntered = 0;
+    bool inIsr = false;
+    bool haveByte = false, inDispatch = false, haveWrite = false;
+    bool awake = false; // a wake not yet followed by a byte
+    uint64_t woke = 0;
+    uint64_t firstByte = 0, packetStart = 0, dispatchStart = 0;
+    uint64_t firstWrite = 0, lastWrite = 0;
+    for (size_t i = 0; i < events.size(); i++) {
+        const Event &e = events[i];
+        switch (e.event) {
+        case TRACE_MIDI_BYTE:
+            if (!haveByte)
+                firstByte = e.ticks;
+            haveByte = true;
+            if (awake)
+                wakeToByte.us.push_back((e.ticks - woke) * usPerTick);
+            awake = false;
+            break;
+        case TRACE_WAKE:
+            awake = true;
+            woke = e.ticks;
+            break;
+        case TRACE_ISR_ENTER:
+            inIsr = true;
+            isrEntered = e.ticks;
+            break;
+        case TRACE_ISR_EXIT:
+            if (inIsr)
+                isr.us.push_back((e.ticks - isrEntered) * usPerTick);
+            inIsr = false;
+            break;
+        case TRACE_PACKET:
+            packetStart = haveByte ? firstByte : e.ticks;
+            haveByte = false;
+            break;
+        case TRACE_DISPATCH_BEGIN:
+            inDispatch = true;
+            haveWrite = false;
+            dispatchStart = e.ticks;
+            break;
+        case TRACE_YM_WRITE:
+        case TRACE_SN_WRITE:
+            if (inDispatch) {
+                if (!haveWrite)
+                    firstWrite = e.ticks;
+                lastWrite = e.ticks;
+                haveWrite = true;
+            }
+            break;
+        case TRACE_DISPATCH_END:
+            if (!inDispatch)
+                break; // began before the buffer wrapped
+            inDispatch = false;
+            dispatch.us.push_back((e.ticks - dispatchStart) * usPerTick);
+            if (haveWrite && packetStart <= dispatchStart) {
+                byteToSound.us.push_back((lastWrite - packetStart) * usPerTick);
+                byteToWrite.us.push_back((firstWrite - packetStart) * usPerTick);
+            }
+            break;
+        }
+    }
+    report(byteToSound);
+    report(byteToWrite);
+    report(dispatch);
+    if (!wakeToByte.us.empty())
+        report(wakeToByte);
+    if (!isr.us.empty())
+        report(isr);
+
+    if (jsonPath) {
+        FILE *out = fopen(jsonPath, "w");
+        if (!out) {
+            perror(jsonPath);
+            return 2;
+        }
+        writeChromeTrace(out, events, rate);
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,226 @@
+/**
+ * tuning - how far every key of MegaSynth is from equal temperament, in
+ * cents, for the chip clocks toggle.h can make.
+ *
+ * The clocks are asked for as in Board.h, SYNTH_SN_CLOCK and
+ * SYNTH_YM_CLOCK unless -s and -y say otherwise, and come out rounded to
+ * what the timer can divide F_CPU by. For the SN76489 the table shows:
+ *
+ *     nominal  periods worked out for the clock asked for, as if it came
+ *              out exactly, played at the clock that does
+ *     tuned    periods for the clock that comes out (Tuning.h)
+ *     dither   periods for Timer1Dither's average, played at the average
+ *              the shim measures stepping it
+ *
+ * and the YM2612 column is Tuning.h's F-numbers at its clock. A key the
+ * SN76489's 10 bit counter cannot reach plays an octave (or more) up and
+ * is marked with ^; its error is taken from that octave. The F-number
+ * tables built into the firmware for SynthBoard are checked against the
+ * same sums, a mismatch exits 1. So does a dithered average that is not
+ * ditherClock()'s, or one off the clock asked for by more than a step of
+ * the share. With -m, so does any tuned or YM2612 error in the range over
+ * that many cents.
+ *
+ * Usage: tuning [-s sn_hz] [-y ym_hz] [-r first-last] [-m cents]
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "Arduino.h"
+#include "Tuning.h"
+
+// the shim runs a sketch's loop(); this tool only needs its registers
+void loop() { }
+
+// Timer1Dither steps averaged for the measured clock
+static const unsigned DITHER_STEPS = 65536;
+
+static const char *const NOTE_NAMES[Tuning::OCTAVE] = {
+    "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"
+};
+
+static double cents(double hz, double target) {
+    return 1200 * log2(hz / target);
+}
+
+
+// the error of a note that may play whole octaves off target
+static double octaveCents(double hz, double target, int *octaves) {
+    const double c = cents(hz, target);
+    *octaves = (int)floor(c / 1200 + 0.5);
+    return c - *octaves * 1200;
+}
+
+
+static double snHz(double clock, word period) {
+    return clock / 32 / period;
+}
+
+
+// what YM2612Chip::frequency() writes for MegaSynth's block, played back
+static double ymHz(double clock, byte key, word fnum) {
+    int block = key / Tuning::OCTAVE - 1;
+    if (block < 0) {
+        fnum >>= -block;
+        block = 0;
+    }
+    for (; block > 7 && !(fnum & bit(10)); block--)
+        fnum <<= 1;
+    if (block > 7)
+        block = 7;
+    return fnum * clock / 144 / (double)(1UL << (21 - block));
+}
+
+
+// Timer1Dither's clock as the OCR1A values it picks average out
+static double measureDither(double f) {
+    Timer1Dither::begin(f);
+    double sum = 0;
+    for (unsigned i = 0; i < DITHER_STEPS; i++) {
+        Timer1Dither::step();
+        sum += (double)F_CPU / (OCR1A + 1);
+    }
+    return sum / DITHER_STEPS;
+}
+
+
+// Timer1Dither's measured average against ditherClock(), which the phase
+// reaches over its 65536 steps, and that against the clock asked for
+static bool checkDither(double asked, double measured) {
+    const unsigned long n = ditherPeriod(asked);
+    const double share = ((double)F_CPU / n - (double)F_CPU / (n + 1))
+        / 65536;
+    bool ok = true;
+    if (fabs(measured - ditherClock(asked)) > asked * 1e-9) {
+        fprintf(stderr, "dither: %.3fHz measured, %.3fHz expected\n",
+                measured, ditherClock(asked));
+        ok = false;
+    }
+    if (fabs(ditherClock(asked) - asked) > share) {
+        fprintf(stderr, "dither: %.3fHz for %.0fHz, a share step is "
+                "%.3fHz\n", ditherClock(asked), asked, share);
+        ok = false;
+    }
+    return ok;
+}
+
+
+// the firmware's tables against the sums below, for SynthBoard's clocks
+static unsigned checkTables() {
+    unsigned mismatches = 0;
+    for (unsigned key = 0; key < Tuning::KEY_COUNT; key++) {
+        const double hz = Tuning::keyHz(key);
+        if (SynthTuning::snPeriod(key)
+                != Tuning::snPeriodFor(SynthBoard::snClock(), hz)) {
+            fprintf(stderr, "key %u: SN76489 period %u in the firmware\n",
+                    key, SynthTuning::snPeriod(key));
+            mismatches++;
+        }
+    }
+    for (unsigned n = 0; n < Tuning::OCTAVE; n++) {
+        const double hz = Tuning::keyHz(Tuning::YM_TABLE_KEY + n);
+        if (SynthTuning::ymFnumber(n)
+                != Tuning::ymFnumberFor(SynthBoard::ymClock(), hz)) {
+            fprintf(stderr, "note %u: YM2612 F-number %u in the firmware\n",
+                    n, SynthTuning::ymFnumber(n));
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+
+int main(int argc, char **argv) {
+    double snAsked = SYNTH_SN_CLOCK;
+    double ymAsked = SYNTH_YM_CLOCK;
+    unsigned first = 0, last = Tuning::KEY_COUNT - 1;
+    double limit = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:y:r:m:h")) != -1) {
+        switch (opt) {
+        case 's':
+            snAsked = atof(optarg);
+            break;
+        case 'y':
+            ymAsked = atof(optarg);
+            break;
+        case 'r':
+            if (sscanf(optarg, "%u-%u", &first, &last) != 2
+                    || first > last || last >= Tuning::KEY_COUNT) {
+                fprintf(stderr, "tuning: -r takes keys first-last, 0-127\n");
+                return 2;
+            }
+            break;
+        case 'm':
+            limit = atof(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: tuning [-s sn_hz] [-y ym_hz] "
+                    "[-r first-last] [-m cents]\n");
+            return 2;
+        }
+    }
+    if (snAsked < F_CPU / 131072.0 || snAsked > F_CPU / 2.0
+            || ymAsked < F_CPU / 131072.0 || ymAsked > F_CPU / 2.0) {
+        fprintf(stderr, "tuning: clocks are %g-%gHz\n",
+                F_CPU / 131072.0, F_CPU / 2.0);
+        return 2;
+    }
+
+    const double snClock = toggleClock(snAsked);
+    const double ymClock = toggleClock(ymAsked);
+    const double ditherClockHz = measureDither(snAsked);
+    printf("SN76489 %.0fHz asked, %.0fHz toggled, %.0fHz dithered "
+           "(%.0fHz expected)\n", snAsked, snClock, ditherClockHz,
+           ditherClock(snAsked));
+    printf("YM2612  %.0fHz asked, %.0fHz toggled\n\n", ymAsked, ymClock);
+    printf("key  note        Hz   SN period  nominal    tuned   dither"
+           "   YM fnum       YM\n");
+
+    double worstNominal = 0, worstTuned = 0, worstDither = 0, worstYm = 0;
+    for (unsigned key = first; key <= last; key++) {
+        const double hz = Tuning::keyHz(key);
+        const word nominalPeriod = Tuning::snPeriodFor(snAsked, hz);
+        const word period = Tuning::snPeriodFor(snClock, hz);
+        const word dithered = Tuning::snPeriodFor(ditherClockHz, hz);
+        const word fnum = Tuning::ymFnumberFor(ymClock,
+            Tuning::keyHz(Tuning::YM_TABLE_KEY + key % Tuning::OCTAVE));
+        int octaves, ymOctaves;
+        const double nominal = octaveCents(snHz(snClock, nominalPeriod), hz,
+                                           &octaves);
+        const double dither = octaveCents(
+            snHz(ditherClockHz, dithered), hz, &octaves);
+        const double tuned = octaveCents(snHz(snClock, period), hz, &octaves);
+        const double ym = octaveCents(ymHz(ymClock, key, fnum), hz,
+                                      &ymOctaves);
+        printf("%3u  %-2s%-2d %11.3f  %5u%c  %8.2f %8.2f %8.2f  %5u%c %8.2f\n",
+               key, NOTE_NAMES[key % Tuning::OCTAVE],
+               (int)key / Tuning::OCTAVE - 1, hz, period,
+               octaves ? '^' : ' ', nominal, tuned, dither, fnum,
+               ymOctaves ? '^' : ' ', ym);
+        worstNominal = fmax(worstNominal, fabs(nominal));
+        worstTuned = fmax(worstTuned, fabs(tuned));
+        worstDither = fmax(worstDither, fabs(dither));
+        worstYm = fmax(worstYm, fabs(ym));
+    }
+    printf("\nworst, cents: SN76489 nominal %.2f, tuned %.2f, dither %.2f; "
+           "YM2612 %.2f\n", worstNominal, worstTuned, worstDither, worstYm);
+
+    int status = 0;
+    if (checkTables()) {
+        fprintf(stderr, "tuning: firmware tables do not match\n");
+        status = 1;
+    }
+    if (!checkDither(snAsked, ditherClockHz)) {
+        fprintf(stderr, "tuning: Timer1Dither is off its clock\n");
+        status = 1;
+    }
+    if (limit > 0 && (worstTuned > limit || worstYm > limit)) {
+        fprintf(stderr, "tuning: keys %u-%u off by more than %g cents\n",
+                first, last, limit);
+        status = 1;
+    }
+    return status;
+}
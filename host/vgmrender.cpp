@@ -0,0 +1,242 @@
+/**
+ * vgmrender - convert VGM/VGZ files to WAV in parallel on the host chip
+ * cores, for regression testing whole soundtracks after firmware changes.
+ *
+ * Arguments are files or directories, which are searched recursively for
+ * .vgm and .vgz files. One worker runs per core and idle workers steal
+ * tracks from busy ones. Per track it reports the render speed, the
+ * memory held for the track and an FNV-1a fingerprint of the PCM; at the
+ * end it prints a "hash  path" list that can be saved and passed back
+ * with -c to check a later build against it.
+ *
+ * Usage: vgmrender [-j jobs] [-o outdir] [-l loops] [-c hashes] path...
+ */
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "VgmPlayer.h"
+#include "WorkQueue.h"
+
+struct Track {
+    std::string path;
+    off_t size;
+};
+
+struct Result {
+    bool ok;
+    std::string error;
+    double seconds;
+    double speed;
+    size_t footprint;
+    uint64_t hash;
+};
+
+static double wallSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool isVgm(const std::string &name) {
+    size_t dot = name.rfind('.');
+    return dot != std::string::npos
+        && (!strcasecmp(name.c_str() + dot, ".vgm")
+            || !strcasecmp(name.c_str() + dot, ".vgz"));
+}
+
+static void collect(const std::string &path, std::vector<Track> &tracks) {
+    struct stat st;
+    if (stat(path.c_str(), &st)) {
+        perror(path.c_str());
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        Track track = { path, st.st_size };
+        tracks.push_back(track);
+        return;
+    }
+    DIR *dir = opendir(path.c_str());
+    if (!dir) {
+        perror(path.c_str());
+        return;
+    }
+    while (struct dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] == '.')
+            continue;
+        std::string child = path + "/" + entry->d_name;
+        if (stat(child.c_str(), &st))
+            continue;
+        if (S_ISDIR(st.st_mode) || isVgm(entry->d_name))
+            collect(child, tracks);
+    }
+    closedir(dir);
+}
+
+static bool bySizeDescending(const Track &a, const Track &b) {
+    return a.size > b.size;
+}
+
+/* out/dir/name.vgz -> outdir/name.wav */
+static std::string wavName(const std::string &outDir, const std::string &path) {
+    size_t slash = path.rfind('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.rfind('.');
+    if (dot != std::string::npos)
+        name.erase(dot);
+    return outDir + "/" + name + ".wav";
+}
+
+static std::map<std::string, std::string> readHashes(const char *path) {
+    std::map<std::string, std::string> hashes;
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        exit(2);
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), in)) {
+        char hash[32];
+        int used;
+        if (sscanf(line, "%31s %n", hash, &used) != 1 || hash[0] == '#')
+            continue;
+        std::string name(line + used);
+        while (!name.empty() && (name.back() == '\n' || name.back() == '\r'))
+            name.pop_back();
+        hashes[name] = hash;
+    }
+    fclose(in);
+    return hashes;
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: vgmrender [-j jobs] [-o outdir] [-l loops] [-c hashes] path...\n"
+            "  -j  worker threads (default: one per core)\n"
+            "  -o  write WAV files here, otherwise only fingerprint\n"
+            "  -l  extra times to play the loop section (default 0)\n"
+            "  -c  compare against a saved hash list, exit 1 on mismatch\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    unsigned jobs = std::thread::hardware_concurrency();
+    const char *outDir = NULL;
+    const char *checkPath = NULL;
+    unsigned loops = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:o:l:c:h")) != -1) {
+        switch (opt) {
+        case 'j':
+            jobs = strtoul(optarg, NULL, 10);
+            break;
+        case 'o':
+            outDir = optarg;
+            break;
+        case 'l':
+            loops = strtoul(optarg, NULL, 10);
+            break;
+        case 'c':
+            checkPath = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind == argc)
+        usage();
+    if (!jobs)
+        jobs = 1;
+
+    std::vector<Track> tracks;
+    for (int i = optind; i < argc; i++)
+        collect(argv[i], tracks);
+    std::sort(tracks.begin(), tracks.end(), bySizeDescending);
+
+    std::map<std::string, Result> results;
+    std::mutex lock;
+    WorkQueue<Track> queue(jobs);
+    for (size_t i = 0; i < tracks.size(); i++)
+        queue.push(tracks[i]);
+
+    double wallStart = wallSeconds();
+    queue.run([&](const Track &track, unsigned worker) {
+        Result result = Result();
+        VgmPlayer player;
+        double start = wallSeconds();
+        std::string wav = outDir ? wavName(outDir, track.path) : "";
+        result.ok = player.load(track.path)
+            && player.render(outDir ? wav.c_str() : NULL, loops);
+        double wall = wallSeconds() - start;
+        if (result.ok) {
+            result.seconds = player.output().seconds();
+            result.speed = wall > 0 ? result.seconds / wall : 0;
+            result.footprint = player.footprint();
+            result.hash = player.output().wav.fingerprint();
+        } else {
+            result.error = player.error();
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+        results[track.path] = result;
+        if (result.ok)
+            fprintf(stderr, "[%u] %-40s %7.1f s %7.1fx %6zu KiB %016llx\n",
+                    worker, track.path.c_str(), result.seconds, result.speed,
+                    result.footprint / 1024,
+                    (unsigned long long)result.hash);
+        else
+            fprintf(stderr, "[%u] %-40s %s\n", worker, track.path.c_str(),
+                    result.error.c_str());
+    });
+    double wall = wallSeconds() - wallStart;
+
+    std::map<std::string, std::string> expected;
+    if (checkPath)
+        expected = readHashes(checkPath);
+    double audio = 0;
+    unsigned failed = 0, mismatched = 0;
+    for (std::map<std::string, Result>::const_iterator it = results.begin();
+            it != results.end(); ++it) {
+        const Result &r = it->second;
+        if (!r.ok) {
+            failed++;
+            continue;
+        }
+        audio += r.seconds;
+        char hash[17];
+        snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)r.hash);
+        printf("%s  %s\n", hash, it->first.c_str());
+        if (checkPath) {
+            std::map<std::string, std::string>::const_iterator e =
+                expected.find(it->first);
+            if (e == expected.end() || strcasecmp(e->second.c_str(), hash)) {
+                fprintf(stderr, "MISMATCH %s\n", it->first.c_str());
+                mismatched++;
+            }
+        }
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(stderr,
+            "%zu tracks, %u failed, %.1f s audio in %.2f s on %u workers "
+            "(%.1fx realtime), peak RSS %ld KiB\n",
+            results.size(), failed, audio, wall, jobs,
+            wall > 0 ? audio / wall : 0, usage.ru_maxrss);
+    if (checkPath)
+        fprintf(stderr, "%u of %zu fingerprints differ\n", mismatched,
+                results.size() - failed);
+    return failed ? 2 : mismatched ? 1 : 0;
+}
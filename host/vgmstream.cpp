@@ -0,0 +1,268 @@
+/**
+ * vgmstream - play a VGM/VGZ file on the device by streaming its chip
+ * writes over the host link into the jitter buffer of
+ * Trahagean/VgmStream.h, so tracks of any length play.
+ *
+ * The device reports its free space and buffered time after every frame
+ * and while it plays. Frames go out only while the buffered time is below
+ * the target and the frame fits the free space, so the buffer never
+ * fills and the link is never stalled by it.
+ *
+ * Usage: vgmstream [-b baud] [-t target ms] [-l loops] device file.vgm
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <deque>
+
+#include "LinkSender.h"
+#include "VgmPlayer.h"
+
+static long long nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+class StreamSink : public VgmSink {
+    public:
+    struct Stats {
+        unsigned long frames;
+        unsigned long waits; // times the pacing held a frame back
+        unsigned underruns;
+        uint32_t lowest; // least buffered samples reported while playing
+        uint32_t highest;
+    };
+
+    StreamSink(LinkSender &link, uint32_t target)
+        : ok(true), link(link), target(target), length(0), frameSamples(0),
+          waitPending(0), sent(0), reported(false), ending(false), room(0), buffered(0),
+          acked(0), playing(false), lost(0), counters() {
+        counters.lowest = UINT32_MAX;
+        link.onFrame = onFrame;
+        link.context = this;
+    }
+
+    /* Start a new stream and learn the device's buffer size */
+    bool begin() {
+        if (!link.frame(LINK_STREAM, NULL, 0))
+            return false;
+        long long deadline = nowMs() + 1000;
+        while (!reported && nowMs() < deadline)
+            link.poll(deadline - nowMs());
+        return reported;
+    }
+
+    void ym(uint8_t part, uint8_t reg, uint8_t data) {
+        flushWait();
+        const uint8_t command[3] = {
+            (uint8_t)(part ? STREAM_YM1 : STREAM_YM0), reg, data
+        };
+        add(command, sizeof(command), 0);
+    }
+
+    void sn(uint8_t data) {
+        flushWait();
+        const uint8_t command[2] = { STREAM_SN, data };
+        add(command, sizeof(command), 0);
+    }
+
+    void wait(uint32_t samples) {
+        waitPending += samples;
+    }
+
+    /* Send the rest and STREAM_END, then wait for the device to play it */
+    bool finish() {
+        flushWait();
+        ending = true;
+        const uint8_t command = STREAM_END;
+        add(&command, 1, 0);
+        send();
+        while (ok && link.connected() && (!inFlight.empty() || buffered))
+            link.poll(100);
+        return ok;
+    }
+
+    const Stats &stats() const { return counters; }
+
+    bool ok;
+
+    private:
+    struct Sent {
+        uint8_t seq;
+        size_t bytes;
+        uint32_t samples;
+    };
+
+    LinkSender &link;
+    const uint32_t target; // samples
+    uint8_t payload[LINK_PAYLOAD_MAX];
+    size_t length;
+    uint32_t frameSamples;
+    uint32_t waitPending;
+    uint8_t sent;
+    std::deque<Sent> inFlight; // sent but not yet reported
+    bool reported;
+    bool ending; // the rest of the stream is going out, stop the stats
+    uint32_t room; // as of the last report
+    uint32_t buffered;
+    uint8_t acked;
+    bool playing;
+    unsigned long lost; // link NAKs and resyncs seen
+    Stats counters;
+
+    static void onFrame(uint8_t type, const uint8_t *payload, uint8_t length,
+                        void *context) {
+        if (type == LINK_STREAM_FILL && length >= STREAM_FILL_LENGTH)
+            static_cast<StreamSink *>(context)->report(payload);
+    }
+
+    void report(const uint8_t *payload) {
+        room = payload[0] | payload[1] << 8;
+        buffered = payload[2] | payload[3] << 8;
+        counters.underruns = payload[4];
+        acked = payload[5];
+        playing = payload[6];
+        // a frame lost on the wire is never counted, start counting again
+        const unsigned long losses = link.stats().naks + link.stats().resyncs;
+        if (losses != lost) {
+            lost = losses;
+            inFlight.clear();
+            sent = acked;
+        }
+        while (!inFlight.empty()
+                && (uint8_t)(acked - inFlight.front().seq) < 0x80)
+            inFlight.pop_front();
+        if (playing && !ending) {
+            if (buffered < counters.lowest)
+                counters.lowest = buffered;
+            if (buffered > counters.highest)
+                counters.highest = buffered;
+        }
+        reported = true;
+    }
+
+    void flushWait() {
+        while (waitPending) {
+            uint32_t n = waitPending < 0xFFFF ? waitPending : 0xFFFF;
+            const uint8_t command[3] = {
+                STREAM_WAIT, (uint8_t)n, (uint8_t)(n >> 8)
+            };
+            add(command, sizeof(command), n);
+            waitPending -= n;
+        }
+    }
+
+    void add(const uint8_t *command, size_t n, uint32_t samples) {
+        if (length + n > sizeof(payload))
+            send();
+        for (size_t i = 0; i < n; i++)
+            payload[length++] = command[i];
+        frameSamples += samples;
+    }
+
+    // Hold the frame while the device plays with enough buffered, or has
+    // no room for it. A failed frame is dropped, the rest of the stream
+    // goes nowhere once ok is false.
+    void send() {
+        if (!ok || !length) {
+            length = 0;
+            frameSamples = 0;
+            return;
+        }
+        for (;;) {
+            uint32_t ahead = buffered, bytes = 0;
+            for (size_t i = 0; i < inFlight.size(); i++) {
+                ahead += inFlight[i].samples;
+                bytes += inFlight[i].bytes;
+            }
+            if (bytes + length <= room && (ahead < target || !playing))
+                break;
+            if (!link.connected()) {
+                ok = false;
+                return;
+            }
+            counters.waits++;
+            link.poll(10);
+        }
+        if (!link.frame(LINK_STREAM, payload, length)) {
+            ok = false;
+            length = 0;
+            return;
+        }
+        Sent s = { ++sent, length, frameSamples };
+        inFlight.push_back(s);
+        counters.frames++;
+        length = 0;
+        frameSamples = 0;
+    }
+};
+
+int main(int argc, char **argv) {
+    unsigned long baud = LINK_BAUDRATE;
+    unsigned long targetMs = 250;
+    unsigned loops = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:t:l:h")) != -1) {
+        if (opt == 'b') {
+            baud = strtoul(optarg, NULL, 10);
+        } else if (opt == 't') {
+            targetMs = strtoul(optarg, NULL, 10);
+        } else if (opt == 'l') {
+            loops = strtoul(optarg, NULL, 10);
+        } else {
+            optind = argc;
+            break;
+        }
+    }
+    if (argc - optind != 2) {
+        fprintf(stderr, "usage: vgmstream [-b baud] [-t target ms] "
+                "[-l loops] device file.vgm\n");
+        return 2;
+    }
+    VgmPlayer vgm;
+    if (!vgm.load(argv[optind + 1])) {
+        fprintf(stderr, "%s: %s\n", argv[optind + 1], vgm.error().c_str());
+        return 2;
+    }
+    int fd = LinkSender::openSerial(argv[optind], baud);
+    if (fd < 0) {
+        perror(argv[optind]);
+        return 2;
+    }
+
+    LinkSender link(fd);
+    if (!link.hello()) {
+        fprintf(stderr, "no answer from the device\n");
+        return 1;
+    }
+    StreamSink sink(link, targetMs * STREAM_RATE / 1000);
+    if (!sink.begin()) {
+        fprintf(stderr, "the device does not stream, build it with "
+                "USE_HOST_LINK\n");
+        return 1;
+    }
+
+    long long start = nowMs();
+    bool ok = vgm.play(sink, loops) && sink.ok && sink.finish();
+    double elapsed = (nowMs() - start) / 1000.0;
+    const LinkSender::Stats &l = link.stats();
+    const StreamSink::Stats &s = sink.stats();
+    fprintf(stderr, "%lu frames, %lu bytes in %.2f s (%.0f B/s), "
+            "%lu pacing waits, %lu resyncs, %lu dropped by the device\n",
+            s.frames, l.bytes, elapsed, elapsed > 0 ? l.bytes / elapsed : 0,
+            s.waits, l.resyncs, l.naks);
+    if (s.lowest != UINT32_MAX)
+        fprintf(stderr, "buffered %.0f to %.0f ms, %u underruns\n",
+                s.lowest * 1000.0 / STREAM_RATE,
+                s.highest * 1000.0 / STREAM_RATE, s.underruns);
+    if (!ok) {
+        fprintf(stderr, "%s\n", vgm.error().empty()
+                ? "device stopped granting credit or hung up"
+                : vgm.error().c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+/**
+ * workqueue - the check of WorkQueue.h's stealing. Two workers get jobs
+ * of sizes 9 down to 1, dealt round robin: worker 0 holds 9, 7, 5, 3 and
+ * 1, worker 1 8, 6, 4 and 2. Job 9 is a long one, and runs until every
+ * other job is done; the others wait for it to start, so worker 0 is the
+ * one that holds it. Worker 1 then runs its own jobs and steals the rest
+ * of worker 0's, which must come biggest first: 8, 6, 4, 2, 7, 5, 3, 1.
+ *
+ * A different order, a job run twice or not at all, or a run that does
+ * not finish within a few seconds exits 1.
+ *
+ * Usage: workqueue
+ */
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "WorkQueue.h"
+
+static const unsigned WORKERS = 2;
+static const unsigned JOBS = 9;
+static const unsigned EXPECTED[JOBS - 1] = { 8, 6, 4, 2, 7, 5, 3, 1 };
+static const std::chrono::seconds TIMEOUT(5);
+
+static std::atomic<bool> longStarted(false);
+static std::atomic<unsigned> done(0);
+static std::atomic<bool> timedOut(false);
+
+// spins until the condition holds or the run is out of time
+template<class F> static void waitFor(F condition) {
+    const auto deadline = std::chrono::steady_clock::now() + TIMEOUT;
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            timedOut = true;
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        fprintf(stderr, "usage: workqueue\n");
+        return 2;
+    }
+    WorkQueue<unsigned> queue(WORKERS);
+    for (unsigned size = JOBS; size >= 1; size--)
+        queue.push(size);
+
+    std::mutex lock;
+    std::vector<unsigned> order[WORKERS];
+    queue.run([&](const unsigned &size, unsigned worker) {
+        if (size == JOBS) {
+            longStarted = true;
+            waitFor([] { return done == JOBS - 1; });
+        } else {
+            waitFor([] { return longStarted.load(); });
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            order[worker].push_back(size);
+        }
+        done++;
+    });
+
+    unsigned errors = 0;
+    for (unsigned w = 0; w < WORKERS; w++) {
+        printf("worker %u:", w);
+        for (size_t i = 0; i < order[w].size(); i++)
+            printf(" %u", order[w][i]);
+        printf("\n");
+    }
+    if (timedOut) {
+        fprintf(stderr, "timed out\n");
+        errors++;
+    }
+    if (order[0].size() != 1 || order[0][0] != JOBS) {
+        fprintf(stderr, "worker 0 ran more than the long job\n");
+        errors++;
+    }
+    const std::vector<unsigned> expected(EXPECTED, EXPECTED + JOBS - 1);
+    if (order[1] != expected) {
+        fprintf(stderr, "worker 1 ran the jobs out of order, expected");
+        for (size_t i = 0; i < expected.size(); i++)
+            fprintf(stderr, " %u", expected[i]);
+        fprintf(stderr, "\n");
+        errors++;
+    }
+    printf("\n%u errors\n", errors);
+    return errors ? 1 : 0;
+}
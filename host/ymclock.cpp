@@ -0,0 +1,132 @@
+/**
+ * ymclock - the check of the sequencer's tempo sources: the firmware
+ * arpeggiates a chord at sixteenths on the internal tempo (CC 107 = 0)
+ * and on the YM2612's Timer B (CC 107 = 40, Trahagean/YmTimer.h), at the
+ * slowest, a middle and the fastest tempo. ChipBus runs the emulated
+ * YM2612's timers and drives its IRQ pin, so the Timer B runs go through
+ * the pin change interrupt as on the board.
+ *
+ * The steps are timed from the key on writes (0x28) on the bus. A run
+ * fails when a step is off the tempo by more than JITTER_US, or a key on
+ * drifts from where the tempo puts it, counted from the first, by more
+ * than that, e.g. when an overflow is lost; ymclock then exits 1.
+ * Halfway a CC 92 = 0 clears Timer A's bits of 0x27, which must leave
+ * Timer B's alone.
+ * ChipBus times a sample at the core's whole sample rate, 10 ppm slow at
+ * 8MHz, so the Timer B runs are held to the tempo on that clock.
+ *
+ * Usage: ymclock
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "Arduino.h"
+#include "Trahagean.ino"
+#include "ChipBus.h"
+
+static const uint32_t SN_CLOCK = 4000000;
+static const unsigned STEPS = 24; // timed, after the first
+static const double JITTER_US = 600; // two Timer B steps
+
+struct Run {
+    const char *clock;
+    uint8_t cc107;
+    unsigned bpm;
+    bool onChip; // counted in YM2612 samples
+};
+
+static const Run runs[] = {
+    { "internal", 0, 20, false }, { "internal", 0, 120, false },
+    { "internal", 0, 254, false }, { "timer b", 40, 20, true },
+    { "timer b", 40, 120, true }, { "timer b", 40, 254, true }
+};
+
+static std::vector<uint64_t> keyOns;
+static HostPort::hook_t busHook; // ChipBus's, called on
+static uint8_t address;
+
+/* the first YM2612's key on writes, as ChipBus sees them */
+static void watch(HostPort &port, uint8_t previous) {
+    const uint8_t wr = bit(SynthBoard::YM_WR::BIT);
+    if (&port == &SynthBoard::YM_WR::out() && !(previous & wr)
+            && (port & wr) && !SynthBoard::YM_A1::isHigh()) {
+        const uint8_t data = SynthBoard::dataBusRead();
+        if (!SynthBoard::YM_A0::isHigh())
+            address = data;
+        else if (address == 0x28 && (data & 0xF0))
+            keyOns.push_back(hostCycles);
+    }
+    busHook(port, previous);
+}
+
+static void midi(const uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; i++)
+        hostSerialSend(data[i], hostCycles);
+}
+
+static bool check(const Run &run) {
+    hostReset();
+    ChipBus bus(SynthBoard::ymClock(), SN_CLOCK);
+    bus.attach();
+    busHook = SynthBoard::YM_WR::out().hook;
+    SynthBoard::YM_WR::out().hook = watch;
+    setup();
+    bus.record(NULL);
+
+    double step = F_CPU * 60.0 / run.bpm / 4;
+    if (run.onChip)
+        step *= SynthBoard::ymClock() / YM2612::TIMER_A_CLOCKS
+            / bus.ym.sampleRate();
+    const uint8_t setupCcs[] = {
+        0xB0, 102, 1, 0xB0, 103, Sequencer::PPQN / 4,
+        0xB0, 106, (uint8_t)(run.bpm / 2), 0xB0, 107, run.cc107 };
+    const uint8_t chord[] = { 0x90, 60, 127, 0x90, 64, 127, 0x90, 67, 127 };
+    midi(setupCcs, sizeof(setupCcs));
+    hostRunUntil(hostCycles + F_CPU / 100);
+    keyOns.clear();
+    const uint8_t timerA[] = { 0xB0, 92, 0 };
+    midi(chord, sizeof(chord));
+    hostRunUntil(hostCycles + (uint64_t)(step * (STEPS / 2 + 0.5)));
+    midi(timerA, sizeof(timerA));
+    hostRunUntil(hostCycles + (uint64_t)(step * (STEPS - STEPS / 2 + 1)));
+    bus.finish();
+
+    if (keyOns.size() < STEPS + 1) {
+        printf("%-8s %4u  %u steps\n", run.clock, run.bpm,
+               (unsigned)keyOns.size());
+        fprintf(stderr, "%s at %u bpm: %u steps, %u expected\n", run.clock,
+                run.bpm, (unsigned)keyOns.size(), STEPS + 1);
+        return false;
+    }
+    double jitter = 0, drift = 0;
+    for (unsigned i = 1; i <= STEPS; i++) {
+        jitter = fmax(jitter, fabs(keyOns[i] - keyOns[i - 1] - step));
+        drift = fmax(drift, fabs(keyOns[i] - keyOns[0] - i * step));
+    }
+    const double mean = (double)(keyOns[STEPS] - keyOns[0]) / STEPS;
+    jitter *= 1e6 / F_CPU;
+    drift *= 1e6 / F_CPU;
+    printf("%-8s %4u %9.3f %9.3f %9.1f %8.1f\n", run.clock, run.bpm,
+           step * 1e3 / F_CPU, mean * 1e3 / F_CPU, jitter, drift);
+    if (jitter > JITTER_US || drift > JITTER_US) {
+        fprintf(stderr, "%s at %u bpm: %.1f us jitter, %.1f us drift\n",
+                run.clock, run.bpm, jitter, drift);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        fprintf(stderr, "usage: ymclock\n");
+        return 2;
+    }
+    printf("clock     bpm   step ms   mean ms jitter us drift us\n");
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); i++)
+        ok = check(runs[i]) && ok;
+    return ok ? 0 : 1;
+}
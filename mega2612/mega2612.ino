@@ -42,46 +42,21 @@
 // These three-byte MIDI messages are the ones the current iteration of this program will use
 
 // SPLITTING UP THE COMMAND/STATUS byte INTO TWO FOUR BIT VALUES
-// The Command/Status byte is split into two distinct messages
-// We first capture a full byte in the 'statusbyte' variable
-// Then, using some bitmath, we "AND" out the Most Significan Bits and assign
-// the remaining Least Significant Bits to the "MIDIChannel" variable
-// ---NEED TO THINK ABOUT HOW TO HANDLE THE FOUR MSBs.  HOW CAN WE APPEND THEM TO THE SPLIT OFF
-// MIDI MESSAGES IN A WAY THAT MAKES SENSE?----
-// Now, we are able to isolate the MIDI Channel independently from the actual MIDI command 
-// (e.g. NoteON, NoteOFF, CC, etc.)
-// this gives us far more programmatical control and allows us to apply universal command functions 
-// to each MIDI channel without having to use gigantic if/then or switch/case codeblocks
+// MidiPacketizer (Trahagean/midiPacketizer.h) collects the bytes into whole
+// messages, running status included, and MegaSynth splits the status byte:
+// the four MSBs pick the command (NoteOn, NoteOff, CC, ...) and the four
+// LSBs the MIDI channel, which picks the chip and voice:
+// - MIDI Channels 1-6: the YM2612 FM channels
+// - MIDI Channels 7-10: the SN76489 channels, 10 being the drums
+// - MIDI Channels 11-14: the YM2612 channel 3 operators in special mode
+// See Trahagean/MegaSynth.h for the CCs.
 
-// GETTING INTO THE ACTUAL DATA!
-// 'statusbyte' records the initial MIDI Command/Status/MIDI Channel byte
-byte statusByte;
+// The chips are wired as on the Trahagean board, see Trahagean/Board.h;
+// define SYNTH_BOARD before the include for another board profile.
+#include "../Trahagean/MegaSynth.h"
 
-// 'StatusCommand' variable will hold the most significant bits of the initial 
-// MIDI Status Command message, defining the actual MIDI command 
-// When combined with the uint4_t 'MIDIChannel', the 'StatusCommand' half 
-// of the full byte-size message will be: B100000000-B11110000 or 0x8m-0xFm
-byte statusCommand = ((statusByte & B01110000) >> 4);
-
-// The four bit MIDIChannel variable will hold the least significant bits of the initial 
-// MIDI Status Command message, defining the MIDI Channel 
-// When combined with the uint4_t 'statusCommand', the 'MIDIChanel' half 
-// of the full byte-size message will be: B10000000-B10001111 or 0xn0-0xnF
-// essentially representing MIDI channels 1 through 16 (or 0-15, in code)
-byte MIDIChannel = statusByte & B00001111;
-
-// The 'databyte1' variable is actually the second data byte
-// It will store the Note value,  CC Number, Instrument Number, etc.
-byte databyte1; 
-
-// Likewise, the 'databyte2' variable is actually the third data byte
-// 
-byte databyte2; 
-
-// ORIGINAL METHOD (hope to replace this)
-// byte statusbyte;
-// byte databyte1;
-// byte databyte2;
+MegaSynth synth;
+MidiPacketizer packetizer;
 
 // BLINKTEST - THE VERY USEFUL TOOL FOR TESTING CODE BLOCKS
 // If you want to test to see if a switch case or if statement is active, 
@@ -103,6 +78,8 @@ void blinkTest(int numBlinks = 1, int LEDHighTime = 50, int LEDLowTime = 50) {
 
 void setup(){
   Serial.begin(38400);
+  SynthBoard::begin(); // chip clocks and the data bus
+  synth.begin();
   pinMode(13,OUTPUT);
   digitalWrite(13,LOW);
   
@@ -111,36 +88,10 @@ void setup(){
   blinkTest(3,400,200);
   blinkTest(3,200,200);
 }
-  
-void MIDIinput() {
-  do {    
-    if (Serial.available()) {
-      statusByte = Serial.read(); // get first byte of MIDI data from computer
-      switch (statusCommand) {
-        case 0x9: //NoteOn
-          //blinkTest(1,50,1);
-          if (!((databyte1 = Serial.read()) & B10000000) && !((databyte2 = Serial.read()) & B10000000)) {
-            
-          }
-          break;
-        case 0x8: //NoteOff
-         // blinkTest(3,100,10);
-         databyte1 = Serial.read();  //note value
-         databyte2 = Serial.read();   //note velocity
-          break;
-        case 0xB: //Continuous Controller (CC)
-         // blinkTest(1, 100, 100);
-         databyte1 = Serial.read(); // CC number
-         databyte2 = Serial.read(); // CC value
-         break;
-        default:
-        break;          
-        }
-      }
-  }
-  while (Serial.available() >= 2);//when at least three bytes available
-}
 
 void loop() {
-  MIDIinput();
+  synth.service(); // drum envelopes
+  while (Serial.available()) {
+    synth.parseMidiPacket(packetizer.receive(Serial.read()));
+  }
 }
@@ -12,29 +12,15 @@
  */
 
 /* Dependencies */
-#include <avr/io.h>     // For I/O and other AVR registers
-#include <util/delay.h> // For timing
+#include "Arduino.h"
+#include "../Trahagean/SN76489.h" // Chip driver and board profiles
 
-/* Pinmap (Arduino UNO compatible) */
-// #define PSG_READY (5)       // PC5 (= pin A5 for Arduino UNO)
-// #define PSG_WE (4)          // PC4 (= pin A4 for Arduino UNO)
-// #define PSG_CE (3)          // PC3 (= pin A3 for Arduino UNO)
-#define PSG_READY (1)       // PC1 (= pin A1 for Arduino UNO)
-#define PSG_WE (3)          // PC3 (= pin A3 for Arduino UNO)
-#define PSG_CE (4)          // PC4 (= pin A4 for Arduino UNO)
-#define PSG_CTRL_DDR DDRC
-#define PSG_CTRL_PORT PORTC
-#define PSG_CTRL_PIN PINC
-#define PSG_DATA_DDR DDRD
-#define PSG_DATA_PORT PORTD // Whole PORT D for data bus (= pins D0 to D7 for Arduino UNO)
-//#define PSG_CLOCK (5)       // PB1 = OC1A (= pin D9 for Arduino UNO)
-#define PSG_CLOCK (1)       // PB1 = OC1A (= pin D9 for Arduino UNO)
-#define PSG_CLOCK_DDR DDRB
-
-//PD0 & PD1 for serial i/o, using PD2-PD7 as YM 0-5
-#define DDATA(d) ((d << 2) & B11111100)
-// PB2 PB3 as YM 6-7
-#define BDATA(d) ((d >> 4) & B00001100)
+/* Pinmap (Arduino UNO compatible), see RewiredSnBoard in Board.h:
+ * READY on PC1 (A1, unused), WE on PC3 (A3), CE on PC4 (A4) and the
+ * clock, F_CPU / 4, on PB1 = OC1A (D9). PD0 & PD1 are left for serial
+ * i/o: the data bus is D0-D5 on PD2-PD7 and D6-D7 on PB2-PB3. */
+typedef RewiredSnBoard Board;
+typedef SN76489Chip<Board> PSG;
 
 /* pinout
              ____
@@ -78,32 +64,13 @@ CLK to D9
 #define NOISE_SHIFT_TONE3 (3)
 
 /**
- * Send raw data to the SN76489
- * 
- * @param data Data to write
- */
-static void write_psg(uint8_t data) {
-	//while(PSG_CTRL_PIN & _BV(PSG_READY)); // Wait for chip to be ready
-	PSG_DATA_PORT = data;
-	_delay_us(500);
-	PSG_CTRL_PORT &= ~_BV(PSG_CE); // CS LOW
-	_delay_us(500);
-	PSG_CTRL_PORT &= ~_BV(PSG_WE); // Write data
-	_delay_us(500);
-	PSG_CTRL_PORT |= _BV(PSG_CE); // CS HIGH
-	_delay_us(500);
-	PSG_CTRL_PORT |= _BV(PSG_WE);
-	_delay_us(500);
-}
-
-/**
- * Set the value of a channel (with latch)
+ * Set the attenuation of a channel
  *
- * @param reg Register address
- * @param data Data to write
+ * @param channel Channel number (0, 1, 2, 3 = noise)
+ * @param attenuation ATTENUATION_* value
  */
-static void setreg(uint8_t reg, uint8_t data) {
-	write_psg(0x80 | ((reg & 0x07) << 4) | (data & 0x0F));
+static void setAttenuation(uint8_t channel, uint8_t attenuation) {
+	PSG::attenuation(static_cast<SN76489Map::channel_e>(channel), attenuation);
 }
 
 
@@ -114,70 +81,51 @@ static void setreg(uint8_t reg, uint8_t data) {
  * @param frequency Frequency in Hz
  */
 static void setFrequency(uint8_t channel, uint16_t frequency) {
-	uint16_t f = FREG_REG_VAL(frequency);
-	setreg(2 * channel, f & 0x0F);
-	write_psg((f >> 4) & 0x3F);
+	PSG::setPeriod125k(static_cast<SN76489Map::channel_e>(channel),
+		FREG_REG_VAL(frequency));
 }
 
 /** Program entry point */
-int main(void) {
-
-	/* Pins setup */
-	PSG_CTRL_DDR |= _BV(PSG_WE) | _BV(PSG_CE);
-	PSG_CTRL_DDR &= ~_BV(PSG_READY);
-	PSG_DATA_DDR = 0xFF;
-	PSG_CLOCK_DDR |= _BV(PSG_CLOCK);
-	PSG_CTRL_PORT |= _BV(PSG_WE) | _BV(PSG_CE) | _BV(PSG_READY); /* CE and WE HIGH by default + Pull-up on READY */
-	
-	/* F_CPU / 4 clock generation */
-        TCCR1A = _BV(COM1A0);            /* Toggle OCA1 on compare match */
-	TCCR1B = _BV(WGM12) | _BV(CS10); /* CTC mode with prescaler /1 */
-	TCCR1C = 0;                      /* Flag reset */
-	TCNT1 = 0;                       /* Counter reset */
-	OCR1A = 1;                       /* Divide base clock by 4 */
- 	
-//        SPCR |= _BV(MSTR);
-//        SPCR |= _BV(SPE);
-        
+void setup() {
 
+	/* Pins setup and F_CPU / 4 clock generation */
+	Board::begin();
+	PSG::begin();
 
 	/* SN76489 Test code */ 
 	setFrequency(0, 392); // Sol
 	_delay_ms(100);
-	setreg(0x01, ATTENUATION_OFF);
+	setAttenuation(0, ATTENUATION_OFF);
 	_delay_ms(100);
 	setFrequency(1, 440); // La 
 	_delay_ms(100);
-	setreg(0x03, ATTENUATION_OFF);
+	setAttenuation(1, ATTENUATION_OFF);
 	_delay_ms(100);
 	setFrequency(2, 493); // Si
 	_delay_ms(100);
-	setreg(0x05, ATTENUATION_OFF);
+	setAttenuation(2, ATTENUATION_OFF);
 	_delay_ms(100);
-	setreg(0x06, NOISE_WHITE_FEEDBACK | NOISE_SHIFT_1024);
+	PSG::setNoise(SN76489Map::WHITE_NOISE, SN76489Map::SHIFT_1024);
 	_delay_ms(100);
-	setreg(0x07, ATTENUATION_OFF);
-	
-	/* Program loop */
-	for(;;) {
-		_delay_ms(1000);
-		setreg(0x01, ATTENUATION_2DB);
-		_delay_ms(1000);
-		setreg(0x01, ATTENUATION_OFF);
-		_delay_ms(1000);
-		setreg(0x03, ATTENUATION_2DB);
-		_delay_ms(1000);
-		setreg(0x03, ATTENUATION_OFF);
-		_delay_ms(1000);
-		setreg(0x05, ATTENUATION_2DB);
-		_delay_ms(1000);
-		setreg(0x05, ATTENUATION_OFF);
-		_delay_ms(1000);
-		setreg(0x07, ATTENUATION_2DB);
-		_delay_ms(1000);
-		setreg(0x07, ATTENUATION_OFF);
-	}
-	
-	/* Compiler fix */
-	return 0;
+	setAttenuation(3, ATTENUATION_OFF);
+}
+
+/* Program loop */
+void loop() {
+	_delay_ms(1000);
+	setAttenuation(0, ATTENUATION_2DB);
+	_delay_ms(1000);
+	setAttenuation(0, ATTENUATION_OFF);
+	_delay_ms(1000);
+	setAttenuation(1, ATTENUATION_2DB);
+	_delay_ms(1000);
+	setAttenuation(1, ATTENUATION_OFF);
+	_delay_ms(1000);
+	setAttenuation(2, ATTENUATION_2DB);
+	_delay_ms(1000);
+	setAttenuation(2, ATTENUATION_OFF);
+	_delay_ms(1000);
+	setAttenuation(3, ATTENUATION_2DB);
+	_delay_ms(1000);
+	setAttenuation(3, ATTENUATION_OFF);
 }
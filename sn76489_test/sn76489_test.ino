@@ -0,0 +1,116 @@
+/**
+ * SN76489 test code for AVR.
+ * 
+ * This program is a simple test code for the SN76489 PSG sound chip using an AVR ATmega328p mcu.
+ * For more informations about wiring please see: http://members.casema.nl/hhaydn/howel/parts/76489.htm
+ * For more informations about SN76489 registers please see: http://www.smspower.org/Development/SN76489
+ *
+ * @warning This test code is made to run on an ATmega328/ATmega168 mcu with a 16MHz external crystal.
+ * 
+ * @author Fabien Batteix <skywodd@gmail.com>
+ * @link http://skyduino.wordpress.com My Blog about electronics
+ */
+
+/* Dependencies */
+#include "Arduino.h"
+#include "../Trahagean/SN76489.h" // Chip driver and board profiles
+
+/* Pinmap (Arduino UNO compatible), see PortDSnBoard in Board.h:
+ * READY on PC5 (A5, unused), WE on PC4 (A4), CE on PC3 (A3), the data
+ * bus on the whole PORT D (D0 to D7) and the clock, F_CPU / 4, on
+ * PB1 = OC1A (D9) */
+typedef PortDSnBoard Board;
+typedef SN76489Chip<Board> PSG;
+
+/* ----- BIG WARNING FOR ARDUINO USERS -----
+ * Normally ICSP port is used to program the AVR chip (see make upload in the top level Makefile). 
+ * So, if you use an arduino UNO board to run this test code BE VERY CAREFULL.
+ * If you don't known what you make you will be in trouble.
+ *
+ * To avoid problems you can compile and upload this code using the Arduino IDE BUT you will need to disconnect pins Rx/Tx before upload !
+ */
+
+/** Macro for frequency register */
+#define FREG_REG_VAL(f) (4000000UL / 32 / (f))
+
+/* Register values */
+#define ATTENUATION_2DB (1)
+#define ATTENUATION_4DB (2)
+#define ATTENUATION_8DB (4)
+#define ATTENUATION_16DB (8)
+#define ATTENUATION_OFF (15)
+
+/* Noise controls */
+#define NOISE_PERIODIC_FEEDBACK (0)
+#define NOISE_WHITE_FEEDBACK (1 << 2)
+#define NOISE_SHIFT_512 (0)
+#define NOISE_SHIFT_1024 (1)
+#define NOISE_SHIFT_2048 (2)
+#define NOISE_SHIFT_TONE3 (3)
+
+/**
+ * Set the attenuation of a channel
+ *
+ * @param channel Channel number (0, 1, 2, 3 = noise)
+ * @param attenuation ATTENUATION_* value
+ */
+static void setAttenuation(uint8_t channel, uint8_t attenuation) {
+	PSG::attenuation(static_cast<SN76489Map::channel_e>(channel), attenuation);
+}
+
+
+/**
+ * Set the frequency of a channel
+ *
+ * @param channel Channel number (0, 1, 2)
+ * @param frequency Frequency in Hz
+ */
+static void setFrequency(uint8_t channel, uint16_t frequency) {
+	PSG::setPeriod125k(static_cast<SN76489Map::channel_e>(channel),
+		FREG_REG_VAL(frequency));
+}
+
+/** Program entry point */
+void setup() {
+
+	/* Pins setup and F_CPU / 4 clock generation */
+	Board::begin();
+	PSG::begin();
+
+	/* SN76489 Test code */ 
+	setFrequency(0, 392); // Sol
+	_delay_ms(100);
+	setAttenuation(0, ATTENUATION_OFF);
+	_delay_ms(100);
+	setFrequency(1, 440); // La 
+	_delay_ms(100);
+	setAttenuation(1, ATTENUATION_OFF);
+	_delay_ms(100);
+	setFrequency(2, 493); // Si
+	_delay_ms(100);
+	setAttenuation(2, ATTENUATION_OFF);
+	_delay_ms(100);
+	PSG::setNoise(SN76489Map::WHITE_NOISE, SN76489Map::SHIFT_1024);
+	_delay_ms(100);
+	setAttenuation(3, ATTENUATION_OFF);
+}
+
+/* Program loop */
+void loop() {
+	_delay_ms(1000);
+	setAttenuation(0, ATTENUATION_2DB);
+	_delay_ms(1000);
+	setAttenuation(0, ATTENUATION_OFF);
+	_delay_ms(1000);
+	setAttenuation(1, ATTENUATION_2DB);
+	_delay_ms(1000);
+	setAttenuation(1, ATTENUATION_OFF);
+	_delay_ms(1000);
+	setAttenuation(2, ATTENUATION_2DB);
+	_delay_ms(1000);
+	setAttenuation(2, ATTENUATION_OFF);
+	_delay_ms(1000);
+	setAttenuation(3, ATTENUATION_2DB);
+	_delay_ms(1000);
+	setAttenuation(3, ATTENUATION_OFF);
+}
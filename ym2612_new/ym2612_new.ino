@@ -19,31 +19,22 @@
  */
 
 /* Dependencies */
-#include <avr/io.h>     // For I/O and other AVR registers
-#include <util/delay.h> // For timing
-
-
-/* Pinmap (Arduino UNO compatible) */
-#define YM_IC (5) // PC5 (= pin A5 for Arduino UNO)
-#define YM_CS (4) // PC4 (= pin A4 for Arduino UNO)
-#define YM_WR (3) // PC3 (= pin A3 for Arduino UNO)
-#define YM_RD (2) // PC2 (= pin A2 for Arduino UNO)
-#define YM_A0 (1) // PC1 (= pin A1 for Arduino UNO)
-#define YM_A1 (0) // PC0 (= pin A0 for Arduino UNO)
-#define YM_CTRL_DDR DDRC
-#define YM_CTRL_PORT PORTC
-#define YM_DATA_DDR DDRD
-#define YM_DATA_PORT PORTD // Whole PORT D for data bus (= pins D0 to D7 for Arduino UNO)
-#define YM_MCLOCK (1) // PB1 = OC1A (= pin D9 for Arduino UNO)
-#define YM_MCLOCK_DDR DDRB
-
-//PD0 & PD1 for serial i/o, using PD2-PD7 as YM 0-5
-#define DDATA(d) ((d << 2) & B11111100)
-// PB2 PB3 as YM 6-7
-#define BDATA(d) ((d >> 4) & B00001100)
+#include "Arduino.h"
+#include "../Trahagean/YM2612.h" // Chip driver and board profiles
+
+/* Pinmap (Arduino UNO compatible), see ShiftedYmBoard in Board.h:
+ * IC on PC5 (A5), CS on PC4 (A4), WR on PC3 (A3), RD on PC2 (A2),
+ * A0 on PC1 (A1), A1 on PC0 (A0) and the master clock, F_CPU / 2, on
+ * PB1 = OC1A (D9). PD0 & PD1 are left for serial i/o: the data bus is
+ * YM D0-D5 on PD2-PD7 and YM D6-D7 on PB2-PB3. */
+typedef ShiftedYmBoard Board;
+YM2612Chip<Board> ym;
+
+#define MIDI_NOTE_ON 0x90
+#define MIDI_NOTE_OFF 0x80
 
 /* ----- BIG WARNING FOR ARDUINO USERS -----
- * Normally ICSP port is used to program the AVR chip (see the makefile for details). 
+ * Normally ICSP port is used to program the AVR chip (see make upload in the top level Makefile). 
  * So, if you use an arduino UNO board to run this test code BE VERY CAREFULL.
  * If you don't known what you make you will be in trouble.
  *
@@ -51,68 +42,27 @@
  */
 
 /**
- * Send raw data to the YM2612
- * 
- * @author Furrtek
- * @param data Data to write
- */
-static void write_ym(uint8_t data) {
-
-	YM_CTRL_PORT &= ~_BV(YM_CS); // CS LOW
-	//YM_DATA_PORT = data;
-        YM_DATA_PORT = DDATA(data) | (YM_DATA_PORT & B00000011);
-        PORTB = BDATA(data) | (PORTB & B11110011);
-	_delay_us(1);
-	YM_CTRL_PORT &= ~_BV(YM_WR); // Write data
-	_delay_us(5);
-	YM_CTRL_PORT |= _BV(YM_WR);
-	_delay_us(5);
-	YM_CTRL_PORT |= _BV(YM_CS); // CS HIGH
-}
-
-/**
- * Write data into a specific register of the YM2612
+ * Write data into a specific register of the YM2612 (part 1)
  *
- * @author Furrtek
  * @param reg Destination register address
  * @param data Data to write
  */
 static void setreg(uint8_t reg, uint8_t data) {
-	YM_CTRL_PORT &= ~_BV(YM_A0); // A0 low (select register)
-	write_ym(reg);
-	YM_CTRL_PORT |= _BV(YM_A0);  // A0 high (write register)
-	write_ym(data);
+	ym.writeReg(YM2612Map::PART1, reg, data);
 }
 
 /** Program entry point */
-int main(void) {
+void setup() {
   /* activate MIDI Serial input - Gopal */
   Serial.begin(38400);
-  byte commandByte;
-  byte noteByte;
-  byte velocityByte;
- 
+  pinMode(13, OUTPUT);
 
-/* Pins setup */
-	YM_CTRL_DDR |= _BV(YM_IC) | _BV(YM_CS) | _BV(YM_WR) | _BV(YM_RD) | _BV(YM_A0) | _BV(YM_A1);
-	//YM_DATA_DDR = 0xFF;
-        YM_DATA_DDR = B11111100;
-	YM_MCLOCK_DDR |= _BV(YM_MCLOCK) | B00001100;
-	YM_CTRL_PORT |= _BV(YM_IC) | _BV(YM_CS) | _BV(YM_WR) | _BV(YM_RD); /* IC, CS, WR and RD HIGH by default */
-	YM_CTRL_PORT &= ~(_BV(YM_A0) | _BV(YM_A1)); /* A0 and A1 LOW by default */
-
-/* F_CPU / 2 clock generation */
-	TCCR1A = _BV(COM1A0);            /* Toggle OCA1 on compare match */
-	TCCR1B = _BV(WGM12) | _BV(CS10); /* CTC mode with prescaler /1 */
-	TCCR1C = 0;                      /* Flag reset */
-	TCNT1 = 0;                       /* Counter reset */
-	OCR1A = 0;                       /* Divide base clock by two */
+/* Pins setup and F_CPU / 2 clock generation */
+	Board::begin();
 
 /* Reset YM2612 */
-	YM_CTRL_PORT &= ~_BV(YM_IC);
-	_delay_ms(10);
-	YM_CTRL_PORT |= _BV(YM_IC);
-	_delay_ms(10);
+	YM2612Chip<Board>::resetChips();
+	ym.begin();
 
 /* YM2612 Test code */ 
 	setreg(0x22, 0x00); // LFO off
@@ -209,9 +159,10 @@ int main(void) {
 	setreg(0xAE, 0x22); // Set CH3 Operator 4 Frequency MSB first
 	setreg(0xAA, 0x69); // Set CH3 Operator 4 Frequency LSB second
 */
+}
 
 /* Program loop */
-	for(;;) {
+void loop() {
 //		setreg(0xA4, random(B00000000,B00111111)); // Set frequency Octave
 //              setreg(0xA0, random(B00000000,B11111111)); // Set Frequency Pitch
 //	        setreg(0xA4, 0x22); // Set CH1 frequency MSB first
@@ -220,23 +171,20 @@ int main(void) {
 //		setreg(0x28, 0xF0); // Key on
 //		_delay_ms(3000);
 //		setreg(0x28, 0x00); // Key off
-                
-                    do{
-                      if (Serial.available()){
-                        commandByte = Serial.read();//read first byte
-                        noteByte = Serial.read();//read next byte
-                        velocityByte = Serial.read();//read final byte
-                        if (commandByte == noteOn){//if note on message
-                          //check if note == 60 and velocity > 0
-                          if (noteByte == 60 && velocityByte > 0){
-                            digitalWrite(13,HIGH);//turn on led
-                          }
-                        }
-                      }
-                    }
-                    while (Serial.available() > 2);//when at least three bytes available
-
-/* Compiler fix */
-	return 0;
-}
 
+  if (Serial.available() < 3) //wait for three bytes
+    return;
+  byte commandByte = Serial.read();//read first byte
+  byte noteByte = Serial.read();//read next byte
+  byte velocityByte = Serial.read();//read final byte
+  //check if note == 60 and velocity > 0
+  if (commandByte == MIDI_NOTE_ON && noteByte == 60 && velocityByte > 0) {
+    digitalWrite(13,HIGH);//turn on led
+    setreg(0x28, 0xF0); // Key on
+  }
+  else if ((commandByte == MIDI_NOTE_OFF || commandByte == MIDI_NOTE_ON)
+           && noteByte == 60) {
+    digitalWrite(13,LOW);//turn off led
+    setreg(0x28, 0x00); // Key off
+  }
+}
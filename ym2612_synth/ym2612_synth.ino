@@ -14,25 +14,18 @@
  */
 
 /* Dependencies */
-#include <avr/io.h>     // For I/O and other AVR registers
-#include <util/delay.h> // For timing
+#include "Arduino.h"
+#include "../Trahagean/YM2612.h" // Chip driver and board profiles
 
-/* Pinmap (Arduino UNO compatible) */
-#define YM_IC (5) // PC5 (= pin A5 for Arduino UNO)
-#define YM_CS (4) // PC4 (= pin A4 for Arduino UNO)
-#define YM_WR (3) // PC3 (= pin A3 for Arduino UNO)
-#define YM_RD (2) // PC2 (= pin A2 for Arduino UNO)
-#define YM_A0 (1) // PC1 (= pin A1 for Arduino UNO)
-#define YM_A1 (0) // PC0 (= pin A0 for Arduino UNO)
-#define YM_CTRL_DDR DDRC
-#define YM_CTRL_PORT PORTC
-#define YM_DATA_DDR DDRD
-#define YM_DATA_PORT PORTD // Whole PORT D for data bus (= pins D0 to D7 for Arduino UNO)
-#define YM_MCLOCK (1) // PB1 = OC1A (= pin D9 for Arduino UNO)
-#define YM_MCLOCK_DDR DDRB
+/* Pinmap (Arduino UNO compatible), see PortDYmBoard in Board.h:
+ * IC on PC5 (A5), CS on PC4 (A4), WR on PC3 (A3), RD on PC2 (A2),
+ * A0 on PC1 (A1), A1 on PC0 (A0), the data bus on the whole PORT D (D0 to
+ * D7) and the master clock, F_CPU / 2, on PB1 = OC1A (D9) */
+typedef PortDYmBoard Board;
+YM2612Chip<Board> ym;
 
 /* ----- BIG WARNING FOR ARDUINO USERS -----
- * Normally ICSP port is used to program the AVR chip (see the makefile for details). 
+ * Normally ICSP port is used to program the AVR chip (see make upload in the top level Makefile). 
  * So, if you use an arduino UNO board to run this test code BE VERY CAREFULL.
  * If you don't known what you make you will be in trouble.
  *
@@ -40,58 +33,24 @@
  */
 
 /**
- * Send raw data to the YM2612
- * 
- * @author Furrtek
- * @param data Data to write
- */
-static void write_ym(uint8_t data) {
-	YM_CTRL_PORT &= ~_BV(YM_CS); // CS LOW
-	YM_DATA_PORT = data;
-	_delay_us(1);
-	YM_CTRL_PORT &= ~_BV(YM_WR); // Write data
-	_delay_us(5);
-	YM_CTRL_PORT |= _BV(YM_WR);
-	_delay_us(5);
-	YM_CTRL_PORT |= _BV(YM_CS); // CS HIGH
-}
-
-/**
- * Write data into a specific register of the YM2612
+ * Write data into a specific register of the YM2612 (part 1)
  *
- * @author Furrtek
  * @param reg Destination register address
  * @param data Data to write
  */
 static void setreg(uint8_t reg, uint8_t data) {
-	YM_CTRL_PORT &= ~_BV(YM_A0); // A0 low (select register)
-	write_ym(reg);
-	YM_CTRL_PORT |= _BV(YM_A0);  // A0 high (write register)
-	write_ym(data);
+	ym.writeReg(YM2612Map::PART1, reg, data);
 }
 
 /** Program entry point */
-int main(void) {
+void setup() {
+
+	/* Pins setup and F_CPU / 2 clock generation */
+	Board::begin();
 
-	/* Pins setup */
-	YM_CTRL_DDR |= _BV(YM_IC) | _BV(YM_CS) | _BV(YM_WR) | _BV(YM_RD) | _BV(YM_A0) | _BV(YM_A1);
-	YM_DATA_DDR = 0xFF;
-	YM_MCLOCK_DDR |= _BV(YM_MCLOCK);
-	YM_CTRL_PORT |= _BV(YM_IC) | _BV(YM_CS) | _BV(YM_WR) | _BV(YM_RD); /* IC, CS, WR and RD HIGH by default */
-	YM_CTRL_PORT &= ~(_BV(YM_A0) | _BV(YM_A1)); /* A0 and A1 LOW by default */
-	
-	/* F_CPU / 2 clock generation */
-	TCCR1A = _BV(COM1A0);            /* Toggle OCA1 on compare match */
-	TCCR1B = _BV(WGM12) | _BV(CS10); /* CTC mode with prescaler /1 */
-	TCCR1C = 0;                      /* Flag reset */
-	TCNT1 = 0;                       /* Counter reset */
-	OCR1A = 0;                       /* Divide base clock by two */
-	
 	/* Reset YM2612 */
-	YM_CTRL_PORT &= ~_BV(YM_IC);
-	_delay_ms(10);
-	YM_CTRL_PORT |= _BV(YM_IC);
-	_delay_ms(10);
+	YM2612Chip<Board>::resetChips();
+	ym.begin();
 
 	/* YM2612 Test code */ 
 	setreg(0x22, 0x00); // LFO off
@@ -135,15 +94,12 @@ int main(void) {
 	setreg(0x28, 0x00); // Key off
 	setreg(0xA4, 0x22);	// 
 	setreg(0xA0, 0x69); // Set frequency
+}
 
-	/* Program loop */
-	for(;;) {
-		_delay_ms(1000);
-		setreg(0x28, 0xF0); // Key on
-		_delay_ms(1000);
-		setreg(0x28, 0x00); // Key off
-	}
-	
-	/* Compiler fix */
-	return 0;
+/* Program loop */
+void loop() {
+	_delay_ms(1000);
+	setreg(0x28, 0xF0); // Key on
+	_delay_ms(1000);
+	setreg(0x28, 0x00); // Key off
 }